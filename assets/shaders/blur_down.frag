@@ -0,0 +1,23 @@
+#version 330 core
+
+layout(location=0) out vec4 o_colour;
+
+in vec2 v_texture_coordinates;
+
+uniform sampler2D u_texture;
+
+// NOTE(tbt): one step down the dual filter blur pyramid, to half the size
+//            - the corner taps are one source texel out, so each is the average of a 2x2 block diagonally around
+//              the 2x2 block under the centre tap
+
+void main()
+{
+ vec2 offset = 1.0 / textureSize(u_texture, 0);
+
+ o_colour = texture(u_texture, v_texture_coordinates) * 4.0;
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(-offset.x, -offset.y));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2( offset.x, -offset.y));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(-offset.x,  offset.y));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2( offset.x,  offset.y));
+ o_colour /= 8.0;
+}
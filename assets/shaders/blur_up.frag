@@ -0,0 +1,26 @@
+#version 330 core
+
+layout(location=0) out vec4 o_colour;
+
+in vec2 v_texture_coordinates;
+
+uniform sampler2D u_texture;
+
+// NOTE(tbt): one step up the dual filter blur pyramid, to twice the size
+//            - a ring of 4 taps one source texel out along the axes, and 4 at double weight half a texel out along the diagonals
+
+void main()
+{
+ vec2 offset = 1.0 / textureSize(u_texture, 0);
+ vec2 half_offset = offset * 0.5;
+
+ o_colour = texture(u_texture, v_texture_coordinates + vec2(-offset.x, 0.0));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2( offset.x, 0.0));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(0.0, -offset.y));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(0.0,  offset.y));
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(-half_offset.x, -half_offset.y)) * 2.0;
+ o_colour += texture(u_texture, v_texture_coordinates + vec2( half_offset.x, -half_offset.y)) * 2.0;
+ o_colour += texture(u_texture, v_texture_coordinates + vec2(-half_offset.x,  half_offset.y)) * 2.0;
+ o_colour += texture(u_texture, v_texture_coordinates + vec2( half_offset.x,  half_offset.y)) * 2.0;
+ o_colour /= 12.0;
+}
@@ -4,15 +4,41 @@ layout(location=0) in vec2 a_position;
 layout(location=1) in vec4 a_colour;
 layout(location=2) in vec2 a_texture_coordinates;
 
+// NOTE(tbt): per instance attributes, only used when u_is_instanced is set
+layout(location=3) in vec4 a_instance_rectangle;
+layout(location=4) in vec4 a_instance_texture_coordinates;
+layout(location=5) in vec4 a_instance_colour;
+layout(location=6) in float a_instance_angle;
+
 out vec4 v_colour;
 out vec2 v_texture_coordinates;
 
 uniform mat4 u_projection_matrix;
+uniform bool u_is_instanced;
 
 void main()
 {
- v_colour = a_colour;
- v_texture_coordinates = a_texture_coordinates;
- gl_Position = u_projection_matrix * vec4(a_position, 0.0, 1.0);
+ if (u_is_instanced)
+ {
+  // NOTE(tbt): the index buffer is shared with the per vertex path, so gl_VertexID is 0, 1, 2, 3 for bl, br, tr, tl
+  vec2 corner = vec2(gl_VertexID == 1 || gl_VertexID == 2 ? 1.0 : 0.0,
+                     gl_VertexID < 2 ? 1.0 : 0.0);
+  
+  // NOTE(tbt): rotate about the origin of the rectangle, then translate it into place
+  vec2 position = corner * a_instance_rectangle.zw;
+  float s = sin(a_instance_angle);
+  float c = cos(a_instance_angle);
+  position = vec2(position.x * c - position.y * s,
+                  position.x * s + position.y * c) + a_instance_rectangle.xy;
+  
+  v_colour = a_instance_colour;
+  v_texture_coordinates = mix(a_instance_texture_coordinates.xy, a_instance_texture_coordinates.zw, corner);
+  gl_Position = u_projection_matrix * vec4(position, 0.0, 1.0);
+ }
+ else
+ {
+  v_colour = a_colour;
+  v_texture_coordinates = a_texture_coordinates;
+  gl_Position = u_projection_matrix * vec4(a_position, 0.0, 1.0);
+ }
 }
-
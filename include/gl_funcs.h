@@ -1,5 +1,6 @@
 gl_func(ACTIVETEXTURE,           ActiveTexture);
 gl_func(ATTACHSHADER,            AttachShader);
+gl_func(BEGINQUERY,              BeginQuery);
 gl_func(BINDBUFFER,              BindBuffer);
 gl_func(BINDFRAMEBUFFER,         BindFramebuffer);
 gl_func(BINDTEXTURE,             BindTexture);
@@ -15,36 +16,49 @@ gl_func(CREATEPROGRAM,           CreateProgram);
 gl_func(CREATESHADER,            CreateShader);
 gl_func(DEBUGMESSAGECALLBACK,    DebugMessageCallback);
 gl_func(DELETEBUFFERS,           DeleteBuffers);
+gl_func(DELETEFRAMEBUFFERS,      DeleteFramebuffers);
 gl_func(DELETEPROGRAM,           DeleteProgram);
+gl_func(DELETEQUERIES,           DeleteQueries);
 gl_func(DELETESHADER,            DeleteShader);
 gl_func(DELETETEXTURES,          DeleteTextures);
 gl_func(DELETEVERTEXARRAYS,      DeleteVertexArrays);
 gl_func(DETACHSHADER,            DetachShader);
 gl_func(DISABLE,                 Disable);
 gl_func(DRAWELEMENTS,            DrawElements);
+gl_func(DRAWELEMENTSBASEVERTEX,  DrawElementsBaseVertex);
+gl_func(DRAWELEMENTSINSTANCED,   DrawElementsInstanced);
 gl_func(DRAWARRAYS,              DrawArrays);
 gl_func(ENABLE,                  Enable);
 gl_func(ENABLEVERTEXATTRIBARRAY, EnableVertexAttribArray);
+gl_func(ENDQUERY,                EndQuery);
 gl_func(FRAMEBUFFERTEXTURE2D,    FramebufferTexture2D);
 gl_func(GENBUFFERS,              GenBuffers);
 gl_func(GENFRAMEBUFFERS,         GenFramebuffers);
+gl_func(GENQUERIES,              GenQueries);
 gl_func(GENTEXTURES,             GenTextures);
 gl_func(GENVERTEXARRAYS,         GenVertexArrays);
 gl_func(GETERROR,                GetError);
 gl_func(GETPROGRAMIV,            GetProgramiv);
+gl_func(GETQUERYOBJECTIV,        GetQueryObjectiv);
+gl_func(GETQUERYOBJECTUI64V,     GetQueryObjectui64v);
 gl_func(GETUNIFORMLOCATION,      GetUniformLocation);
 gl_func(GETSHADERINFOLOG,        GetShaderInfoLog);
 gl_func(GETSHADERIV,             GetShaderiv);
 gl_func(LINKPROGRAM,             LinkProgram);
+gl_func(MAPBUFFERRANGE,          MapBufferRange);
+gl_func(READPIXELS,              ReadPixels);
 gl_func(SCISSOR,                 Scissor);
 gl_func(SHADERSOURCE,            ShaderSource);
 gl_func(TEXIMAGE2D,              TexImage2D);
 gl_func(TEXPARAMETERI,           TexParameteri);
+gl_func(TEXSUBIMAGE2D,           TexSubImage2D);
 gl_func(UNIFORMMATRIX4FV,        UniformMatrix4fv);
 gl_func(UNIFORM1I,               Uniform1i);
 gl_func(UNIFORM1F,               Uniform1f);
 gl_func(UNIFORM2F,               Uniform2f);
+gl_func(UNMAPBUFFER,             UnmapBuffer);
 gl_func(USEPROGRAM,              UseProgram);
+gl_func(VERTEXATTRIBDIVISOR,     VertexAttribDivisor);
 gl_func(VERTEXATTRIBPOINTER,     VertexAttribPointer);
 gl_func(VIEWPORT,                Viewport);
 #undef gl_func
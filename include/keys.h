@@ -0,0 +1,75 @@
+key(esc)
+key(F1)
+key(F2)
+key(F3)
+key(F4)
+key(F5)
+key(F6)
+key(F7)
+key(F8)
+key(F9)
+key(F10)
+key(F11)
+key(F12)
+key(grave_accent)
+key(0)
+key(1)
+key(2)
+key(3)
+key(4)
+key(5)
+key(6)
+key(7)
+key(8)
+key(9)
+key(minus)
+key(equal)
+key(backspace)
+key(delete)
+key(tab)
+key(a)
+key(b)
+key(c)
+key(d)
+key(e)
+key(f)
+key(g)
+key(h)
+key(i)
+key(j)
+key(k)
+key(l)
+key(m)
+key(n)
+key(o)
+key(p)
+key(q)
+key(r)
+key(s)
+key(t)
+key(u)
+key(v)
+key(w)
+key(x)
+key(y)
+key(z)
+key(space)
+key(enter)
+key(ctrl)
+key(shift)
+key(alt)
+key(up)
+key(left)
+key(down)
+key(right)
+key(page_up)
+key(page_down)
+key(home)
+key(end)
+key(forward_slash)
+key(period)
+key(comma)
+key(quote)
+key(left_bracket)
+key(right_bracket)
+#undef key
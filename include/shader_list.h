@@ -1,6 +1,7 @@
 shader(texture, default)
 shader(text, default)
-shader(blur, fullscreen)
+shader(blur_down, fullscreen)
+shader(blur_up, fullscreen)
 shader(post_processing, fullscreen)
 shader(memory_post_processing, fullscreen)
 #undef shader
\ No newline at end of file
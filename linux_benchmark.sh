@@ -0,0 +1,38 @@
+#!/bin/bash
+
+set -e
+
+# NOTE(tbt): runs every scenario in benchmarks/ through the headless platform layer and collects one line of JSON per scenario
+#            - scenarios are event scripts, or replays recorded with --record
+#            - any arguments are passed on to the headless platform layer, e.g. --software or --workers=4
+#            - levels are never saved, so a scenario that quits from the editor does not overwrite the assets
+
+RESULTS="bin/benchmark_results.jsonl"
+
+main(){
+TIMEFORMAT="done in %Rs"
+
+./linux_build.sh -m=release
+
+rm -f $RESULTS
+
+for SCENARIO in benchmarks/*
+do
+    echo -e "\033[35mrunning $SCENARIO.\033[0m"
+    
+    case $SCENARIO in
+        *.replay) INPUT="--replay=../$SCENARIO" ;;
+        *)        INPUT="--script=../$SCENARIO --frames=100000" ;;
+    esac
+    
+    time (cd bin && ./platform_linux_headless $INPUT --summary=../$RESULTS --no-saving "$@" > /dev/null)
+done
+
+echo ""
+cat $RESULTS
+
+echo ""
+TIMEFORMAT="total time taken: %Rs"
+}
+
+time main "$@"
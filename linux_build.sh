@@ -3,7 +3,6 @@
 set -e
 
 MODE="none"
-FULL="false"
 
 for i in "$@"
 do
@@ -12,10 +11,6 @@ case $i in
     MODE="${i#*=}"
     shift
     ;;
-    -f|--full)
-    FULL="true"
-    shift
-    ;;
     --default)
     shift 
     ;;
@@ -26,9 +21,9 @@ esac
 done
 
 if [ "$MODE" == "debug" ]; then
-    FLAGS="-DLUCERNA_DEBUG -g"
+    FLAGS="-DLUCERNA_DEBUG -g -msse4.1"
 elif [ "$MODE" == "release" ]; then
-    FLAGS="-O2 -msse2"
+    FLAGS="-O2 -msse4.1"
 elif [ "$MODE" == "none" ]; then
     echo -e "Must specify mode (-m={mode} or --mode={mode})"
     exit
@@ -40,23 +35,13 @@ fi
 main(){
 TIMEFORMAT="done in %Rs"
 
-if [ "$FULL" == "true" ]; then
-    pushd platform > /dev/null
-    ./linux_build.sh $MODE
-    popd > /dev/null
-
-    pushd meta > /dev/null
-    ./linux_build.sh
-    popd > /dev/null
-fi
+mkdir -p bin
 
-echo -e "\033[35mrunning lcddl.\033[0m"
-pushd bin > /dev/null
-time ./lcddl ./lcddl_user_layer.so ../assets/entities/*
-popd > /dev/null
+echo -e "\033[35mbuilding headless platform layer in $MODE mode.\033[0m"
+time gcc -Iinclude $FLAGS source/lucerna_linux_headless.c -rdynamic -ldl -lpthread -lm -o bin/platform_linux_headless
 
 echo -e "\033[35mbuilding game in $MODE mode.\033[0m"
-time gcc -Iinclude -fPIC -shared $FLAGS game/main.c -lGL -lm -o bin/liblucerna.so
+time gcc -Iinclude -fPIC -shared $FLAGS source/lucerna_game.c -lm -o bin/liblucerna.so
 
 echo ""
 TIMEFORMAT="total time taken: %Rs"
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+set -e
+
+main(){
+TIMEFORMAT="done in %Rs"
+
+mkdir -p bin
+
+echo -e "\033[35mbuilding asset packer.\033[0m"
+time gcc -Iinclude -O2 -msse4.1 source/lucerna_asset_packer.c -lm -o bin/asset_packer
+
+echo -e "\033[35mpacking assets.\033[0m"
+time (cd bin && ./asset_packer ../assets lucerna.pack)
+
+echo ""
+TIMEFORMAT="total time taken: %Rs"
+}
+
+time main
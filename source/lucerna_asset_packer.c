@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "lucerna_common.c"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// NOTE(tbt): offline tool which bakes everything in the assets directory into a single pack file
+//            - usage: asset_packer [assets directory] [output file]
+//            - run from the bin directory, so the default paths line up with the ones the game uses
+//            - images are decoded to RGBA8 up front, so the game never has to inflate a PNG at runtime
+//            - everything else is copied as is
+
+internal MemoryArena global_packer_memory;
+
+typedef struct
+{
+ I8 *path;
+ B32 is_texture;
+} AssetPackerFile;
+
+internal AssetPackerFile *global_files = NULL;
+internal U64 global_file_count = 0;
+internal U64 global_file_capacity = 0;
+
+internal void
+asset_packer_push_file(I8 *path)
+{
+ if (global_file_count == global_file_capacity)
+ {
+  global_file_capacity = max_u(global_file_capacity * 2, 64);
+  global_files = realloc(global_files, global_file_capacity * sizeof(global_files[0]));
+ }
+ 
+ AssetPackerFile *file = &global_files[global_file_count++];
+ file->path = s8_from_format_string(&global_packer_memory, "%s", path).buffer;
+ 
+ I32 width, height;
+ file->is_texture = stbi_info(path, &width, &height, NULL);
+}
+
+internal void
+asset_packer_gather_files(I8 *directory)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+ // NOTE(tbt): the paths pushed are kept in global_packer_memory until the pack is written, so only the search
+ //            string is scratch
+ I8 search[MAX_PATH];
+ snprintf(search, sizeof(search), "%s/*", directory);
+ 
+ WIN32_FIND_DATAA find_data;
+ HANDLE find = FindFirstFileA(search, &find_data);
+ if (INVALID_HANDLE_VALUE != find)
+ {
+  do
+  {
+   if ('.' == find_data.cFileName[0]) { continue; }
+   
+   I8 *path = s8_from_format_string(&global_packer_memory, "%s/%s", directory, find_data.cFileName).buffer;
+   if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+   {
+    asset_packer_gather_files(path);
+   }
+   else
+   {
+    asset_packer_push_file(path);
+   }
+  } while (FindNextFileA(find, &find_data));
+  
+  FindClose(find);
+ }
+#else
+ DIR *dir = opendir(directory);
+ if (dir)
+ {
+  struct dirent *entry;
+  while ((entry = readdir(dir)))
+  {
+   if ('.' == entry->d_name[0]) { continue; }
+   
+   I8 *path = s8_from_format_string(&global_packer_memory, "%s/%s", directory, entry->d_name).buffer;
+   
+   struct stat path_stat;
+   if (0 != stat(path, &path_stat)) { continue; }
+   
+   if (S_ISDIR(path_stat.st_mode))
+   {
+    asset_packer_gather_files(path);
+   }
+   else if (S_ISREG(path_stat.st_mode))
+   {
+    asset_packer_push_file(path);
+   }
+  }
+  
+  closedir(dir);
+ }
+#endif
+}
+
+internal int
+asset_packer_compare_files(const void *a,
+                           const void *b)
+{
+ return strcmp(((AssetPackerFile *)a)->path, ((AssetPackerFile *)b)->path);
+}
+
+internal void
+asset_packer_write_padding(FILE *f)
+{
+ persist U8 zeroes[ASSET_PACK_DATA_ALIGNMENT] = {0};
+ U64 offset = ftell(f);
+ fwrite(zeroes, 1, align_forward(offset, ASSET_PACK_DATA_ALIGNMENT) - offset, f);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+ initialise_arena_with_new_memory(&global_packer_memory, 16 * ONE_MB);
+ 
+ I8 *assets_directory = argc > 1 ? argv[1] : "../assets";
+ I8 *output_path = argc > 2 ? argv[2] : "lucerna.pack";
+ 
+ asset_packer_gather_files(assets_directory);
+ qsort(global_files, global_file_count, sizeof(global_files[0]), asset_packer_compare_files);
+ 
+ FILE *f = fopen(output_path, "wb");
+ if (!f)
+ {
+  fprintf(stderr, "could not open '%s' for writing\n", output_path);
+  return -1;
+ }
+ 
+ AssetPackEntry *entries = calloc(global_file_count, sizeof(entries[0]));
+ U64 entry_count = 0;
+ U64 texture_count = 0;
+ 
+ AssetPackHeader header = {0};
+ fwrite(&header, sizeof(header), 1, f);
+ 
+ for (U64 i = 0;
+      i < global_file_count;
+      ++i)
+ {
+  AssetPackerFile *file = &global_files[i];
+  
+  if (strlen(file->path) >= ASSET_PACK_PATH_SIZE)
+  {
+   fprintf(stderr, "skipping '%s' - path too long\n", file->path);
+   continue;
+  }
+  
+  asset_packer_write_padding(f);
+  
+  AssetPackEntry *entry = &entries[entry_count];
+  memset(entry, 0, sizeof(*entry));
+  strcpy(entry->path, file->path);
+  entry->offset = ftell(f);
+  
+  if (file->is_texture)
+  {
+   U8 *pixels = stbi_load(file->path, &entry->width, &entry->height, NULL, 4);
+   if (!pixels)
+   {
+    fprintf(stderr, "skipping '%s' - %s\n", file->path, stbi_failure_reason());
+    continue;
+   }
+   
+   entry->kind = ASSET_PACK_ENTRY_KIND_texture;
+   entry->size = (U64)entry->width * (U64)entry->height * 4;
+   fwrite(pixels, 1, entry->size, f);
+   
+   stbi_image_free(pixels);
+   texture_count += 1;
+  }
+  else
+  {
+   FILE *source = fopen(file->path, "rb");
+   if (!source)
+   {
+    fprintf(stderr, "skipping '%s' - could not open\n", file->path);
+    continue;
+   }
+   
+   fseek(source, 0, SEEK_END);
+   entry->size = ftell(source);
+   fseek(source, 0, SEEK_SET);
+   
+   U8 *contents = malloc(entry->size + 1);
+   fread(contents, 1, entry->size, source);
+   contents[entry->size] = 0;
+   fwrite(contents, 1, entry->size + 1, f);
+   
+   free(contents);
+   fclose(source);
+   
+   entry->kind = ASSET_PACK_ENTRY_KIND_file;
+  }
+  
+  entry_count += 1;
+ }
+ 
+ asset_packer_write_padding(f);
+ 
+ header.magic = ASSET_PACK_MAGIC;
+ header.version = ASSET_PACK_VERSION;
+ header.entry_count = entry_count;
+ header.entries_offset = ftell(f);
+ fwrite(entries, sizeof(entries[0]), entry_count, f);
+ 
+ U64 pack_size = ftell(f);
+ 
+ fseek(f, 0, SEEK_SET);
+ fwrite(&header, sizeof(header), 1, f);
+ fclose(f);
+ 
+ fprintf(stderr,
+         "packed %llu assets (%llu textures) into '%s' - %.2fMB\n",
+         (unsigned long long)entry_count,
+         (unsigned long long)texture_count,
+         output_path,
+         pack_size / (F64)ONE_MB);
+ 
+ return 0;
+}
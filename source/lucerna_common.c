@@ -33,17 +33,35 @@ typedef uint32_t B32;
 typedef float    B32_s;
 
 #include "errno.h"
+#include <stdarg.h>
 
 //
 // NOTE(tbt): logging
 //~
 
 #ifdef LUCERNA_DEBUG
-#define debug_log(_fmt, ...) fprintf(stderr, _fmt, __VA_ARGS__)
+#define debug_log(_fmt, ...) fprintf(stderr, _fmt, ##__VA_ARGS__)
 #else
 #define debug_log(_fmt, ...) 
 #endif
 
+//
+// NOTE(tbt): atomics
+//~
+
+// NOTE(tbt): for flags and states shared between threads - stores release and loads acquire, so everything written
+//            before a store is visible to the thread which loads the value stored
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define atomic_load_acquire_u32(_pointer) ((U32)_InterlockedOr((volatile long *)(_pointer), 0))
+#define atomic_store_release_u32(_pointer, _value) _InterlockedExchange((volatile long *)(_pointer), (_value))
+#define atomic_compare_exchange_u32(_pointer, _expected, _desired) ((_expected) == (U32)_InterlockedCompareExchange((volatile long *)(_pointer), (_desired), (_expected)))
+#else
+#define atomic_load_acquire_u32(_pointer) __atomic_load_n((_pointer), __ATOMIC_ACQUIRE)
+#define atomic_store_release_u32(_pointer, _value) __atomic_store_n((_pointer), (_value), __ATOMIC_RELEASE)
+#define atomic_compare_exchange_u32(_pointer, _expected, _desired) __sync_bool_compare_and_swap((_pointer), (_expected), (_desired))
+#endif
+
 //
 // NOTE(tbt): handle DLL on windows
 //~
@@ -64,6 +82,18 @@ internal U32 calculate_utf8_cstring_size(U8 *cstring);
 // NOTE(tbt): arenas
 //~
 
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #define initialise_arena_with_new_memory(_arena, _size) initialise_arena(_arena, malloc(_size), _size)
 
 enum
@@ -75,12 +105,18 @@ enum
 
 enum { ARENA_DEFAULT_ALIGNMENT = 2 * sizeof(void *) };
 
+enum { ARENA_COMMIT_SIZE = 64 * ONE_KB };
+
 typedef struct
 {
  U8 *buffer;         // NOTE(tbt): backing memory
- U64 buffer_size;    // NOTE(tbt): size of the backing memory in bytes
+ U64 buffer_size;    // NOTE(tbt): size of the backing memory in bytes - for growable arenas, the size of the reserved address range
  U64 current_offset; // NOTE(tbt): index to allocate from
  U64 saved_offset;   // NOTE(tbt): 'checkpoint' to return to when the temporary memory scope exits
+ U64 high_water_mark; // NOTE(tbt): most bytes ever in use at once
+ U64 committed_size; // NOTE(tbt): how much of the backing memory is actually backed by pages
+ U64 retained_size;  // NOTE(tbt): growable arenas never decommit below this many bytes
+ B32 is_growable;
 } MemoryArena;
 
 internal void
@@ -92,8 +128,184 @@ initialise_arena(MemoryArena *arena,
  arena->buffer_size = size;
  arena->current_offset = 0;
  arena->saved_offset = 0;
+ arena->high_water_mark = 0;
+ arena->committed_size = size;
+ arena->retained_size = size;
+ arena->is_growable = false;
+}
+
+// NOTE(tbt): growable arenas reserve a large range of address space up front, but only commit pages to it in
+//            ARENA_COMMIT_SIZE chunks as it is pushed to
+//            - freeing or ending a temporary memory scope gives pages back to the OS, down to retained_size, so
+//              one off spikes don't stay resident for the rest of the run
+//            - pick retained_size to cover what the arena normally needs, otherwise it will commit and decommit
+//              the same pages over and over
+internal void
+initialise_arena_with_reserved_memory(MemoryArena *arena,
+                                      U64 reserved_size,
+                                      U64 retained_size)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+ void *backing_memory = VirtualAlloc(NULL, reserved_size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+ void *backing_memory = mmap(NULL, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+ if (MAP_FAILED == backing_memory) { backing_memory = NULL; }
+#endif
+ 
+ initialise_arena(arena, backing_memory, backing_memory ? reserved_size : 0);
+ arena->committed_size = 0;
+ arena->retained_size = retained_size;
+ arena->is_growable = true;
+}
+
+//-NOTE(tbt): call site telemetry
+
+// NOTE(tbt): in debug builds every arena_push is counted against the file and line it came from, so arenas can be sized
+//            from real numbers
+//            - a fixed size open addressing table, keyed by the __FILE__ pointer and line
+//            - arenas can be pushed to from worker threads, so slots are claimed and counted with atomics
+//            - each module which includes this file has its own table
+
+#ifdef LUCERNA_DEBUG
+
+enum { ARENA_CALL_SITE_BUCKETS = 2048 }; // NOTE(tbt): must be a power of 2
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define arena_atomic_add_u64(_pointer, _value) _InterlockedExchangeAdd64((volatile __int64 *)(_pointer), (_value))
+#define arena_atomic_compare_exchange_u64(_pointer, _expected, _desired) ((_expected) == (U64)_InterlockedCompareExchange64((volatile __int64 *)(_pointer), (_desired), (_expected)))
+#else
+#define arena_atomic_add_u64(_pointer, _value) __atomic_fetch_add((_pointer), (_value), __ATOMIC_RELAXED)
+#define arena_atomic_compare_exchange_u64(_pointer, _expected, _desired) __sync_bool_compare_and_swap((_pointer), (_expected), (_desired))
+#endif
+
+typedef struct
+{
+ volatile U64 key; // NOTE(tbt): 0 for an empty slot
+ U8 *arena_name;
+ U8 *file;
+ I32 line;
+ volatile U64 push_count;
+ volatile U64 bytes; // NOTE(tbt): total over the whole run, including memory since freed
+} ArenaCallSite;
+
+internal ArenaCallSite global_arena_call_sites[ARENA_CALL_SITE_BUCKETS];
+internal volatile U64 global_arena_dropped_call_sites;
+
+internal void
+arena_record_push(U8 *arena_name,
+                  U8 *file,
+                  I32 line,
+                  U64 size)
+{
+ // NOTE(tbt): user space pointers fit in the low 48 bits
+ U64 key = ((U64)(uintptr_t)file) ^ ((U64)line << 48);
+ U64 hash = key * 0x9e3779b97f4a7c15ULL;
+ 
+ for (U64 probe = 0;
+      probe < ARENA_CALL_SITE_BUCKETS;
+      ++probe)
+ {
+  ArenaCallSite *site = &global_arena_call_sites[((hash >> 40) + probe) & (ARENA_CALL_SITE_BUCKETS - 1)];
+  
+  if (site->key != key)
+  {
+   if (0 != site->key ||
+       !arena_atomic_compare_exchange_u64(&site->key, 0, key))
+   {
+    // NOTE(tbt): someone else claimed the slot first - it might have been for this call site though
+    if (site->key != key) { continue; }
+   }
+   else
+   {
+    site->arena_name = arena_name;
+    site->file = file;
+    site->line = line;
+   }
+  }
+  
+  arena_atomic_add_u64(&site->push_count, 1);
+  arena_atomic_add_u64(&site->bytes, size);
+  return;
+ }
+ 
+ arena_atomic_add_u64(&global_arena_dropped_call_sites, 1);
+}
+
+#endif
+
+//-NOTE(tbt): committing and decommitting pages for growable arenas
+
+internal B32
+arena_commit(MemoryArena *arena,
+             U64 size)
+{
+ if (size <= arena->committed_size)
+ {
+  return true;
+ }
+ 
+ if (size > arena->buffer_size)
+ {
+  return false;
+ }
+ 
+ U64 new_committed_size = (size + ARENA_COMMIT_SIZE - 1) & ~((U64)ARENA_COMMIT_SIZE - 1);
+ if (new_committed_size > arena->buffer_size)
+ {
+  new_committed_size = arena->buffer_size;
+ }
+ 
+ U8 *start = arena->buffer + arena->committed_size;
+ U64 commit_size = new_committed_size - arena->committed_size;
+ 
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+ B32 success = (NULL != VirtualAlloc(start, commit_size, MEM_COMMIT, PAGE_READWRITE));
+#else
+ B32 success = (0 == mprotect(start, commit_size, PROT_READ | PROT_WRITE));
+#endif
+ 
+ if (success)
+ {
+  arena->committed_size = new_committed_size;
+ }
+ 
+ return success;
+}
+
+internal void
+arena_decommit_above(MemoryArena *arena,
+                     U64 size)
+{
+ if (!arena->is_growable)
+ {
+  return;
+ }
+ 
+ if (size < arena->retained_size)
+ {
+  size = arena->retained_size;
+ }
+ size = (size + ARENA_COMMIT_SIZE - 1) & ~((U64)ARENA_COMMIT_SIZE - 1);
+ 
+ if (size < arena->committed_size)
+ {
+  U8 *start = arena->buffer + size;
+  U64 decommit_size = arena->committed_size - size;
+  
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  VirtualFree(start, decommit_size, MEM_DECOMMIT);
+#else
+  madvise(start, decommit_size, MADV_DONTNEED);
+  mprotect(start, decommit_size, PROT_NONE);
+#endif
+  
+  arena->committed_size = size;
+ }
 }
 
+//-NOTE(tbt): arena operations
+
 internal U64
 align_forward(uintptr_t pointer, U64 align)
 {
@@ -127,13 +339,22 @@ arena_push_FUNCTION(MemoryArena *memory,
  uintptr_t offset = align_forward(current_pointer, alignment) -
   (uintptr_t)memory->buffer;
  
- if (offset + size <= memory->buffer_size)
+ if (offset + size <= memory->buffer_size &&
+     arena_commit(memory, offset + size))
  {
   void *result = memory->buffer + offset;
   memory->current_offset = offset + size;
+  if (memory->current_offset > memory->high_water_mark)
+  {
+   memory->high_water_mark = memory->current_offset;
+  }
   
   memset(result, 0, size);
   
+#ifdef LUCERNA_DEBUG
+  arena_record_push(arena_name, file, line, size);
+#endif
+  
   return result;
  }
  else
@@ -161,6 +382,7 @@ arena_free_all(MemoryArena *memory)
 {
  memory->current_offset = 0;
  memory->saved_offset = 0;
+ arena_decommit_above(memory, 0);
 }
 
 #define arena_temporary_memory(_memory) defer_loop(arena_begin_temporary_memory(_memory), arena_end_temporary_memory(_memory))
@@ -175,6 +397,7 @@ internal void
 arena_end_temporary_memory(MemoryArena *memory)
 {
  memory->current_offset = memory->saved_offset;
+ arena_decommit_above(memory, memory->current_offset);
 }
 
 //
@@ -387,8 +610,8 @@ rect_match(Rect a,
            Rect b)
 {
  B32 eq[4];
- __m128 _a = _mm_load_ps((F32 *)&a);
- __m128 _b = _mm_load_ps((F32 *)&b);
+ __m128 _a = _mm_loadu_ps((F32 *)&a);
+ __m128 _b = _mm_loadu_ps((F32 *)&b);
  __m128 mask = _mm_cmpeq_ps(_a, _b);
  _mm_store_ps((F32 *)eq, mask);
  
@@ -566,6 +789,44 @@ hash_s8(S8 string,
  return hash % bounds;
 }
 
+// NOTE(tbt): 64 bit FNV-1a, continuing on from `hash` so that several inputs can be combined
+//            - start from HASH_64_SEED
+#define HASH_64_SEED 0xcbf29ce484222325ULL
+
+internal U64
+hash_64_from_bytes(U64 hash,
+                   void *bytes,
+                   U64 size)
+{
+ for (U64 i = 0;
+      i < size;
+      ++i)
+ {
+  hash ^= ((U8 *)bytes)[i];
+  hash *= 0x100000001b3ULL;
+ }
+ 
+ return hash;
+}
+
+// NOTE(tbt): mixes a whole word in at a time - much cheaper than hash_64_from_bytes when hashing lots of small values
+internal U64
+hash_64_combine(U64 hash,
+                U64 value)
+{
+ hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+ hash *= 0xbf58476d1ce4e5b9ULL;
+ return hash ^ (hash >> 31);
+}
+
+internal U64
+u64_from_f32s(F32 a,
+              F32 b)
+{
+ union { F32 f[2]; U64 u; } result = { { a, b } };
+ return result.u;
+}
+
 internal B32
 s8_match(S8 a,
          S8 b)
@@ -661,7 +922,7 @@ typedef enum
  CURSOR_ADVANCE_MODE_word,
 } CursorAdvanceMode;
 
-internal inline is_utf8_continuation_byte(S8 string, U32 index);
+internal inline B32 is_utf8_continuation_byte(S8 string, U32 index);
 
 internal void
 advance_cursor(S8 string,
@@ -957,7 +1218,7 @@ utf8_from_codepoint(U8 *buffer,
  return advance;
 }
 
-internal inline
+internal inline B32
 is_utf8_continuation_byte(S8 string,
                           U32 index)
 {
@@ -1061,83 +1322,8 @@ s8_concatenate(MemoryArena *temp_memory,
 typedef enum
 {
  KEY_none,
- KEY_esc,
- KEY_F1,
- KEY_F2,
- KEY_F3,
- KEY_F4,
- KEY_F5,
- KEY_F6,
- KEY_F7,
- KEY_F8,
- KEY_F9,
- KEY_F10,
- KEY_F11,
- KEY_F12,
- KEY_grave_accent,
- KEY_0,
- KEY_1,
- KEY_2,
- KEY_3,
- KEY_4,
- KEY_5,
- KEY_6,
- KEY_7,
- KEY_8,
- KEY_9,
- KEY_minus,
- KEY_equal,
- KEY_backspace,
- KEY_delete,
- KEY_tab,
- KEY_a,
- KEY_b,
- KEY_c,
- KEY_d,
- KEY_e,
- KEY_f,
- KEY_g,
- KEY_h,
- KEY_i,
- KEY_j,
- KEY_k,
- KEY_l,
- KEY_m,
- KEY_n,
- KEY_o,
- KEY_p,
- KEY_q,
- KEY_r,
- KEY_s,
- KEY_t,
- KEY_u,
- KEY_v,
- KEY_w,
- KEY_x,
- KEY_y,
- KEY_z,
- KEY_space,
- KEY_enter,
- KEY_ctrl,
- KEY_shift,
- KEY_alt,
- KEY_up,
- KEY_left,
- KEY_down,
- KEY_right,
- KEY_page_up,
- KEY_page_down,
- KEY_home,
- KEY_end,
- KEY_forward_slash,
- KEY_period,
- KEY_comma,
- KEY_quote,
- KEY_left_bracket,
- KEY_right_bracket,
- 
- 
- 
+#define key(_name) KEY_ ## _name,
+#include "keys.h"
  KEY_MAX,
 } Key;
 
@@ -1231,6 +1417,13 @@ typedef struct
  U32 window_w, window_h;
 } PlatformState;
 
+// NOTE(tbt): memory for the game to render into on the CPU, for when there is no GPU to use
+typedef struct
+{
+ U32 *pixels; // NOTE(tbt): RGBA8, top row first
+ U32 w, h;    // NOTE(tbt): kept the same as the window size by the platform layer
+} PlatformFramebuffer;
+
 //
 // NOTE(tbt): event handling helpers
 //~
@@ -1284,11 +1477,28 @@ typedef struct
 // NOTE(tbt): functions in the game called by the platform layer
 //~
 
-typedef void ( *GameInit) (OpenGLFunctions *gl);                                                       // NOTE(tbt): called after the platform layer has finished setup - last thing before entering the main loop
+typedef void ( *GameInit) (OpenGLFunctions *gl, PlatformFramebuffer *software_framebuffer);            // NOTE(tbt): called after the platform layer has finished setup - last thing before entering the main loop. renders with the software renderer if software_framebuffer is not NULL
 typedef void ( *GameUpdateAndRender) (PlatformState *input, F64 frametime_in_s);  // NOTE(tbt): called every frame
 typedef void ( *GameAudioCallback) (void *buffer, U64 buffer_size);                                    // NOTE(tbt): called from the audio thread when the buffer needs refilling
 typedef void ( *GameCleanup) (void);                                      // NOTE(tbt): called when the window is closed and the main loop exits
 
+// NOTE(tbt): optional - only looked up by the headless platform layer, for benchmarking
+typedef struct
+{
+ U64 static_memory_high_water_mark;
+ U64 frame_memory_high_water_mark;
+ U64 level_memory_high_water_mark;
+ U64 temp_memory_high_water_mark;
+ U64 draw_call_count; // NOTE(tbt): for the last frame
+ U64 blur_pass_count; // NOTE(tbt): for the last frame
+ U64 blur_passes_saved; // NOTE(tbt): for the last frame, by sharing and reusing blurs
+ U64 render_target_bytes; // NOTE(tbt): held by offscreen render targets at the end of the last frame
+ U64 render_target_allocation_count; // NOTE(tbt): for the last frame
+} GameStats;
+typedef void ( *GameGetStats) (GameStats *stats);
+typedef void ( *GameLoadBenchmarkLevel) (U32 entity_count);
+typedef void ( *GameDisableLevelSaving) (void);
+
 //
 // NOTE(tbt): functions in the platform layer called by the game
 //~
@@ -1309,6 +1519,26 @@ LC_API void platform_toggle_fullscreen(void);
 LC_API void platform_set_clipboard_text(S8 text);
 LC_API S8 platform_get_clipboard_text(MemoryArena *memory);
 
+// NOTE(tbt): high resolution timer - seconds since some arbitrary point
+LC_API F64 platform_get_time(void);
+
+// NOTE(tbt): pool of worker threads for splitting up CPU heavy work
+//            - work should only be pushed from the main thread
+//            - the calling thread helps out with any remaining work while waiting in platform_complete_all_work
+typedef void ( *PlatformWorkFunction) (void *data);
+LC_API void platform_push_work(PlatformWorkFunction function, void *data);
+LC_API void platform_complete_all_work(void);
+LC_API U32 platform_get_worker_count(void); // NOTE(tbt): not including the calling thread
+LC_API U32 platform_get_thread_index(void); // NOTE(tbt): 0 on the main thread, 1 to platform_get_worker_count() on worker threads
+
+// NOTE(tbt): a few more low priority threads for long running work, such as decoding assets, which a frame shouldn't wait on
+//            - not waited on by platform_complete_all_work, so the game has to check for itself when it is done
+//            - work should only be pushed from the main thread
+//            - background work must not draw anything
+LC_API void platform_push_background_work(PlatformWorkFunction function, void *data);
+LC_API B32 platform_is_background_work_complete(void);
+LC_API void platform_complete_all_background_work(void); // NOTE(tbt): the calling thread helps out while waiting
+
 // NOTE(tbt): basic file IO
 typedef struct PlatformFile PlatformFile;
 
@@ -1338,5 +1568,247 @@ LC_API U64 platform_read_file_p(S8 path, U64 offset, U64 read_size, void *buffer
 LC_API U64 platform_write_entire_file_p(S8 path, void *buffer, U64 buffer_size);
 LC_API U64 platform_append_to_file_p(S8 path, void *buffer, U64 buffer_size);
 
+// NOTE(tbt): writes to a temporary file next to `path`, flushes it to disk and then renames it over `path`
+//            - `path` is left with either the old or the new contents if the game dies part way through
+//            - doesn't use the platform layer's memory, so is safe to call from background work
+LC_API B32 platform_write_entire_file_atomic_p(S8 path, void *buffer, U64 buffer_size);
+
+// NOTE(tbt): read only view of an entire file, which stays valid until it is unmapped
+//            - returns an empty string if the file could not be mapped
+LC_API S8 platform_map_entire_file_p(S8 path);
+LC_API void platform_unmap_file(S8 *file);
+
+//
+// NOTE(tbt): asset pack format
+//~
+
+// NOTE(tbt): written offline by lucerna_asset_packer.c, and mapped by the game at startup
+//            - header, then the data for each entry, then the table of entries
+//            - entries are sorted by path so they can be binary searched
+//            - paths are spelled exactly as the game spells them, e.g. "../assets/textures/player.png"
+
+#define ASSET_PACK_MAGIC 0x00004b434150434cULL // NOTE(tbt): "LCPACK" in a little endian U64
+#define ASSET_PACK_PATH_SIZE 128
+
+enum
+{
+ ASSET_PACK_VERSION = 1,
+ ASSET_PACK_DATA_ALIGNMENT = 16,
+};
+
+typedef struct
+{
+ U64 magic;
+ U64 version;
+ U64 entry_count;
+ U64 entries_offset;
+} AssetPackHeader;
+
+typedef enum
+{
+ ASSET_PACK_ENTRY_KIND_file,    // NOTE(tbt): copied as is, followed by a zero byte which isn't counted in `size`
+ ASSET_PACK_ENTRY_KIND_texture, // NOTE(tbt): decoded RGBA8 pixels, `width` * `height` * 4 bytes, top row first
+} AssetPackEntryKind;
+
+typedef struct
+{
+ U8 path[ASSET_PACK_PATH_SIZE];
+ U64 offset;
+ U64 size;
+ U32 kind;
+ I32 width;
+ I32 height;
+ U32 _unused;
+} AssetPackEntry;
+
+//
+// NOTE(tbt): replay format
+//~
+
+// NOTE(tbt): a recording of the input the platform layer gave the game, frame by frame
+//            - header, then for each frame a ReplayFrame followed by its `event_count` ReplayEvents
+//            - events are stored in the same order as the list they came from, so playback rebuilds an identical list
+//            - key and mouse button state is stored as bitsets, so a frame with no input is only a few dozen bytes
+
+#define REPLAY_MAGIC 0x0059414c5045524cULL // NOTE(tbt): "LREPLAY" in a little endian U64
+
+enum
+{
+ REPLAY_VERSION = 1,
+};
+
+typedef struct
+{
+ U64 magic;
+ U64 version;
+} ReplayHeader;
+
+typedef struct
+{
+ F64 frametime_in_s; // NOTE(tbt): as measured while recording
+ U32 event_count;
+ U32 window_w, window_h;
+ I32 mouse_x, mouse_y;
+ I32 mouse_scroll_h, mouse_scroll_v;
+ U8 is_key_down[(KEY_MAX + 7) / 8];
+ U8 is_mouse_button_down[(MOUSE_BUTTON_MAX + 7) / 8];
+} ReplayFrame;
+
+typedef struct
+{
+ U32 kind;
+ U32 key;
+ U32 mouse_button;
+ U32 modifiers;
+ F32 mouse_x, mouse_y;
+ I32 mouse_scroll_h, mouse_scroll_v;
+ U32 character;
+ U32 window_w, window_h;
+} ReplayEvent;
+
+// NOTE(tbt): the bytes to append to a replay for one frame
+internal S8
+replay_s8_from_frame(MemoryArena *memory,
+                     PlatformState *input,
+                     F64 frametime_in_s)
+{
+ ReplayFrame frame = {0};
+ frame.frametime_in_s = frametime_in_s;
+ frame.window_w = input->window_w;
+ frame.window_h = input->window_h;
+ frame.mouse_x = input->mouse_x;
+ frame.mouse_y = input->mouse_y;
+ frame.mouse_scroll_h = input->mouse_scroll_h;
+ frame.mouse_scroll_v = input->mouse_scroll_v;
+ 
+ for (I32 key = 0;
+      key < KEY_MAX;
+      ++key)
+ {
+  if (input->is_key_down[key]) { frame.is_key_down[key / 8] |= 1 << (key % 8); }
+ }
+ 
+ for (I32 button = 0;
+      button < MOUSE_BUTTON_MAX;
+      ++button)
+ {
+  if (input->is_mouse_button_down[button]) { frame.is_mouse_button_down[button / 8] |= 1 << (button % 8); }
+ }
+ 
+ for (PlatformEvent *event = input->events;
+      NULL != event;
+      event = event->next)
+ {
+  frame.event_count += 1;
+ }
+ 
+ S8 result;
+ result.size = sizeof(frame) + frame.event_count * sizeof(ReplayEvent);
+ result.buffer = arena_push(memory, result.size);
+ 
+ memcpy(result.buffer, &frame, sizeof(frame));
+ 
+ ReplayEvent *replay_events = (ReplayEvent *)(result.buffer + sizeof(frame));
+ for (PlatformEvent *event = input->events;
+      NULL != event;
+      event = event->next)
+ {
+  *replay_events++ = (ReplayEvent)
+  {
+   .kind = event->kind,
+   .key = event->key,
+   .mouse_button = event->mouse_button,
+   .modifiers = event->modifiers,
+   .mouse_x = event->mouse_x,
+   .mouse_y = event->mouse_y,
+   .mouse_scroll_h = event->mouse_scroll_h,
+   .mouse_scroll_v = event->mouse_scroll_v,
+   .character = event->character,
+   .window_w = event->window_w,
+   .window_h = event->window_h,
+  };
+ }
+ 
+ return result;
+}
+
+internal B32
+replay_is_valid(S8 replay)
+{
+ ReplayHeader *header = (ReplayHeader *)replay.buffer;
+ return (replay.size >= sizeof(*header) &&
+         REPLAY_MAGIC == header->magic &&
+         REPLAY_VERSION == header->version);
+}
+
+// NOTE(tbt): overwrites all of `input` with the next frame, allocating the events from `memory`
+//            - `offset` should start just after the header
+//            - returns false once there are no frames left
+internal B32
+replay_read_frame(MemoryArena *memory,
+                  S8 replay,
+                  U64 *offset,
+                  PlatformState *input,
+                  F64 *frametime_in_s)
+{
+ ReplayFrame frame;
+ if (*offset + sizeof(frame) > replay.size) { return false; }
+ memcpy(&frame, replay.buffer + *offset, sizeof(frame));
+ 
+ if (*offset + sizeof(frame) + frame.event_count * sizeof(ReplayEvent) > replay.size) { return false; }
+ *offset += sizeof(frame);
+ 
+ *frametime_in_s = frame.frametime_in_s;
+ input->window_w = frame.window_w;
+ input->window_h = frame.window_h;
+ input->mouse_x = frame.mouse_x;
+ input->mouse_y = frame.mouse_y;
+ input->mouse_scroll_h = frame.mouse_scroll_h;
+ input->mouse_scroll_v = frame.mouse_scroll_v;
+ 
+ for (I32 key = 0;
+      key < KEY_MAX;
+      ++key)
+ {
+  input->is_key_down[key] = !!(frame.is_key_down[key / 8] & (1 << (key % 8)));
+ }
+ 
+ for (I32 button = 0;
+      button < MOUSE_BUTTON_MAX;
+      ++button)
+ {
+  input->is_mouse_button_down[button] = !!(frame.is_mouse_button_down[button / 8] & (1 << (button % 8)));
+ }
+ 
+ input->events = NULL;
+ PlatformEvent **last = &input->events;
+ for (U32 event_index = 0;
+      event_index < frame.event_count;
+      ++event_index)
+ {
+  ReplayEvent replay_event;
+  memcpy(&replay_event, replay.buffer + *offset, sizeof(replay_event));
+  *offset += sizeof(replay_event);
+  
+  PlatformEvent *event = arena_push(memory, sizeof(*event));
+  event->kind = replay_event.kind;
+  event->key = replay_event.key;
+  event->mouse_button = replay_event.mouse_button;
+  event->modifiers = replay_event.modifiers;
+  event->mouse_x = replay_event.mouse_x;
+  event->mouse_y = replay_event.mouse_y;
+  event->mouse_scroll_h = replay_event.mouse_scroll_h;
+  event->mouse_scroll_v = replay_event.mouse_scroll_v;
+  event->character = replay_event.character;
+  event->window_w = replay_event.window_w;
+  event->window_h = replay_event.window_h;
+  
+  *last = event;
+  last = &event->next;
+ }
+ 
+ return true;
+}
+
 #endif
 
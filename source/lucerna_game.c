@@ -28,26 +28,14 @@ malloc_for_stb(U64 size)
     return arena_push(&global_temp_memory, size);
 }
 
-internal void *
-realloc_for_stb(void *p,
-                U64 old_size,
-                U64 new_size)
-{
-    void *result = arena_push(&global_temp_memory, new_size);
-    memcpy(result, p, old_size);
-    return result;
-}
-
 internal void
 free_for_stb(void *p)
 {
     return;
 }
 
+// NOTE(tbt): images are decoded on the background threads, so stb_image can't use the temporary arena
 #define STB_IMAGE_IMPLEMENTATION
-#define STBI_MALLOC(sz) malloc_for_stb(sz)
-#define STBI_REALLOC_SIZED(p, old_size, new_size) realloc_for_stb(p, old_size, new_size)
-#define STBI_FREE(p) free_for_stb(p)
 #include "stb_image.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
@@ -67,6 +55,11 @@ free_for_stb(void *p)
 enum
 {
     BATCH_SIZE = 1024,
+    VERTEX_STREAM_BATCHES = 64, // NOTE(tbt): number of full batches that fit in the vertex ring buffer before it has to be orphaned
+    
+    MAX_RENDER_QUEUES = 32, // NOTE(tbt): one for each thread that can draw - the main thread plus as many workers as any platform layer will start
+    RENDER_QUEUE_MEMORY_SIZE = 8 * ONE_MB,
+    QUAD_GENERATION_JOB_MIN_QUADS = 512, // NOTE(tbt): don't bother handing quad generation out to the worker threads in smaller pieces than this
     
     SHADER_INFO_LOG_MAX_LEN = 4096,
     
@@ -75,16 +68,180 @@ enum
     
     BLUR_TEXTURE_W = SCREEN_W_IN_WORLD_UNITS / 2,
     BLUR_TEXTURE_H = SCREEN_H_IN_WORLD_UNITS / 2,
+    BLUR_PYRAMID_MAX_LEVELS = 5, // NOTE(tbt): levels below the blur texture, each half the size of the one above
+    BLUR_PYRAMID_SIZE = BLUR_TEXTURE_W * BLUR_TEXTURE_H / 3, // NOTE(tbt): in pixels - each level is at most a quarter of the one above, so they all fit
+    BLOOM_BLUR_LEVELS = 1,
+    
+    RENDER_TARGET_POOL_SIZE = 32,
+    RENDER_TARGET_MAX_IDLE_FLUSHES = 60, // NOTE(tbt): free render targets which go this long without being used are deleted
+    RENDER_GRAPH_MAX_RESOURCES = 16,
+    RENDER_GRAPH_MAX_PASSES = 16,
+    RENDER_GRAPH_SCREEN = -1,   // NOTE(tbt): stands in for a resource to read from or write to the default framebuffer
+    RENDER_GRAPH_NO_INPUT = -2,
+    
+    CPU_NOISE_SIZE = 128, // NOTE(tbt): must be a power of 2
+    
+    TEXTURE_ATLAS_PAGE_SIZE = 4096,
+    TEXTURE_ATLAS_MAX_PAGES = 8,
+    TEXTURE_ATLAS_PADDING = 2, // NOTE(tbt): edge pixels are repeated this far out around each texture so bilinear filtering doesn't bleed between neighbours
+    TEXTURE_UPLOAD_BYTES_PER_FRAME = 8 * ONE_MB, // NOTE(tbt): how much streamed in texture data can be uploaded each frame
+    
+    FONT_GLYPH_CACHE_MIN_SLOTS = 256, // NOTE(tbt): the glyph cache texture is made big enough to hold at least this many glyphs
+    FONT_GLYPH_CACHE_MAX_SIZE = 2048,
+    FONT_GLYPH_HASH_BUCKETS = 512, // NOTE(tbt): must be a power of 2
+    
+    TEXT_RUN_CACHE_BUCKETS = 1024,
+    TEXT_RUN_CACHE_MEMORY_SIZE = 4 * ONE_MB, // NOTE(tbt): for each of the two generations
     
     UI_SORT_DEPTH = 128,
     
-    MAX_ENTITIES = 120,
+    GPU_TIMER_FRAMES_IN_FLIGHT = 3, // NOTE(tbt): how many flushes old timer query results are before they are read back
+    GPU_TIMER_MAX_QUERIES = 256,    // NOTE(tbt): for each flush - passes past this go untimed
+    
+    MAX_ENTITIES = 131072,
+    
+    ENTITY_GRID_CELL_SIZE = 512, // NOTE(tbt): in world units
+    ENTITY_GRID_BUCKETS = 4096, // NOTE(tbt): must be a power of 2
+    ENTITY_GRID_OVERSIZED_BUCKET = ENTITY_GRID_BUCKETS, // NOTE(tbt): for entities bigger than a cell
     
     CURRENT_LEVEL_PATH_BUFFER_SIZE = 64,
     
     ENTITY_STRING_BUFFER_SIZE = 64,
+    
+    PROFILER_MAX_THREADS = 40, // NOTE(tbt): the main thread, the workers, the background workers and the audio thread
+    PROFILER_AUDIO_THREAD = PROFILER_MAX_THREADS - 1,
+    PROFILER_RECORDS_PER_THREAD = 4096, // NOTE(tbt): must be a power of 2
+    PROFILER_MAX_DEPTH = 32,
+    PROFILER_FRAME_HISTORY = 64, // NOTE(tbt): must be a power of 2
 };
 
+//
+// NOTE(tbt): profiler
+//~
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// NOTE(tbt): named scopes timed with rdtsc, e.g.
+//
+//                profile_scope("do_player") { do_player(input, frametime_in_s); }
+//
+//            - each thread writes finished scopes in to its own ring buffer, so recording never has to lock
+//            - the audio thread isn't one of the platform's workers, so it has to say which buffer to use
+//            - a scope must not be left with return or break, or its end is never recorded
+#define profile_scope_on_thread(_name, _thread_index) defer_loop(profiler_begin_scope((_name), (_thread_index)), profiler_end_scope(_thread_index))
+#define profile_scope(_name) profile_scope_on_thread((_name), platform_get_thread_index())
+
+typedef struct
+{
+    U8 *name; // NOTE(tbt): must be a string literal, since records outlive the scope they were made in
+    U64 begin;
+    U64 end;
+    U32 depth;
+} ProfilerRecord;
+
+typedef struct
+{
+    ProfilerRecord records[PROFILER_RECORDS_PER_THREAD];
+    volatile U64 record_count; // NOTE(tbt): total ever written - records[record_count & (PROFILER_RECORDS_PER_THREAD - 1)] is the next to be overwritten
+    
+    U8 *open_names[PROFILER_MAX_DEPTH];
+    U64 open_begins[PROFILER_MAX_DEPTH];
+    U32 depth;
+} ProfilerThread;
+
+internal struct
+{
+    ProfilerThread threads[PROFILER_MAX_THREADS];
+    
+    U64 frame_begins[PROFILER_FRAME_HISTORY];
+    U64 frame_count;
+    
+    // NOTE(tbt): for converting timestamps to seconds
+    U64 calibration_begin;
+    F64 calibration_begin_time;
+    F64 ticks_per_second;
+    
+    B32 is_flame_bar_visible;
+} global_profiler = {0};
+
+internal ProfilerThread *
+profiler_thread_from_index(U32 thread_index)
+{
+    // NOTE(tbt): never share a buffer with the audio thread, even if there are more workers than expected
+    if (thread_index != PROFILER_AUDIO_THREAD)
+    {
+        thread_index = min_u(thread_index, PROFILER_AUDIO_THREAD - 1);
+    }
+    return &global_profiler.threads[thread_index];
+}
+
+internal void
+profiler_begin_scope(U8 *name,
+                     U32 thread_index)
+{
+    ProfilerThread *thread = profiler_thread_from_index(thread_index);
+    
+    if (thread->depth < PROFILER_MAX_DEPTH)
+    {
+        thread->open_names[thread->depth] = name;
+        thread->open_begins[thread->depth] = __rdtsc();
+    }
+    thread->depth += 1;
+}
+
+internal void
+profiler_end_scope(U32 thread_index)
+{
+    U64 end = __rdtsc();
+    
+    ProfilerThread *thread = profiler_thread_from_index(thread_index);
+    
+    thread->depth -= 1;
+    if (thread->depth < PROFILER_MAX_DEPTH)
+    {
+        ProfilerRecord *record = &thread->records[thread->record_count & (PROFILER_RECORDS_PER_THREAD - 1)];
+        record->name = thread->open_names[thread->depth];
+        record->begin = thread->open_begins[thread->depth];
+        record->end = end;
+        record->depth = thread->depth;
+        thread->record_count += 1;
+    }
+}
+
+// NOTE(tbt): called by the main thread at the start of every frame
+internal void
+profiler_begin_frame(void)
+{
+    U64 now = __rdtsc();
+    F64 now_time = platform_get_time();
+    
+    if (0 == global_profiler.frame_count)
+    {
+        global_profiler.calibration_begin = now;
+        global_profiler.calibration_begin_time = now_time;
+    }
+    else if (now_time > global_profiler.calibration_begin_time)
+    {
+        global_profiler.ticks_per_second = (now - global_profiler.calibration_begin) / (now_time - global_profiler.calibration_begin_time);
+    }
+    
+    global_profiler.frame_begins[global_profiler.frame_count & (PROFILER_FRAME_HISTORY - 1)] = now;
+    global_profiler.frame_count += 1;
+}
+
+internal F64
+profiler_seconds_from_ticks(I64 ticks)
+{
+    F64 result = 0.0;
+    if (global_profiler.ticks_per_second > 0.0)
+    {
+        result = ticks / global_profiler.ticks_per_second;
+    }
+    return result;
+}
+
 //
 // NOTE(tbt): types
 //~
@@ -98,6 +255,12 @@ typedef enum
 
 typedef U32 TextureID;
 
+typedef struct
+{
+    F32 min_x, min_y;
+    F32 max_x, max_y;
+} SubTexture;
+
 typedef struct Texture Texture;
 struct Texture
 {
@@ -106,23 +269,92 @@ struct Texture
     U64 last_modified;
     TextureID id;
     I32 width, height;
+    
+    // NOTE(tbt): if the texture has been packed into a page of the level texture atlas, `id` is the page and
+    //            sub textures are remapped into `atlas_region` when drawn
+    B32 is_in_atlas;
+    SubTexture atlas_region;
+};
+
+// NOTE(tbt): CPU side copy of a texture for the software renderer
+typedef struct SoftwareTexture SoftwareTexture;
+struct SoftwareTexture
+{
+    SoftwareTexture *next_hash;
+    TextureID id;
+    I32 width, height;
+    I32 channels;
+    U8 *pixels;
 };
 
+// NOTE(tbt): a glyph which has been rasterised in to a slot of its font's glyph cache
 typedef struct
 {
-    F32 min_x, min_y;
-    F32 max_x, max_y;
-} SubTexture;
+    I32 codepoint;
+    I32 next_hash;
+    I32 lru_prev, lru_next;
+    U64 last_used_flush;
+    F32 xoff, yoff;
+    F32 xoff2, yoff2;
+    F32 xadvance;
+    SubTexture sub_texture;
+} FontGlyph;
 
+// NOTE(tbt): glyphs are rasterised on first use in to fixed size slots of a texture
+//            - slots are found by hashing the codepoint
+//            - when the cache is full the least recently used glyph is evicted
+//            - glyphs used since the start of the current renderer flush are never evicted
 typedef struct
 {
     Texture texture;
-    I32 bake_begin, bake_end;
-    stbtt_packedchar *char_data;
     I32 size;
     F32 vertical_advance;
+    
+    stbtt_fontinfo font_info;
+    F32 scale;
+    
+    U8 *bitmap;
+    I32 dirty_min_y, dirty_max_y;
+    
+    I32 slot_w, slot_h;
+    I32 slots_per_row;
+    I32 slot_count;
+    I32 glyph_count;
+    FontGlyph *glyphs;
+    I32 lru_head, lru_tail;
+    I32 hash[FONT_GLYPH_HASH_BUCKETS];
+    
+    U64 eviction_count;
 } Font;
 
+typedef struct
+{
+    I32 glyph_index; // NOTE(tbt): slot in the font's glyph cache
+    I32 byte_index;  // NOTE(tbt): of the first byte of the character in the string
+    Rect rectangle;  // NOTE(tbt): relative to the start of the run
+    SubTexture sub_texture;
+    F32 x_after;     // NOTE(tbt): pen position after the glyph, relative to the start of the run
+} TextRunGlyph;
+
+// NOTE(tbt): a string laid out in a particular font at a particular wrap width
+//            - cached across frames, keyed by (font, string, wrap width)
+//            - if the font has evicted any glyphs since the run was laid out, the sub textures may be stale so it is laid out again
+typedef struct TextRun TextRun;
+struct TextRun
+{
+    TextRun *next_hash;
+    Font *font;
+    S8 string;
+    I32 wrap_width;
+    U64 font_eviction_count;
+    U64 last_used_flush;
+    
+    Rect bounds; // NOTE(tbt): relative to the start of the run
+    I32 line_count;
+    I32 glyph_count;
+    TextRunGlyph *glyphs;
+};
+
 typedef U32 ShaderID;
 
 typedef struct
@@ -137,16 +369,16 @@ typedef struct
     Vertex bl, br, tr, tl;
 } Quad;
 
+// NOTE(tbt): compact description of a single sprite, which default.vert expands into a quad on the GPU
+//            - 32 bytes, against 128 for the four vertices of a quad
+//            - can't describe a gradient, as the colour is the same for every corner
 typedef struct
 {
-    Quad buffer[BATCH_SIZE];
-    U64 quad_count;
-    TextureID texture;
-    ShaderID shader;
-    F32 *projection_matrix;
-    Rect mask;
-    B32 in_use;
-} RenderBatch;
+    F32 x, y, w, h;
+    U16 min_u, min_v, max_u, max_v; // NOTE(tbt): texture coordinates as unorm16
+    U8 r, g, b, a;
+    F32 angle;
+} SpriteInstance;
 
 typedef enum
 {
@@ -156,14 +388,89 @@ typedef enum
     RENDER_MESSAGE_blur_screen_region,
     RENDER_MESSAGE_draw_gradient,
     RENDER_MESSAGE_do_post_processing,
+    
+    RENDER_MESSAGE_MAX,
 } RenderMessageKind;
 
+typedef struct
+{
+    Quad buffer[BATCH_SIZE];
+    SpriteInstance instances[BATCH_SIZE];
+    U64 quad_count; // NOTE(tbt): in whichever of buffer or instances is in use
+    B32 is_instanced;
+    TextureID texture;
+    ShaderID shader;
+    F32 *projection_matrix;
+    Rect mask;
+    B32 in_use;
+    RenderMessageKind kind; // NOTE(tbt): of the message which started the batch - only used to label GPU timings
+} RenderBatch;
+
+// NOTE(tbt): GPU time spent on each kind of render message, from the most recent flush with results back
+typedef struct
+{
+    B32 is_available;
+    F64 pass_times[RENDER_MESSAGE_MAX];  // NOTE(tbt): in seconds
+    U32 pass_counts[RENDER_MESSAGE_MAX];
+    F64 total_time;
+    U64 untimed_flush_count; // NOTE(tbt): flushes skipped because the queries they would have reused were still in flight
+} RendererGpuStats;
+
 typedef struct
 {
     U32 target;
     TextureID texture;
 } Framebuffer;
 
+// NOTE(tbt): an offscreen colour buffer from global_rcx.render_targets
+typedef struct
+{
+    Framebuffer framebuffer;
+    I32 w, h;   // NOTE(tbt): 0 if the slot is empty
+    U32 format; // NOTE(tbt): internal format
+    B32 is_in_use;
+    U64 last_used_flush;
+} RenderTarget;
+
+typedef enum
+{
+    RENDER_PASS_KIND_blit_screen,    // NOTE(tbt): linear filtered to the size of the output
+    RENDER_PASS_KIND_blur_down,      // NOTE(tbt): blur_down.frag
+    RENDER_PASS_KIND_blur_up,        // NOTE(tbt): blur_up.frag
+    RENDER_PASS_KIND_blit_to_screen, // NOTE(tbt): the rectangle of a blur_screen_region message
+    RENDER_PASS_KIND_post_process,   // NOTE(tbt): inputs are the bloom blur and a copy of the screen
+} RenderPassKind;
+
+// NOTE(tbt): a render target needed by some of the passes in a render graph
+//            - only has a target from the pass which writes it to the last pass which reads it, so resources whose
+//              lifetimes don't overlap can be given the same memory by the pool
+typedef struct
+{
+    I32 w, h;
+    U32 format;
+    I32 first_pass;
+    I32 last_pass;
+    B32 is_imported; // NOTE(tbt): given a target from outside the graph, which the graph doesn't release
+    B32 is_kept;     // NOTE(tbt): not released after its last pass, so it can be used once the graph has run
+    RenderTarget *target;
+} RenderGraphResource;
+
+typedef struct
+{
+    RenderPassKind kind;
+    I32 inputs[2]; // NOTE(tbt): indices of resources, RENDER_GRAPH_SCREEN or RENDER_GRAPH_NO_INPUT
+    I32 output;    // NOTE(tbt): index of a resource, or RENDER_GRAPH_SCREEN
+} RenderGraphPass;
+
+// NOTE(tbt): the offscreen passes for one message, declared up front so targets can be handed out as they are needed
+typedef struct
+{
+    RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    I32 resource_count;
+    RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
+    I32 pass_count;
+} RenderGraph;
+
 typedef struct
 {
     F64 time_playing;
@@ -192,6 +499,70 @@ typedef enum
     POST_PROCESSING_KIND_memory,
 } PostProcessingKind_ENUM;
 
+// NOTE(tbt): some RGBA8 pixels for the CPU post processing passes to work on
+//            - always addressed top row first
+//            - the pitch is in pixels and may be negative, so that bottom-up OpenGL read backs can be used in place
+typedef struct
+{
+    U32 *pixels;
+    I32 w, h;
+    I32 pitch;
+} CpuImage;
+
+// NOTE(tbt): 4 pixels, as separate channels, for CPU post processing
+typedef struct
+{
+    __m128 r, g, b;
+} CpuColour4;
+
+// NOTE(tbt): one bilinear tap of the blur shaders, offset from the destination pixel in source texels
+typedef struct
+{
+    F32 x, y;
+    F32 weight;
+} CpuBlurTap;
+
+typedef enum
+{
+    CPU_POST_PROCESSING_PASS_readback,
+    CPU_POST_PROCESSING_PASS_copy,
+    CPU_POST_PROCESSING_PASS_downsample,
+    CPU_POST_PROCESSING_PASS_blur_down,
+    CPU_POST_PROCESSING_PASS_blur_up,
+    CPU_POST_PROCESSING_PASS_upsample,
+    CPU_POST_PROCESSING_PASS_composite,
+    CPU_POST_PROCESSING_PASS_upload,
+    
+    CPU_POST_PROCESSING_PASS_MAX,
+} CpuPostProcessingPass;
+
+// NOTE(tbt): everything a worker thread needs to do one strip of rows of a CPU post processing pass
+typedef struct
+{
+    CpuPostProcessingPass pass;
+    I32 row_begin, row_end;
+    
+    // NOTE(tbt): full resolution images, or levels of the blur pyramid
+    CpuImage source_image;
+    CpuImage destination_image;
+    
+    // NOTE(tbt): BLUR_TEXTURE_W * BLUR_TEXTURE_H buffers
+    U32 *source_blur;
+    U32 *destination_blur;
+    
+    // NOTE(tbt): horizontal extent for passes which write to a full resolution image
+    I32 clip_x0, clip_x1;
+    
+    // NOTE(tbt): post processing parameters
+    PostProcessingKind post_processing_kind;
+    F32 exposure;
+    F32 time;
+    I32 noise_x, noise_y;
+    F32 *column_warp;
+    I32 *blur_column_x0;
+    F32 *blur_column_t;
+} CpuPostProcessingJob;
+
 typedef U64 EntityFlags;
 typedef enum
 {
@@ -203,6 +574,8 @@ typedef enum
     ENTITY_FLAG_set_player_scale,
     ENTITY_FLAG_set_floor_gradient,
     ENTITY_FLAG_set_post_processing_kind,
+    
+    ENTITY_FLAG_MAX,
 } EntityFlags_ENUM;
 
 typedef U8 EntityTriggers;
@@ -223,17 +596,19 @@ typedef enum
     SET_EXPOSURE_MODE_fade_out_w,
 } SetExposureMode_ENUM;
 
+// NOTE(tbt): index into global_entities
+//            - 0 is never handed out, so is used as nil and as the dummy entity when the store is full
+typedef U32 EntityID;
+
 //-
 // NOTE(tbt): update serialisation code when changing this struct
 //-
-#define ENTITY_SERIALISATION_VERSION 1
+#define ENTITY_SERIALISATION_VERSION 2
+
+// NOTE(tbt): cold data for an entity - bounds, flags and triggers are in the dense arrays in global_entities
 typedef struct Entity Entity;
 struct Entity
 {
-    Entity *next;
-    Rect bounds;
-    EntityFlags flags;
-    EntityTriggers triggers;
     U8 editor_name_buffer[ENTITY_STRING_BUFFER_SIZE];
     S8 editor_name;
     
@@ -314,6 +689,54 @@ typedef struct
     EntityTriggers set_post_processing_kind_on_trigger;
 } Entity_SERIALISABLE_V1;
 
+typedef struct
+{
+    U32 offset; // NOTE(tbt): into the string table
+    U32 size;
+} LevelString_SERIALISABLE_V2;
+
+// NOTE(tbt): one entry in the entity table
+typedef struct
+{
+    LevelString_SERIALISABLE_V2 editor_name;
+    Rect bounds;
+    U32 texture_index; // NOTE(tbt): into the texture table, plus one so that 0 means no texture
+    B32 draw_texture_in_fg;
+    EntityFlags flags;
+    B32 dialogue_repeat;
+    F32 dialogue_x;
+    F32 dialogue_y;
+    LevelString_SERIALISABLE_V2 dialogue_path;
+    SetExposureMode set_exposure_mode;
+    F32 set_exposure_to;
+    LevelString_SERIALISABLE_V2 teleport_to_level_path;
+    F32 teleport_to_x;
+    F32 teleport_to_y;
+    F32 set_player_scale_to;
+    F32 set_floor_gradient_to;
+    PostProcessingKind set_post_processing_kind_to;
+} Entity_SERIALISABLE_V2;
+
+// NOTE(tbt): from version 2, a level is a header followed by the tables it points to, and is read in place
+//            - the version is still the first thing in the file, so older levels which are just a version followed by
+//              entities are still recognised
+//            - readers ignore header fields and entity fields past the ones they know about, and zero the ones they
+//              know about which an older writer didn't write, so fields can be added to the end without a new version
+//            - the texture table has a string for each unique texture path
+//            - every string in the string table is followed by a zero byte, which isn't counted in its size
+typedef struct
+{
+    U64 version;
+    U32 header_size;
+    U32 entity_size;
+    U32 entity_count;
+    U32 texture_count;
+    U64 entity_table_offset;
+    U64 texture_table_offset;
+    U64 string_table_offset;
+    U64 string_table_size;
+} Level_SERIALISABLE_V2;
+
 #define Entity_SERIALISABLE macro_concatenate(Entity_SERIALISABLE_V, ENTITY_SERIALISATION_VERSION)
 
 #pragma pack(pop)
@@ -324,6 +747,8 @@ struct RenderMessage
     RenderMessage *next;
     RenderMessageKind kind;
     U8 sort;
+    U64 sort_key; // NOTE(tbt): depth, queue and sequence are filled in when the message is queued, the rest when it is flushed
+    B32 is_in_order; // NOTE(tbt): drawn in a draw_in_order() block, so never reordered
     Rect mask;
     
     Rect rectangle;
@@ -339,8 +764,38 @@ struct RenderMessage
     I32 strength;
     F32 exposure;
     PostProcessingKind post_processing_kind;
+    
+    // NOTE(tbt): filled in when the queue is flushed
+    //            - only one of quads or instances is used, depending on is_instanced
+    TextRun *text_run;
+    B32 is_instanced;
+    Quad *quads;
+    SpriteInstance *instances;
+    U64 quad_count;
+    U64 blur_key; // NOTE(tbt): for blurs, identifies what is being blurred - see renderer_find_blur_keys
 };
 
+typedef struct
+{
+    U64 key;
+    RenderMessage *message;
+} RenderSortEntry;
+
+// NOTE(tbt): see renderer_assign_sort_layers
+typedef struct
+{
+    U32 group_number; // NOTE(tbt): the rest is only valid if this matches the group currently being laid out at the tile's depth
+    U16 layer;        // NOTE(tbt): 1 + the highest layer
+    U32 state;        // NOTE(tbt): the state of everything on that layer, or RENDER_SORT_STATE_MIXED
+} RenderSortTile;
+
+// NOTE(tbt): a contiguous range of the sorted messages to generate quads for on a worker thread
+typedef struct
+{
+    RenderMessage **messages;
+    U64 message_count;
+} QuadGenerationJob;
+
 typedef U64 UIWidgetFlags;
 typedef enum UIWidgetFlags_ENUM
 {
@@ -383,8 +838,11 @@ typedef struct UIWidget UIWidget;
 struct UIWidget
 {
     // NOTE(tbt): hash table of widgets
+    //            - keyed on the identifier and the parent's id, so identifiers only need to be unique among siblings
     UIWidget *next_hash;
-    S8 key;
+    U64 id; // NOTE(tbt): hash of the identifier, seeded with the parent's id
+    U64 parent_id;
+    S8 identifier;
     
     // NOTE(tbt): tree structure
     UIWidget *first_child;
@@ -455,6 +913,16 @@ struct UIWidget
     // NOTE(tbt): layout pass
     Rect layout;
     Rect interactable;
+    
+    // NOTE(tbt): incremental layout
+    //            - hash of everything the measurement and layout passes read from this widget and its subtree
+    //            - if it hasn't changed, and the widget is placed where it was last frame, the whole subtree keeps
+    //              last frame's layout
+    U64 layout_hash;
+    B32 is_layout_dirty;
+    U32 subtree_count;
+    Rect last_placement;
+    Rect last_clip;
 };
 
 //
@@ -513,16 +981,78 @@ internal F32 global_ui_projection_matrix[16];
 
 struct
 {
+    // NOTE(tbt): each thread appends to its own queue, in its own memory, so drawing doesn't need any locking
+    //            the queues are merged by the depth sort when they are flushed
     struct RcxMessageQueue
     {
         RenderMessage *start;
         RenderMessage *end;
-    } message_queue;
+        U32 sequence; // NOTE(tbt): advanced around anything which must stay in order with everything else at its depth
+        MemoryArena memory;
+    } message_queues[MAX_RENDER_QUEUES];
     
     U32 vao;
     U32 ibo;
     U32 vbo;
     
+    // NOTE(tbt): sprites are drawn as instances, which default.vert expands into quads, unless this is turned off
+    //            - instance_vao shares the ibo, and reads one SpriteInstance from instance_vbo per instance
+    //            - gradients always take the per vertex path
+    B32 is_instancing_enabled;
+    U32 instance_vao;
+    U32 instance_vbo;
+    U32 current_vao;
+    
+    // NOTE(tbt): vertices and instances are each streamed through a ring buffer in their vbo
+    //            - each batch is written after the previous one with an unsynchronised map and drawn with a base vertex,
+    //              or for instances by pointing the attributes at where it was written
+    //            - the buffer is only orphaned when the write offset reaches the end
+    struct RcxVertexStream
+    {
+        U64 write_offset;
+        
+        U64 bytes_uploaded;       // NOTE(tbt): accumulated over the current frame
+        U32 orphan_count;         // NOTE(tbt): accumulated over the current frame
+        U64 last_bytes_uploaded;  // NOTE(tbt): totals for the previous frame
+        U32 last_orphan_count;    // NOTE(tbt): totals for the previous frame
+    } vertex_stream;
+    struct RcxVertexStream instance_stream;
+    
+    U64 draw_call_count;      // NOTE(tbt): accumulated over the current frame
+    U64 last_draw_call_count; // NOTE(tbt): total for the previous frame
+    
+    // NOTE(tbt): blurs of the screen at the same depth and strength share one full screen blur, which is also kept from one
+    //            frame to the next while nothing drawn under it has changed
+    //            - a pass is the downsample, or one step down or up the blur pyramid
+    struct RcxScreenBlur
+    {
+        U64 key;     // NOTE(tbt): of the blur currently in `target`, or 0 if it has been thrown away
+        U64 cpu_key; // NOTE(tbt): the same, for cpu_post_processing.blur_a
+        RenderTarget *target;
+        
+        U32 pass_count;        // NOTE(tbt): accumulated over the current frame
+        U32 passes_saved;      // NOTE(tbt): accumulated over the current frame
+        U32 last_pass_count;   // NOTE(tbt): totals for the previous frame
+        U32 last_passes_saved; // NOTE(tbt): totals for the previous frame
+    } screen_blur;
+    
+    U64 texture_upload_count; // NOTE(tbt): incremented whenever the contents of any texture change
+    
+    // NOTE(tbt): text runs used since the last flush are in `runs[current]`, and those from the flush before in the other
+    //            - a run found in the previous generation is copied forward
+    //            - the previous generation is thrown away at the end of each flush, so runs expire after a frame of not being used
+    struct RcxTextRunCache
+    {
+        MemoryArena memory[2];
+        TextRun *runs[2][TEXT_RUN_CACHE_BUCKETS];
+        I32 current;
+        
+        U64 hits;        // NOTE(tbt): accumulated over the current frame
+        U64 misses;      // NOTE(tbt): accumulated over the current frame
+        U64 last_hits;   // NOTE(tbt): totals for the previous frame
+        U64 last_misses; // NOTE(tbt): totals for the previous frame
+    } text_run_cache;
+    
     struct RcxShaders
     {
 #define shader(_name, _vertex_shader) ShaderID _name;
@@ -544,20 +1074,16 @@ struct
         struct RcxTextureShaderUniformLocations
         {
             I32 projection_matrix;
+            I32 is_instanced;
         } texture;
         
         // NOTE(tbt): uniforms for text shader
         struct RcxTextShaderUniformLocations
         {
             I32 projection_matrix;
+            I32 is_instanced;
         } text;
         
-        // NOTE(tbt): uniforms for blur shader
-        struct RcxBlurShaderUniformLocations
-        {
-            I32 direction;
-        } blur;
-        
         // NOTE(tbt): uniforms for post processing and memory post processing shaders
         struct RcxPostProcessingUniformLocations
         {
@@ -582,23 +1108,93 @@ struct
         F32 y;
     } camera;
     
-    struct RcxFramebuffers
+    // NOTE(tbt): offscreen render targets, handed out by size and format
+    //            - a new target is only created when there is no free one of the right size, so they are reused from
+    //              pass to pass and from frame to frame, and only reallocated when the size needed changes
+    //            - free targets which go unused for RENDER_TARGET_MAX_IDLE_FLUSHES flushes are deleted, e.g. those
+    //              for the old window size after a resize
+    struct RcxRenderTargets
     {
-        Framebuffer blur_a;
-        Framebuffer blur_b;
-        
-        Framebuffer bloom_blur_a;
-        Framebuffer bloom_blur_b;
+        RenderTarget targets[RENDER_TARGET_POOL_SIZE];
+        U64 flush_index;
         
-        Framebuffer post_processing;
-    } framebuffers;
+        U64 bytes;                 // NOTE(tbt): held by every target in the pool
+        U32 count;                 // NOTE(tbt): targets in the pool
+        U32 allocation_count;      // NOTE(tbt): accumulated over the current frame
+        U32 last_allocation_count; // NOTE(tbt): total for the previous frame
+    } render_targets;
     
     Rect mask_stack[64];
     I32 mask_stack_size;
     
+    // NOTE(tbt): like the mask stack, only changed from the main thread, and only used by messages queued from it
+    I32 in_order_depth;
+    
+    // NOTE(tbt): kept from frame to frame, so they never need clearing, see renderer_assign_sort_layers
+    struct
+    {
+        RenderSortTile *tiles_by_depth[256];
+        I32 tiles_w;
+        I32 tiles_h;
+        U32 next_group_number;
+    } sort_tiles;
+    
     TextureID flat_colour_texture;
+    TextureID placeholder_texture; // NOTE(tbt): 1x1 transparent texture, used for textures which are still streaming in
     
     TextureID current_texture;
+    
+    U64 flush_count; // NOTE(tbt): incremented at the start of each renderer_flush_message_queue, so the glyph caches know which glyphs are still needed
+    
+    // NOTE(tbt): only used if the platform layer asks for a software framebuffer in game_init
+    struct RcxSoftware
+    {
+        PlatformFramebuffer *framebuffer;
+        SoftwareTexture *textures[256];
+    } software;
+    
+    // NOTE(tbt): blur and post processing on the CPU
+    //            - always used by the software renderer
+    //            - used by the OpenGL renderer if `enabled` is set, by reading the screen back into main memory
+    struct RcxCpuPostProcessing
+    {
+        B32 enabled;
+        
+        U32 *readback;
+        U32 *screen_copy;
+        I32 buffer_w;
+        I32 buffer_h;
+        
+        U32 blur_a[BLUR_TEXTURE_W * BLUR_TEXTURE_H];
+        U32 blur_pyramid[BLUR_PYRAMID_SIZE]; // NOTE(tbt): each level after the one before, see renderer_cpu_blur_level
+        
+        F32 noise[CPU_NOISE_SIZE * (CPU_NOISE_SIZE + 4)];
+        B32 is_noise_initialised;
+        
+        F64 pass_times[CPU_POST_PROCESSING_PASS_MAX];      // NOTE(tbt): accumulated over the current frame
+        F64 last_pass_times[CPU_POST_PROCESSING_PASS_MAX]; // NOTE(tbt): totals for the previous frame
+    } cpu_post_processing;
+    
+    // NOTE(tbt): GL_TIME_ELAPSED queries around each pass of the OpenGL renderer
+    //            - each flush uses its own set of queries, which are read back GPU_TIMER_FRAMES_IN_FLIGHT flushes later
+    //            - if they still aren't ready then, that flush goes untimed instead of waiting on them
+    //            - does nothing if the driver doesn't have timer queries
+    struct RcxGpuTimers
+    {
+        B32 is_supported;
+        B32 is_timing;
+        
+        struct RcxGpuTimerFrame
+        {
+            U32 queries[GPU_TIMER_MAX_QUERIES];
+            RenderMessageKind kinds[GPU_TIMER_MAX_QUERIES];
+            U32 query_count;
+            B32 is_untimed;
+        } frames[GPU_TIMER_FRAMES_IN_FLIGHT];
+        U32 current_frame;
+        
+        RendererGpuStats stats;
+    } gpu_timers;
 } global_rcx = {{0}};
 
 internal Font *global_ui_font;
@@ -607,10 +1203,35 @@ internal GameState global_game_state = GAME_STATE_main_menu;
 
 internal cm_Source *global_click_sound = NULL;
 
-internal Entity *global_editor_selected_entity = NULL;
+internal EntityID global_editor_selected_entity = 0;
 
-internal Entity global_dummy_entity = {0};
-internal Entity global_entity_pool[MAX_ENTITIES] = {{0}};
+// NOTE(tbt): entities are stored as a structure of arrays, indexed by EntityID
+//            - the hot data which queries and passes walk is kept dense, so that it doesn't share cache lines with
+//              names and paths
+//            - every flag has a packed, unordered list of the entities which have it, so a pass over one component
+//              only has to touch the entities with that component
+internal struct
+{
+    Rect bounds[MAX_ENTITIES];
+    EntityFlags flags[MAX_ENTITIES];
+    EntityTriggers triggers[MAX_ENTITIES];
+    U32 query_stamp[MAX_ENTITIES];
+    U64 list_index[MAX_ENTITIES]; // NOTE(tbt): increases along the entity list, so query results can be put back in list order
+    
+    // NOTE(tbt): the entity list (or free list), the spatial index, and the entities which were intersecting the player
+    //            or had just left it last frame
+    EntityID next[MAX_ENTITIES];
+    EntityID prev[MAX_ENTITIES];
+    U32 grid_bucket[MAX_ENTITIES]; // NOTE(tbt): plus one, so that 0 means not in the grid
+    EntityID next_in_cell[MAX_ENTITIES];
+    EntityID prev_in_cell[MAX_ENTITIES];
+    EntityID next_triggered[MAX_ENTITIES];
+    
+    EntityID flag_list[ENTITY_FLAG_MAX][MAX_ENTITIES];
+    U32 flag_list_position[ENTITY_FLAG_MAX][MAX_ENTITIES];
+    
+    Entity cold[MAX_ENTITIES];
+} global_entities;
 
 struct
 {
@@ -661,26 +1282,40 @@ struct
     
     F64 frametime_in_s;
     PlatformState *input;
+    
+    //-NOTE(tbt): metrics for the last frame
+    U64 measured_widget_count;
+    U64 laid_out_widget_count;
+    U64 skipped_widget_count;
 } global_ui_context = {{{0}}};
 
 internal struct
 {
     S8 path;
     Texture *textures;
+    TextureID atlas_pages[TEXTURE_ATLAS_MAX_PAGES];
+    U32 atlas_page_count;
+    B32 is_deferring_texture_loads; // NOTE(tbt): set while loading a level - textures are streamed in once they have all been packed into the atlas
     U64 entity_next_index;
-    Entity *entity_free_list;
-    Entity *first_entity;
-    Entity *last_entity;
+    U64 entity_next_list_index;
+    EntityID entity_free_list;
+    EntityID first_entity;
+    EntityID last_entity;
+    EntityID entity_grid[ENTITY_GRID_BUCKETS + 1];
+    U32 entity_query_stamp;
+    EntityID first_triggered_entity;
+    U32 flag_list_count[ENTITY_FLAG_MAX];
     F32 y_offset_per_x;
     F32 player_scale;
     PostProcessingKind post_processing_kind;
+    B32 is_benchmark; // NOTE(tbt): has synthetic entities from spawn_benchmark_entities in it, so is never saved
 } global_current_level_state = {{0}};
 
 //
 // NOTE(tbt): localisation
 //~
 
-internal Font *load_font(MemoryArena *memory, S8 path, I32 size, I32 bake_begin, I32 bake_count);
+internal Font *load_font(MemoryArena *memory, S8 path, I32 size);
 
 
 internal void
@@ -690,19 +1325,12 @@ set_locale(Locale locale)
     {
         global_current_locale_config.locale = LOCALE_en_gb;
         
-        I32 font_bake_begin = 32;
-        I32 font_bake_end = 255;
-        
         global_current_locale_config.normal_font = load_font(&global_static_memory,
                                                              s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
-                                                             28,
-                                                             font_bake_begin,
-                                                             font_bake_end - font_bake_begin);
+                                                             28);
         global_current_locale_config.title_font = load_font(&global_static_memory,
                                                             s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
-                                                            72,
-                                                            font_bake_begin,
-                                                            font_bake_end - font_bake_begin);
+                                                            72);
         
         global_current_locale_config.dialogue_seconds_per_character = 0.2;
         
@@ -714,19 +1342,12 @@ set_locale(Locale locale)
     {
         global_current_locale_config.locale = LOCALE_fr;
         
-        I32 font_bake_begin = 32;
-        I32 font_bake_end = 255;
-        
         global_current_locale_config.normal_font = load_font(&global_static_memory,
                                                              s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
-                                                             28,
-                                                             font_bake_begin,
-                                                             font_bake_end - font_bake_begin);
+                                                             28);
         global_current_locale_config.title_font = load_font(&global_static_memory,
                                                             s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
-                                                            72,
-                                                            font_bake_begin,
-                                                            font_bake_end - font_bake_begin);
+                                                            72);
         
         global_current_locale_config.dialogue_seconds_per_character = 0.2;
         
@@ -738,19 +1359,12 @@ set_locale(Locale locale)
     {
         global_current_locale_config.locale = LOCALE_sc;
         
-        I32 font_bake_begin = 0x4E00;
-        I32 font_bake_end = 0x9FFF;
-        
         global_current_locale_config.normal_font = load_font(&global_static_memory,
                                                              s8_lit("../assets/fonts/LiuJianMaoCao-Regular.ttf"),
-                                                             28,
-                                                             font_bake_begin,
-                                                             font_bake_end - font_bake_begin);
+                                                             28);
         global_current_locale_config.title_font = load_font(&global_static_memory,
                                                             s8_lit("../assets/fonts/LiuJianMaoCao-Regular.ttf"),
-                                                            72,
-                                                            font_bake_begin,
-                                                            font_bake_end - font_bake_begin);
+                                                            72);
         
         global_current_locale_config.dialogue_seconds_per_character = 0.5;
         
@@ -758,6 +1372,20 @@ set_locale(Locale locale)
         global_current_locale_config.play = s8_from_cstring(&global_static_memory, "玩");
         global_current_locale_config.exit = s8_from_cstring(&global_static_memory, "出口");
     }
+    
+    // NOTE(tbt): not every font is checked in - fall back to the default rather than crashing on the first draw
+    if (NULL == global_current_locale_config.normal_font)
+    {
+        global_current_locale_config.normal_font = load_font(&global_static_memory,
+                                                             s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
+                                                             28);
+    }
+    if (NULL == global_current_locale_config.title_font)
+    {
+        global_current_locale_config.title_font = load_font(&global_static_memory,
+                                                            s8_lit("../assets/fonts/PlayfairDisplay-Regular.ttf"),
+                                                            72);
+    }
 }
 
 internal S8
@@ -775,23 +1403,167 @@ s8_from_locale(MemoryArena *memory,
 // NOTE(tbt): asset management
 //~
 
-internal Texture global_dummy_texture = {0};
-
-#define ENTIRE_TEXTURE ((SubTexture){ 0.0f, 0.0f, 1.0f, 1.0f })
-
-internal S8
-path_from_level_path(MemoryArena *memory,
-                     S8 path)
+internal struct
 {
-    S8List *list = NULL;
-    list = push_s8_to_list(&global_frame_memory, list, path);
-    list = push_s8_to_list(&global_frame_memory, list, s8_lit("../assets/levels/"));
-    return join_s8_list(memory, list);
-}
+    S8 file; // NOTE(tbt): the whole pack, mapped read only for as long as the game is running
+    AssetPackEntry *entries;
+    U64 entry_count;
+    U64 modified_time; // NOTE(tbt): of the pack file, when it was loaded
+} global_asset_pack = {{0}};
 
-internal S8
-path_from_dialogue_path(MemoryArena *memory,
-                        S8 path)
+// NOTE(tbt): the pack is only used in release builds - debug builds always read the loose files so
+//            that hot reloading and the editor keep working
+internal void
+load_asset_pack(S8 path)
+{
+#ifndef LUCERNA_DEBUG
+    S8 file = platform_map_entire_file_p(path);
+    AssetPackHeader *header = (AssetPackHeader *)file.buffer;
+    
+    if (file.size >= sizeof(*header) &&
+        ASSET_PACK_MAGIC == header->magic &&
+        ASSET_PACK_VERSION == header->version &&
+        header->entries_offset + header->entry_count * sizeof(AssetPackEntry) <= file.size)
+    {
+        global_asset_pack.file = file;
+        global_asset_pack.entries = (AssetPackEntry *)(file.buffer + header->entries_offset);
+        global_asset_pack.entry_count = header->entry_count;
+        global_asset_pack.modified_time = platform_get_file_modified_time_p(path);
+    }
+    else
+    {
+        platform_unmap_file(&file);
+    }
+#endif
+}
+
+// NOTE(tbt): binary search of the pack's table of entries, which are sorted by path
+//            - returns NULL if the path isn't in the pack
+//            - only reads from the pack, so is safe to call from any thread
+internal AssetPackEntry *
+asset_pack_entry_from_path(S8 path)
+{
+    AssetPackEntry *result = NULL;
+    
+    if (path.size < ASSET_PACK_PATH_SIZE)
+    {
+        U64 min = 0;
+        U64 max = global_asset_pack.entry_count;
+        while (min < max)
+        {
+            U64 mid = min + (max - min) / 2;
+            AssetPackEntry *entry = &global_asset_pack.entries[mid];
+            
+            I32 comparison = strncmp(entry->path, path.buffer, path.size);
+            if (0 == comparison &&
+                0 != entry->path[path.size])
+            {
+                comparison = 1;
+            }
+            
+            if (comparison < 0)
+            {
+                min = mid + 1;
+            }
+            else if (comparison > 0)
+            {
+                max = mid;
+            }
+            else
+            {
+                result = entry;
+                break;
+            }
+        }
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): returns the contents of a file from the asset pack if it is in there, otherwise reads it from disk in to `memory`
+//            - data from the pack is read only, and stays around for as long as the game is running
+//            - data from the pack is followed by a zero byte, which isn't counted in the size
+internal S8
+read_asset(MemoryArena *memory,
+           S8 path)
+{
+    S8 result;
+    
+    AssetPackEntry *entry = asset_pack_entry_from_path(path);
+    if (NULL != entry &&
+        ASSET_PACK_ENTRY_KIND_file == entry->kind)
+    {
+        result.buffer = global_asset_pack.file.buffer + entry->offset;
+        result.size = entry->size;
+    }
+    else
+    {
+        result = platform_read_entire_file_p(memory, path);
+    }
+    
+    return result;
+}
+
+typedef struct
+{
+    U32 *pixels;
+    I32 width;
+    I32 height;
+    B32 is_from_asset_pack;
+} TexturePixels;
+
+// NOTE(tbt): RGBA8 pixels straight from the asset pack if they are in there, otherwise decoded from the image file
+//            - safe to call from any thread
+//            - must be freed with free_texture_pixels()
+internal TexturePixels
+texture_pixels_from_path(U8 *path)
+{
+    TexturePixels result = {0};
+    
+    AssetPackEntry *entry = asset_pack_entry_from_path(s8(path));
+    if (NULL != entry &&
+        ASSET_PACK_ENTRY_KIND_texture == entry->kind)
+    {
+        result.pixels = (U32 *)(global_asset_pack.file.buffer + entry->offset);
+        result.width = entry->width;
+        result.height = entry->height;
+        result.is_from_asset_pack = true;
+    }
+    else
+    {
+        result.pixels = (U32 *)stbi_load(path, &result.width, &result.height, NULL, 4);
+    }
+    
+    return result;
+}
+
+internal void
+free_texture_pixels(TexturePixels *pixels)
+{
+    if (!pixels->is_from_asset_pack)
+    {
+        stbi_image_free(pixels->pixels);
+    }
+    pixels->pixels = NULL;
+}
+
+internal Texture global_dummy_texture = {0};
+
+#define ENTIRE_TEXTURE ((SubTexture){ 0.0f, 0.0f, 1.0f, 1.0f })
+
+internal S8
+path_from_level_path(MemoryArena *memory,
+                     S8 path)
+{
+    S8List *list = NULL;
+    list = push_s8_to_list(&global_frame_memory, list, path);
+    list = push_s8_to_list(&global_frame_memory, list, s8_lit("../assets/levels/"));
+    return join_s8_list(memory, list);
+}
+
+internal S8
+path_from_dialogue_path(MemoryArena *memory,
+                        S8 path)
 {
     S8List *list = NULL;
     list = push_s8_to_list(&global_frame_memory, list, path);
@@ -801,22 +1573,21 @@ path_from_dialogue_path(MemoryArena *memory,
     return join_s8_list(memory, list);
 }
 
+internal void renderer_software_upload_texture(TextureID id, I32 width, I32 height, I32 channels, U8 *pixels);
+internal void renderer_software_upload_texture_rows(TextureID id, I32 y0, I32 y1, U8 *pixels);
+
 internal B32
 load_texture(Texture *result)
 {
     B32 success;
     
     TextureID texture_id;
-    I32 width, height;
     
     arena_temporary_memory(&global_temp_memory)
     {
-        U8 *pixels = stbi_load(cstring_from_s8(&global_temp_memory, result->path),
-                               &width,
-                               &height,
-                               NULL, 4);
+        TexturePixels pixels = texture_pixels_from_path(cstring_from_s8(&global_temp_memory, result->path));
         
-        if (pixels)
+        if (pixels.pixels)
         {
             glGenTextures(1, &texture_id);
             glBindTexture(GL_TEXTURE_2D, texture_id);
@@ -829,17 +1600,24 @@ load_texture(Texture *result)
             glTexImage2D(GL_TEXTURE_2D,
                          0,
                          GL_RGBA8,
-                         width,
-                         height,
+                         pixels.width,
+                         pixels.height,
                          0,
                          GL_RGBA,
                          GL_UNSIGNED_BYTE,
-                         pixels);
+                         pixels.pixels);
+            renderer_software_upload_texture(texture_id, pixels.width, pixels.height, 4, (U8 *)pixels.pixels);
             
-            result->last_modified = platform_get_file_modified_time_p(result->path);
+            if (!pixels.is_from_asset_pack)
+            {
+                result->last_modified = platform_get_file_modified_time_p(result->path);
+            }
             result->id = texture_id;
-            result->width = width;
-            result->height = height;
+            result->width = pixels.width;
+            result->height = pixels.height;
+            result->is_in_atlas = false;
+            
+            free_texture_pixels(&pixels);
             
             debug_log("successfully loaded texture: '%.*s'\n", unravel_s8(result->path));
             success = true;
@@ -871,7 +1649,35 @@ texture_from_path(S8 path)
     
     Texture temp = {0};
     temp.path = path;
-    if (load_texture(&temp))
+    
+    B32 success;
+    if (global_current_level_state.is_deferring_texture_loads)
+    {
+        // NOTE(tbt): just read the size for now, the pixels are streamed in by begin_streaming_level_textures()
+        AssetPackEntry *entry = asset_pack_entry_from_path(path);
+        if (NULL != entry &&
+            ASSET_PACK_ENTRY_KIND_texture == entry->kind)
+        {
+            temp.width = entry->width;
+            temp.height = entry->height;
+            success = true;
+        }
+        else
+        {
+            arena_temporary_memory(&global_temp_memory)
+            {
+                success = stbi_info(cstring_from_s8(&global_temp_memory, path), &temp.width, &temp.height, NULL);
+            }
+            temp.last_modified = platform_get_file_modified_time_p(path);
+        }
+        temp.id = global_rcx.placeholder_texture;
+    }
+    else
+    {
+        success = load_texture(&temp);
+    }
+    
+    if (success)
     {
         result = arena_push(&global_level_memory, sizeof(*result));
         *result = temp;
@@ -888,6 +1694,7 @@ texture_from_path(S8 path)
 }
 
 internal void renderer_flush_message_queue(void);
+internal void renderer_software_delete_texture(TextureID id);
 
 internal void
 unload_texture(Texture *texture)
@@ -897,6 +1704,14 @@ unload_texture(Texture *texture)
         debug_log("warning: trying to unload flat colour texture\n");
         return;
     }
+    // NOTE(tbt): the atlas page may be shared with other textures, so is unloaded separately
+    if (texture->is_in_atlas ||
+        global_rcx.placeholder_texture == texture->id)
+    {
+        texture->id = 0;
+        texture->is_in_atlas = false;
+        return;
+    }
     // NOTE(tbt): early process all currently queued render messages in case any of them depend on the texture about to be unloaded
     renderer_flush_message_queue();
     
@@ -905,6 +1720,7 @@ unload_texture(Texture *texture)
         global_rcx.current_texture = 0;
     }
     glDeleteTextures(1, &texture->id);
+    renderer_software_delete_texture(texture->id);
     
     texture->id = 0;
     texture->width = 0;
@@ -929,404 +1745,1319 @@ sub_texture_from_texture(Texture *texture,
     return result;
 }
 
-internal Font *
-load_font(MemoryArena *memory,
-          S8 path,
-          I32 size,
-          I32 font_bake_begin,
-          I32 font_bake_count)
+//
+// NOTE(tbt): level texture streaming
+//~
+
+typedef struct
 {
-    Font *result = NULL;
+    TextureID id;
+    I32 width;
+    I32 height;
+    U32 *pixels; // NOTE(tbt): staging copy of the whole page, filled in by the decode jobs and freed once uploaded
+    I32 rows_uploaded;
+    B32 is_atlas_page; // NOTE(tbt): otherwise the page is a single texture which didn't fit in the atlas
+} StreamingTexturePage;
+
+typedef struct
+{
+    Texture *texture;
+    U8 *path; // NOTE(tbt): the decode job can't use the temporary arena, so keep a zero terminated copy around
+    I32 page_index;
+    I32 x, y;
+    I32 padding;
+    B32 was_successful;
+    F64 decode_time;
+} StreamingTexture;
+
+internal struct
+{
+    B32 is_cancelled; // NOTE(tbt): read by the decode jobs, so only accessed atomically
+    B32 is_streaming;
     
-    I32 font_texture_w = 8192;
-    I32 font_texture_h = 8192;
+    StreamingTexturePage *pages;
+    U64 page_count;
+    StreamingTexture *textures;
+    U64 texture_count;
     
-    arena_temporary_memory(&global_temp_memory)
+    // NOTE(tbt): atlas page from the previous level which the player art is still drawn from until its new page is ready
+    TextureID retired_page;
+    
+    //-NOTE(tbt): metrics
+    F64 start_time;
+    F64 parse_time;
+    U64 bytes_uploaded;
+    U64 frame_count;
+} global_texture_streaming = {0};
+
+// NOTE(tbt): runs on a background thread - decodes a texture straight into its place in the staging copy of its page
+internal void
+decode_streaming_texture(void *data)
+{
+    StreamingTexture *streaming = data;
+    
+    if (atomic_load_acquire_u32(&global_texture_streaming.is_cancelled)) { return; }
+    
+    profile_scope("decode_streaming_texture")
     {
-        S8 file = platform_read_entire_file_p(&global_temp_memory, path);
-        if (file.buffer)
+        F64 start_time = platform_get_time();
+        
+        StreamingTexturePage *page = &global_texture_streaming.pages[streaming->page_index];
+        
+        TexturePixels texture_pixels = texture_pixels_from_path(streaming->path);
+        U32 *pixels = texture_pixels.pixels;
+        I32 width = texture_pixels.width;
+        I32 height = texture_pixels.height;
+        
+        if (pixels &&
+            width == streaming->texture->width &&
+            height == streaming->texture->height)
         {
-            U8 *bitmap = arena_push(&global_temp_memory, font_texture_w * font_texture_h);
-            
-            stbtt_pack_context packing_context;
-            if (stbtt_PackBegin(&packing_context,
-                                bitmap,
-                                font_texture_w, font_texture_h,
-                                0, 1, NULL))
-                
+            // NOTE(tbt): copy rows, repeating the edge pixels out into the padding
+            for (I32 y = -streaming->padding;
+                 y < height + streaming->padding;
+                 ++y)
             {
-                result = arena_push(memory, sizeof(*result));
-                
-                result->char_data = arena_push(memory, sizeof(result->char_data[0]) * font_bake_count);
-                
-                stbtt_PackFontRange(&packing_context,
-                                    file.buffer,
-                                    0,
-                                    size,
-                                    font_bake_begin,
-                                    font_bake_count,
-                                    result->char_data);
+                U32 *source_row = pixels + clamp_i(y, 0, height - 1) * width;
+                U32 *destination_row = page->pixels +
+                    (streaming->y + streaming->padding + y) * page->width +
+                    streaming->x + streaming->padding;
                 
-                result->texture.width = font_texture_w;
-                result->texture.height = font_texture_h;
-                result->bake_begin = font_bake_begin;
-                result->bake_end = font_bake_begin + font_bake_count;
-                result->size = size;
-                
-                stbtt_fontinfo font_info = {0};
-                if (stbtt_InitFont(&font_info,
-                                   file.buffer,
-                                   0))
-                {
-                    F32 scale = stbtt_ScaleForMappingEmToPixels(&font_info, size);
-                    
-                    I32 ascent, descent, line_gap;
-                    stbtt_GetFontVMetrics(&font_info,
-                                          &ascent,
-                                          &descent,
-                                          &line_gap);
-                    result->vertical_advance = ascent - descent + line_gap;
-                    result->vertical_advance *= scale;
-                }
-                else
+                memcpy(destination_row, source_row, width * sizeof(source_row[0]));
+                for (I32 x = 1;
+                     x <= streaming->padding;
+                     ++x)
                 {
-                    debug_log("warning loading font - could not get accurate metrics\n");
-                    result->vertical_advance = size;
+                    destination_row[-x] = source_row[0];
+                    destination_row[width - 1 + x] = source_row[width - 1];
                 }
-                
-                glGenTextures(1, &result->texture.id);
-                glBindTexture(GL_TEXTURE_2D, result->texture.id);
-                global_rcx.current_texture = result->texture.id;
-                
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                
-                glTexImage2D(GL_TEXTURE_2D,
-                             0,
-                             GL_RED,
-                             result->texture.width,
-                             result->texture.height,
-                             0,
-                             GL_RED,
-                             GL_UNSIGNED_BYTE,
-                             bitmap);
-            }
-            else
-            {
-                debug_log("error loading font - could not initialise packing context\n");
-                result = NULL;
             }
             
-            stbtt_PackEnd(&packing_context);
-        }
-        else
-        {
-            debug_log("error loading font - could not read file\n");
-            result = NULL;
+            streaming->was_successful = true;
         }
+        
+        free_texture_pixels(&texture_pixels);
+        
+        streaming->decode_time = platform_get_time() - start_time;
     }
-    
-    return result;
 }
 
-internal S8List *
-load_dialogue(MemoryArena *memory,
-              S8 path)
+internal void
+unload_unused_retired_page(void)
 {
-    S8List *result = NULL;
+    if (0 != global_texture_streaming.retired_page &&
+        global_player.art.texture.id != global_texture_streaming.retired_page)
+    {
+        Texture page = { .id = global_texture_streaming.retired_page };
+        unload_texture(&page);
+        global_texture_streaming.retired_page = 0;
+    }
+}
+
+// NOTE(tbt): stops any streaming still in progress for the previous level
+//            - waits for the decode jobs to return, since they write into memory owned by the level
+internal void
+cancel_level_texture_streaming(void)
+{
+    if (!global_texture_streaming.is_streaming) { return; }
     
-    S8 file = platform_read_entire_file_p(memory, path);
-    if (file.buffer)
+    atomic_store_release_u32(&global_texture_streaming.is_cancelled, true);
+    platform_complete_all_background_work();
+    
+    for (U64 page_index = 0;
+         page_index < global_texture_streaming.page_count;
+         ++page_index)
     {
-        S8 line = {0};
-        line.buffer = file.buffer;
+        StreamingTexturePage *page = &global_texture_streaming.pages[page_index];
         
-        for (U64 i = 0;
-             i <= file.size;
-             ++i)
+        if (NULL != page->pixels)
         {
-            if (file.buffer[i] == '\n')
-            {
-                result = append_s8_to_list(memory, result, line);
-                i += 1;
-                line.size = 0;
-                line.buffer = file.buffer + i;
-            }
-            else
+            free(page->pixels);
+            page->pixels = NULL;
+            
+            // NOTE(tbt): atlas pages are unloaded along with the rest of the level, but nothing points at a
+            //            single texture page until it is finished
+            if (!page->is_atlas_page)
             {
-                line.size += 1;
+                Texture texture = { .id = page->id };
+                unload_texture(&texture);
             }
         }
-        result = append_s8_to_list(memory, result, line);
     }
     
-    return result;
+    debug_log("cancelled streaming level textures\n");
+    
+    global_texture_streaming.is_streaming = false;
+    atomic_store_release_u32(&global_texture_streaming.is_cancelled, false);
 }
 
+// NOTE(tbt): packs the current level's textures, and the player art, into as few pages as possible so that
+//            the world can be drawn without changing texture between batches, then starts decoding them
+//            on the background threads
+//            - textures that don't fit in a page (or once TEXTURE_ATLAS_MAX_PAGES are full) get a page of their own
+//            - pages are cropped to the area actually used
+//            - textures are drawn with the transparent placeholder until their page has been uploaded
 internal void
-generate_orthographic_projection_matrix(F32 *matrix,
-                                        F32 left,
-                                        F32 right,
-                                        F32 top,
-                                        F32 bottom)
-{
-    memset(matrix, 0, 16 * sizeof(F32));
-    matrix[0]  = 2.0f / (right - left);
-    matrix[5]  = 2.0f / (top - bottom);
-    matrix[10] = -1.0f;
-    matrix[12] = -(right + left) / (right - left);
-    matrix[13] = -(top + bottom) / (top - bottom);
-    matrix[14] = 0.0f;
-    matrix[15] = 1.0f;
-}
-
-void
-gl_debug_message_callback(GLenum source​,
-                          GLenum type​,
-                          GLuint id​,
-                          GLenum severity​,
-                          GLsizei length​,
-                          const GLchar *message,
-                          const void *userParam​)
-{
-    debug_log("\n*** %s ***\n", message);
-#if defined(_WIN32) && defined(LUCERNA_DEBUG)
-    __debugbreak();
-#endif
-}
-
-
-internal Rect
-measure_s32(Font *font,
-            F32 x, F32 y,
-            I32 wrap_width,
-            S32 string)
+begin_streaming_level_textures(void)
 {
-    Rect result = rect(x, y, 0, 0);
+    Texture *player_texture = &global_player.art.texture;
+    
+    //-NOTE(tbt): gather everything which wants packing
+    U64 texture_count = 0;
+    for (Texture *t = global_current_level_state.textures;
+         NULL != t;
+         t = t->next_loaded)
+    {
+        texture_count += 1;
+    }
+    texture_count += 1;
     
-    F32 line_start = x;
-    F32 curr_x = x, curr_y = y;
+    Texture **textures = arena_push(&global_frame_memory, texture_count * sizeof(textures[0]));
+    stbrp_rect *rects = arena_push(&global_frame_memory, texture_count * sizeof(rects[0]));
+    stbrp_rect *unpacked_rects = arena_push(&global_frame_memory, texture_count * sizeof(unpacked_rects[0]));
+    I32 *pages = arena_push(&global_frame_memory, texture_count * sizeof(pages[0]));
     
-    for (I32 i = 0;
-         i < string.len;
+    texture_count = 0;
+    for (Texture *t = global_current_level_state.textures;
+         NULL != t;
+         t = t->next_loaded)
+    {
+        textures[texture_count++] = t;
+    }
+    if (player_texture->width > 0 &&
+        player_texture->height > 0)
+    {
+        textures[texture_count++] = player_texture;
+    }
+    
+    for (U64 i = 0;
+         i < texture_count;
          ++i)
     {
-        if (string.buffer[i] == '\n')
+        rects[i].id = i;
+        rects[i].w = textures[i]->width + 2 * TEXTURE_ATLAS_PADDING;
+        rects[i].h = textures[i]->height + 2 * TEXTURE_ATLAS_PADDING;
+        pages[i] = -1;
+    }
+    
+    //-NOTE(tbt): pack into pages
+    stbrp_node *nodes = arena_push(&global_frame_memory, TEXTURE_ATLAS_PAGE_SIZE * sizeof(nodes[0]));
+    
+    U32 atlas_page_count = 0;
+    while (atlas_page_count < TEXTURE_ATLAS_MAX_PAGES)
+    {
+        U64 unpacked_count = 0;
+        for (U64 i = 0;
+             i < texture_count;
+             ++i)
         {
-            curr_x = line_start;
-            curr_y += font->vertical_advance;
+            if (pages[i] < 0 &&
+                rects[i].w <= TEXTURE_ATLAS_PAGE_SIZE &&
+                rects[i].h <= TEXTURE_ATLAS_PAGE_SIZE)
+            {
+                unpacked_rects[unpacked_count++] = rects[i];
+            }
         }
-        else if (string.buffer[i] >= font->bake_begin &&
-                 string.buffer[i] < font->bake_end)
+        
+        if (0 == unpacked_count) { break; }
+        
+        stbrp_context context;
+        stbrp_init_target(&context, TEXTURE_ATLAS_PAGE_SIZE, TEXTURE_ATLAS_PAGE_SIZE, nodes, TEXTURE_ATLAS_PAGE_SIZE);
+        stbrp_pack_rects(&context, unpacked_rects, unpacked_count);
+        
+        B32 was_anything_packed = false;
+        for (U64 i = 0;
+             i < unpacked_count;
+             ++i)
         {
-            stbtt_packedchar *b = font->char_data + (string.buffer[i] - font->bake_begin);
-            
-            if (wrap_width > 0.0f &&
-                is_char_space(string.buffer[i]) &&
-                curr_x > line_start + wrap_width)
+            if (unpacked_rects[i].was_packed)
             {
-                curr_x = line_start;
-                curr_y += font->vertical_advance;
-            }
-            else
-            {
-                result.w += b->xadvance;
-                if (curr_x + b->xoff < result.x)
-                {
-                    result.x = curr_x + b->xoff;
-                }
-                if (curr_x + b->xoff2 > (result.x + result.w))
-                {
-                    result.w = (curr_x + b->xoff2) - result.x;
-                }
-                if (curr_y + b->yoff < result.y)
-                {
-                    result.y = curr_y + b->yoff;
-                }
-                if (curr_y + b->yoff2 > (result.y + result.h))
-                {
-                    result.h = (curr_y + b->yoff2) - result.y;
-                }
-                curr_x += b->xadvance;
+                rects[unpacked_rects[i].id] = unpacked_rects[i];
+                pages[unpacked_rects[i].id] = atlas_page_count;
+                was_anything_packed = true;
             }
         }
+        
+        if (!was_anything_packed) { break; }
+        
+        atlas_page_count += 1;
     }
     
-    return result;
-}
-
-
-Quad
-generate_quad(Rect rectangle,
-              Colour colour,
-              SubTexture sub_texture)
-{
-    Quad result;
+    //-NOTE(tbt): anything which didn't fit gets a page of its own
+    U64 page_count = atlas_page_count;
+    for (U64 i = 0;
+         i < texture_count;
+         ++i)
+    {
+        if (pages[i] < 0)
+        {
+            pages[i] = page_count++;
+        }
+    }
     
-    result.bl.x = rectangle.x;
-    result.bl.y = rectangle.y + rectangle.h;
-    result.bl.r = colour.r;
-    result.bl.g = colour.g;
-    result.bl.b = colour.b;
-    result.bl.a = colour.a;
-    result.bl.u = sub_texture.min_x;
-    result.bl.v = sub_texture.max_y;
+    global_texture_streaming.pages = arena_push(&global_level_memory, page_count * sizeof(global_texture_streaming.pages[0]));
+    global_texture_streaming.page_count = page_count;
+    global_texture_streaming.textures = arena_push(&global_level_memory, texture_count * sizeof(global_texture_streaming.textures[0]));
+    global_texture_streaming.texture_count = texture_count;
     
-    result.br.x = rectangle.x + rectangle.w;
-    result.br.y = rectangle.y + rectangle.h;
-    result.br.r = colour.r;
-    result.br.g = colour.g;
-    result.br.b = colour.b;
-    result.br.a = colour.a;
-    result.br.u = sub_texture.max_x;
-    result.br.v = sub_texture.max_y;
+    for (U64 i = 0;
+         i < texture_count;
+         ++i)
+    {
+        StreamingTexture *streaming = &global_texture_streaming.textures[i];
+        streaming->texture = textures[i];
+        streaming->path = cstring_from_s8(&global_level_memory, textures[i]->path);
+        streaming->page_index = pages[i];
+        if (pages[i] < (I32)atlas_page_count)
+        {
+            streaming->x = rects[i].x;
+            streaming->y = rects[i].y;
+            streaming->padding = TEXTURE_ATLAS_PADDING;
+        }
+        
+        StreamingTexturePage *page = &global_texture_streaming.pages[pages[i]];
+        page->width = max_i(page->width, streaming->x + textures[i]->width + 2 * streaming->padding);
+        page->height = max_i(page->height, streaming->y + textures[i]->height + 2 * streaming->padding);
+        page->is_atlas_page = (pages[i] < (I32)atlas_page_count);
+    }
     
-    result.tr.x = rectangle.x + rectangle.w;
-    result.tr.y = rectangle.y;
-    result.tr.r = colour.r;
-    result.tr.g = colour.g;
-    result.tr.b = colour.b;
-    result.tr.a = colour.a;
-    result.tr.u = sub_texture.max_x;
-    result.tr.v = sub_texture.min_y;
+    //-NOTE(tbt): allocate storage for each page
+    for (U64 page_index = 0;
+         page_index < page_count;
+         ++page_index)
+    {
+        StreamingTexturePage *page = &global_texture_streaming.pages[page_index];
+        
+        page->pixels = calloc((U64)page->width * (U64)page->height, sizeof(page->pixels[0]));
+        
+        glGenTextures(1, &page->id);
+        glBindTexture(GL_TEXTURE_2D, page->id);
+        global_rcx.current_texture = page->id;
+        
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (page->is_atlas_page)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+        
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_RGBA8,
+                     page->width,
+                     page->height,
+                     0,
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE,
+                     NULL);
+        renderer_software_upload_texture(page->id, page->width, page->height, 4, (U8 *)page->pixels);
+        
+        if (page->is_atlas_page)
+        {
+            global_current_level_state.atlas_pages[global_current_level_state.atlas_page_count++] = page->id;
+        }
+    }
     
-    result.tl.x = rectangle.x;
-    result.tl.y = rectangle.y;
-    result.tl.r = colour.r;
-    result.tl.g = colour.g;
-    result.tl.b = colour.b;
-    result.tl.a = colour.a;
-    result.tl.u = sub_texture.min_x;
-    result.tl.v = sub_texture.min_y;
+    //-NOTE(tbt): kick off the decode jobs
+    for (U64 i = 0;
+         i < texture_count;
+         ++i)
+    {
+        platform_push_background_work(decode_streaming_texture, &global_texture_streaming.textures[i]);
+    }
     
-    return result;
+    global_texture_streaming.is_streaming = true;
+    global_texture_streaming.bytes_uploaded = 0;
+    global_texture_streaming.frame_count = 0;
+    
+    debug_log("streaming %llu textures in %llu pages (%u atlas pages)\n", texture_count, page_count, atlas_page_count);
 }
 
-Quad
-generate_rotated_quad(Rect rectangle,
-                      F32 angle,
-                      Colour colour,
-                      SubTexture sub_texture)
+// NOTE(tbt): point all the textures on a page at it once it has been completely uploaded
+internal void
+finish_streaming_texture_page(U64 page_index)
 {
-    Quad result;
+    StreamingTexturePage *page = &global_texture_streaming.pages[page_index];
     
-    //
-    // NOTE(tbt): we want to rotate about the quad's origin, not world's, so
-    //            first a quad is generated at (0, 0), a rotation matrix is applied
-    //            and it is then translated to be at the intended position.
-    //
+    free(page->pixels);
+    page->pixels = NULL;
     
-    Rect at_origin = rect(0.0f, 0.0f, rectangle.w, rectangle.h);
+    for (U64 i = 0;
+         i < global_texture_streaming.texture_count;
+         ++i)
+    {
+        StreamingTexture *streaming = &global_texture_streaming.textures[i];
+        Texture *texture = streaming->texture;
+        
+        if (streaming->page_index != page_index) { continue; }
+        
+        if (!streaming->was_successful)
+        {
+            debug_log("error streaming texture: '%.*s'\n", unravel_s8(texture->path));
+        }
+        
+        // NOTE(tbt): a texture which was loaded on its own (the player art, or anything hot reloaded in the
+        //            meantime) doesn't need its own copy any more
+        if (!texture->is_in_atlas &&
+            0 != texture->id &&
+            global_rcx.placeholder_texture != texture->id)
+        {
+            I32 width = texture->width;
+            I32 height = texture->height;
+            unload_texture(texture);
+            texture->width = width;
+            texture->height = height;
+        }
+        
+        texture->id = page->id;
+        texture->is_in_atlas = page->is_atlas_page;
+        if (page->is_atlas_page)
+        {
+            texture->atlas_region.min_x = (F32)(streaming->x + streaming->padding) / page->width;
+            texture->atlas_region.min_y = (F32)(streaming->y + streaming->padding) / page->height;
+            texture->atlas_region.max_x = (F32)(streaming->x + streaming->padding + texture->width) / page->width;
+            texture->atlas_region.max_y = (F32)(streaming->y + streaming->padding + texture->height) / page->height;
+        }
+    }
     
-    result = generate_quad(at_origin, colour, sub_texture);
+    unload_unused_retired_page();
+}
+
+// NOTE(tbt): called once per frame - uploads decoded pages, up to TEXTURE_UPLOAD_BYTES_PER_FRAME at a time
+internal void
+update_level_texture_streaming(void)
+{
+    if (!global_texture_streaming.is_streaming) { return; }
     
+    global_texture_streaming.frame_count += 1;
     
-    // NOTE(tbt): cast the quad to a vertex pointer, so we can iterate through
-    //            each vertex
-    Vertex *vertices = (Vertex *)(&result);
+    // NOTE(tbt): the decode jobs write straight into the staging pages, so nothing can be uploaded until they are all done
+    if (!platform_is_background_work_complete()) { return; }
     
-    for (I32 i = 0; i < 4; ++i)
+    U64 budget = TEXTURE_UPLOAD_BYTES_PER_FRAME;
+    B32 is_complete = true;
+    
+    for (U64 page_index = 0;
+         page_index < global_texture_streaming.page_count;
+         ++page_index)
     {
-        // NOTE(tbt): matrix generation and multiplication are combined into one step
-        Vertex vertex = vertices[i];
-        vertices[i].x = vertex.x * cos(angle) - vertex.y * sin(angle);
-        vertices[i].y = vertex.x * sin(angle) + vertex.y * cos(angle);
+        StreamingTexturePage *page = &global_texture_streaming.pages[page_index];
         
-        // NOTE(tbt): once a vertex has been rotated it can be translated to the
-        //            intended position
-        vertices[i].x += rectangle.x;
-        vertices[i].y += rectangle.y;
+        if (page->rows_uploaded >= page->height) { continue; }
+        
+        if (0 == budget)
+        {
+            is_complete = false;
+            break;
+        }
+        
+        U64 row_size = (U64)page->width * sizeof(page->pixels[0]);
+        I32 row_count = min_i(max_i(budget / row_size, 1), page->height - page->rows_uploaded);
+        
+        glBindTexture(GL_TEXTURE_2D, page->id);
+        global_rcx.current_texture = page->id;
+        glTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0,
+                        page->rows_uploaded,
+                        page->width,
+                        row_count,
+                        GL_RGBA,
+                        GL_UNSIGNED_BYTE,
+                        page->pixels + page->rows_uploaded * page->width);
+        renderer_software_upload_texture_rows(page->id,
+                                              page->rows_uploaded,
+                                              page->rows_uploaded + row_count,
+                                              (U8 *)page->pixels);
+        
+        page->rows_uploaded += row_count;
+        budget -= min_u(budget, row_count * row_size);
+        global_texture_streaming.bytes_uploaded += row_count * row_size;
+        
+        if (page->rows_uploaded < page->height)
+        {
+            is_complete = false;
+            break;
+        }
+        
+        finish_streaming_texture_page(page_index);
     }
     
-    return result;
+    if (is_complete)
+    {
+        F64 decode_time = 0.0;
+        for (U64 i = 0;
+             i < global_texture_streaming.texture_count;
+             ++i)
+        {
+            decode_time += global_texture_streaming.textures[i].decode_time;
+        }
+        
+        debug_log("streamed level textures:\n"
+                  "    parse       : %.2fms\n"
+                  "    decode      : %.2fms for %llu textures across background threads\n"
+                  "    upload      : %.2fMB over %llu frames\n"
+                  "    total       : %.2fms\n",
+                  global_texture_streaming.parse_time * 1000.0,
+                  decode_time * 1000.0,
+                  global_texture_streaming.texture_count,
+                  global_texture_streaming.bytes_uploaded / (F64)ONE_MB,
+                  global_texture_streaming.frame_count,
+                  (platform_get_time() - global_texture_streaming.start_time) * 1000.0);
+        
+        global_texture_streaming.is_streaming = false;
+    }
 }
 
-//
-// NOTE(tbt): x-macro shader compilation (should probably have used LCDDL)
-//
-
-#define renderer_compile_and_link_fragment_shader(_name, _vertex_shader)                                     \
-shader_src = cstring_from_s8(&global_static_memory,                                                         \
-platform_read_entire_file_p(&global_static_memory,                             \
-s8_lit("../assets/shaders/" #_name ".frag"))); \
-fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);                                                       \
-glShaderSource(fragment_shader, 1, &shader_src, NULL);                                                      \
-glCompileShader(fragment_shader);                                                                         \
-glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &status);                                               \
-if (status == GL_FALSE)                                                                                     \
-{                                                                                                           \
-I8 msg[SHADER_INFO_LOG_MAX_LEN];                                                                           \
-glGetShaderInfoLog(fragment_shader,                                                                      \
-SHADER_INFO_LOG_MAX_LEN,                                                              \
-NULL,                                                                                 \
-msg);                                                                                 \
-debug_log(#_name " fragment shader compilation failure. '%s'\n", msg);                                     \
-exit(-1);                                                                                                  \
-}                                                                                                           \
-glAttachShader(global_rcx.shaders. ## _name, fragment_shader);                                            \
-glLinkProgram(global_rcx.shaders. ## _name);                                                              \
-glGetProgramiv(global_rcx.shaders. ## _name, GL_LINK_STATUS, &status);                                    \
-if (status == GL_FALSE)                                                                                     \
-{                                                                                                           \
-I8 msg[SHADER_INFO_LOG_MAX_LEN];                                                                           \
-glGetShaderInfoLog(global_rcx.shaders. ## _name,                                                         \
-SHADER_INFO_LOG_MAX_LEN,                                                              \
-NULL,                                                                                 \
-msg);                                                                                 \
-glDeleteProgram(global_rcx.shaders. ## _name);                                                           \
-glDeleteShader(_vertex_shader);                                                                          \
-glDeleteShader(fragment_shader);                                                                         \
-debug_log(#_name " shader link failure. '%s'\n", msg);                                                     \
-exit(-1);                                                                                                  \
-}                                                                                                           \
-glDetachShader(global_rcx.shaders. ## _name, _vertex_shader);                                             \
-glDetachShader(global_rcx.shaders. ## _name, fragment_shader);                                            \
-glDeleteShader(fragment_shader);                                                                          \
-global_rcx.shaders.last_modified. ## _name = platform_get_file_modified_time_p(s8_lit("../assets/shaders/" #_name ".frag"))
-
-internal void
-cache_uniform_locations(void)
+internal Font *
+load_font(MemoryArena *memory,
+          S8 path,
+          I32 size)
 {
-    global_rcx.uniform_locations.texture.projection_matrix = glGetUniformLocation(global_rcx.shaders.texture, "u_projection_matrix");
+    Font *result = NULL;
     
-    global_rcx.uniform_locations.text.projection_matrix = glGetUniformLocation(global_rcx.shaders.text, "u_projection_matrix");
+    // NOTE(tbt): the font info points in to the file, so it is kept around for as long as the font is
+    S8 file = read_asset(memory, path);
+    if (file.buffer)
+    {
+        result = arena_push(memory, sizeof(*result));
+        
+        if (stbtt_InitFont(&result->font_info,
+                           file.buffer,
+                           0))
+        {
+            result->size = size;
+            result->scale = stbtt_ScaleForPixelHeight(&result->font_info, size);
+            
+            F32 em_scale = stbtt_ScaleForMappingEmToPixels(&result->font_info, size);
+            
+            I32 ascent, descent, line_gap;
+            stbtt_GetFontVMetrics(&result->font_info,
+                                  &ascent,
+                                  &descent,
+                                  &line_gap);
+            result->vertical_advance = ascent - descent + line_gap;
+            result->vertical_advance *= em_scale;
+            
+            // NOTE(tbt): every slot is big enough for the largest glyph in the font, plus a pixel of padding
+            I32 x0, y0, x1, y1;
+            stbtt_GetFontBoundingBox(&result->font_info, &x0, &y0, &x1, &y1);
+            result->slot_w = ceil((x1 - x0) * result->scale) + 1;
+            result->slot_h = ceil((y1 - y0) * result->scale) + 1;
+            
+            I32 font_texture_size = 64;
+            while (font_texture_size < FONT_GLYPH_CACHE_MAX_SIZE &&
+                   (font_texture_size / result->slot_w) * (font_texture_size / result->slot_h) < FONT_GLYPH_CACHE_MIN_SLOTS)
+            {
+                font_texture_size *= 2;
+            }
+            result->slot_w = min_i(result->slot_w, font_texture_size);
+            result->slot_h = min_i(result->slot_h, font_texture_size);
+            
+            result->texture.width = font_texture_size;
+            result->texture.height = font_texture_size;
+            
+            result->slots_per_row = font_texture_size / result->slot_w;
+            result->slot_count = result->slots_per_row * (font_texture_size / result->slot_h);
+            result->glyphs = arena_push(memory, result->slot_count * sizeof(result->glyphs[0]));
+            
+            result->lru_head = -1;
+            result->lru_tail = -1;
+            for (I32 i = 0;
+                 i < FONT_GLYPH_HASH_BUCKETS;
+                 ++i)
+            {
+                result->hash[i] = -1;
+            }
+            
+            result->bitmap = arena_push(memory, font_texture_size * font_texture_size);
+            result->dirty_min_y = font_texture_size;
+            result->dirty_max_y = 0;
+            
+            glGenTextures(1, &result->texture.id);
+            glBindTexture(GL_TEXTURE_2D, result->texture.id);
+            global_rcx.current_texture = result->texture.id;
+            
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            
+            glTexImage2D(GL_TEXTURE_2D,
+                         0,
+                         GL_RED,
+                         result->texture.width,
+                         result->texture.height,
+                         0,
+                         GL_RED,
+                         GL_UNSIGNED_BYTE,
+                         result->bitmap);
+            renderer_software_upload_texture(result->texture.id,
+                                             result->texture.width,
+                                             result->texture.height,
+                                             1,
+                                             result->bitmap);
+        }
+        else
+        {
+            debug_log("error loading font - could not initialise font info\n");
+            result = NULL;
+        }
+    }
+    else
+    {
+        debug_log("error loading font - could not read file\n");
+        result = NULL;
+    }
     
-    global_rcx.uniform_locations.blur.direction = glGetUniformLocation(global_rcx.shaders.blur, "u_direction");
+    return result;
+}
+
+// NOTE(tbt): returns NULL if the glyph is not in the cache
+//            never modifies the cache, so is safe to call from any thread as long as the main thread isn't in font_get_glyph
+internal FontGlyph *
+font_find_glyph(Font *font,
+                I32 codepoint)
+{
+    FontGlyph *result = NULL;
     
-    global_rcx.uniform_locations.post_processing.time = glGetUniformLocation(global_rcx.shaders.post_processing, "u_time");
-    global_rcx.uniform_locations.post_processing.exposure = glGetUniformLocation(global_rcx.shaders.post_processing, "u_exposure");
-    global_rcx.uniform_locations.post_processing.screen_texture = glGetUniformLocation(global_rcx.shaders.post_processing, "u_screen_texture");
-    global_rcx.uniform_locations.post_processing.blur_texture = glGetUniformLocation(global_rcx.shaders.post_processing, "u_blur_texture");
+    for (I32 i = font->hash[codepoint & (FONT_GLYPH_HASH_BUCKETS - 1)];
+         i >= 0;
+         i = font->glyphs[i].next_hash)
+    {
+        if (font->glyphs[i].codepoint == codepoint)
+        {
+            result = &font->glyphs[i];
+            break;
+        }
+    }
     
-    global_rcx.uniform_locations.memory_post_processing.time = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_time");
-    global_rcx.uniform_locations.memory_post_processing.exposure = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_exposure");
-    global_rcx.uniform_locations.memory_post_processing.screen_texture = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_screen_texture");
-    global_rcx.uniform_locations.memory_post_processing.blur_texture = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_blur_texture");
+    return result;
 }
 
-// NOTE(tbt): I have no idea why I chose this preprocessor monstrosity over a simple LCDDL metaprogram, but it works
 internal void
-hot_reload_shaders(F64 frametime_in_s)
+font_glyph_lru_remove(Font *font,
+                      I32 index)
 {
-    persist F64 time = 0.0;
-    time += frametime_in_s;
+    FontGlyph *glyph = &font->glyphs[index];
     
-    I32 status;
-    U32 fragment_shader;
-    const GLchar *shader_src;
+    if (glyph->lru_prev >= 0)
+    {
+        font->glyphs[glyph->lru_prev].lru_next = glyph->lru_next;
+    }
+    else
+    {
+        font->lru_head = glyph->lru_next;
+    }
     
-    F64 refresh_time = 2.0;
-    if (time > refresh_time)
+    if (glyph->lru_next >= 0)
     {
-#define shader(_name, _vertex_shader_name) \
-{\
-U64 last_modified = platform_get_file_modified_time_p(s8_lit("../assets/shaders/" #_name ".frag"));\
-if (last_modified > global_rcx.shaders.last_modified. ## _name) \
-{\
+        font->glyphs[glyph->lru_next].lru_prev = glyph->lru_prev;
+    }
+    else
+    {
+        font->lru_tail = glyph->lru_prev;
+    }
+}
+
+internal void
+font_glyph_lru_push_front(Font *font,
+                          I32 index)
+{
+    FontGlyph *glyph = &font->glyphs[index];
+    
+    glyph->lru_prev = -1;
+    glyph->lru_next = font->lru_head;
+    
+    if (font->lru_head >= 0)
+    {
+        font->glyphs[font->lru_head].lru_prev = index;
+    }
+    else
+    {
+        font->lru_tail = index;
+    }
+    
+    font->lru_head = index;
+}
+
+// NOTE(tbt): marks a glyph as used, so it won't be evicted until after the current flush
+internal void
+font_touch_glyph(Font *font,
+                 I32 index)
+{
+    font_glyph_lru_remove(font, index);
+    font_glyph_lru_push_front(font, index);
+    font->glyphs[index].last_used_flush = global_rcx.flush_count;
+}
+
+// NOTE(tbt): returns NULL for non printing characters, or if every slot is holding a glyph needed by the current flush
+//            rasterises the glyph in to the cache if it isn't already there, so must only be called from the main thread
+internal FontGlyph *
+font_get_glyph(Font *font,
+               I32 codepoint)
+{
+    if (codepoint < 32) { return NULL; }
+    
+    FontGlyph *result = font_find_glyph(font, codepoint);
+    
+    if (result)
+    {
+        font_touch_glyph(font, result - font->glyphs);
+    }
+    else
+    {
+        I32 index = -1;
+        
+        //-NOTE(tbt): find a slot for the glyph
+        if (font->glyph_count < font->slot_count)
+        {
+            index = font->glyph_count;
+            font->glyph_count += 1;
+        }
+        else if (font->lru_tail >= 0 &&
+                 font->glyphs[font->lru_tail].last_used_flush < global_rcx.flush_count)
+        {
+            index = font->lru_tail;
+            
+            FontGlyph *evicted = &font->glyphs[index];
+            
+            for (I32 *i = &font->hash[evicted->codepoint & (FONT_GLYPH_HASH_BUCKETS - 1)];
+                 *i >= 0;
+                 i = &font->glyphs[*i].next_hash)
+            {
+                if (*i == index)
+                {
+                    *i = evicted->next_hash;
+                    break;
+                }
+            }
+            
+            font_glyph_lru_remove(font, index);
+            font->eviction_count += 1;
+        }
+        else
+        {
+            debug_log("warning: glyph cache full - could not draw codepoint %d\n", codepoint);
+        }
+        
+        //-NOTE(tbt): rasterise in to the slot
+        if (index >= 0)
+        {
+            result = &font->glyphs[index];
+            
+            I32 slot_x = (index % font->slots_per_row) * font->slot_w;
+            I32 slot_y = (index / font->slots_per_row) * font->slot_h;
+            
+            I32 glyph_index = stbtt_FindGlyphIndex(&font->font_info, codepoint);
+            
+            I32 advance, left_side_bearing;
+            stbtt_GetGlyphHMetrics(&font->font_info,
+                                   glyph_index,
+                                   &advance,
+                                   &left_side_bearing);
+            
+            I32 x0, y0, x1, y1;
+            stbtt_GetGlyphBitmapBox(&font->font_info,
+                                    glyph_index,
+                                    font->scale, font->scale,
+                                    &x0, &y0, &x1, &y1);
+            I32 w = min_i(x1 - x0, font->slot_w - 1);
+            I32 h = min_i(y1 - y0, font->slot_h - 1);
+            
+            for (I32 y = slot_y;
+                 y < slot_y + font->slot_h;
+                 ++y)
+            {
+                memset(font->bitmap + y * font->texture.width + slot_x, 0, font->slot_w);
+            }
+            
+            stbtt_MakeGlyphBitmap(&font->font_info,
+                                  font->bitmap + slot_y * font->texture.width + slot_x,
+                                  w, h,
+                                  font->texture.width,
+                                  font->scale, font->scale,
+                                  glyph_index);
+            
+            font->dirty_min_y = min_i(font->dirty_min_y, slot_y);
+            font->dirty_max_y = max_i(font->dirty_max_y, slot_y + font->slot_h);
+            
+            result->codepoint = codepoint;
+            result->xoff = x0;
+            result->yoff = y0;
+            result->xoff2 = x0 + w;
+            result->yoff2 = y0 + h;
+            result->xadvance = advance * font->scale;
+            result->sub_texture.min_x = (F32)slot_x / (F32)font->texture.width;
+            result->sub_texture.min_y = (F32)slot_y / (F32)font->texture.height;
+            result->sub_texture.max_x = (F32)(slot_x + w) / (F32)font->texture.width;
+            result->sub_texture.max_y = (F32)(slot_y + h) / (F32)font->texture.height;
+            
+            I32 *bucket = &font->hash[codepoint & (FONT_GLYPH_HASH_BUCKETS - 1)];
+            result->next_hash = *bucket;
+            *bucket = index;
+            
+            font_glyph_lru_push_front(font, index);
+            result->last_used_flush = global_rcx.flush_count;
+        }
+    }
+    
+    return result;
+}
+
+
+
+// NOTE(tbt): uploads any rows of the glyph cache which have had glyphs rasterised in to them since the last upload
+internal void
+font_upload_glyph_cache(Font *font)
+{
+    if (font->dirty_max_y > font->dirty_min_y)
+    {
+        glBindTexture(GL_TEXTURE_2D, font->texture.id);
+        global_rcx.current_texture = font->texture.id;
+        
+        glTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0, font->dirty_min_y,
+                        font->texture.width,
+                        font->dirty_max_y - font->dirty_min_y,
+                        GL_RED,
+                        GL_UNSIGNED_BYTE,
+                        font->bitmap + font->dirty_min_y * font->texture.width);
+        renderer_software_upload_texture_rows(font->texture.id,
+                                              font->dirty_min_y,
+                                              font->dirty_max_y,
+                                              font->bitmap);
+        
+        font->dirty_min_y = font->texture.height;
+        font->dirty_max_y = 0;
+    }
+}
+
+internal S8List *
+load_dialogue(MemoryArena *memory,
+              S8 path)
+{
+    S8List *result = NULL;
+    
+    S8 file = read_asset(memory, path);
+    if (file.buffer)
+    {
+        S8 line = {0};
+        line.buffer = file.buffer;
+        
+        for (U64 i = 0;
+             i <= file.size;
+             ++i)
+        {
+            if (file.buffer[i] == '\n')
+            {
+                result = append_s8_to_list(memory, result, line);
+                i += 1;
+                line.size = 0;
+                line.buffer = file.buffer + i;
+            }
+            else
+            {
+                line.size += 1;
+            }
+        }
+        result = append_s8_to_list(memory, result, line);
+    }
+    
+    return result;
+}
+
+internal void
+generate_orthographic_projection_matrix(F32 *matrix,
+                                        F32 left,
+                                        F32 right,
+                                        F32 top,
+                                        F32 bottom)
+{
+    memset(matrix, 0, 16 * sizeof(F32));
+    matrix[0]  = 2.0f / (right - left);
+    matrix[5]  = 2.0f / (top - bottom);
+    matrix[10] = -1.0f;
+    matrix[12] = -(right + left) / (right - left);
+    matrix[13] = -(top + bottom) / (top - bottom);
+    matrix[14] = 0.0f;
+    matrix[15] = 1.0f;
+}
+
+void
+gl_debug_message_callback(GLenum source​,
+                          GLenum type​,
+                          GLuint id​,
+                          GLenum severity​,
+                          GLsizei length​,
+                          const GLchar *message,
+                          const void *userParam​)
+{
+    debug_log("\n*** %s ***\n", message);
+#if defined(_WIN32) && defined(LUCERNA_DEBUG)
+    __debugbreak();
+#endif
+}
+
+
+//
+// NOTE(tbt): text runs
+//~
+
+internal TextRun *
+lay_out_text_run(MemoryArena *memory,
+                 Font *font,
+                 S8 string,
+                 I32 wrap_width)
+{
+    TextRun *result = arena_push(memory, sizeof(*result));
+    TextRunGlyph *glyphs = arena_push(memory, string.size * sizeof(glyphs[0]));
+    
+    if (result && glyphs)
+    {
+        result->font = font;
+        result->string = copy_s8(memory, string);
+        result->wrap_width = wrap_width;
+        result->last_used_flush = global_rcx.flush_count;
+        result->glyphs = glyphs;
+        
+        F32 x = 0.0f;
+        F32 y = 0.0f;
+        
+        I32 i = 0;
+        for (UTF8Consume consume = consume_utf8_from_string(string, i);
+             i < string.size;
+             i += consume.advance, consume = consume_utf8_from_string(string, i))
+        {
+            FontGlyph *glyph = NULL;
+            
+            if (consume.codepoint == '\n')
+            {
+                x = 0.0f;
+                y += font->vertical_advance;
+                result->line_count += 1;
+            }
+            else if ((glyph = font_get_glyph(font, consume.codepoint)))
+            {
+                TextRunGlyph *run_glyph = &result->glyphs[result->glyph_count++];
+                
+                run_glyph->glyph_index = glyph - font->glyphs;
+                run_glyph->byte_index = i;
+                run_glyph->rectangle = rect(x + glyph->xoff,
+                                            y + glyph->yoff,
+                                            glyph->xoff2 - glyph->xoff,
+                                            glyph->yoff2 - glyph->yoff);
+                run_glyph->sub_texture = glyph->sub_texture;
+                
+                result->bounds.w += glyph->xadvance;
+                if (x + glyph->xoff < result->bounds.x)
+                {
+                    result->bounds.x = x + glyph->xoff;
+                }
+                if (x + glyph->xoff2 > (result->bounds.x + result->bounds.w))
+                {
+                    result->bounds.w = (x + glyph->xoff2) - result->bounds.x;
+                }
+                if (y + glyph->yoff < result->bounds.y)
+                {
+                    result->bounds.y = y + glyph->yoff;
+                }
+                if (y + glyph->yoff2 > (result->bounds.y + result->bounds.h))
+                {
+                    result->bounds.h = (y + glyph->yoff2) - result->bounds.y;
+                }
+                
+                x += glyph->xadvance;
+                run_glyph->x_after = x;
+                
+                if (wrap_width > 0.0f &&
+                    is_char_space(consume.codepoint))
+                {
+                    if (x > wrap_width)
+                    {
+                        x = 0.0f;
+                        y += font->vertical_advance;
+                    }
+                }
+            }
+        }
+        
+        // NOTE(tbt): laying out the run can evict glyphs from the cache, but never ones used by the run itself
+        result->font_eviction_count = font->eviction_count;
+    }
+    else
+    {
+        result = NULL;
+    }
+    
+    return result;
+}
+
+internal TextRun *
+copy_text_run(MemoryArena *memory,
+              TextRun *run)
+{
+    TextRun *result = arena_push(memory, sizeof(*result));
+    TextRunGlyph *glyphs = arena_push(memory, run->glyph_count * sizeof(glyphs[0]));
+    
+    if (result && glyphs)
+    {
+        *result = *run;
+        result->next_hash = NULL;
+        result->string = copy_s8(memory, run->string);
+        result->glyphs = glyphs;
+        memcpy(result->glyphs, run->glyphs, run->glyph_count * sizeof(glyphs[0]));
+    }
+    else
+    {
+        result = NULL;
+    }
+    
+    return result;
+}
+
+internal B32
+is_text_run_valid_for(TextRun *run,
+                      Font *font,
+                      S8 string,
+                      I32 wrap_width)
+{
+    return (run->font == font &&
+            run->wrap_width == wrap_width &&
+            run->font_eviction_count == font->eviction_count &&
+            s8_match(run->string, string));
+}
+
+// NOTE(tbt): may rasterise glyphs, so must only be called from the main thread
+internal TextRun *
+text_run_from_s8(Font *font,
+                 S8 string,
+                 I32 wrap_width)
+{
+    TextRun *result = NULL;
+    
+    struct RcxTextRunCache *cache = &global_rcx.text_run_cache;
+    U64 bucket = hash_s8(string, TEXT_RUN_CACHE_BUCKETS);
+    
+    //-NOTE(tbt): look for the run in this generation
+    for (TextRun *run = cache->runs[cache->current][bucket];
+         NULL != run;
+         run = run->next_hash)
+    {
+        if (is_text_run_valid_for(run, font, string, wrap_width))
+        {
+            result = run;
+            break;
+        }
+    }
+    
+    if (result)
+    {
+        cache->hits += 1;
+    }
+    else
+    {
+        //-NOTE(tbt): copy forward from the previous generation, or lay out from scratch
+        for (TextRun *run = cache->runs[!cache->current][bucket];
+             NULL != run;
+             run = run->next_hash)
+        {
+            if (is_text_run_valid_for(run, font, string, wrap_width))
+            {
+                result = copy_text_run(&cache->memory[cache->current], run);
+                break;
+            }
+        }
+        
+        if (result)
+        {
+            cache->hits += 1;
+        }
+        else
+        {
+            result = lay_out_text_run(&cache->memory[cache->current], font, string, wrap_width);
+            cache->misses += 1;
+        }
+        
+        if (result)
+        {
+            result->next_hash = cache->runs[cache->current][bucket];
+            cache->runs[cache->current][bucket] = result;
+        }
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): stops the glyphs used by a run from being evicted until after the current flush
+internal void
+touch_text_run(TextRun *run)
+{
+    if (run->last_used_flush != global_rcx.flush_count)
+    {
+        for (I32 i = 0;
+             i < run->glyph_count;
+             ++i)
+        {
+            font_touch_glyph(run->font, run->glyphs[i].glyph_index);
+        }
+        run->last_used_flush = global_rcx.flush_count;
+    }
+}
+
+internal Rect
+measure_s8(Font *font,
+           F32 x, F32 y,
+           I32 wrap_width,
+           S8 string)
+{
+    Rect result = rect(x, y, 0, 0);
+    
+    TextRun *run = text_run_from_s8(font, string, wrap_width);
+    if (run)
+    {
+        result = run->bounds;
+        result.x += x;
+        result.y += y;
+    }
+    
+    return result;
+}
+
+
+Quad
+generate_quad(Rect rectangle,
+              Colour colour,
+              SubTexture sub_texture)
+{
+    Quad result;
+    
+    result.bl.x = rectangle.x;
+    result.bl.y = rectangle.y + rectangle.h;
+    result.bl.r = colour.r;
+    result.bl.g = colour.g;
+    result.bl.b = colour.b;
+    result.bl.a = colour.a;
+    result.bl.u = sub_texture.min_x;
+    result.bl.v = sub_texture.max_y;
+    
+    result.br.x = rectangle.x + rectangle.w;
+    result.br.y = rectangle.y + rectangle.h;
+    result.br.r = colour.r;
+    result.br.g = colour.g;
+    result.br.b = colour.b;
+    result.br.a = colour.a;
+    result.br.u = sub_texture.max_x;
+    result.br.v = sub_texture.max_y;
+    
+    result.tr.x = rectangle.x + rectangle.w;
+    result.tr.y = rectangle.y;
+    result.tr.r = colour.r;
+    result.tr.g = colour.g;
+    result.tr.b = colour.b;
+    result.tr.a = colour.a;
+    result.tr.u = sub_texture.max_x;
+    result.tr.v = sub_texture.min_y;
+    
+    result.tl.x = rectangle.x;
+    result.tl.y = rectangle.y;
+    result.tl.r = colour.r;
+    result.tl.g = colour.g;
+    result.tl.b = colour.b;
+    result.tl.a = colour.a;
+    result.tl.u = sub_texture.min_x;
+    result.tl.v = sub_texture.min_y;
+    
+    return result;
+}
+
+Quad
+generate_rotated_quad(Rect rectangle,
+                      F32 angle,
+                      Colour colour,
+                      SubTexture sub_texture)
+{
+    Quad result;
+    
+    //
+    // NOTE(tbt): we want to rotate about the quad's origin, not world's, so
+    //            first a quad is generated at (0, 0), a rotation matrix is applied
+    //            and it is then translated to be at the intended position.
+    //
+    
+    Rect at_origin = rect(0.0f, 0.0f, rectangle.w, rectangle.h);
+    
+    result = generate_quad(at_origin, colour, sub_texture);
+    
+    
+    // NOTE(tbt): cast the quad to a vertex pointer, so we can iterate through
+    //            each vertex
+    Vertex *vertices = (Vertex *)(&result);
+    
+    for (I32 i = 0; i < 4; ++i)
+    {
+        // NOTE(tbt): matrix generation and multiplication are combined into one step
+        Vertex vertex = vertices[i];
+        vertices[i].x = vertex.x * cos(angle) - vertex.y * sin(angle);
+        vertices[i].y = vertex.x * sin(angle) + vertex.y * cos(angle);
+        
+        // NOTE(tbt): once a vertex has been rotated it can be translated to the
+        //            intended position
+        vertices[i].x += rectangle.x;
+        vertices[i].y += rectangle.y;
+    }
+    
+    return result;
+}
+
+internal SpriteInstance
+generate_sprite_instance(Rect rectangle,
+                         F32 angle,
+                         Colour colour,
+                         SubTexture sub_texture)
+{
+    SpriteInstance result;
+    
+    result.x = rectangle.x;
+    result.y = rectangle.y;
+    result.w = rectangle.w;
+    result.h = rectangle.h;
+    
+    result.min_u = clamp_f(sub_texture.min_x, 0.0f, 1.0f) * 65535.0f + 0.5f;
+    result.min_v = clamp_f(sub_texture.min_y, 0.0f, 1.0f) * 65535.0f + 0.5f;
+    result.max_u = clamp_f(sub_texture.max_x, 0.0f, 1.0f) * 65535.0f + 0.5f;
+    result.max_v = clamp_f(sub_texture.max_y, 0.0f, 1.0f) * 65535.0f + 0.5f;
+    
+    result.r = clamp_f(colour.r, 0.0f, 1.0f) * 255.0f + 0.5f;
+    result.g = clamp_f(colour.g, 0.0f, 1.0f) * 255.0f + 0.5f;
+    result.b = clamp_f(colour.b, 0.0f, 1.0f) * 255.0f + 0.5f;
+    result.a = clamp_f(colour.a, 0.0f, 1.0f) * 255.0f + 0.5f;
+    
+    result.angle = angle;
+    
+    return result;
+}
+
+// NOTE(tbt): does the same expansion as default.vert, for the software renderer
+internal Quad
+generate_quad_from_sprite_instance(SpriteInstance *instance)
+{
+    Quad result;
+    
+    Rect rectangle = rect(instance->x, instance->y, instance->w, instance->h);
+    Colour colour = col(instance->r / 255.0f,
+                        instance->g / 255.0f,
+                        instance->b / 255.0f,
+                        instance->a / 255.0f);
+    SubTexture sub_texture;
+    sub_texture.min_x = instance->min_u / 65535.0f;
+    sub_texture.min_y = instance->min_v / 65535.0f;
+    sub_texture.max_x = instance->max_u / 65535.0f;
+    sub_texture.max_y = instance->max_v / 65535.0f;
+    
+    if (0.0f == instance->angle)
+    {
+        result = generate_quad(rectangle, colour, sub_texture);
+    }
+    else
+    {
+        result = generate_rotated_quad(rectangle, instance->angle, colour, sub_texture);
+    }
+    
+    return result;
+}
+
+//
+// NOTE(tbt): x-macro shader compilation (should probably have used LCDDL)
+//
+
+#define renderer_compile_and_link_fragment_shader(_name, _vertex_shader)                                     \
+shader_src = cstring_from_s8(&global_static_memory,                                                         \
+read_asset(&global_static_memory,                                              \
+s8_lit("../assets/shaders/" #_name ".frag"))); \
+fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);                                                       \
+glShaderSource(fragment_shader, 1, &shader_src, NULL);                                                      \
+glCompileShader(fragment_shader);                                                                         \
+glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &status);                                               \
+if (status == GL_FALSE)                                                                                     \
+{                                                                                                           \
+I8 msg[SHADER_INFO_LOG_MAX_LEN];                                                                           \
+glGetShaderInfoLog(fragment_shader,                                                                      \
+SHADER_INFO_LOG_MAX_LEN,                                                              \
+NULL,                                                                                 \
+msg);                                                                                 \
+debug_log(#_name " fragment shader compilation failure. '%s'\n", msg);                                     \
+exit(-1);                                                                                                  \
+}                                                                                                           \
+glAttachShader(global_rcx.shaders._name, fragment_shader);                                            \
+glLinkProgram(global_rcx.shaders._name);                                                              \
+glGetProgramiv(global_rcx.shaders._name, GL_LINK_STATUS, &status);                                    \
+if (status == GL_FALSE)                                                                                     \
+{                                                                                                           \
+I8 msg[SHADER_INFO_LOG_MAX_LEN];                                                                           \
+glGetShaderInfoLog(global_rcx.shaders._name,                                                         \
+SHADER_INFO_LOG_MAX_LEN,                                                              \
+NULL,                                                                                 \
+msg);                                                                                 \
+glDeleteProgram(global_rcx.shaders._name);                                                           \
+glDeleteShader(_vertex_shader);                                                                          \
+glDeleteShader(fragment_shader);                                                                         \
+debug_log(#_name " shader link failure. '%s'\n", msg);                                                     \
+exit(-1);                                                                                                  \
+}                                                                                                           \
+glDetachShader(global_rcx.shaders._name, _vertex_shader);                                             \
+glDetachShader(global_rcx.shaders._name, fragment_shader);                                            \
+glDeleteShader(fragment_shader);                                                                          \
+global_rcx.shaders.last_modified._name = platform_get_file_modified_time_p(s8_lit("../assets/shaders/" #_name ".frag"))
+
+internal void
+cache_uniform_locations(void)
+{
+    global_rcx.uniform_locations.texture.projection_matrix = glGetUniformLocation(global_rcx.shaders.texture, "u_projection_matrix");
+    global_rcx.uniform_locations.texture.is_instanced = glGetUniformLocation(global_rcx.shaders.texture, "u_is_instanced");
+    
+    global_rcx.uniform_locations.text.projection_matrix = glGetUniformLocation(global_rcx.shaders.text, "u_projection_matrix");
+    global_rcx.uniform_locations.text.is_instanced = glGetUniformLocation(global_rcx.shaders.text, "u_is_instanced");
+    
+    global_rcx.uniform_locations.post_processing.time = glGetUniformLocation(global_rcx.shaders.post_processing, "u_time");
+    global_rcx.uniform_locations.post_processing.exposure = glGetUniformLocation(global_rcx.shaders.post_processing, "u_exposure");
+    global_rcx.uniform_locations.post_processing.screen_texture = glGetUniformLocation(global_rcx.shaders.post_processing, "u_screen_texture");
+    global_rcx.uniform_locations.post_processing.blur_texture = glGetUniformLocation(global_rcx.shaders.post_processing, "u_blur_texture");
+    
+    global_rcx.uniform_locations.memory_post_processing.time = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_time");
+    global_rcx.uniform_locations.memory_post_processing.exposure = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_exposure");
+    global_rcx.uniform_locations.memory_post_processing.screen_texture = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_screen_texture");
+    global_rcx.uniform_locations.memory_post_processing.blur_texture = glGetUniformLocation(global_rcx.shaders.memory_post_processing, "u_blur_texture");
+}
+
+// NOTE(tbt): I have no idea why I chose this preprocessor monstrosity over a simple LCDDL metaprogram, but it works
+internal void
+hot_reload_shaders(F64 frametime_in_s)
+{
+    persist F64 time = 0.0;
+    time += frametime_in_s;
+    
+    I32 status;
+    U32 fragment_shader;
+    const GLchar *shader_src;
+    
+    F64 refresh_time = 2.0;
+    if (time > refresh_time)
+    {
+#define shader(_name, _vertex_shader_name) \
+{\
+U64 last_modified = platform_get_file_modified_time_p(s8_lit("../assets/shaders/" #_name ".frag"));\
+if (last_modified > global_rcx.shaders.last_modified._name) \
+{\
 renderer_flush_message_queue();\
-global_rcx.shaders.last_modified. ## _name = last_modified;\
+global_rcx.shaders.last_modified._name = last_modified;\
 debug_log("hot reloading " #_name " shader\n");\
 shader_src = cstring_from_s8(&global_temp_memory, platform_read_entire_file_p(&global_temp_memory, s8_lit("../assets/shaders/" #_vertex_shader_name ".vert")));\
 U32 _vertex_shader_name ## _vertex_shader = glCreateShader(GL_VERTEX_SHADER);\
@@ -1341,7 +3072,7 @@ glDeleteShader(_vertex_shader_name ## _vertex_shader);\
 debug_log("vertex shader compilation failure. '%s'\n", msg);\
 exit(-1);\
 }\
-glAttachShader(global_rcx.shaders. ## _name, _vertex_shader_name ## _vertex_shader);\
+glAttachShader(global_rcx.shaders._name, _vertex_shader_name ## _vertex_shader);\
 renderer_compile_and_link_fragment_shader(_name, _vertex_shader_name ## _vertex_shader);\
 glDeleteShader(_vertex_shader_name ## _vertex_shader);\
 cache_uniform_locations();\
@@ -1352,715 +3083,3974 @@ cache_uniform_locations();\
     }
 }
 
-//
-// NOTE(tbt): renderer
-//~
-
+//
+// NOTE(tbt): software renderer
+//~
+
+// NOTE(tbt): consumes the same batches as the OpenGL path, but rasterises them into
+//            global_rcx.software.framebuffer on the CPU
+//            - textures are kept in memory alongside their OpenGL counterparts, keyed by TextureID
+//            - quads are split into two triangles and filled a span at a time, 4 pixels wide
+//            - blending is premultiplied alpha to match glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+
+internal SoftwareTexture *
+renderer_software_texture_from_id(TextureID id)
+{
+    SoftwareTexture *result = NULL;
+    
+    for (SoftwareTexture *texture = global_rcx.software.textures[id % array_count(global_rcx.software.textures)];
+         NULL != texture;
+         texture = texture->next_hash)
+    {
+        if (texture->id == id)
+        {
+            result = texture;
+            break;
+        }
+    }
+    
+    return result;
+}
+
+internal void
+renderer_software_delete_texture(TextureID id)
+{
+    SoftwareTexture **bucket = &global_rcx.software.textures[id % array_count(global_rcx.software.textures)];
+    
+    for (SoftwareTexture **texture = bucket;
+         NULL != *texture;
+         texture = &(*texture)->next_hash)
+    {
+        if ((*texture)->id == id)
+        {
+            SoftwareTexture *to_free = *texture;
+            *texture = to_free->next_hash;
+            free(to_free->pixels);
+            free(to_free);
+            break;
+        }
+    }
+}
+
+// NOTE(tbt): should be called alongside every glTexImage2D that uploads pixel data
+internal void
+renderer_software_upload_texture(TextureID id,
+                                 I32 width,
+                                 I32 height,
+                                 I32 channels,
+                                 U8 *pixels)
+{
+    global_rcx.texture_upload_count += 1;
+    
+    if (!global_rcx.software.framebuffer) { return; }
+    
+    renderer_software_delete_texture(id);
+    
+    U64 size = (U64)width * (U64)height * (U64)channels;
+    
+    SoftwareTexture *texture = malloc(sizeof(*texture));
+    texture->id = id;
+    texture->width = width;
+    texture->height = height;
+    texture->channels = channels;
+    texture->pixels = malloc(size);
+    memcpy(texture->pixels, pixels, size);
+    
+    SoftwareTexture **bucket = &global_rcx.software.textures[id % array_count(global_rcx.software.textures)];
+    texture->next_hash = *bucket;
+    *bucket = texture;
+}
+
+// NOTE(tbt): should be called alongside every glTexSubImage2D
+//            `pixels` points to the whole image, but only rows `y0` up to `y1` are copied
+internal void
+renderer_software_upload_texture_rows(TextureID id,
+                                      I32 y0,
+                                      I32 y1,
+                                      U8 *pixels)
+{
+    global_rcx.texture_upload_count += 1;
+    
+    SoftwareTexture *texture = renderer_software_texture_from_id(id);
+    
+    if (texture)
+    {
+        U64 row_size = (U64)texture->width * (U64)texture->channels;
+        memcpy(texture->pixels + y0 * row_size,
+               pixels + y0 * row_size,
+               (y1 - y0) * row_size);
+    }
+}
+
+internal void
+renderer_software_clear(void)
+{
+    PlatformFramebuffer *framebuffer = global_rcx.software.framebuffer;
+    
+    // NOTE(tbt): opaque black, the same as glClearColor(0.0f, 0.0f, 0.0f, 1.0f)
+    U32 *end = framebuffer->pixels + (U64)framebuffer->w * (U64)framebuffer->h;
+    for (U32 *pixel = framebuffer->pixels;
+         pixel < end;
+         ++pixel)
+    {
+        *pixel = 0xff000000;
+    }
+}
+
+//-NOTE(tbt): pixel operations
+
+// NOTE(tbt): bilinear filtering with GL_REPEAT wrapping, to match the OpenGL texture parameters
+internal void
+renderer_software_sample(SoftwareTexture *texture,
+                         F32 u, F32 v,
+                         F32 *result)
+{
+    F32 x = u * texture->width - 0.5f;
+    F32 y = v * texture->height - 0.5f;
+    F32 floor_x = floorf(x);
+    F32 floor_y = floorf(y);
+    F32 t_x = x - floor_x;
+    F32 t_y = y - floor_y;
+    
+    I32 x0 = (I32)floor_x % texture->width;
+    I32 y0 = (I32)floor_y % texture->height;
+    if (x0 < 0) { x0 += texture->width; }
+    if (y0 < 0) { y0 += texture->height; }
+    I32 x1 = (x0 + 1) % texture->width;
+    I32 y1 = (y0 + 1) % texture->height;
+    
+    U8 *row_0 = texture->pixels + (U64)y0 * texture->width * texture->channels;
+    U8 *row_1 = texture->pixels + (U64)y1 * texture->width * texture->channels;
+    
+    for (I32 channel = 0;
+         channel < texture->channels;
+         ++channel)
+    {
+        F32 top = row_0[x0 * texture->channels + channel] * (1.0f - t_x) + row_0[x1 * texture->channels + channel] * t_x;
+        F32 bottom = row_1[x0 * texture->channels + channel] * (1.0f - t_x) + row_1[x1 * texture->channels + channel] * t_x;
+        result[channel] = (top * (1.0f - t_y) + bottom * t_y) * (1.0f / 255.0f);
+    }
+}
+
+// NOTE(tbt): blends 4 premultiplied source pixels, given as separate channels, over 4 packed RGBA8 destination pixels
+internal inline __m128i
+renderer_software_blend_4(__m128i destination,
+                          __m128 r, __m128 g, __m128 b, __m128 a)
+{
+    __m128i channel_mask = _mm_set1_epi32(0xff);
+    __m128 to_float = _mm_set1_ps(1.0f / 255.0f);
+    __m128 to_byte = _mm_set1_ps(255.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    __m128 destination_r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(destination, channel_mask)), to_float);
+    __m128 destination_g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(destination, 8), channel_mask)), to_float);
+    __m128 destination_b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(destination, 16), channel_mask)), to_float);
+    __m128 destination_a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(destination, 24)), to_float);
+    
+    __m128 one_minus_a = _mm_sub_ps(one, a);
+    
+    r = _mm_add_ps(r, _mm_mul_ps(destination_r, one_minus_a));
+    g = _mm_add_ps(g, _mm_mul_ps(destination_g, one_minus_a));
+    b = _mm_add_ps(b, _mm_mul_ps(destination_b, one_minus_a));
+    a = _mm_add_ps(a, _mm_mul_ps(destination_a, one_minus_a));
+    
+    __m128i result_r = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), to_byte));
+    __m128i result_g = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), to_byte));
+    __m128i result_b = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), to_byte));
+    __m128i result_a = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(a, zero), one), to_byte));
+    
+    return _mm_or_si128(_mm_or_si128(result_r, _mm_slli_epi32(result_g, 8)),
+                        _mm_or_si128(_mm_slli_epi32(result_b, 16), _mm_slli_epi32(result_a, 24)));
+}
+
+#if defined(__AVX2__)
+internal inline __m256i
+renderer_software_blend_8(__m256i destination,
+                          __m256 r, __m256 g, __m256 b, __m256 a)
+{
+    __m256i channel_mask = _mm256_set1_epi32(0xff);
+    __m256 to_float = _mm256_set1_ps(1.0f / 255.0f);
+    __m256 to_byte = _mm256_set1_ps(255.0f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    
+    __m256 destination_r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(destination, channel_mask)), to_float);
+    __m256 destination_g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(destination, 8), channel_mask)), to_float);
+    __m256 destination_b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(destination, 16), channel_mask)), to_float);
+    __m256 destination_a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(destination, 24)), to_float);
+    
+    __m256 one_minus_a = _mm256_sub_ps(one, a);
+    
+    r = _mm256_add_ps(r, _mm256_mul_ps(destination_r, one_minus_a));
+    g = _mm256_add_ps(g, _mm256_mul_ps(destination_g, one_minus_a));
+    b = _mm256_add_ps(b, _mm256_mul_ps(destination_b, one_minus_a));
+    a = _mm256_add_ps(a, _mm256_mul_ps(destination_a, one_minus_a));
+    
+    __m256i result_r = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(r, zero), one), to_byte));
+    __m256i result_g = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(g, zero), one), to_byte));
+    __m256i result_b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, zero), one), to_byte));
+    __m256i result_a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, zero), one), to_byte));
+    
+    return _mm256_or_si256(_mm256_or_si256(result_r, _mm256_slli_epi32(result_g, 8)),
+                           _mm256_or_si256(_mm256_slli_epi32(result_b, 16), _mm256_slli_epi32(result_a, 24)));
+}
+#endif
+
+//-NOTE(tbt): triangle rasterisation
+
+enum
+{
+    SOFTWARE_ATTRIBUTE_r,
+    SOFTWARE_ATTRIBUTE_g,
+    SOFTWARE_ATTRIBUTE_b,
+    SOFTWARE_ATTRIBUTE_a,
+    SOFTWARE_ATTRIBUTE_u,
+    SOFTWARE_ATTRIBUTE_v,
+    
+    SOFTWARE_ATTRIBUTE_MAX,
+};
+
+typedef struct
+{
+    // NOTE(tbt): attribute = base + x * d_dx + y * d_dy, in framebuffer pixel coordinates
+    F32 base[SOFTWARE_ATTRIBUTE_MAX];
+    F32 d_dx[SOFTWARE_ATTRIBUTE_MAX];
+    F32 d_dy[SOFTWARE_ATTRIBUTE_MAX];
+    
+    SoftwareTexture *texture;
+    B32 is_text;        // NOTE(tbt): sample a single channel coverage mask, as in text.frag
+    B32 is_flat_colour; // NOTE(tbt): no texture sampling needed and constant colour - use the fast path
+} SoftwareShading;
+
+internal void
+renderer_software_fill_span(U32 *row,
+                            I32 x_begin,
+                            I32 x_end,
+                            F32 y_centre,
+                            SoftwareShading *shading)
+{
+    I32 x = x_begin;
+    
+    if (shading->is_flat_colour)
+    {
+        //-NOTE(tbt): constant colour fast path
+        F32 a = shading->base[SOFTWARE_ATTRIBUTE_a];
+        F32 r = shading->base[SOFTWARE_ATTRIBUTE_r] * a;
+        F32 g = shading->base[SOFTWARE_ATTRIBUTE_g] * a;
+        F32 b = shading->base[SOFTWARE_ATTRIBUTE_b] * a;
+
+#if defined(__AVX2__)
+        for (;
+             x + 8 <= x_end;
+             x += 8)
+        {
+            __m256i destination = _mm256_loadu_si256((__m256i *)(row + x));
+            destination = renderer_software_blend_8(destination,
+                                                    _mm256_set1_ps(r),
+                                                    _mm256_set1_ps(g),
+                                                    _mm256_set1_ps(b),
+                                                    _mm256_set1_ps(a));
+            _mm256_storeu_si256((__m256i *)(row + x), destination);
+        }
+#endif
+        
+        __m128 r_4 = _mm_set1_ps(r);
+        __m128 g_4 = _mm_set1_ps(g);
+        __m128 b_4 = _mm_set1_ps(b);
+        __m128 a_4 = _mm_set1_ps(a);
+        
+        for (;
+             x < x_end;
+             x += 4)
+        {
+            I32 count = min_i(x_end - x, 4);
+            U32 pixels[4];
+            memcpy(pixels, row + x, count * sizeof(pixels[0]));
+            
+            __m128i destination = _mm_loadu_si128((__m128i *)pixels);
+            destination = renderer_software_blend_4(destination, r_4, g_4, b_4, a_4);
+            _mm_storeu_si128((__m128i *)pixels, destination);
+            
+            memcpy(row + x, pixels, count * sizeof(pixels[0]));
+        }
+    }
+    else
+    {
+        //-NOTE(tbt): general path - interpolate attributes, sample texture, shade and blend
+        __m128 attribute_row[SOFTWARE_ATTRIBUTE_MAX];
+        __m128 attribute_step[SOFTWARE_ATTRIBUTE_MAX];
+        for (I32 i = 0;
+             i < SOFTWARE_ATTRIBUTE_MAX;
+             ++i)
+        {
+            attribute_row[i] = _mm_set1_ps(shading->base[i] + y_centre * shading->d_dy[i]);
+            attribute_step[i] = _mm_set1_ps(shading->d_dx[i]);
+        }
+        
+        __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        
+        for (;
+             x < x_end;
+             x += 4)
+        {
+            I32 count = min_i(x_end - x, 4);
+            U32 pixels[4];
+            memcpy(pixels, row + x, count * sizeof(pixels[0]));
+            
+            __m128 x_centre = _mm_add_ps(_mm_set1_ps((F32)x), lane_offsets);
+            
+            __m128 attributes[SOFTWARE_ATTRIBUTE_MAX];
+            for (I32 i = 0;
+                 i < SOFTWARE_ATTRIBUTE_MAX;
+                 ++i)
+            {
+                attributes[i] = _mm_add_ps(attribute_row[i], _mm_mul_ps(x_centre, attribute_step[i]));
+            }
+            
+            // NOTE(tbt): gather texels
+            F32 u[4], v[4];
+            _mm_storeu_ps(u, attributes[SOFTWARE_ATTRIBUTE_u]);
+            _mm_storeu_ps(v, attributes[SOFTWARE_ATTRIBUTE_v]);
+            
+            F32 texel_r[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            F32 texel_g[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            F32 texel_b[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            F32 texel_a[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            if (shading->texture)
+            {
+                for (I32 lane = 0;
+                     lane < count;
+                     ++lane)
+                {
+                    F32 texel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                    renderer_software_sample(shading->texture, u[lane], v[lane], texel);
+                    texel_r[lane] = texel[0];
+                    texel_g[lane] = texel[1];
+                    texel_b[lane] = texel[2];
+                    texel_a[lane] = texel[3];
+                }
+            }
+            
+            // NOTE(tbt): shade
+            __m128 a;
+            if (shading->is_text)
+            {
+                a = _mm_mul_ps(_mm_loadu_ps(texel_r), attributes[SOFTWARE_ATTRIBUTE_a]);
+            }
+            else
+            {
+                a = _mm_mul_ps(_mm_loadu_ps(texel_a), attributes[SOFTWARE_ATTRIBUTE_a]);
+                attributes[SOFTWARE_ATTRIBUTE_r] = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_r], _mm_loadu_ps(texel_r));
+                attributes[SOFTWARE_ATTRIBUTE_g] = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_g], _mm_loadu_ps(texel_g));
+                attributes[SOFTWARE_ATTRIBUTE_b] = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_b], _mm_loadu_ps(texel_b));
+            }
+            __m128 r = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_r], a);
+            __m128 g = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_g], a);
+            __m128 b = _mm_mul_ps(attributes[SOFTWARE_ATTRIBUTE_b], a);
+            
+            // NOTE(tbt): blend
+            __m128i destination = _mm_loadu_si128((__m128i *)pixels);
+            destination = renderer_software_blend_4(destination, r, g, b, a);
+            _mm_storeu_si128((__m128i *)pixels, destination);
+            
+            memcpy(row + x, pixels, count * sizeof(pixels[0]));
+        }
+    }
+}
+
+internal void
+renderer_software_fill_triangle(Vertex *a,
+                                Vertex *b,
+                                Vertex *c,
+                                F32 *projection_matrix,
+                                I32 clip_x0, I32 clip_y0,
+                                I32 clip_x1, I32 clip_y1,
+                                SoftwareTexture *texture,
+                                B32 is_text)
+{
+    PlatformFramebuffer *framebuffer = global_rcx.software.framebuffer;
+    
+    //-NOTE(tbt): transform to framebuffer pixel coordinates
+    Vertex *vertices[3] = { a, b, c };
+    F32 x[3], y[3];
+    for (I32 i = 0;
+         i < 3;
+         ++i)
+    {
+        F32 clip_x = projection_matrix[0] * vertices[i]->x + projection_matrix[4] * vertices[i]->y + projection_matrix[12];
+        F32 clip_y = projection_matrix[1] * vertices[i]->x + projection_matrix[5] * vertices[i]->y + projection_matrix[13];
+        x[i] = (clip_x + 1.0f) * 0.5f * framebuffer->w;
+        y[i] = (1.0f - clip_y) * 0.5f * framebuffer->h;
+    }
+    
+    F32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) { return; }
+    
+    //-NOTE(tbt): setup attribute plane equations
+    SoftwareShading shading = {0};
+    shading.texture = texture;
+    shading.is_text = is_text;
+    
+    for (I32 i = 0;
+         i < SOFTWARE_ATTRIBUTE_MAX;
+         ++i)
+    {
+        F32 attribute[3];
+        for (I32 j = 0;
+             j < 3;
+             ++j)
+        {
+            F32 *vertex_attributes = &vertices[j]->r;
+            attribute[j] = vertex_attributes[i];
+        }
+        
+        shading.d_dx[i] = ((attribute[1] - attribute[0]) * (y[2] - y[0]) - (attribute[2] - attribute[0]) * (y[1] - y[0])) / area;
+        shading.d_dy[i] = ((attribute[2] - attribute[0]) * (x[1] - x[0]) - (attribute[1] - attribute[0]) * (x[2] - x[0])) / area;
+        shading.base[i] = attribute[0] - x[0] * shading.d_dx[i] - y[0] * shading.d_dy[i];
+    }
+    
+    shading.is_flat_colour =
+        !is_text &&
+        (!texture || (texture->width == 1 && texture->height == 1 && texture->pixels[3] == 255 &&
+                      texture->pixels[0] == 255 && texture->pixels[1] == 255 && texture->pixels[2] == 255)) &&
+        shading.d_dx[SOFTWARE_ATTRIBUTE_r] == 0.0f && shading.d_dy[SOFTWARE_ATTRIBUTE_r] == 0.0f &&
+        shading.d_dx[SOFTWARE_ATTRIBUTE_g] == 0.0f && shading.d_dy[SOFTWARE_ATTRIBUTE_g] == 0.0f &&
+        shading.d_dx[SOFTWARE_ATTRIBUTE_b] == 0.0f && shading.d_dy[SOFTWARE_ATTRIBUTE_b] == 0.0f &&
+        shading.d_dx[SOFTWARE_ATTRIBUTE_a] == 0.0f && shading.d_dy[SOFTWARE_ATTRIBUTE_a] == 0.0f;
+    
+    //-NOTE(tbt): edge functions, oriented so that the inside is positive
+    F32 orientation = area > 0.0f ? 1.0f : -1.0f;
+    F32 edge_a[3], edge_b[3], edge_c[3];
+    for (I32 i = 0;
+         i < 3;
+         ++i)
+    {
+        I32 j = (i + 1) % 3;
+        edge_a[i] = (y[i] - y[j]) * orientation;
+        edge_b[i] = (x[j] - x[i]) * orientation;
+        edge_c[i] = (x[i] * y[j] - x[j] * y[i]) * orientation;
+    }
+    
+    //-NOTE(tbt): walk rows, sampling at pixel centres
+    F32 min_y = min_f(y[0], min_f(y[1], y[2]));
+    F32 max_y = max_f(y[0], max_f(y[1], y[2]));
+    I32 row_begin = max_i(clip_y0, (I32)ceilf(min_y - 0.5f));
+    I32 row_end = min_i(clip_y1, (I32)ceilf(max_y - 0.5f));
+    
+    for (I32 row = row_begin;
+         row < row_end;
+         ++row)
+    {
+        F32 y_centre = row + 0.5f;
+        F32 span_min = -1e30f;
+        F32 span_max = 1e30f;
+        
+        for (I32 i = 0;
+             i < 3;
+             ++i)
+        {
+            F32 offset = edge_b[i] * y_centre + edge_c[i];
+            if (edge_a[i] > 0.0f)
+            {
+                span_min = max_f(span_min, -offset / edge_a[i]);
+            }
+            else if (edge_a[i] < 0.0f)
+            {
+                span_max = min_f(span_max, -offset / edge_a[i]);
+            }
+            else if (offset < 0.0f)
+            {
+                span_max = span_min;
+            }
+        }
+        
+        I32 x_begin = max_i(clip_x0, (I32)ceilf(max_f(span_min, clip_x0 - 1.0f) - 0.5f));
+        I32 x_end = min_i(clip_x1, (I32)ceilf(min_f(span_max, clip_x1 + 1.0f) - 0.5f));
+        
+        if (x_begin < x_end)
+        {
+            renderer_software_fill_span(framebuffer->pixels + (U64)row * framebuffer->w,
+                                        x_begin, x_end,
+                                        y_centre,
+                                        &shading);
+        }
+    }
+}
+
+internal void
+renderer_software_flush_batch(RenderBatch *batch)
+{
+    PlatformFramebuffer *framebuffer = global_rcx.software.framebuffer;
+    
+    // NOTE(tbt): the mask is already in top-left origin window coordinates, so no need to flip it as for glScissor
+    I32 clip_x0 = max_i((I32)batch->mask.x, 0);
+    I32 clip_y0 = max_i((I32)batch->mask.y, 0);
+    I32 clip_x1 = min_i((I32)batch->mask.x + (I32)batch->mask.w, framebuffer->w);
+    I32 clip_y1 = min_i((I32)batch->mask.y + (I32)batch->mask.h, framebuffer->h);
+    
+    if (clip_x0 >= clip_x1 ||
+        clip_y0 >= clip_y1)
+    {
+        return;
+    }
+    
+    SoftwareTexture *texture = renderer_software_texture_from_id(batch->texture);
+    B32 is_text = (batch->shader == global_rcx.shaders.text);
+    
+    for (I32 i = 0;
+         i < batch->quad_count;
+         ++i)
+    {
+        Quad instance_quad;
+        Quad *quad = &batch->buffer[i];
+        if (batch->is_instanced)
+        {
+            instance_quad = generate_quad_from_sprite_instance(&batch->instances[i]);
+            quad = &instance_quad;
+        }
+        
+        // NOTE(tbt): same winding as the index buffer
+        renderer_software_fill_triangle(&quad->bl, &quad->br, &quad->tr,
+                                        batch->projection_matrix,
+                                        clip_x0, clip_y0, clip_x1, clip_y1,
+                                        texture, is_text);
+        renderer_software_fill_triangle(&quad->tr, &quad->tl, &quad->bl,
+                                        batch->projection_matrix,
+                                        clip_x0, clip_y0, clip_x1, clip_y1,
+                                        texture, is_text);
+    }
+}
+
+//
+// NOTE(tbt): render targets
+//~
+
+internal U64
+renderer_bytes_per_pixel_from_render_target_format(U32 format)
+{
+    U64 result = 4;
+    switch (format)
+    {
+        case GL_R8:      { result = 1; break; }
+        case GL_RG8:     { result = 2; break; }
+        case GL_RGBA16F: { result = 8; break; }
+    }
+    return result;
+}
+
+internal void
+renderer_delete_render_target(RenderTarget *target)
+{
+    glDeleteFramebuffers(1, &target->framebuffer.target);
+    glDeleteTextures(1, &target->framebuffer.texture);
+    
+    global_rcx.render_targets.bytes -= (U64)target->w * (U64)target->h * renderer_bytes_per_pixel_from_render_target_format(target->format);
+    global_rcx.render_targets.count -= 1;
+    
+    memset(target, 0, sizeof(*target));
+}
+
+// NOTE(tbt): binds GL_FRAMEBUFFER to 0 if a new target has to be created
+internal RenderTarget *
+renderer_acquire_render_target(I32 w,
+                               I32 h,
+                               U32 format)
+{
+    RenderTarget *result = NULL;
+    RenderTarget *empty = NULL;
+    RenderTarget *least_recently_used = NULL;
+    
+    for (I32 target_index = 0;
+         target_index < RENDER_TARGET_POOL_SIZE;
+         ++target_index)
+    {
+        RenderTarget *target = &global_rcx.render_targets.targets[target_index];
+        
+        if (0 == target->w)
+        {
+            if (!empty) { empty = target; }
+        }
+        else if (!target->is_in_use)
+        {
+            if (target->w == w &&
+                target->h == h &&
+                target->format == format)
+            {
+                result = target;
+                break;
+            }
+            
+            if (!least_recently_used ||
+                target->last_used_flush < least_recently_used->last_used_flush)
+            {
+                least_recently_used = target;
+            }
+        }
+    }
+    
+    if (!result)
+    {
+        // NOTE(tbt): RENDER_TARGET_POOL_SIZE is well above the most targets ever in use at once, so there is always either
+        //            an empty slot or a free target of the wrong size to make room
+        if (empty)
+        {
+            result = empty;
+        }
+        else
+        {
+            result = least_recently_used;
+            renderer_delete_render_target(result);
+        }
+        
+        result->w = w;
+        result->h = h;
+        result->format = format;
+        
+        glGenFramebuffers(1, &result->framebuffer.target);
+        glBindFramebuffer(GL_FRAMEBUFFER, result->framebuffer.target);
+        
+        glGenTextures(1, &result->framebuffer.texture);
+        glBindTexture(GL_TEXTURE_2D, result->framebuffer.texture);
+        
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     format,
+                     w,
+                     h,
+                     0,
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE,
+                     NULL);
+        
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D,
+                               result->framebuffer.texture,
+                               0);
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
+        
+        global_rcx.render_targets.bytes += (U64)w * (U64)h * renderer_bytes_per_pixel_from_render_target_format(format);
+        global_rcx.render_targets.count += 1;
+        global_rcx.render_targets.allocation_count += 1;
+    }
+    
+    result->is_in_use = true;
+    result->last_used_flush = global_rcx.render_targets.flush_index;
+    
+    return result;
+}
+
+internal void
+renderer_release_render_target(RenderTarget *target)
+{
+    target->is_in_use = false;
+    target->last_used_flush = global_rcx.render_targets.flush_index;
+}
+
+// NOTE(tbt): called at the end of each flush
+internal void
+renderer_delete_idle_render_targets(void)
+{
+    for (I32 target_index = 0;
+         target_index < RENDER_TARGET_POOL_SIZE;
+         ++target_index)
+    {
+        RenderTarget *target = &global_rcx.render_targets.targets[target_index];
+        
+        if (target->w &&
+            !target->is_in_use &&
+            target->last_used_flush + RENDER_TARGET_MAX_IDLE_FLUSHES < global_rcx.render_targets.flush_index)
+        {
+            renderer_delete_render_target(target);
+        }
+    }
+    
+    global_rcx.render_targets.flush_index += 1;
+}
+
+//
+// NOTE(tbt): cpu post processing
+//~
+
+// NOTE(tbt): does the same blur, downsample, bloom and post processing chain as the shaders, but on the CPU
+//            - the blur buffers are RGBA8, like the OpenGL framebuffers, and blurred with 16 bit fixed point maths
+//            - the post processing maths is done in floating point, 4 pixels at a time
+//            - every pass is split into strips of rows, which are spread across the platform layer's worker threads
+
+internal inline CpuColour4
+renderer_cpu_unpack_4(__m128i pixels)
+{
+    CpuColour4 result;
+    
+    __m128i channel_mask = _mm_set1_epi32(0xff);
+    __m128 to_float = _mm_set1_ps(1.0f / 255.0f);
+    
+    result.r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, channel_mask)), to_float);
+    result.g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), channel_mask)), to_float);
+    result.b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), channel_mask)), to_float);
+    
+    return result;
+}
+
+// NOTE(tbt): clamps to [0, 1] and packs with an opaque alpha
+internal inline __m128i
+renderer_cpu_pack_4(CpuColour4 colour)
+{
+    __m128 to_byte = _mm_set1_ps(255.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    __m128i r = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(colour.r, zero), one), to_byte));
+    __m128i g = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(colour.g, zero), one), to_byte));
+    __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(colour.b, zero), one), to_byte));
+    
+    return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                        _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32(0xff000000)));
+}
+
+internal inline __m128
+renderer_cpu_lerp_4(__m128 a,
+                    __m128 b,
+                    __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// NOTE(tbt): bilinear filtering of 4 pixels in 8.8 fixed point - `t_x` and `t_y` are in [0, 256]
+internal inline U32
+renderer_cpu_bilinear(U32 top_left, U32 top_right,
+                      U32 bottom_left, U32 bottom_right,
+                      I32 t_x, I32 t_y)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi16(128);
+    
+    // NOTE(tbt): left pixel in the low 4 lanes, right pixel in the high 4 lanes
+    __m128i top = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, top_right, top_left), zero);
+    __m128i bottom = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, bottom_right, bottom_left), zero);
+    
+    __m128i vertical = _mm_add_epi16(_mm_mullo_epi16(top, _mm_set1_epi16(256 - t_y)),
+                                     _mm_mullo_epi16(bottom, _mm_set1_epi16(t_y)));
+    vertical = _mm_srli_epi16(_mm_add_epi16(vertical, round), 8);
+    
+    __m128i horizontal = _mm_mullo_epi16(vertical, _mm_set_epi16(t_x, t_x, t_x, t_x,
+                                                                 256 - t_x, 256 - t_x, 256 - t_x, 256 - t_x));
+    horizontal = _mm_add_epi16(horizontal, _mm_srli_si128(horizontal, 8));
+    horizontal = _mm_srli_epi16(_mm_add_epi16(horizontal, round), 8);
+    
+    return _mm_cvtsi128_si32(_mm_packus_epi16(horizontal, zero));
+}
+
+// NOTE(tbt): bilinear filtering of 4 arbitrary positions, given in texel space, clamped to the edges of the image
+internal inline CpuColour4
+renderer_cpu_sample_4(U32 *pixels,
+                      I32 pitch,
+                      I32 w, I32 h,
+                      __m128 x, __m128 y)
+{
+    CpuColour4 result;
+    
+    x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(w - 1));
+    y = _mm_min_ps(_mm_max_ps(y, _mm_setzero_ps()), _mm_set1_ps(h - 1));
+    
+    __m128i x0 = _mm_cvttps_epi32(x);
+    __m128i y0 = _mm_cvttps_epi32(y);
+    __m128 t_x = _mm_sub_ps(x, _mm_cvtepi32_ps(x0));
+    __m128 t_y = _mm_sub_ps(y, _mm_cvtepi32_ps(y0));
+    
+    I32 x0s[4];
+    I32 y0s[4];
+    _mm_storeu_si128((__m128i *)x0s, x0);
+    _mm_storeu_si128((__m128i *)y0s, y0);
+    
+    U32 top_left[4];
+    U32 top_right[4];
+    U32 bottom_left[4];
+    U32 bottom_right[4];
+    
+    for (I32 i = 0;
+         i < 4;
+         ++i)
+    {
+        I32 x1 = min_i(x0s[i] + 1, w - 1);
+        U32 *row_0 = pixels + y0s[i] * pitch;
+        U32 *row_1 = pixels + min_i(y0s[i] + 1, h - 1) * pitch;
+        
+        top_left[i] = row_0[x0s[i]];
+        top_right[i] = row_0[x1];
+        bottom_left[i] = row_1[x0s[i]];
+        bottom_right[i] = row_1[x1];
+    }
+    
+    CpuColour4 a = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)top_left));
+    CpuColour4 b = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)top_right));
+    CpuColour4 c = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)bottom_left));
+    CpuColour4 d = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)bottom_right));
+    
+    result.r = renderer_cpu_lerp_4(renderer_cpu_lerp_4(a.r, b.r, t_x), renderer_cpu_lerp_4(c.r, d.r, t_x), t_y);
+    result.g = renderer_cpu_lerp_4(renderer_cpu_lerp_4(a.g, b.g, t_x), renderer_cpu_lerp_4(c.g, d.g, t_x), t_y);
+    result.b = renderer_cpu_lerp_4(renderer_cpu_lerp_4(a.b, b.b, t_x), renderer_cpu_lerp_4(c.b, d.b, t_x), t_y);
+    
+    return result;
+}
+
+// NOTE(tbt): approximates pow(x, 1.0 / 2.2) for x >= 0, within about 0.5%
+internal inline __m128
+renderer_cpu_gamma_4(__m128 x)
+{
+    __m128 a = _mm_sqrt_ps(_mm_max_ps(x, _mm_setzero_ps()));
+    __m128 b = _mm_sqrt_ps(a);
+    __m128 c = _mm_sqrt_ps(b);
+    
+    return _mm_sub_ps(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(0.585122381f)),
+                                 _mm_mul_ps(b, _mm_set1_ps(0.783140355f))),
+                      _mm_mul_ps(c, _mm_set1_ps(0.368262736f)));
+}
+
+// NOTE(tbt): approximates exp(x) by splitting 2^(x * log2(e)) into an integer power, which goes straight into
+//            the exponent bits, and a fractional power, which uses a polynomial
+internal inline __m128
+renderer_cpu_exp_4(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(88.0f));
+    
+    __m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+    
+    // NOTE(tbt): floor, without needing SSE4.1
+    __m128 integer = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    integer = _mm_sub_ps(integer, _mm_and_ps(_mm_cmpgt_ps(integer, t), _mm_set1_ps(1.0f)));
+    __m128 fraction = _mm_sub_ps(t, integer);
+    
+    __m128 polynomial = _mm_set1_ps(0.0013333558f);
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(0.0096181291f));
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(0.0555041087f));
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(0.2402265070f));
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(0.6931471806f));
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, fraction), _mm_set1_ps(1.0f));
+    
+    __m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(integer), _mm_set1_epi32(127)), 23);
+    
+    return _mm_mul_ps(polynomial, _mm_castsi128_ps(exponent));
+}
+
+// NOTE(tbt): smoothstep(-0.5, 0.5, distance(uv, vec2(0.5)) - 0.5), as in the vignette() functions in the shaders
+internal inline __m128
+renderer_cpu_vignette_4(__m128 u,
+                        __m128 v)
+{
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 du = _mm_sub_ps(u, half);
+    __m128 dv = _mm_sub_ps(v, half);
+    
+    __m128 t = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(du, du), _mm_mul_ps(dv, dv)));
+    t = _mm_min_ps(t, _mm_set1_ps(1.0f));
+    
+    return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+}
+
+internal void
+renderer_cpu_copy(CpuPostProcessingJob *job)
+{
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        memcpy(job->destination_image.pixels + y * job->destination_image.pitch,
+               job->source_image.pixels + y * job->source_image.pitch,
+               job->source_image.w * sizeof(U32));
+    }
+}
+
+// NOTE(tbt): linear filtering to BLUR_TEXTURE_W * BLUR_TEXTURE_H, the same as the glBlitFramebuffer on the OpenGL path
+internal void
+renderer_cpu_downsample(CpuPostProcessingJob *job)
+{
+    CpuImage *source = &job->source_image;
+    
+    // NOTE(tbt): fast path for when the screen is exactly twice the size of the blur buffer, where linear filtering
+    //            is just the average of each 2x2 block - 4 output pixels at a time
+    if (source->w == 2 * BLUR_TEXTURE_W &&
+        source->h == 2 * BLUR_TEXTURE_H)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i round = _mm_set1_epi16(2);
+        
+        for (I32 y = job->row_begin;
+             y < job->row_end;
+             ++y)
+        {
+            U32 *row_0 = source->pixels + (2 * y) * source->pitch;
+            U32 *row_1 = source->pixels + (2 * y + 1) * source->pitch;
+            U32 *destination = job->destination_blur + y * BLUR_TEXTURE_W;
+            
+            // NOTE(tbt): BLUR_TEXTURE_W is a multiple of 4
+            for (I32 x = 0;
+                 x < BLUR_TEXTURE_W;
+                 x += 4)
+            {
+                __m128 a_0 = _mm_castsi128_ps(_mm_loadu_si128((__m128i *)(row_0 + 2 * x)));
+                __m128 b_0 = _mm_castsi128_ps(_mm_loadu_si128((__m128i *)(row_0 + 2 * x + 4)));
+                __m128 a_1 = _mm_castsi128_ps(_mm_loadu_si128((__m128i *)(row_1 + 2 * x)));
+                __m128 b_1 = _mm_castsi128_ps(_mm_loadu_si128((__m128i *)(row_1 + 2 * x + 4)));
+                
+                // NOTE(tbt): split into the left and right pixel of each pair
+                __m128i left_0 = _mm_castps_si128(_mm_shuffle_ps(a_0, b_0, _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i right_0 = _mm_castps_si128(_mm_shuffle_ps(a_0, b_0, _MM_SHUFFLE(3, 1, 3, 1)));
+                __m128i left_1 = _mm_castps_si128(_mm_shuffle_ps(a_1, b_1, _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i right_1 = _mm_castps_si128(_mm_shuffle_ps(a_1, b_1, _MM_SHUFFLE(3, 1, 3, 1)));
+                
+                __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(left_0, zero), _mm_unpacklo_epi8(right_0, zero)),
+                                           _mm_add_epi16(_mm_unpacklo_epi8(left_1, zero), _mm_unpacklo_epi8(right_1, zero)));
+                __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(left_0, zero), _mm_unpackhi_epi8(right_0, zero)),
+                                           _mm_add_epi16(_mm_unpackhi_epi8(left_1, zero), _mm_unpackhi_epi8(right_1, zero)));
+                
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+                
+                _mm_storeu_si128((__m128i *)(destination + x), _mm_packus_epi16(lo, hi));
+            }
+        }
+        
+        return;
+    }
+    
+    F32 scale_x = (F32)source->w / (F32)BLUR_TEXTURE_W;
+    F32 scale_y = (F32)source->h / (F32)BLUR_TEXTURE_H;
+    
+    // NOTE(tbt): the horizontal filtering is the same for every row
+    I32 column_x0[BLUR_TEXTURE_W];
+    I32 column_x1[BLUR_TEXTURE_W];
+    I32 column_t[BLUR_TEXTURE_W];
+    for (I32 x = 0;
+         x < BLUR_TEXTURE_W;
+         ++x)
+    {
+        F32 source_x = clamp_f((x + 0.5f) * scale_x - 0.5f, 0.0f, source->w - 1);
+        column_x0[x] = source_x;
+        column_x1[x] = min_i(column_x0[x] + 1, source->w - 1);
+        column_t[x] = (source_x - column_x0[x]) * 256.0f;
+    }
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        F32 source_y = clamp_f((y + 0.5f) * scale_y - 0.5f, 0.0f, source->h - 1);
+        I32 y0 = source_y;
+        I32 y1 = min_i(y0 + 1, source->h - 1);
+        I32 t_y = (source_y - y0) * 256.0f;
+        
+        U32 *row_0 = source->pixels + y0 * source->pitch;
+        U32 *row_1 = source->pixels + y1 * source->pitch;
+        U32 *destination = job->destination_blur + y * BLUR_TEXTURE_W;
+        
+        for (I32 x = 0;
+             x < BLUR_TEXTURE_W;
+             ++x)
+        {
+            destination[x] = renderer_cpu_bilinear(row_0[column_x0[x]], row_0[column_x1[x]],
+                                                   row_1[column_x0[x]], row_1[column_x1[x]],
+                                                   column_t[x], t_y);
+        }
+    }
+}
+
+//-NOTE(tbt): dual filter blur pyramid
+
+// NOTE(tbt): each level of the pyramid about quadruples the variance of the blur, so the strength works out as roughly
+//            that many passes of a 9 tap gaussian - 1 level for strength 1, 2 for 4 to 15, 3 for 16 to 63, ...
+internal I32
+renderer_blur_levels_from_strength(I32 strength)
+{
+    I32 result = 0;
+    while (result < BLUR_PYRAMID_MAX_LEVELS &&
+           (1 << (2 * result)) <= strength)
+    {
+        result += 1;
+    }
+    return result;
+}
+
+// NOTE(tbt): level 0 is the blur buffer, and the rest are packed one after another in cpu_post_processing.blur_pyramid
+internal CpuImage
+renderer_cpu_blur_level(U32 *blur,
+                        I32 level)
+{
+    CpuImage result;
+    result.pixels = blur;
+    result.w = BLUR_TEXTURE_W;
+    result.h = BLUR_TEXTURE_H;
+    result.pitch = BLUR_TEXTURE_W;
+    
+    if (level > 0)
+    {
+        result.pixels = global_rcx.cpu_post_processing.blur_pyramid;
+        for (I32 i = 1;
+             i < level;
+             ++i)
+        {
+            result.pixels += (BLUR_TEXTURE_W >> i) * (BLUR_TEXTURE_H >> i);
+        }
+        result.w = BLUR_TEXTURE_W >> level;
+        result.h = BLUR_TEXTURE_H >> level;
+        result.pitch = result.w;
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): the same taps as blur_down.frag and blur_up.frag, at any pair of sizes, bilinear filtering each tap
+//            - only used for the smallest levels of the pyramid, where the sizes stop halving exactly
+internal void
+renderer_cpu_blur_general(CpuPostProcessingJob *job,
+                          CpuBlurTap *taps,
+                          I32 tap_count)
+{
+    CpuImage *source = &job->source_image;
+    CpuImage *destination = &job->destination_image;
+    
+    F32 scale_x = (F32)source->w / (F32)destination->w;
+    F32 scale_y = (F32)source->h / (F32)destination->h;
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        U32 *row = destination->pixels + y * destination->pitch;
+        
+        for (I32 x = 0;
+             x < destination->w;
+             x += 4)
+        {
+            // NOTE(tbt): in texel space, with texel centres on whole numbers, as renderer_cpu_sample_4 wants
+            __m128 source_x = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set_ps(x + 3, x + 2, x + 1, x), _mm_set1_ps(0.5f)),
+                                                    _mm_set1_ps(scale_x)),
+                                         _mm_set1_ps(0.5f));
+            F32 source_y = (y + 0.5f) * scale_y - 0.5f;
+            
+            CpuColour4 sum = {0};
+            for (I32 tap_index = 0;
+                 tap_index < tap_count;
+                 ++tap_index)
+            {
+                CpuBlurTap *tap = &taps[tap_index];
+                CpuColour4 sample = renderer_cpu_sample_4(source->pixels, source->pitch,
+                                                          source->w, source->h,
+                                                          _mm_add_ps(source_x, _mm_set1_ps(tap->x)),
+                                                          _mm_set1_ps(source_y + tap->y));
+                __m128 weight = _mm_set1_ps(tap->weight);
+                sum.r = _mm_add_ps(sum.r, _mm_mul_ps(sample.r, weight));
+                sum.g = _mm_add_ps(sum.g, _mm_mul_ps(sample.g, weight));
+                sum.b = _mm_add_ps(sum.b, _mm_mul_ps(sample.b, weight));
+            }
+            
+            U32 pixels[4];
+            _mm_storeu_si128((__m128i *)pixels, renderer_cpu_pack_4(sum));
+            memcpy(row + x, pixels, min_i(destination->w - x, 4) * sizeof(U32));
+        }
+    }
+}
+
+// NOTE(tbt): unpacks a row of pixels to 16 bits per channel, repeating the edge pixels `padding` times at either end
+internal void
+renderer_cpu_widen_row(U16 *destination,
+                       U32 *source,
+                       I32 w,
+                       I32 padding)
+{
+    __m128i zero = _mm_setzero_si128();
+    
+    I32 x = 0;
+    for (;
+         x + 4 <= w;
+         x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((__m128i *)(source + x));
+        _mm_storeu_si128((__m128i *)(destination + (padding + x) * 4), _mm_unpacklo_epi8(pixels, zero));
+        _mm_storeu_si128((__m128i *)(destination + (padding + x + 2) * 4), _mm_unpackhi_epi8(pixels, zero));
+    }
+    for (;
+         x < w;
+         ++x)
+    {
+        _mm_storel_epi64((__m128i *)(destination + (padding + x) * 4), _mm_unpacklo_epi8(_mm_cvtsi32_si128(source[x]), zero));
+    }
+    
+    for (I32 i = 0;
+         i < padding;
+         ++i)
+    {
+        memcpy(destination + i * 4, destination + padding * 4, 4 * sizeof(U16));
+        memcpy(destination + (padding + w + i) * 4, destination + (padding + w - 1) * 4, 4 * sizeof(U16));
+    }
+}
+
+// NOTE(tbt): neighbouring destination rows mostly read the same source rows, so the last 8 rows to be widened are kept
+//            in `rows`, each `row_size` U16s, with the index of the source row in each kept in `row_indices`
+internal U16 *
+renderer_cpu_get_wide_row(U16 *rows,
+                          I32 *row_indices,
+                          I32 row_size,
+                          CpuImage *source,
+                          I32 row,
+                          I32 padding)
+{
+    row = clamp_i(row, 0, source->h - 1);
+    
+    I32 slot = row & 7;
+    U16 *result = rows + slot * row_size;
+    
+    if (row_indices[slot] != row)
+    {
+        renderer_cpu_widen_row(result, source->pixels + row * source->pitch, source->w, padding);
+        row_indices[slot] = row;
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): blur_down.frag
+//            - when the source is exactly twice the size, the taps come to 5/32 of each pixel of the 2x2 block under the
+//              destination pixel and 1/32 of each of the 12 around it, which is the sum of the 4x4 block plus 4 times the
+//              sum of the 2x2 block, over 32
+internal void
+renderer_cpu_blur_down(CpuPostProcessingJob *job)
+{
+    CpuImage *source = &job->source_image;
+    CpuImage *destination = &job->destination_image;
+    
+    if (source->w != 2 * destination->w ||
+        source->h != 2 * destination->h)
+    {
+        persist CpuBlurTap taps[] =
+        {
+            {  0.0f,  0.0f, 4.0f / 8.0f },
+            { -1.0f, -1.0f, 1.0f / 8.0f },
+            {  1.0f, -1.0f, 1.0f / 8.0f },
+            { -1.0f,  1.0f, 1.0f / 8.0f },
+            {  1.0f,  1.0f, 1.0f / 8.0f },
+        };
+        renderer_cpu_blur_general(job, taps, array_count(taps));
+        return;
+    }
+    
+    enum { ROW_SIZE = (BLUR_TEXTURE_W + 2) * 4, };
+    
+    U16 rows[8 * ROW_SIZE];
+    I32 row_indices[8] = { -1, -1, -1, -1, -1, -1, -1, -1, };
+    
+    // NOTE(tbt): sums of each column of the 4 source rows, and of the middle 2
+    U16 all[ROW_SIZE];
+    U16 centre[ROW_SIZE];
+    
+    __m128i round = _mm_set1_epi16(16);
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        U16 *row[4];
+        for (I32 i = 0;
+             i < 4;
+             ++i)
+        {
+            row[i] = renderer_cpu_get_wide_row(rows, row_indices, ROW_SIZE, source, 2 * y + i - 1, 1);
+        }
+        
+        I32 count = (source->w + 2) * 4;
+        I32 i = 0;
+        for (;
+             i + 8 <= count;
+             i += 8)
+        {
+            __m128i middle = _mm_add_epi16(_mm_loadu_si128((__m128i *)(row[1] + i)), _mm_loadu_si128((__m128i *)(row[2] + i)));
+            __m128i outer = _mm_add_epi16(_mm_loadu_si128((__m128i *)(row[0] + i)), _mm_loadu_si128((__m128i *)(row[3] + i)));
+            _mm_storeu_si128((__m128i *)(centre + i), middle);
+            _mm_storeu_si128((__m128i *)(all + i), _mm_add_epi16(middle, outer));
+        }
+        for (;
+             i < count;
+             i += 4)
+        {
+            __m128i middle = _mm_add_epi16(_mm_loadl_epi64((__m128i *)(row[1] + i)), _mm_loadl_epi64((__m128i *)(row[2] + i)));
+            __m128i outer = _mm_add_epi16(_mm_loadl_epi64((__m128i *)(row[0] + i)), _mm_loadl_epi64((__m128i *)(row[3] + i)));
+            _mm_storel_epi64((__m128i *)(centre + i), middle);
+            _mm_storel_epi64((__m128i *)(all + i), _mm_add_epi16(middle, outer));
+        }
+        
+        U32 *destination_row = destination->pixels + y * destination->pitch;
+        
+        // NOTE(tbt): source pixel x is at (x + 1) * 4, and each load gets 2 pixels
+        for (I32 x = 0;
+             x < destination->w;
+             ++x)
+        {
+            __m128i sum = _mm_add_epi16(_mm_loadu_si128((__m128i *)(all + (2 * x) * 4)),
+                                        _mm_loadu_si128((__m128i *)(all + (2 * x + 2) * 4)));
+            sum = _mm_add_epi16(sum, _mm_slli_epi16(_mm_loadu_si128((__m128i *)(centre + (2 * x + 1) * 4)), 2));
+            sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 5);
+            
+            destination_row[x] = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+        }
+    }
+}
+
+// NOTE(tbt): blur_up.frag
+//            - when the destination is exactly twice the size, the taps come to a 4x4 block of weights, mirrored
+//              depending on which corner of its source pixel each destination pixel is in
+//            - the source rows are weighted and summed for each column of the block first, which is then shared between
+//              the left and right destination pixels of each source pixel
+internal void
+renderer_cpu_blur_up(CpuPostProcessingJob *job)
+{
+    CpuImage *source = &job->source_image;
+    CpuImage *destination = &job->destination_image;
+    
+    if (destination->w != 2 * source->w ||
+        destination->h != 2 * source->h)
+    {
+        persist CpuBlurTap taps[] =
+        {
+            { -1.0f,  0.0f, 1.0f / 12.0f },
+            {  1.0f,  0.0f, 1.0f / 12.0f },
+            {  0.0f, -1.0f, 1.0f / 12.0f },
+            {  0.0f,  1.0f, 1.0f / 12.0f },
+            { -0.5f, -0.5f, 2.0f / 12.0f },
+            {  0.5f, -0.5f, 2.0f / 12.0f },
+            { -0.5f,  0.5f, 2.0f / 12.0f },
+            {  0.5f,  0.5f, 2.0f / 12.0f },
+        };
+        renderer_cpu_blur_general(job, taps, array_count(taps));
+        return;
+    }
+    
+    // NOTE(tbt): in 256ths, for the top left destination pixel of each source pixel, covering the source pixels from
+    //            2 up and left to 1 down and right - the sum of 8 bit values weighted by these just fits in 16 bits
+    persist I16 kernel[4][4] =
+    {
+        { 0,  1,  4,  0 },
+        { 1, 32, 45, 12 },
+        { 4, 45, 51, 23 },
+        { 0, 12, 23,  3 },
+    };
+    
+    enum { ROW_SIZE = (BLUR_TEXTURE_W / 2 + 4) * 4, };
+    
+    U16 rows[8 * ROW_SIZE];
+    I32 row_indices[8] = { -1, -1, -1, -1, -1, -1, -1, -1, };
+    
+    U16 columns[4][ROW_SIZE];
+    
+    __m128i round = _mm_set1_epi16(128);
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        B32 is_bottom = y & 1;
+        I32 first_row = (y >> 1) - 2 + is_bottom;
+        
+        U16 *row[4];
+        for (I32 i = 0;
+             i < 4;
+             ++i)
+        {
+            row[i] = renderer_cpu_get_wide_row(rows, row_indices, ROW_SIZE, source, first_row + i, 2);
+        }
+        
+        I32 count = (source->w + 4) * 4;
+        
+        for (I32 column = 0;
+             column < 4;
+             ++column)
+        {
+            __m128i weights[4];
+            for (I32 i = 0;
+                 i < 4;
+                 ++i)
+            {
+                weights[i] = _mm_set1_epi16(kernel[is_bottom ? 3 - i : i][column]);
+            }
+            
+            I32 i = 0;
+            for (;
+                 i + 8 <= count;
+                 i += 8)
+            {
+                __m128i sum = _mm_mullo_epi16(_mm_loadu_si128((__m128i *)(row[0] + i)), weights[0]);
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadu_si128((__m128i *)(row[1] + i)), weights[1]));
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadu_si128((__m128i *)(row[2] + i)), weights[2]));
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadu_si128((__m128i *)(row[3] + i)), weights[3]));
+                _mm_storeu_si128((__m128i *)(columns[column] + i), sum);
+            }
+            for (;
+                 i < count;
+                 i += 4)
+            {
+                __m128i sum = _mm_mullo_epi16(_mm_loadl_epi64((__m128i *)(row[0] + i)), weights[0]);
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadl_epi64((__m128i *)(row[1] + i)), weights[1]));
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadl_epi64((__m128i *)(row[2] + i)), weights[2]));
+                sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_loadl_epi64((__m128i *)(row[3] + i)), weights[3]));
+                _mm_storel_epi64((__m128i *)(columns[column] + i), sum);
+            }
+        }
+        
+        U32 *destination_row = destination->pixels + y * destination->pitch;
+        
+        // NOTE(tbt): source pixel x is at (x + 2) * 4 - the left destination pixel takes columns 0 to 3 of the block from
+        //            source pixels x - 2 to x + 1, and the right one takes them mirrored, from x + 2 back to x - 1
+        I32 x = 0;
+        for (;
+             x + 2 <= source->w;
+             x += 2)
+        {
+            __m128i left = _mm_loadu_si128((__m128i *)(columns[0] + x * 4));
+            left = _mm_add_epi16(left, _mm_loadu_si128((__m128i *)(columns[1] + (x + 1) * 4)));
+            left = _mm_add_epi16(left, _mm_loadu_si128((__m128i *)(columns[2] + (x + 2) * 4)));
+            left = _mm_add_epi16(left, _mm_loadu_si128((__m128i *)(columns[3] + (x + 3) * 4)));
+            left = _mm_srli_epi16(_mm_add_epi16(left, round), 8);
+            
+            __m128i right = _mm_loadu_si128((__m128i *)(columns[3] + (x + 1) * 4));
+            right = _mm_add_epi16(right, _mm_loadu_si128((__m128i *)(columns[2] + (x + 2) * 4)));
+            right = _mm_add_epi16(right, _mm_loadu_si128((__m128i *)(columns[1] + (x + 3) * 4)));
+            right = _mm_add_epi16(right, _mm_loadu_si128((__m128i *)(columns[0] + (x + 4) * 4)));
+            right = _mm_srli_epi16(_mm_add_epi16(right, round), 8);
+            
+            _mm_storeu_si128((__m128i *)(destination_row + 2 * x),
+                             _mm_packus_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right)));
+        }
+        for (;
+             x < source->w;
+             ++x)
+        {
+            __m128i left = _mm_loadl_epi64((__m128i *)(columns[0] + x * 4));
+            left = _mm_add_epi16(left, _mm_loadl_epi64((__m128i *)(columns[1] + (x + 1) * 4)));
+            left = _mm_add_epi16(left, _mm_loadl_epi64((__m128i *)(columns[2] + (x + 2) * 4)));
+            left = _mm_add_epi16(left, _mm_loadl_epi64((__m128i *)(columns[3] + (x + 3) * 4)));
+            left = _mm_srli_epi16(_mm_add_epi16(left, round), 8);
+            
+            __m128i right = _mm_loadl_epi64((__m128i *)(columns[3] + (x + 1) * 4));
+            right = _mm_add_epi16(right, _mm_loadl_epi64((__m128i *)(columns[2] + (x + 2) * 4)));
+            right = _mm_add_epi16(right, _mm_loadl_epi64((__m128i *)(columns[1] + (x + 3) * 4)));
+            right = _mm_add_epi16(right, _mm_loadl_epi64((__m128i *)(columns[0] + (x + 4) * 4)));
+            right = _mm_srli_epi16(_mm_add_epi16(right, round), 8);
+            
+            _mm_storel_epi64((__m128i *)(destination_row + 2 * x), _mm_packus_epi16(_mm_unpacklo_epi64(left, right), _mm_setzero_si128()));
+        }
+    }
+}
+
+// NOTE(tbt): linear filtering of the blur buffer back up into a region of the screen
+internal void
+renderer_cpu_upsample(CpuPostProcessingJob *job)
+{
+    CpuImage *destination = &job->destination_image;
+    
+    F32 scale_x = (F32)BLUR_TEXTURE_W / (F32)destination->w;
+    F32 scale_y = (F32)BLUR_TEXTURE_H / (F32)destination->h;
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        F32 source_y = clamp_f((y + 0.5f) * scale_y - 0.5f, 0.0f, BLUR_TEXTURE_H - 1);
+        I32 y0 = source_y;
+        I32 y1 = min_i(y0 + 1, BLUR_TEXTURE_H - 1);
+        I32 t_y = (source_y - y0) * 256.0f;
+        
+        U32 *row_0 = job->source_blur + y0 * BLUR_TEXTURE_W;
+        U32 *row_1 = job->source_blur + y1 * BLUR_TEXTURE_W;
+        U32 *row = destination->pixels + y * destination->pitch;
+        
+        for (I32 x = job->clip_x0;
+             x < job->clip_x1;
+             ++x)
+        {
+            F32 source_x = clamp_f((x + 0.5f) * scale_x - 0.5f, 0.0f, BLUR_TEXTURE_W - 1);
+            I32 x0 = source_x;
+            I32 x1 = min_i(x0 + 1, BLUR_TEXTURE_W - 1);
+            I32 t_x = (source_x - x0) * 256.0f;
+            
+            row[x] = renderer_cpu_bilinear(row_0[x0], row_0[x1],
+                                           row_1[x0], row_1[x1],
+                                           t_x, t_y);
+        }
+    }
+}
+
+// NOTE(tbt): post_processing.frag
+internal CpuColour4
+renderer_cpu_composite_world_4(CpuPostProcessingJob *job,
+                               __m128i pixels,
+                               CpuColour4 blur,
+                               __m128 x, F32 y,
+                               __m128 noise)
+{
+    CpuColour4 result;
+    
+    F32 w = job->destination_image.w;
+    F32 h = job->destination_image.h;
+    
+    __m128 u = _mm_mul_ps(x, _mm_set1_ps(1.0f / w));
+    __m128 v = _mm_set1_ps(y / h);
+    
+    CpuColour4 original = renderer_cpu_unpack_4(pixels);
+    
+    __m128 blur_luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(blur.r, _mm_set1_ps(0.2125f)),
+                                                  _mm_mul_ps(blur.g, _mm_set1_ps(0.7154f))),
+                                       _mm_mul_ps(blur.b, _mm_set1_ps(0.0721f)));
+    __m128 bloom = _mm_mul_ps(_mm_mul_ps(blur_luminance, blur_luminance), _mm_set1_ps(0.75f));
+    
+    noise = _mm_mul_ps(noise, _mm_set1_ps(0.02f));
+    
+    __m128 exposure = _mm_set1_ps(job->exposure);
+    __m128 vignette = renderer_cpu_vignette_4(u, v);
+    __m128 strength = _mm_set1_ps(0.95f);
+    
+    __m128 *original_channels[3] = { &original.r, &original.g, &original.b };
+    __m128 *blur_channels[3] = { &blur.r, &blur.g, &blur.b };
+    __m128 *result_channels[3] = { &result.r, &result.g, &result.b };
+    
+    for (I32 channel = 0;
+         channel < 3;
+         ++channel)
+    {
+        __m128 c = _mm_mul_ps(_mm_mul_ps(*original_channels[channel], *blur_channels[channel]), bloom);
+        c = _mm_add_ps(c, noise);
+        c = renderer_cpu_gamma_4(_mm_mul_ps(c, exposure));
+        c = _mm_sub_ps(c, vignette);
+        *result_channels[channel] = renderer_cpu_lerp_4(*original_channels[channel], c, strength);
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): memory_post_processing.frag
+internal CpuColour4
+renderer_cpu_composite_memory_4(CpuPostProcessingJob *job,
+                                __m128 x, F32 y,
+                                __m128 column_warp,
+                                F32 row_warp,
+                                __m128 noise)
+{
+    CpuColour4 result;
+    
+    F32 w = job->destination_image.w;
+    F32 h = job->destination_image.h;
+    
+    // NOTE(tbt): warp in OpenGL texture coordinates, which have v going up the screen
+    __m128 u = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.0f / w)), _mm_set1_ps(row_warp));
+    __m128 v = _mm_add_ps(_mm_set1_ps(1.0f - y / h), column_warp);
+    __m128 v_from_top = _mm_sub_ps(_mm_set1_ps(1.0f), v);
+    __m128 half = _mm_set1_ps(0.5f);
+    
+    CpuColour4 screen = renderer_cpu_sample_4(job->source_image.pixels, job->source_image.pitch,
+                                              job->source_image.w, job->source_image.h,
+                                              _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(w)), half),
+                                              _mm_sub_ps(_mm_mul_ps(v_from_top, _mm_set1_ps(h)), half));
+    CpuColour4 blur = renderer_cpu_sample_4(job->source_blur, BLUR_TEXTURE_W,
+                                            BLUR_TEXTURE_W, BLUR_TEXTURE_H,
+                                            _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(BLUR_TEXTURE_W)), half),
+                                            _mm_sub_ps(_mm_mul_ps(v_from_top, _mm_set1_ps(BLUR_TEXTURE_H)), half));
+    
+    noise = _mm_mul_ps(noise, _mm_set1_ps(0.03f));
+    
+    __m128 exposure = _mm_set1_ps(-job->exposure);
+    __m128 vignette = renderer_cpu_vignette_4(u, v);
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    F32 bloom_tint[3] = { 0.9f * 0.8f, 0.8f * 0.8f, 1.0f * 0.8f };
+    F32 vignette_colour[3] = { 0.9f, 0.8f, 1.0f };
+    __m128 *screen_channels[3] = { &screen.r, &screen.g, &screen.b };
+    __m128 *blur_channels[3] = { &blur.r, &blur.g, &blur.b };
+    __m128 *result_channels[3] = { &result.r, &result.g, &result.b };
+    
+    for (I32 channel = 0;
+         channel < 3;
+         ++channel)
+    {
+        __m128 c = _mm_add_ps(*screen_channels[channel], _mm_mul_ps(*blur_channels[channel], _mm_set1_ps(bloom_tint[channel])));
+        c = _mm_add_ps(c, noise);
+        c = _mm_mul_ps(c, _mm_add_ps(one, _mm_mul_ps(vignette, _mm_set1_ps(vignette_colour[channel]))));
+        *result_channels[channel] = _mm_sub_ps(one, renderer_cpu_exp_4(_mm_mul_ps(c, exposure)));
+    }
+    
+    return result;
+}
+
+internal void
+renderer_cpu_composite(CpuPostProcessingJob *job)
+{
+    CpuImage *destination = &job->destination_image;
+    
+    // NOTE(tbt): the world effect samples the blur without any warping, so the blur can be filtered vertically once for
+    //            each row, leaving just a horizontal lerp for each pixel
+    F32 blur_r[BLUR_TEXTURE_W];
+    F32 blur_g[BLUR_TEXTURE_W];
+    F32 blur_b[BLUR_TEXTURE_W];
+    
+    for (I32 y = job->row_begin;
+         y < job->row_end;
+         ++y)
+    {
+        U32 *row = destination->pixels + y * destination->pitch;
+        F32 *noise_row = global_rcx.cpu_post_processing.noise + ((y + job->noise_y) & (CPU_NOISE_SIZE - 1)) * (CPU_NOISE_SIZE + 4);
+        F32 row_warp = -0.001f * sinf(job->time + (1.0f - (y + 0.5f) / destination->h) * 5.0f);
+        
+        if (job->post_processing_kind == POST_PROCESSING_KIND_world)
+        {
+            F32 source_y = clamp_f((y + 0.5f) * ((F32)BLUR_TEXTURE_H / destination->h) - 0.5f, 0.0f, BLUR_TEXTURE_H - 1);
+            I32 y0 = source_y;
+            I32 y1 = min_i(y0 + 1, BLUR_TEXTURE_H - 1);
+            __m128 t_y = _mm_set1_ps(source_y - y0);
+            
+            U32 *row_0 = job->source_blur + y0 * BLUR_TEXTURE_W;
+            U32 *row_1 = job->source_blur + y1 * BLUR_TEXTURE_W;
+            
+            // NOTE(tbt): BLUR_TEXTURE_W is a multiple of 4
+            for (I32 x = 0;
+                 x < BLUR_TEXTURE_W;
+                 x += 4)
+            {
+                CpuColour4 a = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)(row_0 + x)));
+                CpuColour4 b = renderer_cpu_unpack_4(_mm_loadu_si128((__m128i *)(row_1 + x)));
+                _mm_storeu_ps(blur_r + x, renderer_cpu_lerp_4(a.r, b.r, t_y));
+                _mm_storeu_ps(blur_g + x, renderer_cpu_lerp_4(a.g, b.g, t_y));
+                _mm_storeu_ps(blur_b + x, renderer_cpu_lerp_4(a.b, b.b, t_y));
+            }
+        }
+        
+        for (I32 x = job->clip_x0;
+             x < job->clip_x1;
+             x += 4)
+        {
+            I32 pixel_count = min_i(job->clip_x1 - x, 4);
+            
+            // NOTE(tbt): go through a temporary buffer for the last few pixels, so they don't need special casing
+            U32 tail[4] = {0};
+            U32 *pixels = row + x;
+            if (pixel_count < 4)
+            {
+                memcpy(tail, pixels, pixel_count * sizeof(U32));
+                pixels = tail;
+            }
+            
+            __m128 pixel_centres = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+            __m128 noise = _mm_loadu_ps(noise_row + ((x + job->noise_x) & (CPU_NOISE_SIZE - 1)));
+            
+            CpuColour4 result;
+            if (job->post_processing_kind == POST_PROCESSING_KIND_memory)
+            {
+                result = renderer_cpu_composite_memory_4(job,
+                                                         pixel_centres, y + 0.5f,
+                                                         _mm_loadu_ps(job->column_warp + x), row_warp,
+                                                         noise);
+            }
+            else
+            {
+                I32 *x0 = job->blur_column_x0 + x;
+                F32 *t_x = job->blur_column_t + x;
+                
+                CpuColour4 blur;
+                blur.r = renderer_cpu_lerp_4(_mm_set_ps(blur_r[x0[3]], blur_r[x0[2]], blur_r[x0[1]], blur_r[x0[0]]),
+                                             _mm_set_ps(blur_r[x0[3] + 1], blur_r[x0[2] + 1], blur_r[x0[1] + 1], blur_r[x0[0] + 1]),
+                                             _mm_loadu_ps(t_x));
+                blur.g = renderer_cpu_lerp_4(_mm_set_ps(blur_g[x0[3]], blur_g[x0[2]], blur_g[x0[1]], blur_g[x0[0]]),
+                                             _mm_set_ps(blur_g[x0[3] + 1], blur_g[x0[2] + 1], blur_g[x0[1] + 1], blur_g[x0[0] + 1]),
+                                             _mm_loadu_ps(t_x));
+                blur.b = renderer_cpu_lerp_4(_mm_set_ps(blur_b[x0[3]], blur_b[x0[2]], blur_b[x0[1]], blur_b[x0[0]]),
+                                             _mm_set_ps(blur_b[x0[3] + 1], blur_b[x0[2] + 1], blur_b[x0[1] + 1], blur_b[x0[0] + 1]),
+                                             _mm_loadu_ps(t_x));
+                
+                result = renderer_cpu_composite_world_4(job,
+                                                        _mm_loadu_si128((__m128i *)pixels),
+                                                        blur,
+                                                        pixel_centres, y + 0.5f,
+                                                        noise);
+            }
+            
+            _mm_storeu_si128((__m128i *)pixels, renderer_cpu_pack_4(result));
+            if (pixels == tail)
+            {
+                memcpy(row + x, tail, pixel_count * sizeof(U32));
+            }
+        }
+    }
+}
+
+internal void
+renderer_cpu_do_job(void *data)
+{
+    CpuPostProcessingJob *job = data;
+    
+    switch (job->pass)
+    {
+        case CPU_POST_PROCESSING_PASS_copy:            profile_scope("renderer_cpu_copy")            { renderer_cpu_copy(job);            } break;
+        case CPU_POST_PROCESSING_PASS_downsample:      profile_scope("renderer_cpu_downsample")      { renderer_cpu_downsample(job);      } break;
+        case CPU_POST_PROCESSING_PASS_blur_down:       profile_scope("renderer_cpu_blur_down")       { renderer_cpu_blur_down(job);       } break;
+        case CPU_POST_PROCESSING_PASS_blur_up:         profile_scope("renderer_cpu_blur_up")         { renderer_cpu_blur_up(job);         } break;
+        case CPU_POST_PROCESSING_PASS_upsample:        profile_scope("renderer_cpu_upsample")        { renderer_cpu_upsample(job);        } break;
+        case CPU_POST_PROCESSING_PASS_composite:       profile_scope("renderer_cpu_composite")       { renderer_cpu_composite(job);       } break;
+        default: break;
+    }
+}
+
+// NOTE(tbt): splits the rows from job->row_begin to job->row_end into strips, and waits for the workers to finish them all
+internal void
+renderer_cpu_run_pass(CpuPostProcessingJob job)
+{
+    F64 start_time = platform_get_time();
+    
+    // NOTE(tbt): a few strips for each thread so that uneven strips balance out
+    I32 strip_count = (platform_get_worker_count() + 1) * 4;
+    I32 rows_per_strip = max_i((job.row_end - job.row_begin + strip_count - 1) / strip_count, 8);
+    
+    for (I32 row = job.row_begin;
+         row < job.row_end;
+         row += rows_per_strip)
+    {
+        CpuPostProcessingJob *strip = arena_push(&global_frame_memory, sizeof(*strip));
+        *strip = job;
+        strip->row_begin = row;
+        strip->row_end = min_i(row + rows_per_strip, job.row_end);
+        platform_push_work(renderer_cpu_do_job, strip);
+    }
+    
+    platform_complete_all_work();
+    
+    global_rcx.cpu_post_processing.pass_times[job.pass] += platform_get_time() - start_time;
+}
+
+// NOTE(tbt): returns the image to do post processing on - reads back the screen if not using the software renderer
+internal CpuImage
+renderer_cpu_begin(void)
+{
+    CpuImage result;
+    
+    if (!global_rcx.cpu_post_processing.is_noise_initialised)
+    {
+        // NOTE(tbt): rows are padded with a copy of their first 4 values, so 4 can always be loaded at once
+        U32 state = 0x9e3779b9;
+        for (I32 y = 0;
+             y < CPU_NOISE_SIZE;
+             ++y)
+        {
+            F32 *row = global_rcx.cpu_post_processing.noise + y * (CPU_NOISE_SIZE + 4);
+            for (I32 x = 0;
+                 x < CPU_NOISE_SIZE;
+                 ++x)
+            {
+                state = state * 1664525 + 1013904223;
+                row[x] = (state >> 8) * (1.0f / 16777216.0f);
+            }
+            memcpy(row + CPU_NOISE_SIZE, row, 4 * sizeof(F32));
+        }
+        global_rcx.cpu_post_processing.is_noise_initialised = true;
+    }
+    
+    if (global_rcx.software.framebuffer)
+    {
+        result.w = global_rcx.software.framebuffer->w;
+        result.h = global_rcx.software.framebuffer->h;
+    }
+    else
+    {
+        result.w = global_rcx.window.w;
+        result.h = global_rcx.window.h;
+    }
+    
+    // NOTE(tbt): reallocate the read back and copy buffers if the screen has changed size
+    if (global_rcx.cpu_post_processing.buffer_w != result.w ||
+        global_rcx.cpu_post_processing.buffer_h != result.h)
+    {
+        U64 buffer_size = (U64)result.w * (U64)result.h * sizeof(U32);
+        global_rcx.cpu_post_processing.readback = realloc(global_rcx.cpu_post_processing.readback, buffer_size);
+        global_rcx.cpu_post_processing.screen_copy = realloc(global_rcx.cpu_post_processing.screen_copy, buffer_size);
+        global_rcx.cpu_post_processing.buffer_w = result.w;
+        global_rcx.cpu_post_processing.buffer_h = result.h;
+    }
+    
+    if (global_rcx.software.framebuffer)
+    {
+        result.pixels = global_rcx.software.framebuffer->pixels;
+        result.pitch = result.w;
+    }
+    else
+    {
+        F64 start_time = platform_get_time();
+        glReadPixels(0, 0, result.w, result.h, GL_RGBA, GL_UNSIGNED_BYTE, global_rcx.cpu_post_processing.readback);
+        global_rcx.cpu_post_processing.pass_times[CPU_POST_PROCESSING_PASS_readback] += platform_get_time() - start_time;
+        
+        // NOTE(tbt): OpenGL gives rows bottom first
+        result.pixels = global_rcx.cpu_post_processing.readback + (result.h - 1) * result.w;
+        result.pitch = -result.w;
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): copies the area which has been post processed back to the screen if not using the software renderer
+internal void
+renderer_cpu_end(I32 clip_x0, I32 clip_y0,
+                 I32 clip_x1, I32 clip_y1)
+{
+    if (!global_rcx.software.framebuffer)
+    {
+        F64 start_time = platform_get_time();
+        
+        I32 w = global_rcx.cpu_post_processing.buffer_w;
+        I32 h = global_rcx.cpu_post_processing.buffer_h;
+        
+        RenderTarget *target = renderer_acquire_render_target(w, h, GL_RGBA8);
+        
+        glBindTexture(GL_TEXTURE_2D, target->framebuffer.texture);
+        glTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0,
+                        0,
+                        w,
+                        h,
+                        GL_RGBA,
+                        GL_UNSIGNED_BYTE,
+                        global_rcx.cpu_post_processing.readback);
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer.target);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(clip_x0,
+                  h - clip_y1,
+                  clip_x1 - clip_x0,
+                  clip_y1 - clip_y0);
+        
+        glBlitFramebuffer(0, 0, w, h,
+                          0, 0, w, h,
+                          GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
+        
+        renderer_release_render_target(target);
+        
+        global_rcx.cpu_post_processing.pass_times[CPU_POST_PROCESSING_PASS_upload] += platform_get_time() - start_time;
+    }
+}
+
+// NOTE(tbt): blurs a downsampled image of the screen, in `blur`, in place - see renderer_push_blur_passes
+internal void
+renderer_cpu_blur_pyramid(U32 *blur,
+                          I32 level_count)
+{
+    CpuPostProcessingJob job = {0};
+    job.row_begin = 0;
+    
+    for (I32 level = 1;
+         level <= level_count;
+         ++level)
+    {
+        job.pass = CPU_POST_PROCESSING_PASS_blur_down;
+        job.source_image = renderer_cpu_blur_level(blur, level - 1);
+        job.destination_image = renderer_cpu_blur_level(blur, level);
+        job.row_end = job.destination_image.h;
+        renderer_cpu_run_pass(job);
+    }
+    
+    for (I32 level = level_count;
+         level >= 1;
+         --level)
+    {
+        job.pass = CPU_POST_PROCESSING_PASS_blur_up;
+        job.source_image = renderer_cpu_blur_level(blur, level);
+        job.destination_image = renderer_cpu_blur_level(blur, level - 1);
+        job.row_end = job.destination_image.h;
+        renderer_cpu_run_pass(job);
+    }
+}
+
+// NOTE(tbt): if `key` matches the blur already in blur_a, that is used rather than blurring the screen again
+internal void
+renderer_cpu_blur_screen_region(Rect region,
+                                Rect mask,
+                                I32 strength,
+                                U64 key)
+{
+    CpuImage screen = renderer_cpu_begin();
+    
+    Rect clip = rect_at_intersection(region, mask);
+    I32 clip_x0 = max_i(clip.x, 0);
+    I32 clip_y0 = max_i(clip.y, 0);
+    I32 clip_x1 = min_i(clip.x + clip.w, screen.w);
+    I32 clip_y1 = min_i(clip.y + clip.h, screen.h);
+    
+    if (clip_x0 >= clip_x1 ||
+        clip_y0 >= clip_y1)
+    {
+        return;
+    }
+    
+    CpuPostProcessingJob job = {0};
+    
+    I32 level_count = renderer_blur_levels_from_strength(strength);
+    U32 pass_count = 1 + 2 * level_count;
+    
+    if (key == global_rcx.screen_blur.cpu_key)
+    {
+        global_rcx.screen_blur.passes_saved += pass_count;
+    }
+    else
+    {
+        global_rcx.screen_blur.cpu_key = key;
+        global_rcx.screen_blur.pass_count += pass_count;
+        
+        job.pass = CPU_POST_PROCESSING_PASS_downsample;
+        job.source_image = screen;
+        job.destination_blur = global_rcx.cpu_post_processing.blur_a;
+        job.row_begin = 0;
+        job.row_end = BLUR_TEXTURE_H;
+        renderer_cpu_run_pass(job);
+        
+        renderer_cpu_blur_pyramid(global_rcx.cpu_post_processing.blur_a, level_count);
+    }
+    
+    job.pass = CPU_POST_PROCESSING_PASS_upsample;
+    job.source_blur = global_rcx.cpu_post_processing.blur_a;
+    job.destination_image = screen;
+    job.clip_x0 = clip_x0;
+    job.clip_x1 = clip_x1;
+    job.row_begin = clip_y0;
+    job.row_end = clip_y1;
+    renderer_cpu_run_pass(job);
+    
+    renderer_cpu_end(clip_x0, clip_y0, clip_x1, clip_y1);
+}
+
+internal void
+renderer_cpu_do_post_processing(PostProcessingKind kind,
+                                F32 exposure,
+                                Rect mask)
+{
+    if (kind != POST_PROCESSING_KIND_world &&
+        kind != POST_PROCESSING_KIND_memory)
+    {
+        return;
+    }
+    
+    CpuImage screen = renderer_cpu_begin();
+    
+    I32 clip_x0 = max_i(mask.x, 0);
+    I32 clip_y0 = max_i(mask.y, 0);
+    I32 clip_x1 = min_i(mask.x + mask.w, screen.w);
+    I32 clip_y1 = min_i(mask.y + mask.h, screen.h);
+    
+    if (clip_x0 >= clip_x1 ||
+        clip_y0 >= clip_y1)
+    {
+        return;
+    }
+    
+    CpuPostProcessingJob job = {0};
+    job.post_processing_kind = kind;
+    job.exposure = exposure;
+    job.time = global_time;
+    
+    // NOTE(tbt): new noise every frame, like the u_time term in the shaders
+    U32 noise_seed = (U32)(global_time * 7919.0);
+    job.noise_x = noise_seed * 2654435761u >> 16;
+    job.noise_y = noise_seed * 2246822519u >> 16;
+    
+    //-NOTE(tbt): bloom
+    // NOTE(tbt): about to overwrite the screen blur
+    global_rcx.screen_blur.cpu_key = 0;
+    
+    job.pass = CPU_POST_PROCESSING_PASS_downsample;
+    job.source_image = screen;
+    job.destination_blur = global_rcx.cpu_post_processing.blur_a;
+    job.row_begin = 0;
+    job.row_end = BLUR_TEXTURE_H;
+    renderer_cpu_run_pass(job);
+    
+    renderer_cpu_blur_pyramid(global_rcx.cpu_post_processing.blur_a, BLOOM_BLUR_LEVELS);
+    
+    //-NOTE(tbt): the memory effect samples the screen at warped coordinates, so needs a copy to read from
+    if (kind == POST_PROCESSING_KIND_memory)
+    {
+        CpuImage screen_copy = screen;
+        screen_copy.pixels = global_rcx.cpu_post_processing.screen_copy;
+        screen_copy.pitch = screen.w;
+        
+        job.pass = CPU_POST_PROCESSING_PASS_copy;
+        job.source_image = screen;
+        job.destination_image = screen_copy;
+        job.row_begin = 0;
+        job.row_end = screen.h;
+        renderer_cpu_run_pass(job);
+        
+        job.source_image = screen_copy;
+        
+        // NOTE(tbt): the vertical warp only depends on the column - padded in the same way as the blur lookups below
+        job.column_warp = arena_push(&global_frame_memory, (screen.w + 4) * sizeof(F32));
+        for (I32 x = 0;
+             x < screen.w + 4;
+             ++x)
+        {
+            job.column_warp[x] = -0.001f * cosf(job.time + ((min_i(x, screen.w - 1) + 0.5f) / screen.w) * 5.0f);
+        }
+    }
+    
+    //-NOTE(tbt): blur lookups for each column, padded so that the last few pixels can always be done 4 at once
+    job.blur_column_x0 = arena_push(&global_frame_memory, (screen.w + 4) * sizeof(I32));
+    job.blur_column_t = arena_push(&global_frame_memory, (screen.w + 4) * sizeof(F32));
+    for (I32 x = 0;
+         x < screen.w + 4;
+         ++x)
+    {
+        F32 source_x = clamp_f((min_i(x, screen.w - 1) + 0.5f) * ((F32)BLUR_TEXTURE_W / screen.w) - 0.5f, 0.0f, BLUR_TEXTURE_W - 1);
+        job.blur_column_x0[x] = min_i(source_x, BLUR_TEXTURE_W - 2);
+        job.blur_column_t[x] = source_x - job.blur_column_x0[x];
+    }
+    
+    //-NOTE(tbt): combine
+    job.pass = CPU_POST_PROCESSING_PASS_composite;
+    job.source_blur = global_rcx.cpu_post_processing.blur_a;
+    job.destination_image = screen;
+    job.clip_x0 = clip_x0;
+    job.clip_x1 = clip_x1;
+    job.row_begin = clip_y0;
+    job.row_end = clip_y1;
+    renderer_cpu_run_pass(job);
+    
+    renderer_cpu_end(clip_x0, clip_y0, clip_x1, clip_y1);
+}
+
+//
+// NOTE(tbt): renderer
+//~
+
+//-NOTE(tbt): GPU timers
+
+internal void
+renderer_initialise_gpu_timers(void)
+{
+    // NOTE(tbt): GL_TIME_ELAPSED and glGetQueryObjectui64v both come from ARB_timer_query
+    if (!global_rcx.software.framebuffer &&
+        glGenQueries &&
+        glBeginQuery &&
+        glEndQuery &&
+        glGetQueryObjectiv &&
+        glGetQueryObjectui64v)
+    {
+        for (I32 frame_index = 0;
+             frame_index < GPU_TIMER_FRAMES_IN_FLIGHT;
+             ++frame_index)
+        {
+            glGenQueries(GPU_TIMER_MAX_QUERIES, global_rcx.gpu_timers.frames[frame_index].queries);
+        }
+        global_rcx.gpu_timers.is_supported = true;
+    }
+}
+
+// NOTE(tbt): called at the start of each flush - moves on to the oldest set of queries, reading back its results if they are ready
+internal void
+renderer_begin_gpu_timer_frame(void)
+{
+    if (!global_rcx.gpu_timers.is_supported) { return; }
+    
+    global_rcx.gpu_timers.current_frame = (global_rcx.gpu_timers.current_frame + 1) % GPU_TIMER_FRAMES_IN_FLIGHT;
+    struct RcxGpuTimerFrame *frame = &global_rcx.gpu_timers.frames[global_rcx.gpu_timers.current_frame];
+    frame->is_untimed = false;
+    
+    if (frame->query_count > 0)
+    {
+        // NOTE(tbt): queries complete in the order they were issued, so if the last one is ready they all are
+        GLint is_available = GL_FALSE;
+        glGetQueryObjectiv(frame->queries[frame->query_count - 1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+        
+        if (is_available)
+        {
+            RendererGpuStats *stats = &global_rcx.gpu_timers.stats;
+            memset(stats->pass_times, 0, sizeof(stats->pass_times));
+            memset(stats->pass_counts, 0, sizeof(stats->pass_counts));
+            stats->total_time = 0.0;
+            
+            for (U32 query_index = 0;
+                 query_index < frame->query_count;
+                 ++query_index)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(frame->queries[query_index], GL_QUERY_RESULT, &nanoseconds);
+                
+                F64 seconds = nanoseconds / 1000000000.0;
+                stats->pass_times[frame->kinds[query_index]] += seconds;
+                stats->pass_counts[frame->kinds[query_index]] += 1;
+                stats->total_time += seconds;
+            }
+            
+            stats->is_available = true;
+            frame->query_count = 0;
+        }
+        else
+        {
+            frame->is_untimed = true;
+            global_rcx.gpu_timers.stats.untimed_flush_count += 1;
+        }
+    }
+}
+
+internal void
+renderer_begin_gpu_timer(RenderMessageKind kind)
+{
+    struct RcxGpuTimerFrame *frame = &global_rcx.gpu_timers.frames[global_rcx.gpu_timers.current_frame];
+    
+    if (global_rcx.gpu_timers.is_supported &&
+        !frame->is_untimed &&
+        frame->query_count < GPU_TIMER_MAX_QUERIES)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->query_count]);
+        frame->kinds[frame->query_count] = kind;
+        frame->query_count += 1;
+        global_rcx.gpu_timers.is_timing = true;
+    }
+}
+
+internal void
+renderer_end_gpu_timer(void)
+{
+    if (global_rcx.gpu_timers.is_timing)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        global_rcx.gpu_timers.is_timing = false;
+    }
+}
+
+internal RendererGpuStats *
+renderer_get_gpu_stats(void)
+{
+    return &global_rcx.gpu_timers.stats;
+}
+
+// NOTE(tbt): the instance attributes have to be pointed at each batch as it is written, as there is no base instance
+//            before GL 4.2 - instance_vao and instance_vbo must be bound
+internal void
+renderer_opengl_point_instance_attributes(U64 offset)
+{
+    glVertexAttribPointer(3,
+                          4,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(SpriteInstance),
+                          (const void *)(offset));
+    
+    glVertexAttribPointer(4,
+                          4,
+                          GL_UNSIGNED_SHORT,
+                          GL_TRUE,
+                          sizeof(SpriteInstance),
+                          (const void *)(offset + 4 * sizeof(F32)));
+    
+    glVertexAttribPointer(5,
+                          4,
+                          GL_UNSIGNED_BYTE,
+                          GL_TRUE,
+                          sizeof(SpriteInstance),
+                          (const void *)(offset + 4 * sizeof(F32) + 4 * sizeof(U16)));
+    
+    glVertexAttribPointer(6,
+                          1,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(SpriteInstance),
+                          (const void *)(offset + 4 * sizeof(F32) + 4 * sizeof(U16) + 4 * sizeof(U8)));
+}
+
+internal void
+initialise_renderer(void)
+{
+    I32 i;
+    I32 offset;
+    I32 indices[BATCH_SIZE * 6];
+    void *render_queue_backing_memory;
+    
+    //
+    // NOTE(tbt): render message queues
+    //
+    
+    for (U32 queue_index = 0;
+         queue_index <= platform_get_worker_count() &&
+         queue_index < MAX_RENDER_QUEUES;
+         ++queue_index)
+    {
+        initialise_arena_with_new_memory(&global_rcx.message_queues[queue_index].memory, RENDER_QUEUE_MEMORY_SIZE);
+    }
+    
+    //
+    // NOTE(tbt): text run cache
+    //
+    
+    initialise_arena_with_new_memory(&global_rcx.text_run_cache.memory[0], TEXT_RUN_CACHE_MEMORY_SIZE);
+    initialise_arena_with_new_memory(&global_rcx.text_run_cache.memory[1], TEXT_RUN_CACHE_MEMORY_SIZE);
+    
+    //
+    // NOTE(tbt): general OpenGL setup
+    //
+
+#ifdef LUCERNA_DEBUG
+    glDebugMessageCallback(gl_debug_message_callback, NULL);
+#endif
+    
+    glGenVertexArrays(1, &global_rcx.vao);
+    glBindVertexArray(global_rcx.vao);
+    
+    glGenBuffers(1, &global_rcx.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, global_rcx.vbo);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,
+                          2,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(Vertex),
+                          NULL);
+    
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1,
+                          4,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(Vertex),
+                          (const void *)(2 * sizeof(F32)));
+    
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2,
+                          2,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(Vertex),
+                          (const void *)(6 * sizeof(F32)));
+    
+    glGenBuffers(1, &global_rcx.ibo);
+    offset = 0;
+    for (i = 0; i < BATCH_SIZE * 6; i += 6)
+    {
+        indices[i + 0] = 0 + offset;
+        indices[i + 1] = 1 + offset;
+        indices[i + 2] = 2 + offset;
+        
+        indices[i + 3] = 2 + offset;
+        indices[i + 4] = 3 + offset;
+        indices[i + 5] = 0 + offset;
+        
+        offset += 4;
+    }
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, global_rcx.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 BATCH_SIZE * 6 * sizeof(indices[0]),
+                 indices,
+                 GL_STATIC_DRAW);
+    
+    glBufferData(GL_ARRAY_BUFFER,
+                 VERTEX_STREAM_BATCHES * BATCH_SIZE * sizeof(Quad),
+                 NULL,
+                 GL_STREAM_DRAW);
+    
+    //
+    // NOTE(tbt): instanced sprites
+    //
+    
+    global_rcx.is_instancing_enabled = true;
+    
+    glGenVertexArrays(1, &global_rcx.instance_vao);
+    glBindVertexArray(global_rcx.instance_vao);
+    
+    // NOTE(tbt): the first 6 indices are the same for every quad, and are all an instance needs
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, global_rcx.ibo);
+    
+    glGenBuffers(1, &global_rcx.instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, global_rcx.instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 VERTEX_STREAM_BATCHES * BATCH_SIZE * sizeof(SpriteInstance),
+                 NULL,
+                 GL_STREAM_DRAW);
+    
+    for (U32 attribute = 3;
+         attribute <= 6;
+         ++attribute)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    renderer_opengl_point_instance_attributes(0);
+    
+    glBindVertexArray(global_rcx.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, global_rcx.vbo);
+    global_rcx.current_vao = global_rcx.vao;
+    
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glEnable(GL_SCISSOR_TEST);
+    
+    //
+    // NOTE(tbt): setup 1x1 white texture for rendering flat colours
+    //
+    
+    U32 flat_colour_texture_data = 0xffffffff;
+    
+    glGenTextures(1, &global_rcx.flat_colour_texture);
+    glBindTexture(GL_TEXTURE_2D, global_rcx.flat_colour_texture);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_RGBA8,
+                 1,
+                 1,
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 &flat_colour_texture_data);
+    renderer_software_upload_texture(global_rcx.flat_colour_texture, 1, 1, 4, (U8 *)&flat_colour_texture_data);
+    
+    //
+    // NOTE(tbt): setup 1x1 transparent texture for textures which haven't finished loading
+    //
+    
+    U32 placeholder_texture_data = 0x00000000;
+    
+    glGenTextures(1, &global_rcx.placeholder_texture);
+    glBindTexture(GL_TEXTURE_2D, global_rcx.placeholder_texture);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_RGBA8,
+                 1,
+                 1,
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 &placeholder_texture_data);
+    renderer_software_upload_texture(global_rcx.placeholder_texture, 1, 1, 4, (U8 *)&placeholder_texture_data);
+    
+    //
+    // NOTE(tbt): shader compilation
+    //
+    
+    I32 status;
+    global_rcx.shaders.texture = glCreateProgram();
+    global_rcx.shaders.blur_down = glCreateProgram();
+    global_rcx.shaders.blur_up = glCreateProgram();
+    global_rcx.shaders.text = glCreateProgram();
+    global_rcx.shaders.post_processing = glCreateProgram();
+    global_rcx.shaders.memory_post_processing = glCreateProgram();
+    const GLchar *shader_src;
+    ShaderID default_vertex_shader, fullscreen_vertex_shader;
+    ShaderID fragment_shader;
+    
+    arena_temporary_memory(&global_temp_memory)
+    {
+        // NOTE(tbt): compile the default vertex shader
+        shader_src = cstring_from_s8(&global_temp_memory,
+                                     read_asset(&global_temp_memory,
+                                                s8_lit("../assets/shaders/default.vert")));
+        
+        default_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(default_vertex_shader, 1, &shader_src, NULL);
+        glCompileShader(default_vertex_shader);
+        
+        // NOTE(tbt): check for default vertex shader compilation errors
+        glGetShaderiv(default_vertex_shader, GL_COMPILE_STATUS, &status);
+        if (status == GL_FALSE)
+        {
+            I8 msg[SHADER_INFO_LOG_MAX_LEN];
+            
+            glGetShaderInfoLog(default_vertex_shader,
+                               SHADER_INFO_LOG_MAX_LEN,
+                               NULL,
+                               msg);
+            glDeleteShader(default_vertex_shader);
+            
+            debug_log("default vertex shader compilation failure. '%s'\n", msg);
+            exit(-1);
+        }
+        
+        debug_log("successfully compiled default vertex shader\n");
+        
+        // NOTE(tbt): compile the fullscreen vertex shader
+        shader_src = cstring_from_s8(&global_temp_memory,
+                                     read_asset(&global_temp_memory,
+                                                s8_lit("../assets/shaders/fullscreen.vert")));
+        
+        fullscreen_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(fullscreen_vertex_shader, 1, &shader_src, NULL);
+        glCompileShader(fullscreen_vertex_shader);
+        
+        // NOTE(tbt): check for fullscreen vertex shader compilation errors
+        glGetShaderiv(fullscreen_vertex_shader, GL_COMPILE_STATUS, &status);
+        if (status == GL_FALSE)
+        {
+            I8 msg[SHADER_INFO_LOG_MAX_LEN];
+            
+            glGetShaderInfoLog(fullscreen_vertex_shader,
+                               SHADER_INFO_LOG_MAX_LEN,
+                               NULL,
+                               msg);
+            glDeleteShader(fullscreen_vertex_shader);
+            
+            debug_log("fullscreen vertex shader compilation failure. '%s'\n", msg);
+            exit(-1);
+        }
+        
+        debug_log("successfully compiled fullscreen vertex shader\n");
+        
+        // NOTE(tbt): attach vertex shaders to shader programs
+#define shader(_name, _vertex_shader_name) glAttachShader(global_rcx.shaders._name, _vertex_shader_name ## _vertex_shader);
+#include "shader_list.h"
+        
+        // NOTE(tbt): compile and line fragment shaders
+#define shader(_name, _vertex_shader_name) renderer_compile_and_link_fragment_shader(_name, _vertex_shader_name ## _vertex_shader);
+#include "shader_list.h"
+        
+        // NOTE(tbt): cleanup shader stuff
+        glDeleteShader(default_vertex_shader);
+        glDeleteShader(fullscreen_vertex_shader);
+    }
+    
+    cache_uniform_locations();
+    
+    // NOTE(tbt): reset currently bound shader
+    glUseProgram(global_rcx.shaders.current);
+    
+    
+    //
+    // NOTE(tbt): GPU timers
+    //
+    
+    renderer_initialise_gpu_timers();
+}
+
+// NOTE(tbt): messages are drawn in order of their sort keys, which are made up of (from most to least significant):
+//            - 8 bits of depth
+//            - 5 bits of the index of the queue the message was drawn into, and 19 bits of that queue's sequence number
+//            - 8 bits of sort layer
+//            - 24 bits of the state needed to draw the message: 1 of projection matrix, 1 of shader, 8 of mask and 14 of texture
+//            the first 32 bits are filled in when the message is queued, and the rest when the queue is flushed
+//            the state bits are truncated or hashed, so two messages with the same key may still need different state - they
+//            are only there to group messages which can share a batch
+internal U64
+renderer_sort_key_from_message(RenderMessage *message)
+{
+    U32 thread_index = platform_get_thread_index();
+    struct RcxMessageQueue *queue = &global_rcx.message_queues[thread_index];
+    
+    U64 result = 0;
+    result |= (U64)message->sort << 56;
+    result |= (U64)thread_index << 51;
+    result |= (U64)min_u(queue->sequence, (1 << 19) - 1) << 32;
+    
+    return result;
+}
+
+internal U32
+renderer_sort_state_from_message(RenderMessage *message)
+{
+    B32 is_text = (RENDER_MESSAGE_draw_text == message->kind);
+    
+    TextureID texture = message->texture;
+    if (is_text)
+    {
+        texture = message->font->texture.id;
+    }
+    else if (RENDER_MESSAGE_stroke_rectangle == message->kind ||
+             RENDER_MESSAGE_draw_gradient == message->kind)
+    {
+        texture = global_rcx.flat_colour_texture;
+    }
+    
+    U32 result = 0;
+    result |= (U32)(message->projection_matrix == global_ui_projection_matrix) << 23;
+    result |= (U32)is_text << 22;
+    result |= (U32)(hash_64_from_bytes(HASH_64_SEED, &message->mask, sizeof(message->mask)) & 0xff) << 14;
+    result |= texture & 0x3fff;
+    
+    return result;
+}
+
+// NOTE(tbt): transforms a rectangle, rotated about its origin in the same way as generate_rotated_quad, to window coordinates
+//            in the same way as renderer_software_fill_triangle, and returns the bounds of the result
+internal Rect
+renderer_window_bounds_from_rect(Rect rectangle,
+                                 F32 angle,
+                                 F32 *projection_matrix)
+{
+    F32 corners[4][2] =
+    {
+        { 0.0f,        0.0f        },
+        { rectangle.w, 0.0f        },
+        { rectangle.w, rectangle.h },
+        { 0.0f,        rectangle.h },
+    };
+    
+    F32 min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (I32 i = 0;
+         i < 4;
+         ++i)
+    {
+        F32 x = corners[i][0];
+        F32 y = corners[i][1];
+        if (0.0f != angle)
+        {
+            F32 rotated_x = x * cos(angle) - y * sin(angle);
+            F32 rotated_y = x * sin(angle) + y * cos(angle);
+            x = rotated_x;
+            y = rotated_y;
+        }
+        x += rectangle.x;
+        y += rectangle.y;
+        
+        F32 clip_x = projection_matrix[0] * x + projection_matrix[4] * y + projection_matrix[12];
+        F32 clip_y = projection_matrix[1] * x + projection_matrix[5] * y + projection_matrix[13];
+        F32 window_x = (clip_x + 1.0f) * 0.5f * global_rcx.window.w;
+        F32 window_y = (1.0f - clip_y) * 0.5f * global_rcx.window.h;
+        
+        min_x = min_f(min_x, window_x);
+        min_y = min_f(min_y, window_y);
+        max_x = max_f(max_x, window_x);
+        max_y = max_f(max_y, window_y);
+    }
+    
+    return rect(min_x, min_y, max_x - min_x, max_y - min_y);
+}
+
+// NOTE(tbt): finds the bounds, in window coordinates, of what a message can draw to before masking
+//            returns false for messages which don't draw quads, e.g. blurs
+//            text needs its text run to know its bounds
+internal B32
+renderer_window_bounds_from_message(RenderMessage *message,
+                                    Rect *result)
+{
+    if (RENDER_MESSAGE_draw_rectangle == message->kind)
+    {
+        *result = renderer_window_bounds_from_rect(message->rectangle, message->angle, message->projection_matrix);
+    }
+    else if (RENDER_MESSAGE_stroke_rectangle == message->kind ||
+             RENDER_MESSAGE_draw_gradient == message->kind)
+    {
+        *result = renderer_window_bounds_from_rect(message->rectangle, 0.0f, message->projection_matrix);
+    }
+    else if (RENDER_MESSAGE_draw_text == message->kind && message->text_run)
+    {
+        Rect text_bounds = offset_rect(message->text_run->bounds, message->rectangle.x, message->rectangle.y);
+        *result = renderer_window_bounds_from_rect(text_bounds, 0.0f, message->projection_matrix);
+    }
+    else
+    {
+        return false;
+    }
+    
+    return true;
+}
+
+// NOTE(tbt): masking a message which is entirely inside its mask does nothing, so it may as well use the window's mask, and
+//            then it can share a batch with anything else which could
+//            the test is against the mask shrunk to whole pixels and then by another pixel, so it holds however the mask is
+//            rounded to a scissor rectangle
+internal void
+renderer_relax_mask(RenderMessage *message,
+                    Rect bounds)
+{
+    I32 clip_x0 = (I32)message->mask.x + 1;
+    I32 clip_y0 = (I32)message->mask.y + 1;
+    I32 clip_x1 = (I32)message->mask.x + (I32)message->mask.w - 1;
+    I32 clip_y1 = (I32)message->mask.y + (I32)message->mask.h - 1;
+    
+    if (bounds.x >= clip_x0 &&
+        bounds.y >= clip_y0 &&
+        bounds.x + bounds.w <= clip_x1 &&
+        bounds.y + bounds.h <= clip_y1)
+    {
+        message->mask = global_rcx.mask_stack[0];
+    }
+}
+
+// NOTE(tbt): a range of pixels, inclusive
+typedef struct
+{
+    I32 x0, y0;
+    I32 x1, y1;
+} RenderSortArea;
+
+// NOTE(tbt): a quad only fills the pixels whose centres it covers, so finds those, with a little leeway for rounding,
+//            clipped to the mask with a pixel to spare and to the window
+//            returns false if there aren't any
+internal B32
+renderer_sort_area_from_window_bounds(Rect bounds,
+                                      Rect mask,
+                                      RenderSortArea *result)
+{
+    F32 leeway = 0.05f;
+    
+    F32 x0 = max_f(ceilf(bounds.x - 0.5f - leeway), floorf(mask.x) - 1.0f);
+    F32 y0 = max_f(ceilf(bounds.y - 0.5f - leeway), floorf(mask.y) - 1.0f);
+    F32 x1 = min_f(ceilf(bounds.x + bounds.w - 0.5f + leeway) - 1.0f, ceilf(mask.x + mask.w));
+    F32 y1 = min_f(ceilf(bounds.y + bounds.h - 0.5f + leeway) - 1.0f, ceilf(mask.y + mask.h));
+    
+    x0 = max_f(x0, 0.0f);
+    y0 = max_f(y0, 0.0f);
+    x1 = min_f(x1, global_rcx.window.w - 1);
+    y1 = min_f(y1, global_rcx.window.h - 1);
+    
+    if (x0 > x1 || y0 > y1)
+    {
+        return false;
+    }
+    
+    result->x0 = x0;
+    result->y0 = y0;
+    result->x1 = x1;
+    result->y1 = y1;
+    
+    return true;
+}
+
+// NOTE(tbt): the areas of the window a message draws to - the whole of its bounds, apart from strokes, which only draw
+//            their edges
+internal I32
+renderer_sort_areas_from_message(RenderMessage *message,
+                                 Rect bounds,
+                                 RenderSortArea areas[4])
+{
+    I32 result = 0;
+    
+    if (RENDER_MESSAGE_stroke_rectangle == message->kind)
+    {
+        Rect r = message->rectangle;
+        F32 stroke_width = message->stroke_width;
+        
+        Rect edges[4] =
+        {
+            rect(r.x, r.y, r.w, stroke_width),
+            rect(r.x, r.y + r.h - stroke_width, r.w, stroke_width),
+            rect(r.x, r.y + stroke_width, stroke_width, r.h - stroke_width * 2),
+            rect(r.x + r.w - stroke_width, r.y + stroke_width, stroke_width, r.h - stroke_width * 2),
+        };
+        
+        for (I32 i = 0;
+             i < 4;
+             ++i)
+        {
+            Rect edge_bounds = renderer_window_bounds_from_rect(edges[i], 0.0f, message->projection_matrix);
+            result += renderer_sort_area_from_window_bounds(edge_bounds, message->mask, &areas[result]);
+        }
+    }
+    else
+    {
+        result += renderer_sort_area_from_window_bounds(bounds, message->mask, &areas[result]);
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): the window is split into tiles, and each tile remembers the highest layer drawn over it so far in the current
+//            group of messages (those with the same depth, queue and sequence), and the state that layer needs
+//            large messages, like backgrounds, would touch too many tiles, so are kept in a list instead
+#define RENDER_SORT_TILE_SIZE 8
+#define RENDER_SORT_LARGE_TILE_COUNT 1024
+#define RENDER_SORT_STATE_MIXED 0xffffffff
+
+typedef struct RenderSortLargeMessage RenderSortLargeMessage;
+struct RenderSortLargeMessage
+{
+    RenderSortLargeMessage *next;
+    RenderSortArea area;
+    U32 layer;
+    U32 state;
+};
+
+typedef struct
+{
+    U64 group;
+    U32 group_number;
+    RenderSortLargeMessage *large_messages;
+    B32 is_empty;
+    U32 top_layer; // NOTE(tbt): the highest layer of anything in the group so far
+    U32 top_state; // NOTE(tbt): the state of everything on that layer, or RENDER_SORT_STATE_MIXED
+} RenderSortDepth;
+
+// NOTE(tbt): fills in the layer and state bits of the sort keys, so that sorting groups messages by the state they need
+//            wherever that can't change what ends up on screen
+//            - `entries` must be in the order the messages were drawn in
+//            - each message is put in the lowest layer which is at least as high as the layer of everything drawn before it
+//              which it might overlap, and higher if that needs different state
+//            - messages in the same layer with the same state may still overlap, but then the stable sort keeps their order
+//            - after 255 layers, everything goes on the last layer in the order it was drawn
+//            - messages with no bounds and anything drawn in a draw_in_order() block are left with no layer or state bits,
+//              and their sequence numbers keep them apart from everything else
+internal void
+renderer_assign_sort_layers(RenderSortEntry *entries,
+                            U64 count)
+{
+    I32 tiles_w = (global_rcx.window.w + RENDER_SORT_TILE_SIZE - 1) / RENDER_SORT_TILE_SIZE;
+    I32 tiles_h = (global_rcx.window.h + RENDER_SORT_TILE_SIZE - 1) / RENDER_SORT_TILE_SIZE;
+    
+    if (tiles_w <= 0 || tiles_h <= 0) { return; }
+    
+    // NOTE(tbt): messages at different depths are interleaved, so the tiles for each depth are kept separately, and only
+    //            allocated when that depth is used. rather than clearing them when a new group starts, each group gets a
+    //            new number, which keeps counting up from one frame to the next
+    if (tiles_w != global_rcx.sort_tiles.tiles_w ||
+        tiles_h != global_rcx.sort_tiles.tiles_h)
+    {
+        for (I32 i = 0;
+             i < array_count(global_rcx.sort_tiles.tiles_by_depth);
+             ++i)
+        {
+            free(global_rcx.sort_tiles.tiles_by_depth[i]);
+            global_rcx.sort_tiles.tiles_by_depth[i] = NULL;
+        }
+        
+        global_rcx.sort_tiles.tiles_w = tiles_w;
+        global_rcx.sort_tiles.tiles_h = tiles_h;
+    }
+    
+    RenderSortDepth *depths = arena_push(&global_frame_memory, 256 * sizeof(depths[0]));
+    
+    for (U64 i = 0;
+         i < count;
+         ++i)
+    {
+        RenderMessage *message = entries[i].message;
+        
+        Rect bounds;
+        if (!renderer_window_bounds_from_message(message, &bounds)) { continue; }
+        
+        renderer_relax_mask(message, bounds);
+        
+        if (message->is_in_order) { continue; }
+        
+        RenderSortArea areas[4];
+        I32 area_count = renderer_sort_areas_from_message(message, bounds, areas);
+        
+        if (0 == area_count) { continue; }
+        
+        //-NOTE(tbt): get the tiles for the message's group
+        RenderSortDepth *depth = &depths[message->sort];
+        U64 group = entries[i].key >> 32;
+        
+        RenderSortTile **tiles = &global_rcx.sort_tiles.tiles_by_depth[message->sort];
+        if (!(*tiles))
+        {
+            *tiles = calloc(tiles_w * tiles_h, sizeof((*tiles)[0]));
+        }
+        
+        if (!depth->group_number ||
+            depth->group != group)
+        {
+            global_rcx.sort_tiles.next_group_number += 1;
+            
+            depth->group = group;
+            depth->group_number = global_rcx.sort_tiles.next_group_number;
+            depth->large_messages = NULL;
+            depth->is_empty = true;
+        }
+        
+        I32 tile_count = 0;
+        for (I32 area_index = 0;
+             area_index < area_count;
+             ++area_index)
+        {
+            RenderSortArea *area = &areas[area_index];
+            tile_count += ((area->x1 / RENDER_SORT_TILE_SIZE - area->x0 / RENDER_SORT_TILE_SIZE + 1) *
+                           (area->y1 / RENDER_SORT_TILE_SIZE - area->y0 / RENDER_SORT_TILE_SIZE + 1));
+        }
+        
+        B32 is_large = (tile_count > RENDER_SORT_LARGE_TILE_COUNT);
+        
+        //-NOTE(tbt): find the lowest layer the message can go on
+        U32 state = renderer_sort_state_from_message(message);
+        U32 layer = 0;
+        
+        if (is_large)
+        {
+            // NOTE(tbt): don't bother looking at the tiles, just go above everything so far
+            if (!depth->is_empty)
+            {
+                layer = depth->top_layer + (depth->top_state != state);
+            }
+        }
+        else
+        {
+            for (I32 area_index = 0;
+                 area_index < area_count;
+                 ++area_index)
+            {
+                RenderSortArea *area = &areas[area_index];
+                
+                for (I32 y = area->y0 / RENDER_SORT_TILE_SIZE;
+                     y <= area->y1 / RENDER_SORT_TILE_SIZE;
+                     ++y)
+                {
+                    for (I32 x = area->x0 / RENDER_SORT_TILE_SIZE;
+                         x <= area->x1 / RENDER_SORT_TILE_SIZE;
+                         ++x)
+                    {
+                        RenderSortTile *tile = &(*tiles)[x + y * tiles_w];
+                        if (tile->group_number == depth->group_number)
+                        {
+                            layer = max_u(layer, tile->layer - 1 + (tile->state != state));
+                        }
+                    }
+                }
+                
+                for (RenderSortLargeMessage *large = depth->large_messages;
+                     large;
+                     large = large->next)
+                {
+                    if (area->x0 <= large->area.x1 && large->area.x0 <= area->x1 &&
+                        area->y0 <= large->area.y1 && large->area.y0 <= area->y1)
+                    {
+                        layer = max_u(layer, large->layer + (large->state != state));
+                    }
+                }
+            }
+        }
+        
+        if (layer >= 255)
+        {
+            layer = 255;
+            state = 0;
+        }
+        
+        //-NOTE(tbt): record the message as being drawn on that layer
+        U32 recorded_state = (255 == layer) ? RENDER_SORT_STATE_MIXED : state;
+        
+        if (depth->is_empty || layer > depth->top_layer)
+        {
+            depth->top_layer = layer;
+            depth->top_state = recorded_state;
+            depth->is_empty = false;
+        }
+        else if (layer == depth->top_layer &&
+                 depth->top_state != recorded_state)
+        {
+            depth->top_state = RENDER_SORT_STATE_MIXED;
+        }
+        
+        for (I32 area_index = 0;
+             area_index < area_count;
+             ++area_index)
+        {
+            RenderSortArea *area = &areas[area_index];
+            
+            if (is_large)
+            {
+                RenderSortLargeMessage *large = arena_push(&global_frame_memory, sizeof(*large));
+                large->area = *area;
+                large->layer = layer;
+                large->state = recorded_state;
+                large->next = depth->large_messages;
+                depth->large_messages = large;
+            }
+            else
+            {
+                for (I32 y = area->y0 / RENDER_SORT_TILE_SIZE;
+                     y <= area->y1 / RENDER_SORT_TILE_SIZE;
+                     ++y)
+                {
+                    for (I32 x = area->x0 / RENDER_SORT_TILE_SIZE;
+                         x <= area->x1 / RENDER_SORT_TILE_SIZE;
+                         ++x)
+                    {
+                        RenderSortTile *tile = &(*tiles)[x + y * tiles_w];
+                        if (tile->group_number != depth->group_number ||
+                            tile->layer < layer + 1)
+                        {
+                            tile->group_number = depth->group_number;
+                            tile->layer = layer + 1;
+                            tile->state = recorded_state;
+                        }
+                        else if (tile->layer == layer + 1 &&
+                                 tile->state != recorded_state)
+                        {
+                            tile->state = RENDER_SORT_STATE_MIXED;
+                        }
+                    }
+                }
+            }
+        }
+        
+        entries[i].key |= (U64)layer << 24;
+        entries[i].key |= state;
+    }
+}
+
 internal void
-initialise_renderer(void)
+renderer_enqueue_message(RenderMessage message)
 {
-    I32 i;
-    I32 offset;
-    I32 indices[BATCH_SIZE * 6];
-    void *render_queue_backing_memory;
-    
-    //
-    // NOTE(tbt): general OpenGL setup
-    //
-    
-#ifdef LUCERNA_DEBUG
-    glDebugMessageCallback(gl_debug_message_callback, NULL);
-#endif
-    
-    glGenVertexArrays(1, &global_rcx.vao);
-    glBindVertexArray(global_rcx.vao);
-    
-    glGenBuffers(1, &global_rcx.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, global_rcx.vbo);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,
-                          2,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          NULL);
+    struct RcxMessageQueue *queue = &global_rcx.message_queues[platform_get_thread_index()];
     
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,
-                          4,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          (const void *)(2 * sizeof(F32)));
+    RenderMessage *queued_message =
+        arena_push(&queue->memory,
+                   sizeof(*queued_message));
     
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2,
-                          2,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          (const void *)(6 * sizeof(F32)));
+    *queued_message = message;
     
-    glGenBuffers(1, &global_rcx.ibo);
-    offset = 0;
-    for (i = 0; i < BATCH_SIZE * 6; i += 6)
+    // NOTE(tbt): copy mask from stack
+    //            the mask stack is only ever pushed to from the main thread, so the mask must not be changed while workers are drawing
     {
-        indices[i + 0] = 0 + offset;
-        indices[i + 1] = 1 + offset;
-        indices[i + 2] = 2 + offset;
-        
-        indices[i + 3] = 2 + offset;
-        indices[i + 4] = 3 + offset;
-        indices[i + 5] = 0 + offset;
+        queued_message->mask = global_rcx.mask_stack[global_rcx.mask_stack_size];
         
-        offset += 4;
+        if (queued_message->mask.x < 0.0f)
+        {
+            queued_message->mask.w -= queued_message->mask.x;
+            queued_message->mask.x = 0.0f;
+        }
+        if (queued_message->mask.y < 0.0f)
+        {
+            queued_message->mask.h -= queued_message->mask.y;
+            queued_message->mask.y = 0.0f;
+        }
+        queued_message->mask.w = max_f(queued_message->mask.w, 0.0f);
+        queued_message->mask.h = max_f(queued_message->mask.h, 0.0f);
     }
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, global_rcx.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 BATCH_SIZE * 6 * sizeof(indices[0]),
-                 indices,
-                 GL_STATIC_DRAW);
-    
-    glBufferData(GL_ARRAY_BUFFER,
-                 BATCH_SIZE * 4 * sizeof(Vertex),
-                 NULL,
-                 GL_DYNAMIC_DRAW);
-    
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glEnable(GL_SCISSOR_TEST);
-    
-    //
-    // NOTE(tbt): setup 1x1 white texture for rendering flat colours
-    //
+    // NOTE(tbt): blurs and post processing read back what has been drawn so far, so nothing may be moved past them
+    B32 is_barrier = (RENDER_MESSAGE_blur_screen_region == message.kind ||
+                      RENDER_MESSAGE_do_post_processing == message.kind);
     
-    U32 flat_colour_texture_data = 0xffffffff;
+    queued_message->is_in_order = (0 == platform_get_thread_index() && global_rcx.in_order_depth > 0);
     
-    glGenTextures(1, &global_rcx.flat_colour_texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.flat_colour_texture);
+    queue->sequence += is_barrier;
+    queued_message->sort_key = renderer_sort_key_from_message(queued_message);
+    queue->sequence += is_barrier;
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    if (queue->end)
+    {
+        queue->end->next = queued_message;
+    }
+    else
+    {
+        queue->start = queued_message;
+    }
     
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 1,
-                 1,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 &flat_colour_texture_data);
+    queue->end = queued_message;
+}
+
+// NOTE(tbt): the most quads a message could possibly expand to
+internal U64
+renderer_max_quads_for_message(RenderMessage *message)
+{
+    U64 result = 0;
     
-    //
-    // NOTE(tbt): shader compilation
-    //
+    switch (message->kind)
+    {
+        case RENDER_MESSAGE_draw_rectangle: result = 1; break;
+        case RENDER_MESSAGE_stroke_rectangle: result = 4; break;
+        case RENDER_MESSAGE_draw_text: result = message->string.size; break;
+        case RENDER_MESSAGE_draw_gradient: result = 1; break;
+        default: break;
+    }
     
-    I32 status;
-    global_rcx.shaders.texture = glCreateProgram();
-    global_rcx.shaders.blur = glCreateProgram();
-    global_rcx.shaders.text = glCreateProgram();
-    global_rcx.shaders.post_processing = glCreateProgram();
-    global_rcx.shaders.memory_post_processing = glCreateProgram();
-    const GLchar *shader_src;
-    ShaderID default_vertex_shader, fullscreen_vertex_shader;
-    ShaderID fragment_shader;
+    return result;
+}
+
+internal void
+renderer_push_sprite(RenderMessage *message,
+                     Rect rectangle,
+                     F32 angle,
+                     Colour colour,
+                     SubTexture sub_texture)
+{
+    if (message->is_instanced)
+    {
+        message->instances[message->quad_count++] = generate_sprite_instance(rectangle,
+                                                                             angle,
+                                                                             colour,
+                                                                             sub_texture);
+    }
+    else if (0.0f == angle)
+    {
+        message->quads[message->quad_count++] = generate_quad(rectangle,
+                                                              colour,
+                                                              sub_texture);
+    }
+    else
+    {
+        message->quads[message->quad_count++] = generate_rotated_quad(rectangle,
+                                                                      angle,
+                                                                      colour,
+                                                                      sub_texture);
+    }
+}
+
+// NOTE(tbt): fills in message->quads or message->instances, which must already have room for
+//            renderer_max_quads_for_message(message) of them
+//            only reads from the message and its text run, so is safe to call from any thread
+internal void
+renderer_generate_quads(RenderMessage *message)
+{
+    message->quad_count = 0;
     
-    arena_temporary_memory(&global_temp_memory)
+    switch (message->kind)
     {
-        // NOTE(tbt): compile the default vertex shader
-        shader_src = cstring_from_s8(&global_temp_memory,
-                                     platform_read_entire_file_p(&global_temp_memory,
-                                                                 s8_lit("../assets/shaders/default.vert")));
-        
-        default_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(default_vertex_shader, 1, &shader_src, NULL);
-        glCompileShader(default_vertex_shader);
+        case RENDER_MESSAGE_draw_rectangle:
+        {
+            renderer_push_sprite(message,
+                                 message->rectangle,
+                                 message->angle,
+                                 message->colour,
+                                 message->sub_texture);
+            
+            break;
+        }
         
-        // NOTE(tbt): check for default vertex shader compilation errors
-        glGetShaderiv(default_vertex_shader, GL_COMPILE_STATUS, &status);
-        if (status == GL_FALSE)
+        case RENDER_MESSAGE_stroke_rectangle:
         {
-            I8 msg[SHADER_INFO_LOG_MAX_LEN];
+            Rect top, bottom, left, right;
+            F32 stroke_width;
             
-            glGetShaderInfoLog(default_vertex_shader,
-                               SHADER_INFO_LOG_MAX_LEN,
-                               NULL,
-                               msg);
-            glDeleteShader(default_vertex_shader);
+            stroke_width = message->stroke_width;
             
-            debug_log("default vertex shader compilation failure. '%s'\n", msg);
-            exit(-1);
+            top = rect(message->rectangle.x,
+                       message->rectangle.y,
+                       message->rectangle.w,
+                       stroke_width);
+            
+            bottom = rect(message->rectangle.x,
+                          message->rectangle.y +
+                          message->rectangle.h -
+                          stroke_width,
+                          message->rectangle.w,
+                          stroke_width);
+            
+            left = rect(message->rectangle.x,
+                        message->rectangle.y +
+                        stroke_width,
+                        stroke_width,
+                        message->rectangle.h -
+                        stroke_width * 2);
+            
+            right = rect(message->rectangle.x +
+                         message->rectangle.w -
+                         stroke_width,
+                         message->rectangle.y +
+                         stroke_width,
+                         stroke_width,
+                         message->rectangle.h -
+                         stroke_width * 2);
+            
+            renderer_push_sprite(message,
+                                 top,
+                                 0.0f,
+                                 message->colour,
+                                 message->sub_texture);
+            
+            renderer_push_sprite(message,
+                                 bottom,
+                                 0.0f,
+                                 message->colour,
+                                 message->sub_texture);
+            
+            renderer_push_sprite(message,
+                                 left,
+                                 0.0f,
+                                 message->colour,
+                                 message->sub_texture);
+            
+            renderer_push_sprite(message,
+                                 right,
+                                 0.0f,
+                                 message->colour,
+                                 message->sub_texture);
+            
+            break;
         }
         
-        debug_log("successfully compiled default vertex shader\n");
-        
-        // NOTE(tbt): compile the fullscreen vertex shader
-        shader_src = cstring_from_s8(&global_temp_memory,
-                                     platform_read_entire_file_p(&global_temp_memory,
-                                                                 s8_lit("../assets/shaders/fullscreen.vert")));
-        
-        fullscreen_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(fullscreen_vertex_shader, 1, &shader_src, NULL);
-        glCompileShader(fullscreen_vertex_shader);
+        case RENDER_MESSAGE_draw_text:
+        {
+            TextRun *run = message->text_run;
+            
+            if (run)
+            {
+                for (I32 i = 0;
+                     i < run->glyph_count;
+                     ++i)
+                {
+                    Rect rectangle = run->glyphs[i].rectangle;
+                    rectangle.x += message->rectangle.x;
+                    rectangle.y += message->rectangle.y;
+                    
+                    renderer_push_sprite(message,
+                                         rectangle,
+                                         0.0f,
+                                         message->colour,
+                                         run->glyphs[i].sub_texture);
+                }
+            }
+            
+            break;
+        }
         
-        // NOTE(tbt): check for fullscreen vertex shader compilation errors
-        glGetShaderiv(fullscreen_vertex_shader, GL_COMPILE_STATUS, &status);
-        if (status == GL_FALSE)
+        case RENDER_MESSAGE_draw_gradient:
         {
-            I8 msg[SHADER_INFO_LOG_MAX_LEN];
+            Quad *quad = &message->quads[message->quad_count++];
             
-            glGetShaderInfoLog(fullscreen_vertex_shader,
-                               SHADER_INFO_LOG_MAX_LEN,
-                               NULL,
-                               msg);
-            glDeleteShader(fullscreen_vertex_shader);
+            quad->bl.x = message->rectangle.x;
+            quad->bl.y = message->rectangle.y + message->rectangle.h;
+            quad->bl.r = message->gradient.bl.r;
+            quad->bl.g = message->gradient.bl.g;
+            quad->bl.b = message->gradient.bl.b;
+            quad->bl.a = message->gradient.bl.a;
+            quad->bl.u = 0.0f;
+            quad->bl.v = 1.0f;
+            
+            quad->br.x = message->rectangle.x + message->rectangle.w;
+            quad->br.y = message->rectangle.y + message->rectangle.h;
+            quad->br.r = message->gradient.br.r;
+            quad->br.g = message->gradient.br.g;
+            quad->br.b = message->gradient.br.b;
+            quad->br.a = message->gradient.br.a;
+            quad->br.u = 1.0f;
+            quad->br.v = 1.0f;
             
-            debug_log("fullscreen vertex shader compilation failure. '%s'\n", msg);
-            exit(-1);
+            quad->tr.x = message->rectangle.x + message->rectangle.w;
+            quad->tr.y = message->rectangle.y;
+            quad->tr.r = message->gradient.tr.r;
+            quad->tr.g = message->gradient.tr.g;
+            quad->tr.b = message->gradient.tr.b;
+            quad->tr.a = message->gradient.tr.a;
+            quad->tr.u = 1.0f;
+            quad->tr.v = 0.0f;
+            
+            quad->tl.x = message->rectangle.x;
+            quad->tl.y = message->rectangle.y;
+            quad->tl.r = message->gradient.tl.r;
+            quad->tl.g = message->gradient.tl.g;
+            quad->tl.b = message->gradient.tl.b;
+            quad->tl.a = message->gradient.tl.a;
+            quad->tl.u = 0.0f;
+            quad->tl.v = 0.0f;
+            
+            break;
         }
         
-        debug_log("successfully compiled fullscreen vertex shader\n");
-        
-        // NOTE(tbt): attach vertex shaders to shader programs
-#define shader(_name, _vertex_shader_name) glAttachShader(global_rcx.shaders. ## _name, _vertex_shader_name ## _vertex_shader);
-#include "shader_list.h"
-        
-        // NOTE(tbt): compile and line fragment shaders
-#define shader(_name, _vertex_shader_name) renderer_compile_and_link_fragment_shader(_name, _vertex_shader_name ## _vertex_shader);
-#include "shader_list.h"
-        
-        // NOTE(tbt): cleanup shader stuff
-        glDeleteShader(default_vertex_shader);
-        glDeleteShader(fullscreen_vertex_shader);
+        default: break;
     }
+}
+
+internal void
+renderer_do_quad_generation_job(void *data)
+{
+    QuadGenerationJob *job = data;
     
-    cache_uniform_locations();
-    
-    // NOTE(tbt): reset currently bound shader
-    glUseProgram(global_rcx.shaders.current);
-    
-    
-    //
-    // NOTE(tbt): setup framebuffers
-    //
-    
-    // NOTE(tbt): framebuffer for first blur pass
-    glGenFramebuffers(1, &global_rcx.framebuffers.blur_a.target);
-    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.blur_a.target);
-    
-    glGenTextures(1, &global_rcx.framebuffers.blur_a.texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.blur_a.texture);
-    
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 BLUR_TEXTURE_W,
-                 BLUR_TEXTURE_H,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
+    profile_scope("renderer_generate_quads")
+    {
+        for (U64 i = 0;
+             i < job->message_count;
+             ++i)
+        {
+            renderer_generate_quads(job->messages[i]);
+        }
+    }
+}
+
+// NOTE(tbt): writes to the ring buffer in the vbo currently bound to GL_ARRAY_BUFFER
+//            returns false if the buffer couldn't be mapped, otherwise where the data was written is returned in `offset`
+internal B32
+renderer_opengl_write_to_stream(struct RcxVertexStream *stream,
+                                U64 capacity,
+                                void *data,
+                                U64 size,
+                                U64 *offset)
+{
+    B32 result = false;
+    
+    // NOTE(tbt): orphan the buffer and start again from the beginning if there isn't room left for this batch
+    //            the driver hands us fresh storage so we never have to wait on draws still reading the old data
+    if (stream->write_offset + size > capacity)
+    {
+        glBufferData(GL_ARRAY_BUFFER,
+                     capacity,
+                     NULL,
+                     GL_STREAM_DRAW);
+        stream->write_offset = 0;
+        stream->orphan_count += 1;
+    }
+    
+    // NOTE(tbt): nothing written before the write offset since the last orphaning is touched, so no need to synchronise
+    void *destination = glMapBufferRange(GL_ARRAY_BUFFER,
+                                         stream->write_offset,
+                                         size,
+                                         GL_MAP_WRITE_BIT |
+                                         GL_MAP_INVALIDATE_RANGE_BIT |
+                                         GL_MAP_UNSYNCHRONIZED_BIT);
+    if (destination)
+    {
+        memcpy(destination, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        
+        *offset = stream->write_offset;
+        result = true;
+    }
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    stream->write_offset += size;
+    stream->bytes_uploaded += size;
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D,
-                           global_rcx.framebuffers.blur_a.texture,
-                           0);
+    return result;
+}
+
+internal void
+renderer_opengl_flush_batch(RenderBatch *batch)
+{
+    glScissor(batch->mask.x,
+              global_rcx.window.h - batch->mask.y - batch->mask.h,
+              batch->mask.w,
+              batch->mask.h);
     
-    // NOTE(tbt): framebuffer for second blur pass
-    glGenFramebuffers(1, &global_rcx.framebuffers.blur_b.target);
-    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.blur_b.target);
+    if (global_rcx.shaders.current != batch->shader)
+    {
+        glUseProgram(batch->shader);
+        global_rcx.shaders.current = batch->shader;
+    }
     
-    glGenTextures(1, &global_rcx.framebuffers.blur_b.texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.blur_b.texture);
+    if (global_rcx.current_texture != batch->texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, batch->texture);
+        global_rcx.current_texture = batch->texture;
+    }
     
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 BLUR_TEXTURE_W,
-                 BLUR_TEXTURE_H,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
+    if (batch->shader == global_rcx.shaders.texture)
+    {
+        glUniformMatrix4fv(global_rcx.uniform_locations.texture.projection_matrix,
+                           1,
+                           GL_FALSE,
+                           batch->projection_matrix);
+        glUniform1i(global_rcx.uniform_locations.texture.is_instanced, batch->is_instanced);
+    }
+    else if (batch->shader == global_rcx.shaders.text)
+    {
+        glUniformMatrix4fv(global_rcx.uniform_locations.text.projection_matrix,
+                           1,
+                           GL_FALSE,
+                           batch->projection_matrix);
+        glUniform1i(global_rcx.uniform_locations.text.is_instanced, batch->is_instanced);
+    }
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    U32 vao = batch->is_instanced ? global_rcx.instance_vao : global_rcx.vao;
+    if (global_rcx.current_vao != vao)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, batch->is_instanced ? global_rcx.instance_vbo : global_rcx.vbo);
+        global_rcx.current_vao = vao;
+    }
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D,
-                           global_rcx.framebuffers.blur_b.texture,
-                           0);
+    U64 offset;
     
-    // NOTE(tbt): framebuffer for first blur pass for bloom
-    glGenFramebuffers(1, &global_rcx.framebuffers.bloom_blur_a.target);
-    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.bloom_blur_a.target);
+    if (batch->is_instanced)
+    {
+        if (renderer_opengl_write_to_stream(&global_rcx.instance_stream,
+                                            VERTEX_STREAM_BATCHES * BATCH_SIZE * sizeof(SpriteInstance),
+                                            batch->instances,
+                                            batch->quad_count * sizeof(SpriteInstance),
+                                            &offset))
+        {
+            renderer_opengl_point_instance_attributes(offset);
+            glDrawElementsInstanced(GL_TRIANGLES,
+                                    6,
+                                    GL_UNSIGNED_INT,
+                                    NULL,
+                                    batch->quad_count);
+        }
+    }
+    else
+    {
+        if (renderer_opengl_write_to_stream(&global_rcx.vertex_stream,
+                                            VERTEX_STREAM_BATCHES * BATCH_SIZE * sizeof(Quad),
+                                            batch->buffer,
+                                            batch->quad_count * sizeof(Quad),
+                                            &offset))
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES,
+                                     batch->quad_count * 6,
+                                     GL_UNSIGNED_INT,
+                                     NULL,
+                                     offset / sizeof(Vertex));
+        }
+    }
+}
+
+internal void
+renderer_flush_batch(RenderBatch *batch)
+{
+    if (!batch->in_use) return;
     
-    glGenTextures(1, &global_rcx.framebuffers.bloom_blur_a.texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.bloom_blur_a.texture);
+    global_rcx.draw_call_count += 1;
     
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 BLUR_TEXTURE_W,
-                 BLUR_TEXTURE_H,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
+    if (global_rcx.software.framebuffer)
+    {
+        renderer_software_flush_batch(batch);
+    }
+    else
+    {
+        renderer_begin_gpu_timer(batch->kind);
+        renderer_opengl_flush_batch(batch);
+        renderer_end_gpu_timer();
+    }
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    batch->quad_count = 0;
+    batch->texture = 0;
+    batch->shader = 0;
+    batch->projection_matrix = NULL;
+    batch->in_use = false;
+}
+
+internal void
+renderer_push_quads_to_batch(RenderBatch *batch,
+                             RenderMessage *message,
+                             ShaderID shader,
+                             TextureID texture)
+{
+    Quad *quads = message->quads;
+    SpriteInstance *instances = message->instances;
+    U64 quads_remaining = message->quad_count;
+    
+    while (quads_remaining)
+    {
+        if (batch->texture != texture ||
+            batch->shader != shader ||
+            batch->is_instanced != message->is_instanced ||
+            batch->quad_count >= BATCH_SIZE ||
+            batch->projection_matrix != message->projection_matrix ||
+            !rect_match(batch->mask, message->mask) ||
+            !(batch->in_use))
+        {
+            renderer_flush_batch(batch);
+            
+            batch->shader = shader;
+            batch->texture = texture;
+            batch->projection_matrix = message->projection_matrix;
+            batch->mask = message->mask;
+            batch->kind = message->kind;
+            batch->is_instanced = message->is_instanced;
+        }
+        
+        batch->in_use = true;
+        
+        U64 quads_to_copy = min_u(quads_remaining, BATCH_SIZE - batch->quad_count);
+        if (message->is_instanced)
+        {
+            memcpy(batch->instances + batch->quad_count, instances, quads_to_copy * sizeof(*instances));
+            instances += quads_to_copy;
+        }
+        else
+        {
+            memcpy(batch->buffer + batch->quad_count, quads, quads_to_copy * sizeof(*quads));
+            quads += quads_to_copy;
+        }
+        batch->quad_count += quads_to_copy;
+        quads_remaining -= quads_to_copy;
+    }
+}
+
+// NOTE(tbt): stable LSD radix sort on the whole 64 bit key, a byte at a time
+//            - the counts for every byte are found in one pass up front
+//            - bytes which are the same for every key, like most of the state bits when nothing is in a sort layer, are skipped
+//            - the result ends up back in `entries`
+internal void
+renderer_radix_sort(RenderSortEntry *entries,
+                    RenderSortEntry *scratch,
+                    U64 count)
+{
+    if (count < 2) { return; }
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D,
-                           global_rcx.framebuffers.bloom_blur_a.texture,
-                           0);
+    U64 counts[8][256] = {0};
     
-    // NOTE(tbt): framebuffer for second blur pass for bloom
-    glGenFramebuffers(1, &global_rcx.framebuffers.bloom_blur_b.target);
-    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.bloom_blur_b.target);
+    for (U64 i = 0;
+         i < count;
+         ++i)
+    {
+        for (I32 digit = 0;
+             digit < 8;
+             ++digit)
+        {
+            counts[digit][(entries[i].key >> (digit * 8)) & 0xff] += 1;
+        }
+    }
     
-    glGenTextures(1, &global_rcx.framebuffers.bloom_blur_b.texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.bloom_blur_b.texture);
+    RenderSortEntry *from = entries;
+    RenderSortEntry *to = scratch;
     
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 BLUR_TEXTURE_W,
-                 BLUR_TEXTURE_H,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
+    for (I32 digit = 0;
+         digit < 8;
+         ++digit)
+    {
+        U32 shift = digit * 8;
+        
+        if (counts[digit][(from[0].key >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+        
+        U64 offsets[256];
+        U64 offset = 0;
+        for (I32 i = 0;
+             i < 256;
+             ++i)
+        {
+            offsets[i] = offset;
+            offset += counts[digit][i];
+        }
+        
+        for (U64 i = 0;
+             i < count;
+             ++i)
+        {
+            to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+        }
+        
+        RenderSortEntry *temp = from;
+        from = to;
+        to = temp;
+    }
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (from != entries)
+    {
+        memcpy(entries, from, count * sizeof(entries[0]));
+    }
+}
+
+internal I32
+renderer_push_render_graph_resource(RenderGraph *graph,
+                                    I32 w,
+                                    I32 h,
+                                    U32 format)
+{
+    I32 result = graph->resource_count;
+    graph->resource_count += 1;
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D,
-                           global_rcx.framebuffers.bloom_blur_b.texture,
-                           0);
+    RenderGraphResource *resource = &graph->resources[result];
+    memset(resource, 0, sizeof(*resource));
+    resource->w = w;
+    resource->h = h;
+    resource->format = format;
+    resource->first_pass = -1;
+    resource->last_pass = -1;
     
-    // NOTE(tbt): framebuffer for post processing
-    glGenFramebuffers(1, &global_rcx.framebuffers.post_processing.target);
-    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.post_processing.target);
+    return result;
+}
+
+// NOTE(tbt): a resource which already has a target, e.g. one kept from an earlier graph
+internal I32
+renderer_import_render_graph_resource(RenderGraph *graph,
+                                      RenderTarget *target)
+{
+    I32 result = renderer_push_render_graph_resource(graph, target->w, target->h, target->format);
+    graph->resources[result].target = target;
+    graph->resources[result].is_imported = true;
+    return result;
+}
+
+internal void
+renderer_push_render_graph_pass(RenderGraph *graph,
+                                RenderPassKind kind,
+                                I32 input_a,
+                                I32 input_b,
+                                I32 output)
+{
+    I32 pass_index = graph->pass_count;
+    graph->pass_count += 1;
+    
+    RenderGraphPass *pass = &graph->passes[pass_index];
+    pass->kind = kind;
+    pass->inputs[0] = input_a;
+    pass->inputs[1] = input_b;
+    pass->output = output;
+    
+    for (I32 input_index = 0;
+         input_index < array_count(pass->inputs);
+         ++input_index)
+    {
+        if (pass->inputs[input_index] >= 0)
+        {
+            graph->resources[pass->inputs[input_index]].last_pass = pass_index;
+        }
+    }
     
-    glGenTextures(1, &global_rcx.framebuffers.post_processing.texture);
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.post_processing.texture);
+    if (output >= 0)
+    {
+        graph->resources[output].first_pass = pass_index;
+        graph->resources[output].last_pass = pass_index;
+    }
+}
+
+// NOTE(tbt): dual filter blur of a downsampled image of the screen - returns the resource holding the result
+//            - steps down through `level_count` levels, each half the size of the one above, then back up, so the
+//              radius doubles with each level for the cost of only a few more small passes
+//            - each step up writes a new resource rather than going back over the level it was blurred down from, so
+//              every resource is written once, and the pool hands the levels of the way down on to those of the way up
+internal I32
+renderer_push_blur_passes(RenderGraph *graph,
+                          I32 level_count)
+{
+    I32 levels[BLUR_PYRAMID_MAX_LEVELS + 1];
     
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 DEFAULT_WINDOW_WIDTH,
-                 DEFAULT_WINDOW_HEIGHT,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
+    levels[0] = renderer_push_render_graph_resource(graph, BLUR_TEXTURE_W, BLUR_TEXTURE_H, GL_RGBA8);
+    renderer_push_render_graph_pass(graph, RENDER_PASS_KIND_blit_screen, RENDER_GRAPH_SCREEN, RENDER_GRAPH_NO_INPUT, levels[0]);
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    for (I32 level = 1;
+         level <= level_count;
+         ++level)
+    {
+        levels[level] = renderer_push_render_graph_resource(graph, BLUR_TEXTURE_W >> level, BLUR_TEXTURE_H >> level, GL_RGBA8);
+        renderer_push_render_graph_pass(graph, RENDER_PASS_KIND_blur_down, levels[level - 1], RENDER_GRAPH_NO_INPUT, levels[level]);
+    }
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D,
-                           global_rcx.framebuffers.post_processing.texture,
-                           0);
+    for (I32 level = level_count;
+         level >= 1;
+         --level)
+    {
+        I32 destination = renderer_push_render_graph_resource(graph, BLUR_TEXTURE_W >> (level - 1), BLUR_TEXTURE_H >> (level - 1), GL_RGBA8);
+        renderer_push_render_graph_pass(graph, RENDER_PASS_KIND_blur_up, levels[level], RENDER_GRAPH_NO_INPUT, destination);
+        levels[level - 1] = destination;
+    }
     
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return levels[0];
 }
 
 internal void
-renderer_enqueue_message(RenderMessage message)
+renderer_execute_render_graph_pass(RenderGraph *graph,
+                                   RenderGraphPass *pass,
+                                   RenderMessage *message)
 {
-    RenderMessage *queued_message =
-        arena_push(&global_frame_memory,
-                   sizeof(*queued_message));
-    
-    *queued_message = message;
+    RenderTarget *input_a = (pass->inputs[0] >= 0) ? graph->resources[pass->inputs[0]].target : NULL;
+    RenderTarget *input_b = (pass->inputs[1] >= 0) ? graph->resources[pass->inputs[1]].target : NULL;
+    RenderTarget *output = (pass->output >= 0) ? graph->resources[pass->output].target : NULL;
     
-    // NOTE(tbt): copy mask from stack
+    switch (pass->kind)
     {
-        queued_message->mask = global_rcx.mask_stack[global_rcx.mask_stack_size];
+        case RENDER_PASS_KIND_blit_screen:
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output->framebuffer.target);
+            
+            glBlitFramebuffer(0, 0, global_rcx.window.w, global_rcx.window.h,
+                              0, 0, output->w, output->h,
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            
+            break;
+        }
         
-        if (queued_message->mask.x < 0.0f)
+        case RENDER_PASS_KIND_blur_down:
+        case RENDER_PASS_KIND_blur_up:
         {
-            queued_message->mask.w -= queued_message->mask.x;
-            queued_message->mask.x = 0.0f;
+            ShaderID shader = (RENDER_PASS_KIND_blur_down == pass->kind) ? global_rcx.shaders.blur_down : global_rcx.shaders.blur_up;
+            if (shader != global_rcx.shaders.current)
+            {
+                glUseProgram(shader);
+                global_rcx.shaders.current = shader;
+            }
+            
+            glBindFramebuffer(GL_FRAMEBUFFER, output->framebuffer.target);
+            glViewport(0, 0, output->w, output->h);
+            glBindTexture(GL_TEXTURE_2D, input_a->framebuffer.texture);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            
+            break;
         }
-        if (queued_message->mask.y < 0.0f)
+        
+        case RENDER_PASS_KIND_blit_to_screen:
         {
-            queued_message->mask.h -= queued_message->mask.y;
-            queued_message->mask.y = 0.0f;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, input_a->framebuffer.target);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            
+            glViewport(0,
+                       0,
+                       global_rcx.window.w,
+                       global_rcx.window.h);
+            
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(message->mask.x,
+                      global_rcx.window.h - message->mask.y - message->mask.h,
+                      message->mask.w,
+                      message->mask.h);
+            
+            F32 x0 = message->rectangle.x;
+            F32 y0 = global_rcx.window.h - message->rectangle.y;
+            F32 x1 = message->rectangle.x + message->rectangle.w;
+            F32 y1 = global_rcx.window.h - message->rectangle.y - message->rectangle.h;
+            
+            F32 x_scale = (F32)input_a->w / (F32)global_rcx.window.w;
+            F32 y_scale = (F32)input_a->h / (F32)global_rcx.window.h;
+            glBlitFramebuffer(x0 * x_scale,
+                              y0 * y_scale,
+                              x1 * x_scale,
+                              y1 * y_scale,
+                              x0, y0, x1, y1,
+                              GL_COLOR_BUFFER_BIT,
+                              GL_LINEAR);
+            
+            break;
+        }
+        
+        case RENDER_PASS_KIND_post_process:
+        {
+            U32 post_shader;
+            struct RcxPostProcessingUniformLocations *uniforms;
+            
+            if (message->post_processing_kind == POST_PROCESSING_KIND_memory)
+            {
+                post_shader = global_rcx.shaders.memory_post_processing;
+                uniforms = &global_rcx.uniform_locations.memory_post_processing;
+            }
+            else
+            {
+                post_shader = global_rcx.shaders.post_processing;
+                uniforms = &global_rcx.uniform_locations.post_processing;
+            }
+            
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            
+            glUseProgram(post_shader);
+            glUniform1f(uniforms->time, (F32)global_time);
+            glUniform1f(uniforms->exposure, message->exposure);
+            
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, input_a->framebuffer.texture);
+            glUniform1i(uniforms->blur_texture, 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, input_b->framebuffer.texture);
+            glUniform1i(uniforms->screen_texture, 1);
+            
+            glViewport(0, 0, global_rcx.window.w, global_rcx.window.h);
+            
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(message->mask.x,
+                      global_rcx.window.h - message->mask.y - message->mask.h,
+                      message->mask.w,
+                      message->mask.h);
+            
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            
+            glActiveTexture(GL_TEXTURE0);
+            glUseProgram(global_rcx.shaders.current);
+            
+            break;
+        }
+    }
+}
+
+// NOTE(tbt): runs the passes in the order they were pushed
+//            - each resource is given a target from the pool just before the pass which writes it, and gives it back
+//              straight after the last pass which reads it, unless it is imported or kept
+internal void
+renderer_execute_render_graph(RenderGraph *graph,
+                              RenderMessage *message)
+{
+    for (I32 pass_index = 0;
+         pass_index < graph->pass_count;
+         ++pass_index)
+    {
+        RenderGraphPass *pass = &graph->passes[pass_index];
+        
+        if (pass->output >= 0)
+        {
+            RenderGraphResource *output = &graph->resources[pass->output];
+            if (!output->target)
+            {
+                output->target = renderer_acquire_render_target(output->w, output->h, output->format);
+            }
+        }
+        
+        renderer_execute_render_graph_pass(graph, pass, message);
+        
+        for (I32 resource_index = 0;
+             resource_index < graph->resource_count;
+             ++resource_index)
+        {
+            RenderGraphResource *resource = &graph->resources[resource_index];
+            if (resource->last_pass == pass_index &&
+                !resource->is_imported &&
+                !resource->is_kept)
+            {
+                renderer_release_render_target(resource->target);
+            }
         }
-        queued_message->mask.w = max_f(queued_message->mask.w, 0.0f);
-        queued_message->mask.h = max_f(queued_message->mask.h, 0.0f);
     }
     
-    if (global_rcx.message_queue.end)
-    {
-        global_rcx.message_queue.end->next = queued_message;
-    }
-    else
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
+}
+
+internal U64
+renderer_hash_f32s(U64 hash,
+                   F32 *values,
+                   U64 count)
+{
+    for (U64 i = 0;
+         i < count;
+         ++i)
     {
-        global_rcx.message_queue.start = queued_message;
+        U32 bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        hash = hash_64_combine(hash, bits);
     }
     
-    global_rcx.message_queue.end = queued_message;
+    return hash;
 }
 
-internal B32
-renderer_dequeue_message(RenderMessage *result)
+// NOTE(tbt): hashes everything about a message which affects what it draws
+//            projection matrices are only hashed when they change from one message to the next
+internal U64
+renderer_hash_message(U64 hash,
+                      RenderMessage *message,
+                      F32 **last_projection_matrix)
 {
+    hash = hash_64_combine(hash, message->kind);
+    hash = hash_64_combine(hash, message->sort);
+    hash = renderer_hash_f32s(hash, &message->mask.x, 4);
+    hash = renderer_hash_f32s(hash, &message->rectangle.x, 4);
+    hash = hash_64_combine(hash, message->texture);
+    hash = renderer_hash_f32s(hash, &message->sub_texture.min_x, 4);
+    hash = renderer_hash_f32s(hash, &message->angle, 1);
+    hash = renderer_hash_f32s(hash, &message->stroke_width, 1);
+    hash = renderer_hash_f32s(hash, &message->colour.r, 4);
+    hash = renderer_hash_f32s(hash, &message->gradient.tl.r, 16);
+    hash = hash_64_combine(hash, message->strength);
+    hash = renderer_hash_f32s(hash, &message->exposure, 1);
+    hash = hash_64_combine(hash, message->post_processing_kind);
+    hash = hash_64_combine(hash, (uintptr_t)message->font);
+    hash = hash_64_from_bytes(hash, message->string.buffer, message->string.size);
     
-    if (!global_rcx.message_queue.start) { return false; }
+    if (message->projection_matrix &&
+        message->projection_matrix != *last_projection_matrix)
+    {
+        hash = renderer_hash_f32s(hash, message->projection_matrix, 16);
+        *last_projection_matrix = message->projection_matrix;
+    }
     
-    *result = *global_rcx.message_queue.start;
-    global_rcx.message_queue.start = global_rcx.message_queue.start->next;
+    // NOTE(tbt): post processing adds noise which changes every frame
+    if (RENDER_MESSAGE_do_post_processing == message->kind)
+    {
+        hash = hash_64_combine(hash, global_rcx.flush_count);
+    }
     
-    return true;
+    return hash;
 }
 
+// NOTE(tbt): fills in blur_key for each blur in the sorted messages
+//            - blurs at the same depth with the same strength share the key of the first of them, so all use the blur done
+//              for it, of what was drawn before it
+//            - the key is a hash of everything drawn before that first blur, so if it matches the key of the blur left over
+//              from last frame, that can be used again
+//            - only 16 different depths and strengths are shared in a flush - any more each get a key of their own
 internal void
-renderer_flush_batch(RenderBatch *batch)
+renderer_find_blur_keys(RenderMessage **messages,
+                        U64 message_count)
 {
-    if (!batch->in_use) return;
-    
-    glScissor(batch->mask.x,
-              global_rcx.window.h - batch->mask.y - batch->mask.h,
-              batch->mask.w,
-              batch->mask.h);
-    
-    if (global_rcx.shaders.current != batch->shader)
+    B32 has_blur = false;
+    for (U64 i = 0;
+         i < message_count && !has_blur;
+         ++i)
     {
-        glUseProgram(batch->shader);
-        global_rcx.shaders.current = batch->shader;
+        has_blur = (RENDER_MESSAGE_blur_screen_region == messages[i]->kind);
     }
     
-    if (global_rcx.current_texture != batch->texture)
-    {
-        glBindTexture(GL_TEXTURE_2D, batch->texture);
-        global_rcx.current_texture = batch->texture;
-    }
+    if (!has_blur) { return; }
     
-    if (batch->shader == global_rcx.shaders.texture)
-    {
-        glUniformMatrix4fv(global_rcx.uniform_locations.texture.projection_matrix,
-                           1,
-                           GL_FALSE,
-                           batch->projection_matrix);
-    }
-    else if (batch->shader == global_rcx.shaders.text)
+    struct
     {
-        glUniformMatrix4fv(global_rcx.uniform_locations.text.projection_matrix,
-                           1,
-                           GL_FALSE,
-                           batch->projection_matrix);
-    }
+        U8 sort;
+        I32 strength;
+        U64 key;
+    } shared[16];
+    I32 shared_count = 0;
     
-    glBufferData(GL_ARRAY_BUFFER,
-                 batch->quad_count * sizeof(Quad),
-                 batch->buffer,
-                 GL_DYNAMIC_DRAW);
+    U64 hash = HASH_64_SEED;
+    hash = hash_64_combine(hash, global_rcx.window.w);
+    hash = hash_64_combine(hash, global_rcx.window.h);
+    hash = hash_64_combine(hash, global_rcx.texture_upload_count);
     
-    glDrawElements(GL_TRIANGLES,
-                   batch->quad_count * 6,
-                   GL_UNSIGNED_INT,
-                   NULL);
+    F32 *last_projection_matrix = NULL;
     
-    batch->quad_count = 0;
-    batch->texture = 0;
-    batch->shader = 0;
-    batch->projection_matrix = NULL;
-    batch->in_use = false;
+    for (U64 i = 0;
+         i < message_count;
+         ++i)
+    {
+        RenderMessage *message = messages[i];
+        
+        if (RENDER_MESSAGE_blur_screen_region == message->kind)
+        {
+            message->blur_key = 0;
+            
+            for (I32 shared_index = 0;
+                 shared_index < shared_count;
+                 ++shared_index)
+            {
+                if (shared[shared_index].sort == message->sort &&
+                    shared[shared_index].strength == message->strength)
+                {
+                    message->blur_key = shared[shared_index].key;
+                    break;
+                }
+            }
+            
+            if (!message->blur_key)
+            {
+                message->blur_key = max_u(hash_64_combine(hash, message->strength), 1);
+                
+                if (shared_count < array_count(shared))
+                {
+                    shared[shared_count].sort = message->sort;
+                    shared[shared_count].strength = message->strength;
+                    shared[shared_count].key = message->blur_key;
+                    shared_count += 1;
+                }
+            }
+        }
+        
+        hash = renderer_hash_message(hash, message, &last_projection_matrix);
+    }
 }
 
 internal void
 renderer_flush_message_queue()
 {
-    RenderMessage message;
-    
     RenderBatch batch;
     batch.quad_count = 0;
+    batch.is_instanced = false;
     batch.texture = 0;
     batch.shader = 0;
     batch.in_use = false;
     
+    renderer_begin_gpu_timer_frame();
+    
     glEnable(GL_SCISSOR_TEST);
     
     //
-    // NOTE(tbt): sort message queue
+    // NOTE(tbt): gather message queues
     //
     
-    // NOTE(tbt): form a bucket for each depth
-    RenderMessage *heads[256] = {0};
-    RenderMessage *tails[256] = {0};
+    // NOTE(tbt): the per thread queues are gathered into one array to be sorted
+    //            the queue index is part of the sort key, so within a depth messages from the main thread come first, then
+    //            each worker in order, so the result is the same however the work was split up
+    U64 message_count = 0;
+    U64 max_quad_count = 0;
+    U64 max_instance_count = 0; // NOTE(tbt): of max_quad_count, how many are for instanced messages
+    
+    for (I32 queue_index = 0;
+         queue_index < MAX_RENDER_QUEUES;
+         ++queue_index)
+    {
+        for (RenderMessage *node = global_rcx.message_queues[queue_index].start;
+             node;
+             node = node->next)
+        {
+            message_count += 1;
+        }
+    }
     
-    RenderMessage *next = NULL;
+    RenderSortEntry *sort_entries = arena_push(&global_frame_memory, message_count * sizeof(sort_entries[0]));
+    RenderSortEntry *sort_scratch = arena_push(&global_frame_memory, message_count * sizeof(sort_scratch[0]));
+    U64 sort_entry_count = 0;
     
-    for (RenderMessage *node = global_rcx.message_queue.start;
-         node;
-         node = next)
+    for (I32 queue_index = 0;
+         queue_index < MAX_RENDER_QUEUES;
+         ++queue_index)
     {
-        if (tails[node->sort])
+        struct RcxMessageQueue *queue = &global_rcx.message_queues[queue_index];
+        
+        for (RenderMessage *node = queue->start;
+             node;
+             node = node->next)
         {
-            tails[node->sort]->next = node;
+            sort_entries[sort_entry_count].key = node->sort_key;
+            sort_entries[sort_entry_count].message = node;
+            sort_entry_count += 1;
+            
+            max_quad_count += renderer_max_quads_for_message(node);
+            
+            node->is_instanced = (global_rcx.is_instancing_enabled &&
+                                  node->kind != RENDER_MESSAGE_draw_gradient);
+            if (node->is_instanced)
+            {
+                max_instance_count += renderer_max_quads_for_message(node);
+            }
         }
-        else
+        
+        queue->start = NULL;
+        queue->end = NULL;
+        queue->sequence = 0;
+    }
+    
+    //
+    // NOTE(tbt): find or lay out a text run for each text message
+    //
+    
+    // NOTE(tbt): done on the main thread before quad generation, which then only has to read from the text runs
+    //            also needed before sorting, to know the bounds of the text
+    global_rcx.flush_count += 1;
+    
+    for (U64 i = 0;
+         i < message_count;
+         ++i)
+    {
+        RenderMessage *message = sort_entries[i].message;
+        if (message->kind == RENDER_MESSAGE_draw_text)
         {
-            heads[node->sort] = node;
+            message->text_run = text_run_from_s8(message->font,
+                                                 message->string,
+                                                 message->rectangle.w);
+            if (message->text_run)
+            {
+                touch_text_run(message->text_run);
+            }
         }
-        tails[node->sort] = node;
-        next = node->next;
-        node->next = NULL;
     }
     
-    // NOTE(tbt): reconstruct queue in correct order
-    global_rcx.message_queue.start = NULL;
-    global_rcx.message_queue.end = NULL;
-    for (I32 i = 0;
-         i < 256;
+    for (U64 i = 0;
+         i < message_count;
+         ++i)
+    {
+        RenderMessage *message = sort_entries[i].message;
+        if (message->kind == RENDER_MESSAGE_draw_text)
+        {
+            font_upload_glyph_cache(message->font);
+        }
+    }
+    
+    //
+    // NOTE(tbt): sort message queue
+    //
+    
+    profile_scope("sort render messages")
+    {
+        renderer_assign_sort_layers(sort_entries, message_count);
+        renderer_radix_sort(sort_entries, sort_scratch, message_count);
+    }
+    
+    RenderMessage **messages = arena_push(&global_frame_memory, message_count * sizeof(messages[0]));
+    Quad *quads = arena_push(&global_frame_memory, (max_quad_count - max_instance_count) * sizeof(quads[0]));
+    SpriteInstance *instances = arena_push(&global_frame_memory, max_instance_count * sizeof(instances[0]));
+    
+    U64 quad_index = 0;
+    U64 instance_index = 0;
+    
+    for (U64 i = 0;
+         i < message_count;
          ++i)
     {
-        if (!heads[i]) { continue; }
+        RenderMessage *node = sort_entries[i].message;
         
-        if (global_rcx.message_queue.end)
+        if (node->is_instanced)
         {
-            global_rcx.message_queue.end->next = heads[i];
+            node->instances = instances + instance_index;
+            instance_index += renderer_max_quads_for_message(node);
         }
         else
         {
-            global_rcx.message_queue.start = heads[i];
+            node->quads = quads + quad_index;
+            quad_index += renderer_max_quads_for_message(node);
+        }
+        messages[i] = node;
+    }
+    
+    renderer_find_blur_keys(messages, message_count);
+    
+    //
+    // NOTE(tbt): expand messages into quads
+    //
+    
+    // NOTE(tbt): split the sorted messages into roughly evenly sized (by number of quads) jobs for the worker threads
+    U64 job_count = min_u((platform_get_worker_count() + 1) * 4, max_quad_count / QUAD_GENERATION_JOB_MIN_QUADS);
+    
+    if (job_count > 1)
+    {
+        U64 quads_per_job = max_quad_count / job_count;
+        U64 quads_in_job = 0;
+        QuadGenerationJob *job = NULL;
+        
+        for (U64 i = 0;
+             i < message_count;
+             ++i)
+        {
+            if (!job)
+            {
+                job = arena_push(&global_frame_memory, sizeof(*job));
+                job->messages = &messages[i];
+                quads_in_job = 0;
+            }
+            
+            job->message_count += 1;
+            quads_in_job += renderer_max_quads_for_message(messages[i]);
+            
+            if (quads_in_job >= quads_per_job ||
+                i + 1 == message_count)
+            {
+                platform_push_work(renderer_do_quad_generation_job, job);
+                job = NULL;
+            }
+        }
+        
+        platform_complete_all_work();
+    }
+    else
+    {
+        for (U64 i = 0;
+             i < message_count;
+             ++i)
+        {
+            renderer_generate_quads(messages[i]);
         }
-        global_rcx.message_queue.end = tails[i];
     }
     
     //
     // NOTE(tbt): main render message processing loop
     //
     
-    while (renderer_dequeue_message(&message))
+    for (U64 i = 0;
+         i < message_count;
+         ++i)
     {
+        RenderMessage message = *messages[i];
+        
         switch (message.kind)
         {
             case RENDER_MESSAGE_draw_rectangle:
             {
-                if (batch.texture != message.texture ||
-                    batch.shader != global_rcx.shaders.texture ||
-                    batch.quad_count >= BATCH_SIZE ||
-                    batch.projection_matrix != message.projection_matrix ||
-                    !rect_match(batch.mask, message.mask) ||
-                    !(batch.in_use))
-                {
-                    renderer_flush_batch(&batch);
-                    
-                    batch.shader = global_rcx.shaders.texture;
-                    batch.texture = message.texture;
-                    batch.projection_matrix = message.projection_matrix;
-                    batch.mask = message.mask;
-                }
-                
-                batch.in_use = true;
-                
-                batch.buffer[batch.quad_count] = generate_rotated_quad(message.rectangle,
-                                                                       message.angle,
-                                                                       message.colour,
-                                                                       message.sub_texture);
-                batch.quad_count += 1;
-                
+                renderer_push_quads_to_batch(&batch, &message, global_rcx.shaders.texture, message.texture);
                 break;
             }
             
             case RENDER_MESSAGE_stroke_rectangle:
+            case RENDER_MESSAGE_draw_gradient:
             {
-                Rect top, bottom, left, right;
-                F32 stroke_width;
-                
-                if (batch.texture != global_rcx.flat_colour_texture ||
-                    batch.shader != global_rcx.shaders.texture||
-                    batch.projection_matrix != message.projection_matrix ||
-                    batch.quad_count >= BATCH_SIZE - 4 || // NOTE(tbt): 4 quads to stroke a rectangle
-                    !rect_match(batch.mask, message.mask) ||
-                    !(batch.in_use))
-                {
-                    renderer_flush_batch(&batch);
-                    
-                    batch.shader = global_rcx.shaders.texture;
-                    batch.texture = global_rcx.flat_colour_texture;
-                    batch.projection_matrix = message.projection_matrix;
-                    batch.mask = message.mask;
-                }
-                
-                batch.in_use = true;
-                
-                stroke_width = message.stroke_width;
-                
-                top = rect(message.rectangle.x,
-                           message.rectangle.y,
-                           message.rectangle.w,
-                           stroke_width);
-                
-                bottom = rect(message.rectangle.x,
-                              message.rectangle.y +
-                              message.rectangle.h -
-                              stroke_width,
-                              message.rectangle.w,
-                              stroke_width);
-                
-                left = rect(message.rectangle.x,
-                            message.rectangle.y +
-                            stroke_width,
-                            stroke_width,
-                            message.rectangle.h -
-                            stroke_width * 2);
-                
-                right = rect(message.rectangle.x +
-                             message.rectangle.w -
-                             stroke_width,
-                             message.rectangle.y +
-                             stroke_width,
-                             stroke_width,
-                             message.rectangle.h -
-                             stroke_width * 2);
-                
-                batch.buffer[batch.quad_count++] =
-                    generate_quad(top,
-                                  message.colour,
-                                  message.sub_texture);
-                
-                batch.buffer[batch.quad_count++] =
-                    generate_quad(bottom,
-                                  message.colour,
-                                  message.sub_texture);
-                
-                batch.buffer[batch.quad_count++] =
-                    generate_quad(left,
-                                  message.colour,
-                                  message.sub_texture);
-                
-                batch.buffer[batch.quad_count++] =
-                    generate_quad(right,
-                                  message.colour,
-                                  message.sub_texture);
-                
+                renderer_push_quads_to_batch(&batch, &message, global_rcx.shaders.texture, global_rcx.flat_colour_texture);
                 break;
             }
             
             case RENDER_MESSAGE_draw_text:
             {
-                F32 line_start = message.rectangle.x;
-                F32 x = message.rectangle.x;
-                F32 y = message.rectangle.y;
-                I32 wrap_width = message.rectangle.w;
-                
-                if (batch.texture != message.font->texture.id ||
-                    batch.shader != global_rcx.shaders.text ||
-                    batch.projection_matrix != message.projection_matrix ||
-                    batch.quad_count >= BATCH_SIZE ||
-                    !rect_match(batch.mask, message.mask) ||
-                    !(batch.in_use))
-                {
-                    renderer_flush_batch(&batch);
-                    
-                    batch.shader = global_rcx.shaders.text;
-                    batch.texture = message.font->texture.id;
-                    batch.projection_matrix = message.projection_matrix;
-                    batch.mask = message.mask;
-                }
-                
-                batch.in_use = true;
-                
-                I32 font_bake_begin = message.font->bake_begin;
-                I32 font_bake_end = message.font->bake_end;
-                
-                I32 i = 0;
-                for (UTF8Consume consume = consume_utf8_from_string(message.string, i);
-                     i < message.string.size;
-                     i += consume.advance, consume = consume_utf8_from_string(message.string, i))
-                {
-                    if (consume.codepoint == '\n')
-                    {
-                        x = line_start;
-                        y += message.font->vertical_advance;
-                    }
-                    else if (consume.codepoint >= font_bake_begin &&
-                             consume.codepoint < font_bake_end)
-                    {
-                        stbtt_aligned_quad q;
-                        Rect rectangle;
-                        SubTexture sub_texture;
-                        
-                        stbtt_GetPackedQuad(message.font->char_data,
-                                            message.font->texture.width,
-                                            message.font->texture.height,
-                                            consume.codepoint - font_bake_begin,
-                                            &x, &y,
-                                            &q,
-                                            false);
-                        
-                        sub_texture.min_x = q.s0;
-                        sub_texture.min_y = q.t0;
-                        sub_texture.max_x = q.s1;
-                        sub_texture.max_y = q.t1;
-                        
-                        rectangle = rect(q.x0, q.y0,
-                                         q.x1 - q.x0,
-                                         q.y1 - q.y0);
-                        
-                        if (batch.quad_count >= BATCH_SIZE)
-                        {
-                            renderer_flush_batch(&batch);
-                            
-                            batch.shader = global_rcx.shaders.text;
-                            batch.texture = message.font->texture.id;
-                            batch.projection_matrix = message.projection_matrix;
-                            batch.mask = message.mask;
-                        }
-                        else
-                        {
-                            batch.buffer[batch.quad_count++] =
-                                generate_quad(rectangle,
-                                              message.colour,
-                                              sub_texture);
-                        }
-                        if (wrap_width > 0.0f &&
-                            is_char_space(consume.codepoint))
-                        {
-                            if (x > line_start + wrap_width)
-                            {
-                                x = line_start;
-                                y += message.font->vertical_advance;
-                            }
-                        }
-                    }
-                }
-                
+                renderer_push_quads_to_batch(&batch, &message, global_rcx.shaders.text, message.font->texture.id);
                 break;
             }
             
@@ -2068,139 +7058,57 @@ renderer_flush_message_queue()
             {
                 renderer_flush_batch(&batch);
                 
-                glDisable(GL_SCISSOR_TEST);
-                
-                // NOTE(tbt): blit screen to framebuffer
-                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, global_rcx.framebuffers.blur_a.target);
+                I32 level_count = renderer_blur_levels_from_strength(message.strength);
+                U32 pass_count = 1 + 2 * level_count;
                 
-                glViewport(0, 0, BLUR_TEXTURE_W, BLUR_TEXTURE_H);
-                
-                glBlitFramebuffer(0,
-                                  0,
-                                  global_rcx.window.w,
-                                  global_rcx.window.h,
-                                  0,
-                                  0,
-                                  BLUR_TEXTURE_W,
-                                  BLUR_TEXTURE_H,
-                                  GL_COLOR_BUFFER_BIT,
-                                  GL_LINEAR);
-                
-                glUseProgram(global_rcx.shaders.blur);
-                global_rcx.shaders.current = global_rcx.shaders.blur;
-                
-                for (I32 i = 0;
-                     i < message.strength;
-                     ++i)
+                if (global_rcx.software.framebuffer ||
+                    global_rcx.cpu_post_processing.enabled)
                 {
-                    // NOTE(tbt): apply first (horizontal) blur pass
-                    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.blur_b.target);
-                    glUniform2f(global_rcx.uniform_locations.blur.direction, 1.0f, 0.0f);
-                    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.blur_a.texture);
-                    glDrawArrays(GL_TRIANGLES, 0, 6);
-                    
-                    // NOTE(tbt): apply second (vertical) blur pass
-                    glBindFramebuffer(GL_FRAMEBUFFER, global_rcx.framebuffers.blur_a.target);
-                    glUniform2f(global_rcx.uniform_locations.blur.direction, 0.0f, 1.0f);
-                    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.blur_b.texture);
-                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                    renderer_cpu_blur_screen_region(message.rectangle,
+                                                    message.mask,
+                                                    message.strength,
+                                                    message.blur_key);
+                    break;
                 }
                 
-                // NOTE(tbt): blit desired region back to screen
-                glBindFramebuffer(GL_READ_FRAMEBUFFER, global_rcx.framebuffers.blur_a.target);
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-                
-                glViewport(0,
-                           0,
-                           global_rcx.window.w,
-                           global_rcx.window.h);
-                
-                glEnable(GL_SCISSOR_TEST);
-                glScissor(message.mask.x,
-                          global_rcx.window.h - message.mask.y - message.mask.h,
-                          message.mask.w,
-                          message.mask.h);
-                
-                F32 x0 = message.rectangle.x;
-                F32 y0 = global_rcx.window.h - message.rectangle.y;
-                F32 x1 = message.rectangle.x + message.rectangle.w;
-                F32 y1 = global_rcx.window.h - message.rectangle.y - message.rectangle.h;
-                
-                F32 x_scale = (F32)BLUR_TEXTURE_W / (F32)global_rcx.window.w;
-                F32 y_scale = (F32)BLUR_TEXTURE_H / (F32)global_rcx.window.h;
-                glBlitFramebuffer(x0 * x_scale,
-                                  y0 * y_scale,
-                                  x1 * x_scale,
-                                  y1 * y_scale,
-                                  x0, y0, x1, y1,
-                                  GL_COLOR_BUFFER_BIT,
-                                  GL_LINEAR);
-                
-                // NOTE(tbt): reset current texture
-                glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
+                renderer_begin_gpu_timer(RENDER_MESSAGE_blur_screen_region);
                 
-                break;
-            }
-            
-            case RENDER_MESSAGE_draw_gradient:
-            {
-                Quad quad;
-                
-                quad.bl.x = message.rectangle.x;
-                quad.bl.y = message.rectangle.y + message.rectangle.h;
-                quad.bl.r = message.gradient.bl.r;
-                quad.bl.g = message.gradient.bl.g;
-                quad.bl.b = message.gradient.bl.b;
-                quad.bl.a = message.gradient.bl.a;
-                quad.bl.u = 0.0f;
-                quad.bl.v = 1.0f;
-                
-                quad.br.x = message.rectangle.x + message.rectangle.w;
-                quad.br.y = message.rectangle.y + message.rectangle.h;
-                quad.br.r = message.gradient.br.r;
-                quad.br.g = message.gradient.br.g;
-                quad.br.b = message.gradient.br.b;
-                quad.br.a = message.gradient.br.a;
-                quad.br.u = 1.0f;
-                quad.br.v = 1.0f;
-                
-                quad.tr.x = message.rectangle.x + message.rectangle.w;
-                quad.tr.y = message.rectangle.y;
-                quad.tr.r = message.gradient.tr.r;
-                quad.tr.g = message.gradient.tr.g;
-                quad.tr.b = message.gradient.tr.b;
-                quad.tr.a = message.gradient.tr.a;
-                quad.tr.u = 1.0f;
-                quad.tr.v = 0.0f;
+                glDisable(GL_SCISSOR_TEST);
                 
-                quad.tl.x = message.rectangle.x;
-                quad.tl.y = message.rectangle.y;
-                quad.tl.r = message.gradient.tl.r;
-                quad.tl.g = message.gradient.tl.g;
-                quad.tl.b = message.gradient.tl.b;
-                quad.tl.a = message.gradient.tl.a;
-                quad.tl.u = 0.0f;
-                quad.tl.v = 0.0f;
+                RenderGraph graph;
+                graph.resource_count = 0;
+                graph.pass_count = 0;
                 
-                if (batch.texture != global_rcx.flat_colour_texture ||
-                    batch.shader != global_rcx.shaders.texture ||
-                    batch.quad_count >= BATCH_SIZE ||
-                    batch.projection_matrix != message.projection_matrix ||
-                    !rect_match(batch.mask, message.mask) ||
-                    !(batch.in_use))
+                I32 blur;
+                if (global_rcx.screen_blur.target &&
+                    message.blur_key == global_rcx.screen_blur.key)
+                {
+                    global_rcx.screen_blur.passes_saved += pass_count;
+                    blur = renderer_import_render_graph_resource(&graph, global_rcx.screen_blur.target);
+                }
+                else
                 {
-                    renderer_flush_batch(&batch);
+                    global_rcx.screen_blur.key = message.blur_key;
+                    global_rcx.screen_blur.pass_count += pass_count;
                     
-                    batch.shader = global_rcx.shaders.texture;
-                    batch.texture = global_rcx.flat_colour_texture;
-                    batch.projection_matrix = message.projection_matrix;
-                    batch.mask = message.mask;
+                    // NOTE(tbt): the old screen blur is finished with, so its memory can go to the new one
+                    if (global_rcx.screen_blur.target)
+                    {
+                        renderer_release_render_target(global_rcx.screen_blur.target);
+                        global_rcx.screen_blur.target = NULL;
+                    }
+                    
+                    blur = renderer_push_blur_passes(&graph, level_count);
+                    graph.resources[blur].is_kept = true;
                 }
                 
-                batch.in_use = true;
+                renderer_push_render_graph_pass(&graph, RENDER_PASS_KIND_blit_to_screen, blur, RENDER_GRAPH_NO_INPUT, RENDER_GRAPH_SCREEN);
+                
+                renderer_execute_render_graph(&graph, &message);
                 
-                batch.buffer[batch.quad_count++] = quad;
+                global_rcx.screen_blur.target = graph.resources[blur].target;
+                
+                renderer_end_gpu_timer();
                 
                 break;
             }
@@ -2209,94 +7117,48 @@ renderer_flush_message_queue()
             {
                 renderer_flush_batch(&batch);
                 
-                glDisable(GL_SCISSOR_TEST);
-                
-                //-NOTE(tbt): setup for relevant post processing kind
-                
-                U32 post_shader;
-                Framebuffer *blur_framebuffer_1;
-                Framebuffer *blur_framebuffer_2;
-                struct RcxPostProcessingUniformLocations *uniforms;
-                
-                if (message.post_processing_kind == POST_PROCESSING_KIND_memory)
-                {
-                    post_shader = global_rcx.shaders.memory_post_processing;
-                    uniforms = &global_rcx.uniform_locations.memory_post_processing;
-                    blur_framebuffer_1 = &global_rcx.framebuffers.bloom_blur_a;
-                    blur_framebuffer_2 = &global_rcx.framebuffers.bloom_blur_b;
-                }
-                else if (message.post_processing_kind == POST_PROCESSING_KIND_world)
-                {
-                    post_shader = global_rcx.shaders.post_processing;
-                    uniforms = &global_rcx.uniform_locations.post_processing;
-                    blur_framebuffer_1 = &global_rcx.framebuffers.blur_a;
-                    blur_framebuffer_2 = &global_rcx.framebuffers.blur_b;
-                }
-                else
+                if (global_rcx.software.framebuffer ||
+                    global_rcx.cpu_post_processing.enabled)
                 {
+                    renderer_cpu_do_post_processing(message.post_processing_kind,
+                                                    message.exposure,
+                                                    message.mask);
                     break;
                 }
                 
-                //-NOTE(tbt): blit screen to framebuffers
-                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                glDisable(GL_SCISSOR_TEST);
                 
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, global_rcx.framebuffers.post_processing.target);
+                if (message.post_processing_kind != POST_PROCESSING_KIND_world &&
+                    message.post_processing_kind != POST_PROCESSING_KIND_memory)
                 {
-                    glBlitFramebuffer(0, 0, global_rcx.window.w, global_rcx.window.h,
-                                      0, 0, global_rcx.window.w, global_rcx.window.h,
-                                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                    break;
                 }
                 
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, blur_framebuffer_1->target);
+                if (message.post_processing_kind == POST_PROCESSING_KIND_world &&
+                    global_rcx.screen_blur.target)
                 {
-                    glViewport(0, 0, BLUR_TEXTURE_W, BLUR_TEXTURE_H);
-                    glBlitFramebuffer(0, 0, global_rcx.window.w, global_rcx.window.h,
-                                      0, 0, BLUR_TEXTURE_W, BLUR_TEXTURE_H,
-                                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                    // NOTE(tbt): throw away the screen blur, so its memory can go to the bloom blur
+                    renderer_release_render_target(global_rcx.screen_blur.target);
+                    global_rcx.screen_blur.target = NULL;
+                    global_rcx.screen_blur.key = 0;
                 }
                 
-                //-NOTE(tbt): blur for bloom
-                glUseProgram(global_rcx.shaders.blur);
+                renderer_begin_gpu_timer(RENDER_MESSAGE_do_post_processing);
                 
-                // NOTE(tbt): apply first (horizontal) blur pass
-                glBindFramebuffer(GL_FRAMEBUFFER, blur_framebuffer_2->target);
-                glUniform2f(global_rcx.uniform_locations.blur.direction, 1.0f, 0.0f);
-                glBindTexture(GL_TEXTURE_2D, blur_framebuffer_1->texture);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+                RenderGraph graph;
+                graph.resource_count = 0;
+                graph.pass_count = 0;
                 
-                // NOTE(tbt): apply second (vertical) blur pass
-                glBindFramebuffer(GL_FRAMEBUFFER, blur_framebuffer_1->target);
-                glUniform2f(global_rcx.uniform_locations.blur.direction, 0.0f, 1.0f);
-                glBindTexture(GL_TEXTURE_2D, blur_framebuffer_2->texture);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+                I32 screen_copy = renderer_push_render_graph_resource(&graph, global_rcx.window.w, global_rcx.window.h, GL_RGBA8);
+                renderer_push_render_graph_pass(&graph, RENDER_PASS_KIND_blit_screen, RENDER_GRAPH_SCREEN, RENDER_GRAPH_NO_INPUT, screen_copy);
                 
-                //-NOTE(tbt): blend back to screen
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                I32 bloom_blur = renderer_push_blur_passes(&graph, BLOOM_BLUR_LEVELS);
                 
-                glUseProgram(post_shader);
-                glUniform1f(uniforms->time, (F32)global_time);
-                glUniform1f(uniforms->exposure, message.exposure);
+                renderer_push_render_graph_pass(&graph, RENDER_PASS_KIND_post_process, bloom_blur, screen_copy, RENDER_GRAPH_SCREEN);
                 
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, blur_framebuffer_1->texture);
-                glUniform1i(uniforms->blur_texture, 0);
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.post_processing.texture);
-                glUniform1i(uniforms->screen_texture, 1);
+                renderer_execute_render_graph(&graph, &message);
                 
-                glViewport(0, 0, global_rcx.window.w, global_rcx.window.h);
-                
-                glEnable(GL_SCISSOR_TEST);
-                glScissor(message.mask.x,
-                          global_rcx.window.h - message.mask.y - message.mask.h,
-                          message.mask.w,
-                          message.mask.h);
-                
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
-                glUseProgram(global_rcx.shaders.current);
+                renderer_end_gpu_timer();
                 
                 break;
             }
@@ -2305,9 +7167,52 @@ renderer_flush_message_queue()
     
     renderer_flush_batch(&batch);
     
-    global_rcx.message_queue.start = NULL;
-    global_rcx.message_queue.end = NULL;
+    for (I32 queue_index = 0;
+         queue_index < MAX_RENDER_QUEUES;
+         ++queue_index)
+    {
+        arena_free_all(&global_rcx.message_queues[queue_index].memory);
+    }
+    
     glDisable(GL_SCISSOR_TEST);
+    
+    // NOTE(tbt): keep the CPU post processing timings for this frame around to be displayed next frame
+    memcpy(global_rcx.cpu_post_processing.last_pass_times,
+           global_rcx.cpu_post_processing.pass_times,
+           sizeof(global_rcx.cpu_post_processing.pass_times));
+    memset(global_rcx.cpu_post_processing.pass_times, 0, sizeof(global_rcx.cpu_post_processing.pass_times));
+    
+    global_rcx.vertex_stream.last_bytes_uploaded = global_rcx.vertex_stream.bytes_uploaded;
+    global_rcx.vertex_stream.last_orphan_count = global_rcx.vertex_stream.orphan_count;
+    global_rcx.vertex_stream.bytes_uploaded = 0;
+    global_rcx.vertex_stream.orphan_count = 0;
+    
+    global_rcx.instance_stream.last_bytes_uploaded = global_rcx.instance_stream.bytes_uploaded;
+    global_rcx.instance_stream.last_orphan_count = global_rcx.instance_stream.orphan_count;
+    global_rcx.instance_stream.bytes_uploaded = 0;
+    global_rcx.instance_stream.orphan_count = 0;
+    
+    global_rcx.last_draw_call_count = global_rcx.draw_call_count;
+    global_rcx.draw_call_count = 0;
+    
+    global_rcx.screen_blur.last_pass_count = global_rcx.screen_blur.pass_count;
+    global_rcx.screen_blur.last_passes_saved = global_rcx.screen_blur.passes_saved;
+    global_rcx.screen_blur.pass_count = 0;
+    global_rcx.screen_blur.passes_saved = 0;
+    
+    global_rcx.render_targets.last_allocation_count = global_rcx.render_targets.allocation_count;
+    global_rcx.render_targets.allocation_count = 0;
+    renderer_delete_idle_render_targets();
+    
+    global_rcx.text_run_cache.last_hits = global_rcx.text_run_cache.hits;
+    global_rcx.text_run_cache.last_misses = global_rcx.text_run_cache.misses;
+    global_rcx.text_run_cache.hits = 0;
+    global_rcx.text_run_cache.misses = 0;
+    
+    // NOTE(tbt): throw away the runs which weren't used this frame
+    global_rcx.text_run_cache.current = !global_rcx.text_run_cache.current;
+    arena_free_all(&global_rcx.text_run_cache.memory[global_rcx.text_run_cache.current]);
+    memset(global_rcx.text_run_cache.runs[global_rcx.text_run_cache.current], 0, sizeof(global_rcx.text_run_cache.runs[0]));
 }
 
 //
@@ -2320,15 +7225,29 @@ renderer_flush_message_queue()
 internal void
 renderer_recalculate_world_projection_matrix(void)
 {
-    persist F32 half_screen_width_in_world_units = (F32)(SCREEN_W_IN_WORLD_UNITS >> 1);
+    persist F32 half_screen_width_in_world_units = (F32)(SCREEN_W_IN_WORLD_UNITS >> 1);
+    
+    F32 aspect = (F32)global_rcx.window.h / (F32)global_rcx.window.w;
+    
+    generate_orthographic_projection_matrix(global_world_projection_matrix,
+                                            global_rcx.camera.x - half_screen_width_in_world_units,
+                                            global_rcx.camera.x + half_screen_width_in_world_units,
+                                            global_rcx.camera.y - half_screen_width_in_world_units * aspect,
+                                            global_rcx.camera.y + half_screen_width_in_world_units * aspect);
+}
+
+// NOTE(tbt): the region of the world covered by global_world_projection_matrix
+internal Rect
+renderer_get_visible_world_rect(void)
+{
+    F32 half_screen_width_in_world_units = (F32)(SCREEN_W_IN_WORLD_UNITS >> 1);
     
     F32 aspect = (F32)global_rcx.window.h / (F32)global_rcx.window.w;
     
-    generate_orthographic_projection_matrix(global_world_projection_matrix,
-                                            global_rcx.camera.x - half_screen_width_in_world_units,
-                                            global_rcx.camera.x + half_screen_width_in_world_units,
-                                            global_rcx.camera.y - half_screen_width_in_world_units * aspect,
-                                            global_rcx.camera.y + half_screen_width_in_world_units * aspect);
+    return rect(global_rcx.camera.x - half_screen_width_in_world_units,
+                global_rcx.camera.y - half_screen_width_in_world_units * aspect,
+                half_screen_width_in_world_units * 2.0f,
+                half_screen_width_in_world_units * aspect * 2.0f);
 }
 
 internal void
@@ -2341,19 +7260,6 @@ renderer_set_window_size(I32 w, I32 h)
     
     glViewport(0, 0, w, h);
     
-    glBindTexture(GL_TEXTURE_2D, global_rcx.framebuffers.post_processing.texture);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 w,
-                 h,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
-    
-    glBindTexture(GL_TEXTURE_2D, global_rcx.current_texture);
-    
     generate_orthographic_projection_matrix(global_ui_projection_matrix,
                                             0, w,
                                             0, h);
@@ -2405,6 +7311,30 @@ renderer_push_projection_matrix(F32 *projection_matrix)
 {
 }
 
+// NOTE(tbt): messages at the same depth may be reordered to cut down on batch breaks, but only where they can't overlap
+//            (see renderer_assign_sort_layers). anything drawn in a draw_in_order() block is instead drawn exactly in the
+//            order it was drawn in, with nothing else at the same depth moved into or across the block
+//            - an escape hatch for drawing whose bounds don't tell the whole story
+//            - only from the main thread, like the mask stack
+#define draw_in_order() defer_loop(renderer_begin_draw_in_order(), renderer_end_draw_in_order())
+
+internal void
+renderer_begin_draw_in_order(void)
+{
+    global_rcx.in_order_depth += 1;
+    global_rcx.message_queues[0].sequence += 1;
+}
+
+internal void
+renderer_end_draw_in_order(void)
+{
+    if (global_rcx.in_order_depth)
+    {
+        global_rcx.in_order_depth -= 1;
+        global_rcx.message_queues[0].sequence += 1;
+    }
+}
+
 internal void
 draw_rotated_sub_texture(Rect rectangle,
                          F32 angle,
@@ -2425,6 +7355,15 @@ draw_rotated_sub_texture(Rect rectangle,
     message.projection_matrix = projection_matrix;
     message.sort = sort;
     
+    if (texture->is_in_atlas)
+    {
+        SubTexture region = texture->atlas_region;
+        message.sub_texture.min_x = region.min_x + sub_texture.min_x * (region.max_x - region.min_x);
+        message.sub_texture.min_y = region.min_y + sub_texture.min_y * (region.max_y - region.min_y);
+        message.sub_texture.max_x = region.min_x + sub_texture.max_x * (region.max_x - region.min_x);
+        message.sub_texture.max_y = region.min_y + sub_texture.max_y * (region.max_y - region.min_y);
+    }
+    
     renderer_enqueue_message(message);
 }
 
@@ -2814,38 +7753,42 @@ ui_insert_widget(UIWidget *widget)
     global_ui_context.insertion_point->child_count += 1;
 }
 
+internal B32
+ui_is_widget_key_match(UIWidget *widget,
+                       U64 id,
+                       U64 parent_id,
+                       S8 identifier)
+{
+    return (widget->id == id &&
+            widget->parent_id == parent_id &&
+            s8_match(widget->identifier, identifier));
+}
+
 internal UIWidget *
 ui_widget_from_string(S8 identifier)
 {
     UIWidget *result = NULL;
     
-    S8List *identifier_list = NULL;
-    identifier_list = push_s8_to_list(&global_frame_memory,
-                                      identifier_list,
-                                      identifier);
-    identifier_list = push_s8_to_list(&global_frame_memory,
-                                      identifier_list,
-                                      s8_lit("\\"));
-    identifier_list = push_s8_to_list(&global_frame_memory,
-                                      identifier_list,
-                                      global_ui_context.insertion_point->key);
-    S8 _identifier = join_s8_list(&global_frame_memory, identifier_list);
-    
-    U64 index = hash_s8(_identifier,
-                        array_count(global_ui_context.widget_dict));
+    UIWidget *parent = global_ui_context.insertion_point;
+    U64 id = hash_64_from_bytes(HASH_64_SEED, &parent->id, sizeof(parent->id));
+    id = hash_64_from_bytes(id, identifier.buffer, identifier.size);
+    
+    U64 index = id & (array_count(global_ui_context.widget_dict) - 1);
     
     UIWidget *chain = global_ui_context.widget_dict + index;
     
-    if (s8_match(chain->key, _identifier))
+    if (ui_is_widget_key_match(chain, id, parent->id, identifier))
         // NOTE(tbt): matching widget directly in hash table slot
     {
         result = chain;
     }
-    else if (NULL == chain->key.buffer)
+    else if (NULL == chain->identifier.buffer)
         // NOTE(tbt): hash table slot unused
     {
         result = chain;
-        result->key = copy_s8(&global_static_memory, _identifier);
+        result->id = id;
+        result->parent_id = parent->id;
+        result->identifier = copy_s8(&global_static_memory, identifier);
     }
     else
     {
@@ -2854,7 +7797,7 @@ ui_widget_from_string(S8 identifier)
              NULL != widget;
              widget = widget->next_hash)
         {
-            if (s8_match(widget->key, _identifier))
+            if (ui_is_widget_key_match(widget, id, parent->id, identifier))
             {
                 result = widget;
                 break;
@@ -2866,7 +7809,9 @@ ui_widget_from_string(S8 identifier)
         {
             result = arena_push(&global_static_memory, sizeof(*result));
             result->next_hash = global_ui_context.widget_dict[index].next_hash;
-            result->key = copy_s8(&global_static_memory, _identifier);
+            result->id = id;
+            result->parent_id = parent->id;
+            result->identifier = copy_s8(&global_static_memory, identifier);
             global_ui_context.widget_dict[index].next_hash = result;
         }
     }
@@ -3007,40 +7952,32 @@ ui_update_widget(UIWidget *widget)
         Rect cursor, selection;
         
         F32 line_start = widget->layout.x + global_ui_context.padding;
-        F32 x = widget->layout.x + global_ui_context.padding;
-        
-        I32 font_bake_begin = widget->font->bake_begin;
-        I32 font_bake_end = widget->font->bake_end;
         
-        cursor.x = selection.x = x - cursor_width / 2;
+        cursor.x = selection.x = line_start - cursor_width / 2;
         cursor.y = selection.y = widget->layout.y + global_ui_context.padding;
         cursor.w = cursor_width;
         cursor.h = selection.h = widget->font->vertical_advance - global_ui_context.padding;
         
-        I32 i = 0;
-        for (UTF8Consume consume = consume_utf8_from_string(widget->label, i);
-             i < widget->label.size;
-             i += consume.advance, consume = consume_utf8_from_string(widget->label, i))
+        // NOTE(tbt): the label is drawn without wrapping, so this is the same run the label will be drawn with
+        TextRun *run = text_run_from_s8(widget->font, widget->label, -1);
+        if (run)
         {
-            if (consume.codepoint == '\n')
+            for (I32 i = 0;
+                 i < run->glyph_count;
+                 ++i)
             {
-                x = line_start;
-                cursor.y += widget->font->vertical_advance;
-                selection.y += widget->font->vertical_advance;
-            }
-            else if (consume.codepoint >= font_bake_begin &&
-                     consume.codepoint < font_bake_end)
-            {
-                x += widget->font->char_data[consume.codepoint - font_bake_begin].xadvance;
-                if (i == widget->cursor - 1)
+                if (run->glyphs[i].byte_index == widget->cursor - 1)
                 {
-                    cursor.x = x;
+                    cursor.x = line_start + run->glyphs[i].x_after;
                 }
-                if (i == widget->mark - 1)
+                if (run->glyphs[i].byte_index == widget->mark - 1)
                 {
-                    selection.x = x;
+                    selection.x = line_start + run->glyphs[i].x_after;
                 }
             }
+            
+            cursor.y += widget->font->vertical_advance * run->line_count;
+            selection.y += widget->font->vertical_advance * run->line_count;
         }
         selection.w = (cursor.x + cursor.w) - selection.x;
         
@@ -3067,31 +8004,74 @@ ui_update_widget(UIWidget *widget)
 internal void
 ui_measurement_pass(UIWidget *root)
 {
-    root->measure.w = root->w.dim;
-    root->measure.h = root->h.dim;
-    root->measure.children_total_w = global_ui_context.padding;
-    root->measure.children_total_h = global_ui_context.padding;
-    root->measure.children_total_w_can_loose = 0.0f;
-    root->measure.children_total_h_can_loose = 0.0f;
-    root->measure.w_can_loose = (1.0f - root->w.strictness) * root->measure.w;
-    root->measure.h_can_loose = (1.0f - root->h.strictness) * root->measure.h;
+    U64 hash = HASH_64_SEED;
+    hash = hash_64_combine(hash, u64_from_f32s(root->w.dim, root->w.strictness));
+    hash = hash_64_combine(hash, u64_from_f32s(root->h.dim, root->h.strictness));
+    hash = hash_64_combine(hash, u64_from_f32s(root->drag_x, root->drag_y));
+    hash = hash_64_combine(hash, u64_from_f32s(root->indent, root->scroll));
+    hash = hash_64_combine(hash, (root->flags & UI_WIDGET_FLAG_draggable) | ((U64)root->children_placement << 32));
     
+    root->subtree_count = 1;
     for (UIWidget *child = root->first_child;
          NULL != child;
          child = child->next_sibling)
     {
         ui_measurement_pass(child);
-        root->measure.children_total_w += child->measure.w + global_ui_context.padding + child->indent;
-        root->measure.children_total_h += child->measure.h + global_ui_context.padding;
-        root->measure.children_total_w_can_loose += child->measure.w_can_loose;
-        root->measure.children_total_h_can_loose += child->measure.h_can_loose;
+        hash = hash_64_combine(hash, child->id);
+        hash = hash_64_combine(hash, child->layout_hash);
+        root->subtree_count += child->subtree_count;
+    }
+    
+    root->is_layout_dirty = (hash != root->layout_hash);
+    root->layout_hash = hash;
+    
+    // NOTE(tbt): otherwise the measurements from last frame are still right
+    if (root->is_layout_dirty)
+    {
+        global_ui_context.measured_widget_count += 1;
+        
+        root->measure.w = root->w.dim;
+        root->measure.h = root->h.dim;
+        root->measure.children_total_w = global_ui_context.padding;
+        root->measure.children_total_h = global_ui_context.padding;
+        root->measure.children_total_w_can_loose = 0.0f;
+        root->measure.children_total_h_can_loose = 0.0f;
+        root->measure.w_can_loose = (1.0f - root->w.strictness) * root->measure.w;
+        root->measure.h_can_loose = (1.0f - root->h.strictness) * root->measure.h;
+        
+        for (UIWidget *child = root->first_child;
+             NULL != child;
+             child = child->next_sibling)
+        {
+            root->measure.children_total_w += child->measure.w + global_ui_context.padding + child->indent;
+            root->measure.children_total_h += child->measure.h + global_ui_context.padding;
+            root->measure.children_total_w_can_loose += child->measure.w_can_loose;
+            root->measure.children_total_h_can_loose += child->measure.h_can_loose;
+        }
     }
 }
 
+// NOTE(tbt): `w` and `h` are the measured size, after the parent has taken what it needs to fit its children in
 internal void
 ui_layout_pass(UIWidget *root,
-               F32 x, F32 y)
+               F32 x, F32 y,
+               F32 w, F32 h)
 {
+    Rect placement = rect(x, y, w, h);
+    Rect clip = root->parent ? root->parent->interactable : placement;
+    
+    if (!root->is_layout_dirty &&
+        rect_match(placement, root->last_placement) &&
+        rect_match(clip, root->last_clip))
+    {
+        global_ui_context.skipped_widget_count += root->subtree_count;
+        return;
+    }
+    
+    root->last_placement = placement;
+    root->last_clip = clip;
+    global_ui_context.laid_out_widget_count += 1;
+    
     x += root->indent;
     
     if (root->flags & UI_WIDGET_FLAG_draggable_x)
@@ -3103,7 +8083,7 @@ ui_layout_pass(UIWidget *root,
         y = root->parent->layout.y + root->drag_y;
     }
     
-    root->layout = rect(x, y, root->measure.w, root->measure.h);
+    root->layout = rect(x, y, w, h);
     
     y += root->scroll;
     
@@ -3134,18 +8114,19 @@ ui_layout_pass(UIWidget *root,
              NULL != child;
              child = child->next_sibling)
         {
-            child->measure.h -= child->measure.h_can_loose * proportion;
-            if (child->measure.w > root->measure.w)
+            F32 child_w = child->measure.w;
+            F32 child_h = child->measure.h - child->measure.h_can_loose * proportion;
+            if (child_w > w)
             {
-                child->measure.w -= min_f(child->measure.w - root->measure.w, child->measure.w_can_loose);
+                child_w -= min_f(child_w - w, child->measure.w_can_loose);
             }
-            ui_layout_pass(child, x, y);
+            ui_layout_pass(child, x, y, child_w, child_h);
             y += child->layout.h + global_ui_context.padding;
         }
     }
     else if (root->children_placement == UI_LAYOUT_PLACEMENT_horizontal)
     {
-        F32 to_loose = root->measure.children_total_w - root->measure.w;
+        F32 to_loose = root->measure.children_total_w - w;
         
         F32 proportion = 0.0f;
         if (root->measure.children_total_w_can_loose > 0.0f &&
@@ -3158,12 +8139,13 @@ ui_layout_pass(UIWidget *root,
              NULL != child;
              child = child->next_sibling)
         {
-            child->measure.w -= child->measure.w_can_loose * proportion;
-            if (child->measure.h > root->measure.h)
+            F32 child_w = child->measure.w - child->measure.w_can_loose * proportion;
+            F32 child_h = child->measure.h;
+            if (child_h > h)
             {
-                child->measure.h -= min_f(child->measure.h - root->measure.h, child->measure.h_can_loose);
+                child_h -= min_f(child_h - h, child->measure.h_can_loose);
             }
-            ui_layout_pass(child, x, y);
+            ui_layout_pass(child, x, y, child_w, child_h);
             x += child->layout.w + global_ui_context.padding;
         }
     }
@@ -3409,8 +8391,16 @@ ui_finish(void)
     global_ui_context.root.w = (UIDimension){ input->window_w, 1.0f };
     global_ui_context.root.h = (UIDimension){ input->window_h, 1.0f };
     ui_defered_input(input);
+    
+    global_ui_context.measured_widget_count = 0;
+    global_ui_context.laid_out_widget_count = 0;
+    global_ui_context.skipped_widget_count = 0;
+    
     ui_measurement_pass(&global_ui_context.root);
-    ui_layout_pass(&global_ui_context.root, 0.0f, 0.0f);
+    ui_layout_pass(&global_ui_context.root,
+                   0.0f, 0.0f,
+                   global_ui_context.root.measure.w,
+                   global_ui_context.root.measure.h);
     ui_render_pass(&global_ui_context.root);
 }
 
@@ -3948,145 +8938,628 @@ do_dialogue(DialogueState *dialogue_state,
                 }
             }
         }
-        else
+        else
+        {
+            dialogue_state->fade_out_transition = 0.0f;
+        }
+        
+        draw_s8(global_current_locale_config.normal_font,
+                dialogue_state->x,
+                dialogue_state->y,
+                -1,
+                col(dialogue_state->colour.r,
+                    dialogue_state->colour.g,
+                    dialogue_state->colour.b,
+                    dialogue_state->colour.a * (1.0f - dialogue_state->fade_out_transition)),
+                string_to_draw,
+                UI_SORT_DEPTH - 1,
+                global_world_projection_matrix);
+    }
+}
+
+//
+// NOTE(tbt): entities
+//~
+
+internal void
+load_player_art(void)
+{
+    global_player.art.texture.path = s8_lit("../assets/textures/player.png");
+    
+    if (load_texture(&global_player.art.texture))
+    {
+        global_player.art.forward_head = sub_texture_from_texture(&global_player.art.texture, 16.0f, 16.0f, 88.0f, 175.0f);
+        global_player.art.forward_left_arm = sub_texture_from_texture(&global_player.art.texture, 112.0f, 16.0f, 43.0f, 212.0f);
+        global_player.art.forward_right_arm = sub_texture_from_texture(&global_player.art.texture, 160.0f, 16.0f, 29.0f, 216.0f);
+        global_player.art.forward_lower_body = sub_texture_from_texture(&global_player.art.texture, 192.0f, 16.0f, 131.0f, 320.0f);
+        global_player.art.forward_torso = sub_texture_from_texture(&global_player.art.texture, 336.0f, 16.0f, 175.0f, 310.0f);
+        
+        global_player.art.left_jacket = sub_texture_from_texture(&global_player.art.texture, 16.0f, 352.0f, 110.0f, 312.0f);
+        global_player.art.left_leg = sub_texture_from_texture(&global_player.art.texture, 128.0f, 352.0f, 71.0f, 246.0f);
+        global_player.art.left_head = sub_texture_from_texture(&global_player.art.texture, 208.0f, 352.0f, 113.0f, 203.0f);
+        global_player.art.left_arm = sub_texture_from_texture(&global_player.art.texture, 464.0f, 352.0f, 42.0f, 213.0f);
+        
+        global_player.art.right_jacket = sub_texture_from_texture(&global_player.art.texture, 126.0f, 352.0f, -110.0f, 312.0f);
+        global_player.art.right_leg = sub_texture_from_texture(&global_player.art.texture, 199.0f, 352.0f, -71.0f, 246.0f);
+        global_player.art.right_head = sub_texture_from_texture(&global_player.art.texture, 336.0f, 352.0f, 113.0f, 203.0f);
+        global_player.art.right_arm = sub_texture_from_texture(&global_player.art.texture, 512.0f, 352.0f, 42.0f, 213.0f);
+    }
+    else
+    {
+        debug_log("*** could not load player art ***\n");
+    }
+}
+
+#define PLAYER_COLLISION_X  000.0f
+#define PLAYER_COLLISION_Y -155.0f
+#define PLAYER_COLLISION_W  175.0f
+#define PLAYER_COLLISION_H  605.0f
+
+internal EntityID
+allocate_and_push_entity(void)
+{
+    EntityID result;
+    
+    if (global_current_level_state.entity_free_list)
+    {
+        result = global_current_level_state.entity_free_list;
+        global_current_level_state.entity_free_list = global_entities.next[result];
+    }
+    else if (global_current_level_state.entity_next_index + 1 < MAX_ENTITIES)
+    {
+        result = ++global_current_level_state.entity_next_index;
+    }
+    else
+    {
+        result = 0;
+    }
+    
+    global_entities.bounds[result] = rect(0.0f, 0.0f, 0.0f, 0.0f);
+    global_entities.flags[result] = 0;
+    global_entities.triggers[result] = 0;
+    global_entities.query_stamp[result] = 0;
+    global_entities.next[result] = 0;
+    global_entities.prev[result] = 0;
+    global_entities.grid_bucket[result] = 0;
+    global_entities.next_in_cell[result] = 0;
+    global_entities.prev_in_cell[result] = 0;
+    global_entities.next_triggered[result] = 0;
+    
+    Entity *e = &global_entities.cold[result];
+    memset(e, 0, sizeof(*e));
+    e->teleport_to_level_path.buffer = e->teleport_to_level_path_buffer;
+    e->dialogue_path.buffer = e->dialogue_path_buffer;
+    e->editor_name.size = snprintf(e->editor_name_buffer, ENTITY_STRING_BUFFER_SIZE, "new entity");
+    e->editor_name.size = min_u(e->editor_name.size, ENTITY_STRING_BUFFER_SIZE - 1);
+    e->editor_name.buffer = e->editor_name_buffer;
+    
+    // NOTE(tbt): the dummy entity is written to, but never linked in to anything
+    if (result)
+    {
+        global_entities.list_index[result] = global_current_level_state.entity_next_list_index++;
+        
+        global_entities.prev[result] = global_current_level_state.last_entity;
+        if (global_current_level_state.last_entity)
+        {
+            global_entities.next[global_current_level_state.last_entity] = result;
+        }
+        else
+        {
+            global_current_level_state.first_entity = result;
+        }
+        global_current_level_state.last_entity = result;
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): keeps the packed list for each flag in step with the flags of an entity
+internal void
+set_entity_flags(EntityID id,
+                 EntityFlags flags)
+{
+    if (!id)
+    {
+        return;
+    }
+    
+    EntityFlags changed = global_entities.flags[id] ^ flags;
+    
+    for (EntityFlags_ENUM flag = 0;
+         flag < ENTITY_FLAG_MAX;
+         ++flag)
+    {
+        if (changed & (1 << flag))
+        {
+            EntityID *list = global_entities.flag_list[flag];
+            U32 *count = &global_current_level_state.flag_list_count[flag];
+            
+            if (flags & (1 << flag))
+            {
+                global_entities.flag_list_position[flag][id] = *count;
+                list[*count] = id;
+                *count += 1;
+            }
+            else
+            {
+                // NOTE(tbt): swap remove - the lists are unordered
+                U32 position = global_entities.flag_list_position[flag][id];
+                EntityID last = list[*count - 1];
+                list[position] = last;
+                global_entities.flag_list_position[flag][last] = position;
+                *count -= 1;
+            }
+        }
+    }
+    
+    global_entities.flags[id] = flags;
+}
+
+//-NOTE(tbt): spatial index
+
+// NOTE(tbt): entities are bucketed by the grid cell containing their top left corner, in a hash grid so that levels can be
+//            any size
+//            - an entity no bigger than a cell can only reach into the cells to the right of and below its own, so
+//              queries look one cell further up and to the left than the region they cover
+//            - anything bigger than a cell goes in the oversized bucket, which every query checks
+//            - call update_entity_in_grid whenever an entity's bounds are set or change
+
+internal U32
+entity_grid_bucket_from_cell(I32 cell_x,
+                             I32 cell_y)
+{
+    U32 hash = ((U32)cell_x * 73856093u) ^ ((U32)cell_y * 19349663u);
+    return hash & (ENTITY_GRID_BUCKETS - 1);
+}
+
+internal U32
+entity_grid_bucket_from_bounds(Rect bounds)
+{
+    U32 result;
+    
+    if (bounds.w > ENTITY_GRID_CELL_SIZE ||
+        bounds.h > ENTITY_GRID_CELL_SIZE)
+    {
+        result = ENTITY_GRID_OVERSIZED_BUCKET;
+    }
+    else
+    {
+        result = entity_grid_bucket_from_cell(floorf(bounds.x / ENTITY_GRID_CELL_SIZE),
+                                              floorf(bounds.y / ENTITY_GRID_CELL_SIZE));
+    }
+    
+    return result;
+}
+
+internal void
+remove_entity_from_grid(EntityID id)
+{
+    if (global_entities.grid_bucket[id])
+    {
+        EntityID next = global_entities.next_in_cell[id];
+        EntityID prev = global_entities.prev_in_cell[id];
+        
+        if (prev)
+        {
+            global_entities.next_in_cell[prev] = next;
+        }
+        else
+        {
+            global_current_level_state.entity_grid[global_entities.grid_bucket[id] - 1] = next;
+        }
+        
+        if (next)
+        {
+            global_entities.prev_in_cell[next] = prev;
+        }
+        
+        global_entities.next_in_cell[id] = 0;
+        global_entities.prev_in_cell[id] = 0;
+        global_entities.grid_bucket[id] = 0;
+    }
+}
+
+internal void
+update_entity_in_grid(EntityID id)
+{
+    if (!id)
+    {
+        return;
+    }
+    
+    U32 bucket = entity_grid_bucket_from_bounds(global_entities.bounds[id]);
+    
+    if (global_entities.grid_bucket[id] != bucket + 1)
+    {
+        remove_entity_from_grid(id);
+        
+        EntityID next = global_current_level_state.entity_grid[bucket];
+        global_entities.grid_bucket[id] = bucket + 1;
+        global_entities.next_in_cell[id] = next;
+        if (next)
+        {
+            global_entities.prev_in_cell[next] = id;
+        }
+        global_current_level_state.entity_grid[bucket] = id;
+    }
+}
+
+internal void
+remove_entity(EntityID id)
+{
+    if (!id)
+    {
+        return;
+    }
+    
+    remove_entity_from_grid(id);
+    set_entity_flags(id, 0);
+    
+    for (EntityID *triggered = &global_current_level_state.first_triggered_entity;
+         0 != *triggered;
+         triggered = &global_entities.next_triggered[*triggered])
+    {
+        if (*triggered == id)
+        {
+            *triggered = global_entities.next_triggered[id];
+            break;
+        }
+    }
+    
+    EntityID next = global_entities.next[id];
+    EntityID prev = global_entities.prev[id];
+    
+    if (prev)
+    {
+        global_entities.next[prev] = next;
+    }
+    else
+    {
+        global_current_level_state.first_entity = next;
+    }
+    
+    if (next)
+    {
+        global_entities.prev[next] = prev;
+    }
+    else
+    {
+        global_current_level_state.last_entity = prev;
+    }
+    
+    global_entities.next[id] = global_current_level_state.entity_free_list;
+    global_current_level_state.entity_free_list = id;
+}
+
+typedef struct
+{
+    EntityID *entities;
+    U64 count;
+    U64 capacity;
+    U32 stamp;
+} EntityQuery;
+
+internal void
+entity_query_push(MemoryArena *memory,
+                  EntityQuery *query,
+                  EntityID id)
+{
+    if (global_entities.query_stamp[id] != query->stamp)
+    {
+        global_entities.query_stamp[id] = query->stamp;
+        
+        if (query->count == query->capacity)
+        {
+            // NOTE(tbt): the old array is just left in the arena - queries are only built in short lived arenas
+            U64 capacity = max_u(query->capacity * 2, 256);
+            EntityID *entities = arena_push(memory, capacity * sizeof(entities[0]));
+            memcpy(entities, query->entities, query->count * sizeof(entities[0]));
+            query->entities = entities;
+            query->capacity = capacity;
+        }
+        
+        query->entities[query->count++] = id;
+    }
+}
+
+internal void
+entity_query_push_bucket(MemoryArena *memory,
+                         EntityQuery *query,
+                         U32 bucket,
+                         Rect region)
+{
+    for (EntityID id = global_current_level_state.entity_grid[bucket];
+         0 != id;
+         id = global_entities.next_in_cell[id])
+    {
+        if (are_rects_intersecting(global_entities.bounds[id], region))
+        {
+            entity_query_push(memory, query, id);
+        }
+    }
+}
+
+// NOTE(tbt): every entity intersecting region, in no particular order
+//            - more can be pushed with entity_query_push before sorting
+internal EntityQuery
+query_entities(MemoryArena *memory,
+               Rect region)
+{
+    EntityQuery result = {0};
+    result.stamp = ++global_current_level_state.entity_query_stamp;
+    
+    I32 cell_x0 = floorf(region.x / ENTITY_GRID_CELL_SIZE) - 1;
+    I32 cell_y0 = floorf(region.y / ENTITY_GRID_CELL_SIZE) - 1;
+    I32 cell_x1 = floorf((region.x + region.w) / ENTITY_GRID_CELL_SIZE);
+    I32 cell_y1 = floorf((region.y + region.h) / ENTITY_GRID_CELL_SIZE);
+    
+    if ((U64)(cell_x1 - cell_x0 + 1) * (U64)(cell_y1 - cell_y0 + 1) > ENTITY_GRID_BUCKETS)
+    {
+        // NOTE(tbt): covers more cells than there are buckets, so just check every bucket once
+        for (U32 bucket = 0;
+             bucket < ENTITY_GRID_BUCKETS;
+             ++bucket)
+        {
+            entity_query_push_bucket(memory, &result, bucket, region);
+        }
+    }
+    else
+    {
+        for (I32 cell_y = cell_y0;
+             cell_y <= cell_y1;
+             ++cell_y)
         {
-            dialogue_state->fade_out_transition = 0.0f;
+            for (I32 cell_x = cell_x0;
+                 cell_x <= cell_x1;
+                 ++cell_x)
+            {
+                entity_query_push_bucket(memory, &result, entity_grid_bucket_from_cell(cell_x, cell_y), region);
+            }
         }
-        
-        draw_s8(global_current_locale_config.normal_font,
-                dialogue_state->x,
-                dialogue_state->y,
-                -1,
-                col(dialogue_state->colour.r,
-                    dialogue_state->colour.g,
-                    dialogue_state->colour.b,
-                    dialogue_state->colour.a * (1.0f - dialogue_state->fade_out_transition)),
-                string_to_draw,
-                UI_SORT_DEPTH - 1,
-                global_world_projection_matrix);
     }
+    
+    entity_query_push_bucket(memory, &result, ENTITY_GRID_OVERSIZED_BUCKET, region);
+    
+    return result;
 }
 
-//
-// NOTE(tbt): entities
-//~
+internal int
+compare_entities_by_list_index(const void *a,
+                               const void *b)
+{
+    U64 a_index = global_entities.list_index[*(EntityID *)a];
+    U64 b_index = global_entities.list_index[*(EntityID *)b];
+    return (a_index > b_index) - (a_index < b_index);
+}
 
+// NOTE(tbt): puts the results back in the order of the entity list, which is the order entities are drawn and their
+//            effects are applied in
 internal void
-load_player_art(void)
+sort_entity_query(EntityQuery *query)
 {
-    global_player.art.texture.path = s8_lit("../assets/textures/player.png");
+    qsort(query->entities, query->count, sizeof(query->entities[0]), compare_entities_by_list_index);
+}
+
+// NOTE(tbt): the entities in a sorted query which have a flag, still in list order
+//            - walks whichever is shorter out of the query and the packed list for the flag, using the query stamp to
+//              check membership when walking the packed list
+internal EntityQuery
+filter_entity_query(MemoryArena *memory,
+                    EntityQuery *query,
+                    EntityFlags_ENUM flag)
+{
+    EntityQuery result = {0};
+    result.stamp = query->stamp;
     
-    if (load_texture(&global_player.art.texture))
+    U32 with_flag_count = global_current_level_state.flag_list_count[flag];
+    result.capacity = min_u(query->count, with_flag_count);
+    result.entities = arena_push(memory, result.capacity * sizeof(result.entities[0]));
+    
+    if (with_flag_count < query->count)
     {
-        global_player.art.forward_head = sub_texture_from_texture(&global_player.art.texture, 16.0f, 16.0f, 88.0f, 175.0f);
-        global_player.art.forward_left_arm = sub_texture_from_texture(&global_player.art.texture, 112.0f, 16.0f, 43.0f, 212.0f);
-        global_player.art.forward_right_arm = sub_texture_from_texture(&global_player.art.texture, 160.0f, 16.0f, 29.0f, 216.0f);
-        global_player.art.forward_lower_body = sub_texture_from_texture(&global_player.art.texture, 192.0f, 16.0f, 131.0f, 320.0f);
-        global_player.art.forward_torso = sub_texture_from_texture(&global_player.art.texture, 336.0f, 16.0f, 175.0f, 310.0f);
-        
-        global_player.art.left_jacket = sub_texture_from_texture(&global_player.art.texture, 16.0f, 352.0f, 110.0f, 312.0f);
-        global_player.art.left_leg = sub_texture_from_texture(&global_player.art.texture, 128.0f, 352.0f, 71.0f, 246.0f);
-        global_player.art.left_head = sub_texture_from_texture(&global_player.art.texture, 208.0f, 352.0f, 113.0f, 203.0f);
-        global_player.art.left_arm = sub_texture_from_texture(&global_player.art.texture, 464.0f, 352.0f, 42.0f, 213.0f);
-        
-        global_player.art.right_jacket = sub_texture_from_texture(&global_player.art.texture, 126.0f, 352.0f, -110.0f, 312.0f);
-        global_player.art.right_leg = sub_texture_from_texture(&global_player.art.texture, 199.0f, 352.0f, -71.0f, 246.0f);
-        global_player.art.right_head = sub_texture_from_texture(&global_player.art.texture, 336.0f, 352.0f, 113.0f, 203.0f);
-        global_player.art.right_arm = sub_texture_from_texture(&global_player.art.texture, 512.0f, 352.0f, 42.0f, 213.0f);
+        EntityID *with_flag = global_entities.flag_list[flag];
+        for (U32 i = 0;
+             i < with_flag_count;
+             ++i)
+        {
+            if (global_entities.query_stamp[with_flag[i]] == query->stamp)
+            {
+                result.entities[result.count++] = with_flag[i];
+            }
+        }
+        sort_entity_query(&result);
     }
     else
     {
-        debug_log("*** could not load player art ***\n");
+        for (U64 i = 0;
+             i < query->count;
+             ++i)
+        {
+            if (global_entities.flags[query->entities[i]] & (1 << flag))
+            {
+                result.entities[result.count++] = query->entities[i];
+            }
+        }
     }
+    
+    return result;
 }
 
-#define PLAYER_COLLISION_X  000.0f
-#define PLAYER_COLLISION_Y -155.0f
-#define PLAYER_COLLISION_W  175.0f
-#define PLAYER_COLLISION_H  605.0f
+internal LevelString_SERIALISABLE_V2
+push_level_string(U8 *string_table,
+                  U64 *string_table_size,
+                  S8 string)
+{
+    LevelString_SERIALISABLE_V2 result;
+    result.offset = *string_table_size;
+    result.size = string.size;
+    
+    memcpy(string_table + *string_table_size, string.buffer, string.size);
+    string_table[*string_table_size + string.size] = 0;
+    *string_table_size += string.size + 1;
+    
+    return result;
+}
 
-internal Entity *
-allocate_and_push_entity(void)
+// NOTE(tbt): the current level as a level file, allocated in `memory`
+//            - uses the frame arena for scratch
+internal S8
+s8_from_current_level(MemoryArena *memory)
 {
-    Entity *result;
+    S8 result = {0};
     
-    if (global_current_level_state.entity_free_list)
+    //-NOTE(tbt): size everything up, giving each unique texture an index in the texture table
+    U32 entity_count = 0;
+    for (EntityID id = global_current_level_state.first_entity;
+         0 != id;
+         id = global_entities.next[id])
     {
-        result = global_current_level_state.entity_free_list;
-        global_current_level_state.entity_free_list = global_current_level_state.entity_free_list->next;
+        entity_count += 1;
     }
-    else if (global_current_level_state.entity_next_index < MAX_ENTITIES)
+    
+    // NOTE(tbt): open addressed, keyed on the texture pointer - texture_from_path already gives each path one Texture
+    U64 texture_lookup_size = 1;
+    while (texture_lookup_size < entity_count * 2) { texture_lookup_size <<= 1; }
+    Texture **texture_lookup_keys = arena_push(&global_frame_memory, texture_lookup_size * sizeof(texture_lookup_keys[0]));
+    U32 *texture_lookup_values = arena_push(&global_frame_memory, texture_lookup_size * sizeof(texture_lookup_values[0]));
+    Texture **textures = arena_push(&global_frame_memory, entity_count * sizeof(textures[0]) + 1);
+    U32 texture_count = 0;
+    
+    U32 *texture_indices = arena_push(&global_frame_memory, entity_count * sizeof(texture_indices[0]) + 1);
+    U64 string_table_size = 0;
+    
+    U32 entity_index = 0;
+    for (EntityID id = global_current_level_state.first_entity;
+         0 != id;
+         id = global_entities.next[id], ++entity_index)
     {
-        result = &global_entity_pool[global_current_level_state.entity_next_index++];
+        Entity *e = &global_entities.cold[id];
+        
+        string_table_size += e->editor_name.size + 1;
+        string_table_size += e->dialogue_path.size + 1;
+        string_table_size += e->teleport_to_level_path.size + 1;
+        
+        texture_indices[entity_index] = 0;
+        if (NULL != e->texture &&
+            e->texture->path.size > 0)
+        {
+            U64 slot = ((uintptr_t)e->texture >> 4) & (texture_lookup_size - 1);
+            while (NULL != texture_lookup_keys[slot] &&
+                   e->texture != texture_lookup_keys[slot])
+            {
+                slot = (slot + 1) & (texture_lookup_size - 1);
+            }
+            
+            if (NULL == texture_lookup_keys[slot])
+            {
+                texture_lookup_keys[slot] = e->texture;
+                texture_lookup_values[slot] = texture_count;
+                textures[texture_count++] = e->texture;
+                string_table_size += e->texture->path.size + 1;
+            }
+            
+            texture_indices[entity_index] = texture_lookup_values[slot] + 1;
+        }
     }
-    else
+    
+    //-NOTE(tbt): lay out the file
+    Level_SERIALISABLE_V2 header = {0};
+    header.version = ENTITY_SERIALISATION_VERSION;
+    header.header_size = sizeof(header);
+    header.entity_size = sizeof(Entity_SERIALISABLE);
+    header.entity_count = entity_count;
+    header.texture_count = texture_count;
+    header.entity_table_offset = align_forward(sizeof(header), 16);
+    header.texture_table_offset = header.entity_table_offset + (U64)entity_count * sizeof(Entity_SERIALISABLE);
+    header.string_table_offset = header.texture_table_offset + (U64)texture_count * sizeof(LevelString_SERIALISABLE_V2);
+    header.string_table_size = string_table_size;
+    
+    result.size = header.string_table_offset + header.string_table_size;
+    result.buffer = arena_push(memory, result.size);
+    if (NULL == result.buffer)
     {
-        result = &global_dummy_entity;
+        result.size = 0;
+        return result;
     }
     
-    memset(result, 0, sizeof(*result));
-    result->teleport_to_level_path.buffer = result->teleport_to_level_path_buffer;
-    result->dialogue_path.buffer = result->dialogue_path_buffer;
-    result->editor_name.size = snprintf(result->editor_name_buffer, ENTITY_STRING_BUFFER_SIZE, "new entity");
-    result->editor_name.size = min_u(result->editor_name.size, ENTITY_STRING_BUFFER_SIZE - 1);
-    result->editor_name.buffer = result->editor_name_buffer;
+    memcpy(result.buffer, &header, sizeof(header));
     
-    if (global_current_level_state.last_entity)
+    Entity_SERIALISABLE *entity_table = (Entity_SERIALISABLE *)(result.buffer + header.entity_table_offset);
+    LevelString_SERIALISABLE_V2 *texture_table = (LevelString_SERIALISABLE_V2 *)(result.buffer + header.texture_table_offset);
+    U8 *string_table = result.buffer + header.string_table_offset;
+    U64 string_table_used = 0;
+    
+    //-NOTE(tbt): fill in the tables
+    for (U32 i = 0;
+         i < texture_count;
+         ++i)
     {
-        global_current_level_state.last_entity->next = result;
+        texture_table[i] = push_level_string(string_table, &string_table_used, textures[i]->path);
     }
-    else
+    
+    entity_index = 0;
+    for (EntityID id = global_current_level_state.first_entity;
+         0 != id;
+         id = global_entities.next[id], ++entity_index)
     {
-        global_current_level_state.first_entity = result;
+        Entity *e = &global_entities.cold[id];
+        Entity_SERIALISABLE *_e = &entity_table[entity_index];
+        
+        _e->editor_name = push_level_string(string_table, &string_table_used, e->editor_name);
+        _e->bounds = global_entities.bounds[id];
+        _e->texture_index = texture_indices[entity_index];
+        _e->draw_texture_in_fg = e->draw_texture_in_fg;
+        _e->flags = global_entities.flags[id];
+        _e->dialogue_repeat = e->dialogue_repeat;
+        _e->dialogue_x = e->dialogue_x;
+        _e->dialogue_y = e->dialogue_y;
+        _e->dialogue_path = push_level_string(string_table, &string_table_used, e->dialogue_path);
+        _e->set_exposure_mode = e->set_exposure_mode;
+        _e->set_exposure_to = e->set_exposure_to;
+        _e->teleport_to_level_path = push_level_string(string_table, &string_table_used, e->teleport_to_level_path);
+        _e->teleport_to_x = e->teleport_to_x;
+        _e->teleport_to_y = e->teleport_to_y;
+        _e->set_player_scale_to = e->set_player_scale_to;
+        _e->set_floor_gradient_to = e->set_floor_gradient_to;
+        _e->set_post_processing_kind_to = e->set_post_processing_kind_to;
     }
-    global_current_level_state.last_entity = result;
     
     return result;
 }
 
-internal void
-serialise_entity(Entity *e,
-                 PlatformFile *f)
+// NOTE(tbt): like platform_read_file_f, but from a file which has already been read in to memory
+//            - anything past the end of the file is zeroed
+internal U64
+read_from_s8(S8 file,
+             U64 offset,
+             U64 read_size,
+             void *buffer)
 {
-    Entity_SERIALISABLE _e;
-    
-    _e.bounds = e->bounds;
-    _e.flags = e->flags;
-    _e.dialogue_repeat = e->dialogue_repeat;
-    _e.dialogue_x = e->dialogue_x;
-    _e.dialogue_y = e->dialogue_y;
-    _e.set_exposure_mode = e->set_exposure_mode;
-    _e.set_exposure_to = e->set_exposure_to;
-    _e.teleport_to_x = e->teleport_to_x;
-    _e.teleport_to_y = e->teleport_to_y;
-    _e.set_player_scale_to = e->set_player_scale_to;
-    _e.set_floor_gradient_to = e->set_floor_gradient_to;
-    _e.set_post_processing_kind_to = e->set_post_processing_kind_to;
-    _e.draw_texture_in_fg = e->draw_texture_in_fg;
-    if (e->texture)
+    U64 result = 0;
+    if (offset < file.size)
     {
-        snprintf(_e.texture_path, ENTITY_STRING_BUFFER_SIZE, "%.*s", unravel_s8(e->texture->path));
+        result = min_u(read_size, file.size - offset);
+        memcpy(buffer, file.buffer + offset, result);
     }
-    snprintf(_e.editor_name, ENTITY_STRING_BUFFER_SIZE, "%.*s", unravel_s8(e->editor_name));
-    snprintf(_e.dialogue_path, ENTITY_STRING_BUFFER_SIZE, "%.*s", unravel_s8(e->dialogue_path));
-    snprintf(_e.teleport_to_level_path, ENTITY_STRING_BUFFER_SIZE, "%.*s", unravel_s8(e->teleport_to_level_path));
-    
-    platform_write_to_file_f(f, &_e, sizeof(_e));
+    memset((U8 *)buffer + result, 0, read_size - result);
+    return result;
 }
 
 internal void
 deserialise_entity(U64 version,
-                   Entity *e,
-                   PlatformFile *f,
+                   EntityID id,
+                   S8 file,
                    U64 *i)
 {
+    Entity *e = &global_entities.cold[id];
+    
     if (version == 0)
     {
         Entity_SERIALISABLE_V0 _e;
-        platform_read_file_f(f, *i, sizeof(_e), &_e);
+        read_from_s8(file, *i, sizeof(_e), &_e);
         
-        e->bounds = _e.bounds;
-        e->flags = _e.flags;
+        global_entities.bounds[id] = _e.bounds;
+        set_entity_flags(id, _e.flags);
         e->dialogue_repeat = _e.dialogue_repeat;
         e->dialogue_x = _e.dialogue_x;
         e->dialogue_y = _e.dialogue_y;
@@ -4113,10 +9586,10 @@ deserialise_entity(U64 version,
     else if (version == 1)
     {
         Entity_SERIALISABLE_V1 _e;
-        platform_read_file_f(f, *i, sizeof(_e), &_e);
+        read_from_s8(file, *i, sizeof(_e), &_e);
         
-        e->bounds = _e.bounds;
-        e->flags = _e.flags;
+        global_entities.bounds[id] = _e.bounds;
+        set_entity_flags(id, _e.flags);
         e->dialogue_repeat = _e.dialogue_repeat;
         e->dialogue_x = _e.dialogue_x;
         e->dialogue_y = _e.dialogue_y;
@@ -4146,27 +9619,245 @@ deserialise_entity(U64 version,
     }
 }
 
+// NOTE(tbt): a string from the string table of a version 2 level, pointing in to the file
+//            - empty if it runs off the end of the table
+//            - deserialise_level has already checked that the table is inside the file
+internal S8
+s8_from_level_string(S8 file,
+                     Level_SERIALISABLE_V2 *header,
+                     LevelString_SERIALISABLE_V2 string)
+{
+    S8 result = {0};
+    if (string.offset <= header->string_table_size &&
+        string.size <= header->string_table_size - string.offset)
+    {
+        result.buffer = file.buffer + header->string_table_offset + string.offset;
+        result.size = string.size;
+    }
+    return result;
+}
+
+internal void
+copy_level_string_to_entity_string(S8 *string,
+                                   U8 *buffer,
+                                   S8 source)
+{
+    string->buffer = buffer;
+    string->size = min_u(source.size, ENTITY_STRING_BUFFER_SIZE - 1);
+    memcpy(buffer, source.buffer, string->size);
+    buffer[string->size] = 0;
+}
+
+// NOTE(tbt): loads every entity from a version 2 level, reading the file in place
+internal void
+deserialise_level(S8 file)
+{
+    Level_SERIALISABLE_V2 header;
+    read_from_s8(file, 0, sizeof(header), &header);
+    if (header.header_size < sizeof(header))
+    {
+        memset((U8 *)&header + header.header_size, 0, sizeof(header) - header.header_size);
+    }
+    
+    // NOTE(tbt): offsets and sizes are compared against what is left of the file after them rather than added together,
+    //            so that a corrupt header can't wrap around
+    U64 entity_table_size = (U64)header.entity_count * (U64)header.entity_size;
+    U64 texture_table_size = (U64)header.texture_count * (U64)sizeof(LevelString_SERIALISABLE_V2);
+    if (0 == header.entity_size ||
+        header.entity_table_offset > file.size ||
+        entity_table_size > file.size - header.entity_table_offset ||
+        header.texture_table_offset > file.size ||
+        texture_table_size > file.size - header.texture_table_offset ||
+        header.string_table_offset > file.size ||
+        header.string_table_size > file.size - header.string_table_offset)
+    {
+        debug_log("level '%.*s' is truncated or corrupt\n", unravel_s8(global_current_level_state.path));
+        return;
+    }
+    
+    // NOTE(tbt): each unique texture is only looked up once
+    Texture **textures = arena_push(&global_frame_memory, header.texture_count * sizeof(textures[0]) + 1);
+    for (U32 i = 0;
+         i < header.texture_count;
+         ++i)
+    {
+        LevelString_SERIALISABLE_V2 path;
+        memcpy(&path, file.buffer + header.texture_table_offset + i * sizeof(path), sizeof(path));
+        textures[i] = texture_from_path(s8_from_level_string(file, &header, path));
+    }
+    
+    for (U32 i = 0;
+         i < header.entity_count;
+         ++i)
+    {
+        U8 *entry = file.buffer + header.entity_table_offset + (U64)i * header.entity_size;
+        
+        // NOTE(tbt): copied out rather than read in place, as entries aren't necessarily aligned in the file and may be
+        //            smaller than the current struct if they were written by an older version
+        Entity_SERIALISABLE_V2 padded;
+        memset(&padded, 0, sizeof(padded));
+        memcpy(&padded, entry, min_u(header.entity_size, sizeof(padded)));
+        Entity_SERIALISABLE_V2 *_e = &padded;
+        
+        EntityID id = allocate_and_push_entity();
+        Entity *e = &global_entities.cold[id];
+        
+        global_entities.bounds[id] = _e->bounds;
+        set_entity_flags(id, _e->flags);
+        e->dialogue_repeat = _e->dialogue_repeat;
+        e->dialogue_x = _e->dialogue_x;
+        e->dialogue_y = _e->dialogue_y;
+        e->set_exposure_mode = _e->set_exposure_mode;
+        e->set_exposure_to = _e->set_exposure_to;
+        e->teleport_to_x = _e->teleport_to_x;
+        e->teleport_to_y = _e->teleport_to_y;
+        e->set_player_scale_to = _e->set_player_scale_to;
+        e->set_floor_gradient_to = _e->set_floor_gradient_to;
+        e->set_post_processing_kind_to = _e->set_post_processing_kind_to;
+        e->draw_texture_in_fg = _e->draw_texture_in_fg;
+        
+        // NOTE(tbt): imported levels give every entity a texture, even if it is just the dummy one
+        e->texture = (_e->texture_index > 0 && _e->texture_index <= header.texture_count) ?
+            textures[_e->texture_index - 1] :
+        &global_dummy_texture;
+        
+        copy_level_string_to_entity_string(&e->editor_name, e->editor_name_buffer,
+                                           s8_from_level_string(file, &header, _e->editor_name));
+        copy_level_string_to_entity_string(&e->dialogue_path, e->dialogue_path_buffer,
+                                           s8_from_level_string(file, &header, _e->dialogue_path));
+        copy_level_string_to_entity_string(&e->teleport_to_level_path, e->teleport_to_level_path_buffer,
+                                           s8_from_level_string(file, &header, _e->teleport_to_level_path));
+        
+        update_entity_in_grid(id);
+    }
+}
+
+//
+// NOTE(tbt): level saving
+//~
+
+// NOTE(tbt): the level is snapshot in to a single buffer on the main thread, then written out by a background thread
+//            - only one save is written at a time, so starting another while one is still being written waits for it,
+//              but not for any other background work
+//            - `state` is only changed atomically, so the writer's accesses to the snapshot and the file are ordered
+//              before the main thread sees the save as finished
+
+typedef enum
+{
+    LEVEL_SAVE_STATE_idle,
+    LEVEL_SAVE_STATE_queued,  // NOTE(tbt): snapshot taken, but no thread has started writing it yet
+    LEVEL_SAVE_STATE_writing,
+} LevelSaveState;
+
+internal struct
+{
+    MemoryArena memory; // NOTE(tbt): holds the snapshot until the next save
+    U8 path_buffer[CURRENT_LEVEL_PATH_BUFFER_SIZE];
+    S8 path;
+    S8 file;
+    U32 state; // NOTE(tbt): LevelSaveState
+    B32 is_disabled; // NOTE(tbt): set for benchmark runs, which must never write to the assets
+    
+    //-NOTE(tbt): autosave
+    B32 is_autosave_enabled;
+    F32 autosave_interval; // NOTE(tbt): in seconds
+    F64 time_since_last_save; // NOTE(tbt): only counts time spent in the editor
+} global_level_save = {0};
+
+internal B32
+is_level_save_in_flight(void)
+{
+    return LEVEL_SAVE_STATE_idle != atomic_load_acquire_u32(&global_level_save.state);
+}
+
+// NOTE(tbt): writes the snapshot, unless another thread has already started to
+internal void
+try_write_level_save(void)
+{
+    if (atomic_compare_exchange_u32(&global_level_save.state, LEVEL_SAVE_STATE_queued, LEVEL_SAVE_STATE_writing))
+    {
+        platform_write_entire_file_atomic_p(global_level_save.path,
+                                            global_level_save.file.buffer,
+                                            global_level_save.file.size);
+        atomic_store_release_u32(&global_level_save.state, LEVEL_SAVE_STATE_idle);
+    }
+}
+
+// NOTE(tbt): runs on a background thread
+internal void
+write_level_save(void *data)
+{
+    try_write_level_save();
+}
+
+// NOTE(tbt): if the background thread hasn't got to the save yet, e.g. because it is still decoding level textures, the
+//            save is written here instead of waiting behind them
+internal void
+complete_level_save(void)
+{
+    try_write_level_save();
+    
+    while (is_level_save_in_flight())
+    {
+        _mm_pause();
+    }
+}
+
 internal void
 serialise_current_level(void)
 {
-    PlatformFile *f = platform_open_file_ex(global_current_level_state.path,
-                                            PLATFORM_OPEN_FILE_write);
+    if (global_current_level_state.is_benchmark)
+    {
+        debug_log("not saving %.*s - it has benchmark entities in it\n", unravel_s8(global_current_level_state.path));
+        return;
+    }
+    
+    if (global_level_save.is_disabled)
+    {
+        debug_log("not saving %.*s - level saving is disabled\n", unravel_s8(global_current_level_state.path));
+        return;
+    }
     
-    platform_write_to_file_f(f, (U64[]){ ENTITY_SERIALISATION_VERSION }, sizeof(U64));
+    complete_level_save();
     
-    for (Entity *e = global_current_level_state.first_entity;
-         NULL != e;
-         e = e->next)
+    arena_free_all(&global_level_save.memory);
+    
+    global_level_save.path.buffer = global_level_save.path_buffer;
+    global_level_save.path.size = min_u(global_current_level_state.path.size, sizeof(global_level_save.path_buffer));
+    memcpy(global_level_save.path_buffer, global_current_level_state.path.buffer, global_level_save.path.size);
+    
+    global_level_save.file = s8_from_current_level(&global_level_save.memory);
+    global_level_save.time_since_last_save = 0.0;
+    
+    if (global_level_save.file.size > 0)
     {
-        serialise_entity(e, f);
+        atomic_store_release_u32(&global_level_save.state, LEVEL_SAVE_STATE_queued);
+        platform_push_background_work(write_level_save, NULL);
     }
+}
+
+// NOTE(tbt): called every frame from the editor
+internal void
+update_level_autosave(F64 frametime_in_s)
+{
+    global_level_save.time_since_last_save += frametime_in_s;
     
-    platform_close_file(&f);
+    if (global_level_save.is_autosave_enabled &&
+        !global_current_level_state.is_benchmark &&
+        !global_level_save.is_disabled &&
+        !is_level_save_in_flight() &&
+        global_level_save.time_since_last_save >= global_level_save.autosave_interval)
+    {
+        debug_log("autosaving %.*s\n", unravel_s8(global_current_level_state.path));
+        serialise_current_level();
+    }
 }
 
 internal void
 set_current_level(S8 path)
 {
+    cancel_level_texture_streaming();
+    
     // NOTE(tbt): unload textures loaded for previous level
     for (Texture *texture = global_current_level_state.textures;
          NULL != texture;
@@ -4174,6 +9865,23 @@ set_current_level(S8 path)
     {
         unload_texture(texture);
     }
+    for (U32 i = 0;
+         i < global_current_level_state.atlas_page_count;
+         ++i)
+    {
+        // NOTE(tbt): the player art is still drawn from its page until it has been streamed into the new level's atlas
+        if (global_player.art.texture.is_in_atlas &&
+            global_player.art.texture.id == global_current_level_state.atlas_pages[i])
+        {
+            unload_unused_retired_page();
+            global_texture_streaming.retired_page = global_current_level_state.atlas_pages[i];
+        }
+        else
+        {
+            Texture page = { .id = global_current_level_state.atlas_pages[i] };
+            unload_texture(&page);
+        }
+    }
     
     // NOTE(tbt): clear current level state, saving statically allocated path buffer
     U8 *path_buffer = global_current_level_state.path.buffer;
@@ -4190,26 +9898,108 @@ set_current_level(S8 path)
     arena_free_all(&global_level_memory);
     
     // NOTE(tbt): load the new level
-    arena_temporary_memory(&global_temp_memory)
+    global_texture_streaming.start_time = platform_get_time();
+    global_current_level_state.is_deferring_texture_loads = true;
+    
+    // NOTE(tbt): levels are read in place, from the first of these which applies:
+    //            - the snapshot, if a save of the level is still being written, rather than waiting for it
+    //            - the loose file, if it has been modified since the pack was built, e.g. saved by the editor or by
+    //              autosave, so that saved edits aren't hidden by the stale copy in the pack
+    //            - the asset pack, if the level is in it
+    //            - the loose file
+    S8 file;
+    B32 is_mapped = false;
+    AssetPackEntry *entry = asset_pack_entry_from_path(global_current_level_state.path);
+    if (is_level_save_in_flight() &&
+        s8_match(global_level_save.path, global_current_level_state.path))
+    {
+        file = global_level_save.file;
+    }
+    else if (NULL != entry &&
+             ASSET_PACK_ENTRY_KIND_file == entry->kind &&
+             platform_get_file_modified_time_p(global_current_level_state.path) <= global_asset_pack.modified_time)
+    {
+        file = read_asset(&global_frame_memory, global_current_level_state.path);
+    }
+    else
+    {
+        file = platform_map_entire_file_p(global_current_level_state.path);
+        is_mapped = true;
+    }
+    
+    if (file.size > sizeof(U64))
     {
-        PlatformFile *f = platform_open_file_ex(global_current_level_state.path,
-                                                PLATFORM_OPEN_FILE_read);
-        U64 file_size = platform_get_file_size_f(f);
+        U64 entity_version;
+        read_from_s8(file, 0, sizeof(entity_version), &entity_version);
         
-        if (file_size > sizeof(U64))
+        if (entity_version >= 2)
         {
-            U64 entity_version;
-            platform_read_file_f(f, 0, sizeof(entity_version), &entity_version);
-            
+            deserialise_level(file);
+        }
+        else
+        {
+            // NOTE(tbt): import levels from before the header
             U64 i = sizeof(entity_version);
-            while (i < file_size)
+            while (i < file.size)
             {
-                Entity *e = allocate_and_push_entity();
-                deserialise_entity(entity_version, e, f, &i);
+                EntityID id = allocate_and_push_entity();
+                deserialise_entity(entity_version, id, file, &i);
+                update_entity_in_grid(id);
             }
         }
+    }
+    
+    if (is_mapped)
+    {
+        platform_unmap_file(&file);
+    }
+    
+    global_current_level_state.is_deferring_texture_loads = false;
+    global_texture_streaming.parse_time = platform_get_time() - global_texture_streaming.start_time;
+    
+    begin_streaming_level_textures();
+}
+
+// NOTE(tbt): scatters synthetic entities over a wide strip around the current level, to benchmark the entity store
+//            - most just draw the texture of the first textured entity already in the level, every tenth is a plain
+//              marker, and every hundredth is an exposure zone
+internal void
+spawn_benchmark_entities(U32 count)
+{
+    Texture *texture = NULL;
+    if (global_current_level_state.flag_list_count[ENTITY_FLAG_draw_texture])
+    {
+        texture = global_entities.cold[global_entities.flag_list[ENTITY_FLAG_draw_texture][0]].texture;
+    }
+    
+    for (U32 i = 0;
+         i < count;
+         ++i)
+    {
+        EntityID id = allocate_and_push_entity();
+        Entity *e = &global_entities.cold[id];
+        
+        global_entities.bounds[id] = rect(-50000.0f + (i % 1000) * 100.0f,
+                                          -5000.0f + (i / 1000) * 100.0f,
+                                          64.0f, 64.0f);
+        
+        e->editor_name.size = snprintf(e->editor_name_buffer, ENTITY_STRING_BUFFER_SIZE, "benchmark %u", i);
+        
+        EntityFlags flags = 0;
+        if (0 == i % 100)
+        {
+            flags = (1 << ENTITY_FLAG_set_exposure);
+            e->set_exposure_mode = SET_EXPOSURE_MODE_uniform;
+            e->set_exposure_to = 1.0f;
+        }
+        else if (0 != i % 10)
+        {
+            flags = (1 << ENTITY_FLAG_draw_texture);
+            e->texture = texture;
+        }
         
-        platform_close_file(&f);
+        set_entity_flags(id, flags);
+        update_entity_in_grid(id);
     }
 }
 
@@ -4440,72 +10230,123 @@ do_current_level(F64 frametime_in_s)
         {
             persist DialogueState dialogue_state = {0};
             
-            for (Entity *prev = NULL, *e = global_current_level_state.first_entity;
-                 NULL != e;
-                 prev = e, e = e->next)
+            // NOTE(tbt): only entities which are on screen, touching the player, or were touching the player last frame
+            //            have anything to do
+            Rect visible = renderer_get_visible_world_rect();
+            Rect player = global_player.collision_bounds;
+            F32 region_x0 = min_f(visible.x, player.x);
+            F32 region_y0 = min_f(visible.y, player.y);
+            F32 region_x1 = max_f(visible.x + visible.w, player.x + player.w);
+            F32 region_y1 = max_f(visible.y + visible.h, player.y + player.h);
+            
+            EntityQuery nearby = query_entities(&global_frame_memory,
+                                                rect(region_x0, region_y0, region_x1 - region_x0, region_y1 - region_y0));
+            for (EntityID id = global_current_level_state.first_triggered_entity;
+                 0 != id;
+                 id = global_entities.next_triggered[id])
             {
-                //
-                // NOTE(tbt): remove deleted entities
-                //
-                
-                if (e->flags & ENTITY_FLAG_marked_for_removal)
-                {
-                    if (prev)
-                    {
-                        prev->next = e->next;
-                        if (global_current_level_state.last_entity == e)
-                        {
-                            global_current_level_state.last_entity = prev;
-                        }
-                    }
-                    else
-                    {
-                        global_current_level_state.first_entity = e->next;
-                    }
-                    
-                    e->next = global_current_level_state.entity_free_list;
-                    global_current_level_state.entity_free_list = e;
-                    
+                entity_query_push(&global_frame_memory, &nearby, id);
+            }
+            sort_entity_query(&nearby);
+            
+            //
+            // NOTE(tbt): process entity triggers
+            //
+            
+            global_current_level_state.first_triggered_entity = 0;
+            
+            EntityFlags triggered_flags = ((1 << ENTITY_FLAG_teleport) |
+                                           (1 << ENTITY_FLAG_trigger_dialogue) |
+                                           (1 << ENTITY_FLAG_set_exposure) |
+                                           (1 << ENTITY_FLAG_set_player_scale) |
+                                           (1 << ENTITY_FLAG_set_floor_gradient) |
+                                           (1 << ENTITY_FLAG_set_post_processing_kind));
+            
+            for (U64 entity_index = 0;
+                 entity_index < nearby.count;
+                 ++entity_index)
+            {
+                EntityID id = nearby.entities[entity_index];
+                
+                if (!(global_entities.flags[id] & triggered_flags))
+                {
+                    global_entities.triggers[id] = 0;
                     continue;
                 }
                 
-                //
-                // NOTE(tbt): process entity triggers
-                //
+                EntityTriggers *triggers = &global_entities.triggers[id];
                 
-                if (are_rects_intersecting(e->bounds, global_player.collision_bounds))
+                if (are_rects_intersecting(global_entities.bounds[id], global_player.collision_bounds))
                 {
-                    if (e->triggers & (1 << ENTITY_TRIGGER_player_intersecting))
+                    if (*triggers & (1 << ENTITY_TRIGGER_player_intersecting))
                     {
-                        e->triggers &= ~(1 << ENTITY_TRIGGER_player_entered);
+                        *triggers &= ~(1 << ENTITY_TRIGGER_player_entered);
                     }
                     else
                     {
-                        e->triggers |= (1 << ENTITY_TRIGGER_player_entered);
-                        e->triggers |= (1 << ENTITY_TRIGGER_player_intersecting);
+                        *triggers |= (1 << ENTITY_TRIGGER_player_entered);
+                        *triggers |= (1 << ENTITY_TRIGGER_player_intersecting);
                     }
                 }
                 else
                 {
-                    if (e->triggers & (1 << ENTITY_TRIGGER_player_intersecting))
+                    if (*triggers & (1 << ENTITY_TRIGGER_player_intersecting))
                     {
-                        e->triggers |= (1 << ENTITY_TRIGGER_player_left);
-                        e->triggers &= ~(1 << ENTITY_TRIGGER_player_intersecting);
+                        *triggers |= (1 << ENTITY_TRIGGER_player_left);
+                        *triggers &= ~(1 << ENTITY_TRIGGER_player_intersecting);
                     }
                     else
                     {
-                        e->triggers &= ~(1 << ENTITY_TRIGGER_player_left);
+                        *triggers &= ~(1 << ENTITY_TRIGGER_player_left);
                     }
                 }
                 
-                //
-                // NOTE(tbt): process entity flags
-                //
-                
+                if (*triggers)
+                {
+                    global_entities.next_triggered[id] = global_current_level_state.first_triggered_entity;
+                    global_current_level_state.first_triggered_entity = id;
+                }
+            }
+            
+            //
+            // NOTE(tbt): process entity flags
+            //
+            
+            // NOTE(tbt): teleports
+            //            - go first, as changing level throws away everything the rest of the passes would look at
+            B32 teleported = false;
+            {
+                EntityQuery teleports = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_teleport);
+                for (U64 entity_index = 0;
+                     entity_index < teleports.count;
+                     ++entity_index)
+                {
+                    EntityID id = teleports.entities[entity_index];
+                    Entity *e = &global_entities.cold[id];
+                    
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_entered))
+                    {
+                        global_player.x = e->teleport_to_x;
+                        global_player.y = e->teleport_to_y;
+                        set_current_level(path_from_level_path(&global_frame_memory, e->teleport_to_level_path));
+                        teleported = true;
+                        break;
+                    }
+                }
+            }
+            
+            if (!teleported)
+            {
                 // NOTE(tbt): texture rendering
-                if (e->flags & (1 << ENTITY_FLAG_draw_texture))
+                EntityQuery textured = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_draw_texture);
+                for (U64 entity_index = 0;
+                     entity_index < textured.count;
+                     ++entity_index)
                 {
-                    draw_sub_texture(e->bounds,
+                    EntityID id = textured.entities[entity_index];
+                    Entity *e = &global_entities.cold[id];
+                    
+                    draw_sub_texture(global_entities.bounds[id],
                                      WHITE,
                                      e->texture,
                                      ENTIRE_TEXTURE,
@@ -4513,10 +10354,17 @@ do_current_level(F64 frametime_in_s)
                                      global_world_projection_matrix);
                 }
                 
-                if (e->triggers & (1 << ENTITY_TRIGGER_player_intersecting))
+                // NOTE(tbt): set exposure
+                EntityQuery exposures = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_set_exposure);
+                for (U64 entity_index = 0;
+                     entity_index < exposures.count;
+                     ++entity_index)
                 {
-                    // NOTE(tbt): set exposure
-                    if (e->flags & (1 << ENTITY_FLAG_set_exposure))
+                    EntityID id = exposures.entities[entity_index];
+                    Entity *e = &global_entities.cold[id];
+                    Rect bounds = global_entities.bounds[id];
+                    
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_intersecting))
                     {
                         F32 player_centre_x = global_player.collision_bounds.x + (global_player.collision_bounds.w / 2.0f);
                         F32 player_centre_y = global_player.collision_bounds.y + (global_player.collision_bounds.h / 2.0f);
@@ -4527,22 +10375,22 @@ do_current_level(F64 frametime_in_s)
                         {
                             case SET_EXPOSURE_MODE_fade_out_n:
                             {
-                                fade = (player_centre_y - e->bounds.y) / e->bounds.h;
+                                fade = (player_centre_y - bounds.y) / bounds.h;
                                 break;
                             }
                             case SET_EXPOSURE_MODE_fade_out_e:
                             {
-                                fade = ((e->bounds.x + e->bounds.w) - player_centre_x) / e->bounds.w;
+                                fade = ((bounds.x + bounds.w) - player_centre_x) / bounds.w;
                                 break;
                             }
                             case SET_EXPOSURE_MODE_fade_out_s:
                             {
-                                fade = ((e->bounds.y + e->bounds.h) - player_centre_y) / e->bounds.h;
+                                fade = ((bounds.y + bounds.h) - player_centre_y) / bounds.h;
                                 break;
                             }
                             case SET_EXPOSURE_MODE_fade_out_w:
                             {
-                                fade = (player_centre_x - e->bounds.x) / e->bounds.w;
+                                fade = (player_centre_x - bounds.x) / bounds.w;
                                 break;
                             }
                         }
@@ -4552,56 +10400,76 @@ do_current_level(F64 frametime_in_s)
                         global_exposure = e->set_exposure_to * fade;
                         cm_set_master_gain(fade * global_audio_master_level);
                     }
-                    
-                    // NOTE(tbt): set player scale
-                    if (e->flags & (1 << ENTITY_FLAG_set_player_scale))
-                    {
-                        global_current_level_state.player_scale = e->set_player_scale_to;
-                    }
-                    
-                    // NOTE(tbt): set floor gradient
-                    if (e->flags & (1 << ENTITY_FLAG_set_floor_gradient))
+                }
+                
+                // NOTE(tbt): set player scale
+                EntityQuery player_scales = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_set_player_scale);
+                for (U64 entity_index = 0;
+                     entity_index < player_scales.count;
+                     ++entity_index)
+                {
+                    EntityID id = player_scales.entities[entity_index];
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_intersecting))
                     {
-                        global_current_level_state.y_offset_per_x = e->set_floor_gradient_to;
+                        global_current_level_state.player_scale = global_entities.cold[id].set_player_scale_to;
                     }
-                    
-                    // NOTE(tbt): set post processing kind
-                    if (e->flags & (1 << ENTITY_FLAG_set_post_processing_kind))
+                }
+                
+                // NOTE(tbt): set floor gradient
+                EntityQuery floor_gradients = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_set_floor_gradient);
+                for (U64 entity_index = 0;
+                     entity_index < floor_gradients.count;
+                     ++entity_index)
+                {
+                    EntityID id = floor_gradients.entities[entity_index];
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_intersecting))
                     {
-                        global_current_level_state.post_processing_kind = e->set_post_processing_kind_to;
+                        global_current_level_state.y_offset_per_x = global_entities.cold[id].set_floor_gradient_to;
                     }
                 }
                 
-                // NOTE(tbt): teleports
-                if (e->flags & (1 << ENTITY_FLAG_teleport) &&
-                    e->triggers & (1 << ENTITY_TRIGGER_player_entered))
+                // NOTE(tbt): set post processing kind
+                EntityQuery post_processing_kinds = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_set_post_processing_kind);
+                for (U64 entity_index = 0;
+                     entity_index < post_processing_kinds.count;
+                     ++entity_index)
                 {
-                    global_player.x = e->teleport_to_x;
-                    global_player.y = e->teleport_to_y;
-                    set_current_level(path_from_level_path(&global_frame_memory, e->teleport_to_level_path));
-                    break;
+                    EntityID id = post_processing_kinds.entities[entity_index];
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_intersecting))
+                    {
+                        global_current_level_state.post_processing_kind = global_entities.cold[id].set_post_processing_kind_to;
+                    }
                 }
                 
                 // NOTE(tbt): dialogue
-                if (e->flags & (1 << ENTITY_FLAG_trigger_dialogue) &&
-                    e->triggers & (1 << ENTITY_TRIGGER_player_entered))
+                EntityQuery dialogues = filter_entity_query(&global_frame_memory, &nearby, ENTITY_FLAG_trigger_dialogue);
+                for (U64 entity_index = 0;
+                     entity_index < dialogues.count;
+                     ++entity_index)
                 {
-                    if (e->dialogue_repeat ||
-                        !e->dialogue_played)
+                    EntityID id = dialogues.entities[entity_index];
+                    Entity *e = &global_entities.cold[id];
+                    
+                    if (global_entities.triggers[id] & (1 << ENTITY_TRIGGER_player_entered))
                     {
-                        debug_log("playing dialogue\n");
-                        
-                        play_dialogue(&dialogue_state,
-                                      load_dialogue(&global_level_memory,
-                                                    path_from_dialogue_path(&global_frame_memory,
-                                                                            e->dialogue_path)),
-                                      e->dialogue_x, e->dialogue_y,
-                                      WHITE);
-                        
-                        e->dialogue_played = true;
+                        if (e->dialogue_repeat ||
+                            !e->dialogue_played)
+                        {
+                            debug_log("playing dialogue\n");
+                            
+                            play_dialogue(&dialogue_state,
+                                          load_dialogue(&global_level_memory,
+                                                        path_from_dialogue_path(&global_frame_memory,
+                                                                                e->dialogue_path)),
+                                          e->dialogue_x, e->dialogue_y,
+                                          WHITE);
+                            
+                            e->dialogue_played = true;
+                        }
                     }
                 }
             }
+            
             do_dialogue(&dialogue_state, frametime_in_s);
         }
     }
@@ -4618,8 +10486,10 @@ internal void
 do_level_editor(PlatformState *input,
                 F64 frametime_in_s)
 {
-    Entity *do_not_set_selection = (void *)(~0);
-    Entity *set_selection_to = do_not_set_selection;
+    EntityID do_not_set_selection = ~((EntityID)0);
+    EntityID set_selection_to = do_not_set_selection;
+    
+    update_level_autosave(frametime_in_s);
     
     ui_width(400.0f, 0.0f) ui_height(600.0f, 1.0f) ui_window(s8_lit("level editor"))
     {
@@ -4633,9 +10503,10 @@ do_level_editor(PlatformState *input,
         {
             if (ui_button(s8_lit("new entity")))
             {
-                Entity *e = allocate_and_push_entity();
-                e->bounds = rect(960.0f, 540.0f, 64.0f, 64.0f);
-                set_selection_to = e;
+                EntityID id = allocate_and_push_entity();
+                global_entities.bounds[id] = rect(960.0f, 540.0f, 64.0f, 64.0f);
+                update_entity_in_grid(id);
+                set_selection_to = id;
             }
             
             if (ui_button(s8_lit("save level")))
@@ -4647,7 +10518,7 @@ do_level_editor(PlatformState *input,
             ui_toggle_button(s8_lit("open level"), &opening_level);
             if (opening_level)
             {
-                global_editor_selected_entity = NULL;
+                global_editor_selected_entity = 0;
                 
                 ui_height(200.0f, 1.0f) ui_window(s8_lit("open level"))
                 {
@@ -4675,6 +10546,18 @@ do_level_editor(PlatformState *input,
             }
         }
         
+        ui_height(32.0f, 1.0f) ui_row()
+        {
+            ui_width(150.0f, 1.0f) ui_toggle_button(s8_lit("autosave"), &global_level_save.is_autosave_enabled);
+            if (global_level_save.is_autosave_enabled)
+            {
+                ui_h_slider_text_edit_f32(s8_lit("autosave interval"),
+                                          &global_level_save.autosave_interval,
+                                          10.0f, 600.0f,
+                                          (UIDimension){ 75.0f, 0.75f });
+            }
+        }
+        
         //
         // NOTE(tbt): entity lister
         //
@@ -4686,15 +10569,15 @@ do_level_editor(PlatformState *input,
             ui_indent(32)
             {
                 I32 entity_index = 0;
-                for (Entity *e = global_current_level_state.first_entity;
-                     NULL != e;
-                     e = e->next)
+                for (EntityID id = global_current_level_state.first_entity;
+                     0 != id;
+                     id = global_entities.next[id])
                 {
                     if (ui_button_with_id(s8_from_format_string(&global_frame_memory, "%d", entity_index++),
-                                          e->editor_name,
-                                          global_editor_selected_entity == e))
+                                          global_entities.cold[id].editor_name,
+                                          global_editor_selected_entity == id))
                     {
-                        set_selection_to = e;
+                        set_selection_to = id;
                     }
                 }
             }
@@ -4708,88 +10591,75 @@ do_level_editor(PlatformState *input,
     {
         persist F32 drag_x_offset;
         persist F32 drag_y_offset;
-        persist Entity *dragging;
-        persist Entity *resizing;
-        Entity *hot = NULL;
+        persist EntityID dragging;
+        persist EntityID resizing;
+        EntityID hot = 0;
         
-        for (Entity *prev = NULL, *e = global_current_level_state.first_entity;
-             NULL != e;
-             prev = e, e = e->next)
+        EntityQuery visible = query_entities(&global_frame_memory, renderer_get_visible_world_rect());
+        sort_entity_query(&visible);
+        
+        for (U64 entity_index = 0;
+             entity_index < visible.count;
+             ++entity_index)
         {
-            if (e->flags & (1 << ENTITY_FLAG_marked_for_removal))
-            {
-                if (prev)
-                {
-                    prev->next = e->next;
-                    if (global_current_level_state.last_entity == e)
-                    {
-                        global_current_level_state.last_entity = prev;
-                    }
-                }
-                else
-                {
-                    global_current_level_state.first_entity = e->next;
-                }
-                
-                e->next = global_current_level_state.entity_free_list;
-                global_current_level_state.entity_free_list = e;
-                
-                break;
-            }
+            EntityID id = visible.entities[entity_index];
+            Rect *bounds = &global_entities.bounds[id];
             
-            if (e->flags & (1 << ENTITY_FLAG_draw_texture))
+            if (global_entities.flags[id] & (1 << ENTITY_FLAG_draw_texture))
             {
-                draw_sub_texture(e->bounds,
+                draw_sub_texture(*bounds,
                                  WHITE,
-                                 e->texture,
+                                 global_entities.cold[id].texture,
                                  ENTIRE_TEXTURE,
                                  0,
                                  global_world_projection_matrix);
             }
             
-            stroke_rectangle(e->bounds,
+            stroke_rectangle(*bounds,
                              col(0.2f, 0.8f, 0.3f, 0.5f),
                              2.0f,
                              0, global_world_projection_matrix);
             
-            if (is_point_in_rect(MOUSE_WORLD_X, MOUSE_WORLD_Y, e->bounds) &&
+            if (is_point_in_rect(MOUSE_WORLD_X, MOUSE_WORLD_Y, *bounds) &&
                 !global_ui_context.hot)
             {
-                hot = e;
+                hot = id;
             }
             
-            if (global_editor_selected_entity == e)
+            if (global_editor_selected_entity == id)
             {
-                fill_rectangle(e->bounds,
+                fill_rectangle(*bounds,
                                col(0.2f, 0.8f, 0.3f, 0.25f),
                                0, global_world_projection_matrix);
             }
             
-            if (dragging == e)
+            if (dragging == id)
             {
-                e->bounds.x = MOUSE_WORLD_X + drag_x_offset;
-                e->bounds.y = MOUSE_WORLD_Y + drag_y_offset;
+                bounds->x = MOUSE_WORLD_X + drag_x_offset;
+                bounds->y = MOUSE_WORLD_Y + drag_y_offset;
+                update_entity_in_grid(id);
             }
             
-            if (resizing == e)
+            if (resizing == id)
             {
-                e->bounds.w = max_f(MOUSE_WORLD_X - e->bounds.x, 1.0f);
-                e->bounds.h = max_f(MOUSE_WORLD_Y - e->bounds.y, 1.0f);
+                bounds->w = max_f(MOUSE_WORLD_X - bounds->x, 1.0f);
+                bounds->h = max_f(MOUSE_WORLD_Y - bounds->y, 1.0f);
+                update_entity_in_grid(id);
             }
         }
         
         // NOTE(tbt): highlight the entity under the mouse
         if (hot)
         {
-            fill_rectangle(hot->bounds,
+            fill_rectangle(global_entities.bounds[hot],
                            col(0.2f, 0.8f, 0.3f, 0.125f),
                            0, global_world_projection_matrix);
         }
         
         if (global_ui_context.hot)
         {
-            dragging = NULL;
-            resizing = NULL;
+            dragging = 0;
+            resizing = 0;
         }
         else
         {
@@ -4804,8 +10674,8 @@ do_level_editor(PlatformState *input,
                         if (hot && global_editor_selected_entity == hot)
                         {
                             dragging = hot;
-                            drag_x_offset = hot->bounds.x - MOUSE_WORLD_X;
-                            drag_y_offset = hot->bounds.y - MOUSE_WORLD_Y;
+                            drag_x_offset = global_entities.bounds[hot].x - MOUSE_WORLD_X;
+                            drag_y_offset = global_entities.bounds[hot].y - MOUSE_WORLD_Y;
                         }
                         else
                         {
@@ -4816,34 +10686,37 @@ do_level_editor(PlatformState *input,
                     {
                         if (hot && global_editor_selected_entity == hot)
                         {
-                            dragging = NULL;
+                            dragging = 0;
                             resizing = hot;
                         }
                     }
                 }
                 else if (event->kind == PLATFORM_EVENT_key_press &&
                          event->key == KEY_delete &&
-                         NULL != global_editor_selected_entity)
+                         0 != global_editor_selected_entity)
                 {
-                    global_editor_selected_entity->flags |= (1 << ENTITY_FLAG_marked_for_removal);
-                    global_editor_selected_entity = NULL;
+                    if (dragging == global_editor_selected_entity) { dragging = 0; }
+                    if (resizing == global_editor_selected_entity) { resizing = 0; }
+                    remove_entity(global_editor_selected_entity);
+                    global_editor_selected_entity = 0;
+                    hot = 0;
                 }
             }
             
             if (!input->is_mouse_button_down[MOUSE_BUTTON_left])
             {
-                dragging = NULL;
+                dragging = 0;
             }
             
             if (!input->is_mouse_button_down[MOUSE_BUTTON_right])
             {
-                resizing = NULL;
+                resizing = 0;
             }
         }
         
         if (input->is_key_down[KEY_esc])
         {
-            set_selection_to = NULL;
+            set_selection_to = 0;
         }
         
         // NOTE(tbt): buffers for strings in entity inspector panel
@@ -4856,12 +10729,13 @@ do_level_editor(PlatformState *input,
             global_editor_selected_entity = set_selection_to;
             
             memset(texture_path_buffer, 0, sizeof(texture_path_buffer));
-            if (NULL != global_editor_selected_entity &&
-                NULL != global_editor_selected_entity->texture)
+            Texture *selected_texture = global_entities.cold[global_editor_selected_entity].texture;
+            if (0 != global_editor_selected_entity &&
+                NULL != selected_texture)
             {
-                texture_path.size = global_editor_selected_entity->texture->path.size;
+                texture_path.size = selected_texture->path.size;
                 memcpy(texture_path_buffer,
-                       global_editor_selected_entity->texture->path.buffer,
+                       selected_texture->path.buffer,
                        min_u(sizeof(texture_path_buffer), texture_path.size));
             }
         }
@@ -4872,7 +10746,10 @@ do_level_editor(PlatformState *input,
         
         if (global_editor_selected_entity)
         {
-            Entity *e = global_editor_selected_entity;
+            EntityID id = global_editor_selected_entity;
+            Entity *e = &global_entities.cold[id];
+            Rect *bounds = &global_entities.bounds[id];
+            EntityFlags flags = global_entities.flags[id];
             
             ui_width(800.0f, 0.0f) ui_height(800.0f, 1.0f) ui_window(s8_lit("entity inspector"))
             {
@@ -4893,22 +10770,22 @@ do_level_editor(PlatformState *input,
                         {
                             ui_width(column_0_w, 1.0f) ui_label(s8_lit("bounds:"));
                             ui_h_slider_f32(s8_lit("entity bounds x slider"),
-                                            &e->bounds.x,
+                                            &bounds->x,
                                             0.0f, SCREEN_W_IN_WORLD_UNITS);
                             ui_h_slider_f32(s8_lit("entity bounds y slider"),
-                                            &e->bounds.y,
+                                            &bounds->y,
                                             0.0f, SCREEN_H_IN_WORLD_UNITS);
                             ui_h_slider_f32(s8_lit("entity bounds w slider"),
-                                            &e->bounds.w,
+                                            &bounds->w,
                                             0.0f, SCREEN_W_IN_WORLD_UNITS);
                             ui_h_slider_f32(s8_lit("entity bounds h slider"),
-                                            &e->bounds.h,
+                                            &bounds->h,
                                             0.0f, SCREEN_H_IN_WORLD_UNITS);
                         }
                     }
                     
                     // NOTE(tbt): telport inspector section
-                    if (ui_bit_toggle_button(s8_lit("teleport"), &e->flags, ENTITY_FLAG_teleport))
+                    if (ui_bit_toggle_button(s8_lit("teleport"), &flags, ENTITY_FLAG_teleport))
                     {
                         ui_row()
                         {
@@ -4928,7 +10805,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): trigger dialogue inspector section
-                    if (ui_bit_toggle_button(s8_lit("trigger dialogue"), &e->flags, ENTITY_FLAG_trigger_dialogue))
+                    if (ui_bit_toggle_button(s8_lit("trigger dialogue"), &flags, ENTITY_FLAG_trigger_dialogue))
                     {
                         ui_row()
                         {
@@ -4973,7 +10850,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): draw texture inspector section
-                    if (ui_bit_toggle_button(s8_lit("draw texture"), &e->flags, ENTITY_FLAG_draw_texture))
+                    if (ui_bit_toggle_button(s8_lit("draw texture"), &flags, ENTITY_FLAG_draw_texture))
                     {
                         ui_row()
                         {
@@ -5014,7 +10891,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): set exposure inspector section
-                    if (ui_bit_toggle_button(s8_lit("set exposure"), &e->flags, ENTITY_FLAG_set_exposure))
+                    if (ui_bit_toggle_button(s8_lit("set exposure"), &flags, ENTITY_FLAG_set_exposure))
                     {
                         ui_row()
                         {
@@ -5050,7 +10927,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): set player scale inspector section
-                    if (ui_bit_toggle_button(s8_lit("set player scale"), &e->flags, ENTITY_FLAG_set_player_scale))
+                    if (ui_bit_toggle_button(s8_lit("set player scale"), &flags, ENTITY_FLAG_set_player_scale))
                     {
                         ui_row()
                         {
@@ -5060,7 +10937,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): set floor gradient player scale inspector section
-                    if (ui_bit_toggle_button(s8_lit("set floor gradient"), &e->flags, ENTITY_FLAG_set_floor_gradient))
+                    if (ui_bit_toggle_button(s8_lit("set floor gradient"), &flags, ENTITY_FLAG_set_floor_gradient))
                     {
                         ui_row()
                         {
@@ -5070,7 +10947,7 @@ do_level_editor(PlatformState *input,
                     }
                     
                     // NOTE(tbt): set post processing kind inspector section
-                    if (ui_bit_toggle_button(s8_lit("set post processing kind"), &e->flags, ENTITY_FLAG_set_post_processing_kind))
+                    if (ui_bit_toggle_button(s8_lit("set post processing kind"), &flags, ENTITY_FLAG_set_post_processing_kind))
                     {
                         ui_row()
                         {
@@ -5088,6 +10965,10 @@ do_level_editor(PlatformState *input,
                     }
                 }
             }
+            
+            // NOTE(tbt): the bounds sliders may have moved or resized it, and components may have been toggled
+            update_entity_in_grid(id);
+            set_entity_flags(id, flags);
         }
     }
 }
@@ -5106,10 +10987,10 @@ main_menu_measure_and_draw_s8(Font *font,
                               S8 text,
                               B32 centre_align)
 {
-    Rect result = measure_s32(font,
-                              x, y,
-                              wrap_width,
-                              s32_from_s8(&global_frame_memory, text));
+    Rect result = measure_s8(font,
+                             x, y,
+                             wrap_width,
+                             text);
     if (centre_align)
     {
         F32 offset = result.w / 2.0f;
@@ -5127,11 +11008,11 @@ main_menu_measure_and_draw_s8(Font *font,
 #define MAIN_MENU_BUTTON_REGION_TOLERANCE 16.0f
 
 #define MAIN_MENU_BUTTON(_text, _y, _selected_with_keyboard)                                                       \
-Rect _button_bounds = measure_s32(global_current_locale_config.normal_font,                                        \
-global_rcx.window.w / 2.0f,                                                 \
-(_y),                                                                            \
--1.0f,                                                                           \
-s32_from_s8(&global_frame_memory, (_text)));                                     \
+Rect _button_bounds = measure_s8(global_current_locale_config.normal_font,                                         \
+global_rcx.window.w / 2.0f,                                                  \
+(_y),                                                                             \
+-1.0f,                                                                            \
+(_text));                                                                         \
 persist B32 _hovered = false;                                                                                       \
 persist F32 _x_offset = 0.0f;                                                                                       \
 if (is_point_in_rect(input->mouse_x,                                                                             \
@@ -5147,12 +11028,12 @@ if (!_hovered)
 _hovered = true;                                                                                                 \
 cm_play(global_click_sound);                                                                                     \
 }                                                                                                                 \
-_x_offset = min(_x_offset + frametime_in_s * MAIN_MENU_BUTTON_SHIFT_SPEED, MAIN_MENU_BUTTON_SHIFT_AMOUNT);        \
+_x_offset = min_f(_x_offset + frametime_in_s * MAIN_MENU_BUTTON_SHIFT_SPEED, MAIN_MENU_BUTTON_SHIFT_AMOUNT);        \
 }                                                                                                                  \
 else                                                                                                               \
 {                                                                                                                  \
 _hovered = false;                                                                                                 \
-_x_offset = max(_x_offset - frametime_in_s * MAIN_MENU_BUTTON_SHIFT_SPEED, 0.0);                                  \
+_x_offset = max_f(_x_offset - frametime_in_s * MAIN_MENU_BUTTON_SHIFT_SPEED, 0.0);                                  \
 }                                                                                                                  \
 draw_s8(global_current_locale_config.normal_font,                                                                  \
 global_rcx.window.w / 2.0f - _button_bounds.w / 2.0f + _x_offset, (_y),                               \
@@ -5184,6 +11065,12 @@ do_main_menu(PlatformState *input,
         keyboard_selection = (keyboard_selection + 1) % MAIN_MENU_BUTTON_MAX;
     }
     
+    // NOTE(tbt): cycle through the locales
+    if (is_key_pressed(input, KEY_l, INPUT_MODIFIER_ctrl))
+    {
+        set_locale((global_current_locale_config.locale + 1) % LOCALE_MAX);
+    }
+    
     main_menu_measure_and_draw_s8(global_current_locale_config.title_font,
                                   global_rcx.window.w / 2.0f,
                                   300.0f,
@@ -5241,7 +11128,10 @@ void
 game_audio_callback(void *buffer,
                     U64 buffer_size)
 {
-    cm_process(buffer, buffer_size / 2);
+    profile_scope_on_thread("game_audio_callback", PROFILER_AUDIO_THREAD)
+    {
+        cm_process(buffer, buffer_size / 2);
+    }
 }
 
 //
@@ -5249,16 +11139,31 @@ game_audio_callback(void *buffer,
 //~
 
 void
-game_init(OpenGLFunctions *gl)
+game_init(OpenGLFunctions *gl,
+          PlatformFramebuffer *software_framebuffer)
 {
     // NOTE(tbt): copy OpenGLFunctions struct to global function pointers
-#define gl_func(_type, _func) gl ## _func = gl-> ## _func;
+#define gl_func(_type, _func) gl ## _func = gl->_func;
 #include "gl_funcs.h"
     
-    initialise_arena_with_new_memory(&global_static_memory, 100 * ONE_MB);
-    initialise_arena_with_new_memory(&global_frame_memory, 100 * ONE_MB);
-    initialise_arena_with_new_memory(&global_level_memory, 100 * ONE_MB);
-    initialise_arena_with_new_memory(&global_temp_memory, 100 * ONE_MB);
+    // NOTE(tbt): must be set before any textures are loaded so that CPU side copies are kept
+    global_rcx.software.framebuffer = software_framebuffer;
+    
+    // NOTE(tbt): reserving is just address space, so these are sized generously and only grow as far as they are used
+    //            - static memory is never freed, so has nothing to retain
+    //            - level memory is given back on every set_current_level
+    //            - temp memory is given back after spikes like baking a font atlas
+    //            - a level save snapshot is only freed to make room for the next one, so there is nothing to retain
+    initialise_arena_with_reserved_memory(&global_static_memory, 1 * ONE_GB, 0);
+    initialise_arena_with_reserved_memory(&global_frame_memory, 1 * ONE_GB, 4 * ONE_MB);
+    initialise_arena_with_reserved_memory(&global_level_memory, 1 * ONE_GB, 1 * ONE_MB);
+    initialise_arena_with_reserved_memory(&global_temp_memory, 1 * ONE_GB, 4 * ONE_MB);
+    initialise_arena_with_reserved_memory(&global_level_save.memory, 1 * ONE_GB, 0);
+    
+    global_level_save.is_autosave_enabled = true;
+    global_level_save.autosave_interval = 60.0f;
+    
+    load_asset_pack(s8_lit("lucerna.pack"));
     
     set_locale(LOCALE_en_gb);
     
@@ -5268,10 +11173,10 @@ game_init(OpenGLFunctions *gl)
     
     global_ui_font = load_font(&global_static_memory,
                                s8_lit("../assets/fonts/mononoki.ttf"),
-                               19,
-                               32, 255);
+                               19);
     
-    global_click_sound = cm_new_source_from_file("../assets/audio/click.wav");
+    S8 click_sound = read_asset(&global_static_memory, s8_lit("../assets/audio/click.wav"));
+    global_click_sound = cm_new_source_from_mem(click_sound.buffer, click_sound.size);
     
     memset(&global_current_level_state, 0, sizeof(global_current_level_state));
     global_current_level_state.path.buffer = arena_push(&global_static_memory, CURRENT_LEVEL_PATH_BUFFER_SIZE);
@@ -5285,6 +11190,320 @@ game_init(OpenGLFunctions *gl)
     set_camera_position(960.0f, 540.0f);
 }
 
+//
+// NOTE(tbt): profiler output
+//~
+
+internal S8
+profiler_thread_name(MemoryArena *memory,
+                     U32 thread_index)
+{
+    S8 result;
+    
+    U32 worker_count = platform_get_worker_count();
+    
+    if (0 == thread_index)
+    {
+        result = s8_lit("main");
+    }
+    else if (PROFILER_AUDIO_THREAD == thread_index)
+    {
+        result = s8_lit("audio");
+    }
+    else if (thread_index <= worker_count)
+    {
+        result = s8_from_format_string(memory, "worker %u", thread_index);
+    }
+    else
+    {
+        result = s8_from_format_string(memory, "background %u", thread_index - worker_count);
+    }
+    
+    return result;
+}
+
+// NOTE(tbt): writes everything still in the ring buffers in Chrome's trace event format
+//            - open with chrome://tracing or ui.perfetto.dev
+internal void
+write_profiler_chrome_trace(S8 path)
+{
+    U64 record_count = 0;
+    for (U32 thread_index = 0;
+         thread_index < PROFILER_MAX_THREADS;
+         ++thread_index)
+    {
+        record_count += min_u(global_profiler.threads[thread_index].record_count, PROFILER_RECORDS_PER_THREAD);
+    }
+    
+    U64 capacity = (record_count + PROFILER_MAX_THREADS + 2) * 256;
+    U8 *buffer = arena_push(&global_frame_memory, capacity);
+    U64 size = 0;
+    
+    size += snprintf(buffer + size, capacity - size, "{\"traceEvents\":[\n");
+    
+    B32 is_first = true;
+    for (U32 thread_index = 0;
+         thread_index < PROFILER_MAX_THREADS;
+         ++thread_index)
+    {
+        ProfilerThread *thread = &global_profiler.threads[thread_index];
+        U64 count = thread->record_count;
+        
+        if (0 == count) { continue; }
+        
+        S8 thread_name = profiler_thread_name(&global_frame_memory, thread_index);
+        
+        size += snprintf(buffer + size, capacity - size,
+                         "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%.*s\"}}",
+                         is_first ? "" : ",\n",
+                         thread_index,
+                         unravel_s8(thread_name));
+        is_first = false;
+        
+        for (U64 i = count - min_u(count, PROFILER_RECORDS_PER_THREAD);
+             i < count;
+             ++i)
+        {
+            ProfilerRecord *record = &thread->records[i & (PROFILER_RECORDS_PER_THREAD - 1)];
+            
+            F64 begin_in_us = profiler_seconds_from_ticks(record->begin - global_profiler.calibration_begin) * 1000000.0;
+            F64 duration_in_us = profiler_seconds_from_ticks(record->end - record->begin) * 1000000.0;
+            
+            size += snprintf(buffer + size, capacity - size,
+                             ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                             record->name,
+                             thread_index,
+                             begin_in_us,
+                             duration_in_us);
+        }
+    }
+    
+    size += snprintf(buffer + size, capacity - size, "\n]}\n");
+    
+    platform_write_entire_file_p(path, buffer, size);
+}
+
+// NOTE(tbt): draws the scopes from the previous frame along the bottom of the screen, with a lane for each thread
+//            - scopes on the background and audio threads aren't in step with frames, so are cut off at the edges
+internal void
+draw_profiler_flame_bar(void)
+{
+    if (global_profiler.frame_count < 2) { return; }
+    
+    U64 frame_begin = global_profiler.frame_begins[(global_profiler.frame_count - 2) & (PROFILER_FRAME_HISTORY - 1)];
+    U64 frame_end = global_profiler.frame_begins[(global_profiler.frame_count - 1) & (PROFILER_FRAME_HISTORY - 1)];
+    F64 frame_ticks = frame_end - frame_begin;
+    
+    F32 row_height = 22.0f;
+    F32 bar_x = 16.0f;
+    F32 bar_w = global_rcx.window.w - 32.0f;
+    F32 y = global_rcx.window.h - 16.0f;
+    
+    for (U32 thread_index = 0;
+         thread_index < PROFILER_MAX_THREADS;
+         ++thread_index)
+    {
+        ProfilerThread *thread = &global_profiler.threads[thread_index];
+        U64 count = thread->record_count;
+        U64 oldest = count - min_u(count, PROFILER_RECORDS_PER_THREAD);
+        
+        //-NOTE(tbt): find the records which overlap the frame
+        //            records are written as scopes end, so can stop as soon as one ended before the frame began
+        U64 first = count;
+        U32 max_depth = 0;
+        for (U64 i = count;
+             i > oldest;
+             --i)
+        {
+            ProfilerRecord *record = &thread->records[(i - 1) & (PROFILER_RECORDS_PER_THREAD - 1)];
+            if (record->end < frame_begin) { break; }
+            
+            first = i - 1;
+            if (record->begin < frame_end)
+            {
+                max_depth = max_u(max_depth, record->depth + 1);
+            }
+        }
+        
+        if (0 == max_depth) { continue; }
+        
+        y -= max_depth * row_height;
+        
+        //-NOTE(tbt): draw them
+        for (U64 i = first;
+             i < count;
+             ++i)
+        {
+            ProfilerRecord *record = &thread->records[i & (PROFILER_RECORDS_PER_THREAD - 1)];
+            if (record->begin >= frame_end) { continue; }
+            
+            F32 x0 = bar_x + bar_w * clamp_f((I64)(record->begin - frame_begin) / frame_ticks, 0.0, 1.0);
+            F32 x1 = bar_x + bar_w * clamp_f((I64)(record->end - frame_begin) / frame_ticks, 0.0, 1.0);
+            Rect bounds = rect(x0, y + record->depth * row_height, max_f(x1 - x0, 1.0f), row_height - 2.0f);
+            
+            S8 name = s8(record->name);
+            U64 hash = hash_s8(name, 4096);
+            Colour colour = col(0.3f + 0.4f * ((hash >> 0) & 15) / 15.0f,
+                                0.3f + 0.4f * ((hash >> 4) & 15) / 15.0f,
+                                0.3f + 0.4f * ((hash >> 8) & 15) / 15.0f,
+                                0.9f);
+            fill_rectangle(bounds, colour, UI_SORT_DEPTH, global_ui_projection_matrix);
+            
+            if (measure_s8(global_ui_font, 0.0f, 0.0f, -1, name).w < bounds.w - 4.0f)
+            {
+                draw_s8(global_ui_font,
+                        bounds.x + 2.0f, bounds.y + row_height - 6.0f,
+                        -1.0f,
+                        col(0.0f, 0.0f, 0.0f, 1.0f),
+                        name,
+                        UI_SORT_DEPTH, global_ui_projection_matrix);
+            }
+        }
+        
+        draw_s8(global_ui_font,
+                bar_x, y - 4.0f,
+                -1.0f,
+                col(1.0f, 1.0f, 1.0f, 1.0f),
+                profiler_thread_name(&global_frame_memory, thread_index),
+                UI_SORT_DEPTH, global_ui_projection_matrix);
+        
+        y -= row_height;
+    }
+    
+    draw_s8(global_ui_font,
+            bar_x, y - 4.0f,
+            -1.0f,
+            col(1.0f, 1.0f, 1.0f, 1.0f),
+            s8_from_format_string(&global_frame_memory,
+                                  "previous frame : %.3f ms",
+                                  profiler_seconds_from_ticks(frame_end - frame_begin) * 1000.0),
+            UI_SORT_DEPTH, global_ui_projection_matrix);
+}
+
+//
+// NOTE(tbt): memory telemetry
+//~
+
+// NOTE(tbt): how much of the frame arena each frame needed, recorded just before it is freed
+internal struct
+{
+    U64 last;
+    U64 peak;
+    U64 total;
+    U64 frame_count;
+} global_frame_memory_usage = {0};
+
+internal void
+record_frame_memory_usage(void)
+{
+    U64 used = global_frame_memory.current_offset;
+    global_frame_memory_usage.last = used;
+    global_frame_memory_usage.peak = max_u(global_frame_memory_usage.peak, used);
+    global_frame_memory_usage.total += used;
+    global_frame_memory_usage.frame_count += 1;
+}
+
+#ifdef LUCERNA_DEBUG
+
+internal int
+compare_arena_call_sites(const void *a,
+                         const void *b)
+{
+    U64 a_bytes = (*(ArenaCallSite **)a)->bytes;
+    U64 b_bytes = (*(ArenaCallSite **)b)->bytes;
+    return (a_bytes < b_bytes) - (a_bytes > b_bytes);
+}
+
+// NOTE(tbt): written at shutdown - the peak use of each of the global arenas against its size, and every call site which
+//            pushed to an arena, biggest first
+internal void
+write_memory_report(S8 path)
+{
+    arena_temporary_memory(&global_temp_memory)
+    {
+        ArenaCallSite **sites = arena_push(&global_temp_memory, ARENA_CALL_SITE_BUCKETS * sizeof(sites[0]));
+        U64 site_count = 0;
+        for (U64 i = 0;
+             i < ARENA_CALL_SITE_BUCKETS;
+             ++i)
+        {
+            if (global_arena_call_sites[i].key)
+            {
+                sites[site_count++] = &global_arena_call_sites[i];
+            }
+        }
+        qsort(sites, site_count, sizeof(sites[0]), compare_arena_call_sites);
+        
+        U64 capacity = (site_count + 32) * 256;
+        U8 *buffer = arena_push(&global_temp_memory, capacity);
+        U64 size = 0;
+        
+        struct
+        {
+            U8 *name;
+            MemoryArena *arena;
+        } arenas[] =
+        {
+            { "static", &global_static_memory },
+            { "frame",  &global_frame_memory  },
+            { "level",  &global_level_memory  },
+            { "temp",   &global_temp_memory   },
+        };
+        
+        size += snprintf(buffer + size, capacity - size,
+                         "%-8s %12s %12s %12s %8s\n",
+                         "arena", "size", "committed", "high water", "used");
+        for (I32 i = 0;
+             i < array_count(arenas);
+             ++i)
+        {
+            size += snprintf(buffer + size, capacity - size,
+                             "%-8s %12llu %12llu %12llu %7.2f%%\n",
+                             arenas[i].name,
+                             (unsigned long long)arenas[i].arena->buffer_size,
+                             (unsigned long long)arenas[i].arena->committed_size,
+                             (unsigned long long)arenas[i].arena->high_water_mark,
+                             100.0 * arenas[i].arena->high_water_mark / arenas[i].arena->buffer_size);
+        }
+        
+        size += snprintf(buffer + size, capacity - size,
+                         "\nframe arena per frame over %llu frames: mean %llu, peak %llu\n",
+                         (unsigned long long)global_frame_memory_usage.frame_count,
+                         (unsigned long long)(global_frame_memory_usage.frame_count ?
+                                              global_frame_memory_usage.total / global_frame_memory_usage.frame_count :
+                                              0),
+                         (unsigned long long)global_frame_memory_usage.peak);
+        
+        size += snprintf(buffer + size, capacity - size,
+                         "\n%14s %10s  %-40s %s\n",
+                         "total bytes", "pushes", "arena", "call site");
+        for (U64 i = 0;
+             i < site_count;
+             ++i)
+        {
+            size += snprintf(buffer + size, capacity - size,
+                             "%14llu %10llu  %-40s %s(%d)\n",
+                             (unsigned long long)sites[i]->bytes,
+                             (unsigned long long)sites[i]->push_count,
+                             sites[i]->arena_name,
+                             sites[i]->file,
+                             sites[i]->line);
+        }
+        
+        if (global_arena_dropped_call_sites)
+        {
+            size += snprintf(buffer + size, capacity - size,
+                             "\n%llu pushes from call sites which didn't fit in the table\n",
+                             (unsigned long long)global_arena_dropped_call_sites);
+        }
+        
+        platform_write_entire_file_p(path, buffer, size);
+        debug_log("wrote memory report to '%.*s'\n", unravel_s8(path));
+    }
+}
+
+#endif
+
 //
 // NOTE(tbt): main loop
 //~
@@ -5293,29 +11512,42 @@ void
 game_update_and_render(PlatformState *input,
                        F64 frametime_in_s)
 {
+    profiler_begin_frame();
+    
     renderer_set_window_size(input->window_w, input->window_h);
     
-    ui_prepare(input, frametime_in_s);
+    profile_scope("update_level_texture_streaming") { update_level_texture_streaming(); }
     
-    glClear(GL_COLOR_BUFFER_BIT);
+    profile_scope("ui_prepare") { ui_prepare(input, frametime_in_s); }
     
+    if (global_rcx.software.framebuffer)
+    {
+        renderer_software_clear();
+    }
+    else
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
     
     if (global_game_state == GAME_STATE_playing)
     {
 #ifdef LUCERNA_DEBUG
-        hot_reload_textures(frametime_in_s);
-        hot_reload_shaders(frametime_in_s);
+        profile_scope("hot reload")
+        {
+            hot_reload_textures(frametime_in_s);
+            hot_reload_shaders(frametime_in_s);
+        }
 #endif
-        do_current_level(frametime_in_s);
-        do_player(input, frametime_in_s);
+        profile_scope("do_current_level") { do_current_level(frametime_in_s); }
+        profile_scope("do_player") { do_player(input, frametime_in_s); }
     }
     else if (global_game_state == GAME_STATE_main_menu)
     {
-        do_main_menu(input, frametime_in_s);
+        profile_scope("do_main_menu") { do_main_menu(input, frametime_in_s); }
     }
     else if (global_game_state == GAME_STATE_editor)
     {
-        do_level_editor(input, frametime_in_s);
+        profile_scope("do_level_editor") { do_level_editor(input, frametime_in_s); }
     }
     
     //
@@ -5323,15 +11555,102 @@ game_update_and_render(PlatformState *input,
     //~
 #if defined LUCERNA_DEBUG
     
-    U8 debug_overlay_str[256];
-    snprintf(debug_overlay_str,
-             sizeof(debug_overlay_str),
-             "frametime  : %f ms (%f fps)\n"
-             "player pos : %f %f",
-             frametime_in_s * 1000.0,
-             1.0 / frametime_in_s,
-             global_player.x,
-             global_player.y);
+    U8 debug_overlay_str[2048];
+    I32 debug_overlay_str_len = snprintf(debug_overlay_str,
+                                         sizeof(debug_overlay_str),
+                                         "frametime  : %f ms (%f fps)\n"
+                                         "player pos : %f %f\n"
+                                         "draw calls : %llu\n"
+                                         "vertices   : %llu bytes uploaded, %u orphanings\n"
+                                         "instances  : %llu bytes uploaded, %u orphanings%s\n"
+                                         "text runs  : %llu hits, %llu misses\n"
+                                         "blurs      : %u passes, %u saved\n"
+                                         "targets    : %u, %.2fMB, %u allocated\n"
+                                         "ui widgets : %llu measured, %llu laid out, %llu skipped",
+                                         frametime_in_s * 1000.0,
+                                         1.0 / frametime_in_s,
+                                         global_player.x,
+                                         global_player.y,
+                                         (unsigned long long)global_rcx.last_draw_call_count,
+                                         (unsigned long long)global_rcx.vertex_stream.last_bytes_uploaded,
+                                         global_rcx.vertex_stream.last_orphan_count,
+                                         (unsigned long long)global_rcx.instance_stream.last_bytes_uploaded,
+                                         global_rcx.instance_stream.last_orphan_count,
+                                         global_rcx.is_instancing_enabled ? "" : " (instancing off)",
+                                         (unsigned long long)global_rcx.text_run_cache.last_hits,
+                                         (unsigned long long)global_rcx.text_run_cache.last_misses,
+                                         global_rcx.screen_blur.last_pass_count,
+                                         global_rcx.screen_blur.last_passes_saved,
+                                         global_rcx.render_targets.count,
+                                         global_rcx.render_targets.bytes / (F64)ONE_MB,
+                                         global_rcx.render_targets.last_allocation_count,
+                                         (unsigned long long)global_ui_context.measured_widget_count,
+                                         (unsigned long long)global_ui_context.laid_out_widget_count,
+                                         (unsigned long long)global_ui_context.skipped_widget_count);
+    
+    if (global_rcx.software.framebuffer ||
+        global_rcx.cpu_post_processing.enabled)
+    {
+        U8 *pass_names[CPU_POST_PROCESSING_PASS_MAX] =
+        {
+            [CPU_POST_PROCESSING_PASS_readback] = "readback",
+            [CPU_POST_PROCESSING_PASS_copy] = "copy",
+            [CPU_POST_PROCESSING_PASS_downsample] = "downsample",
+            [CPU_POST_PROCESSING_PASS_blur_down] = "blur down",
+            [CPU_POST_PROCESSING_PASS_blur_up] = "blur up",
+            [CPU_POST_PROCESSING_PASS_upsample] = "upsample",
+            [CPU_POST_PROCESSING_PASS_composite] = "composite",
+            [CPU_POST_PROCESSING_PASS_upload] = "upload",
+        };
+        
+        debug_overlay_str_len += snprintf(debug_overlay_str + debug_overlay_str_len,
+                                          sizeof(debug_overlay_str) - debug_overlay_str_len,
+                                          "\n\ncpu post processing (%u threads):",
+                                          platform_get_worker_count() + 1);
+        
+        for (I32 pass = 0;
+             pass < CPU_POST_PROCESSING_PASS_MAX;
+             ++pass)
+        {
+            debug_overlay_str_len += snprintf(debug_overlay_str + debug_overlay_str_len,
+                                              sizeof(debug_overlay_str) - debug_overlay_str_len,
+                                              "\n    %-16s: %f ms",
+                                              pass_names[pass],
+                                              global_rcx.cpu_post_processing.last_pass_times[pass] * 1000.0);
+        }
+    }
+    
+    RendererGpuStats *gpu_stats = renderer_get_gpu_stats();
+    if (gpu_stats->is_available)
+    {
+        U8 *kind_names[RENDER_MESSAGE_MAX] =
+        {
+            [RENDER_MESSAGE_draw_rectangle] = "rectangles",
+            [RENDER_MESSAGE_stroke_rectangle] = "strokes",
+            [RENDER_MESSAGE_draw_text] = "text",
+            [RENDER_MESSAGE_blur_screen_region] = "blur",
+            [RENDER_MESSAGE_draw_gradient] = "gradients",
+            [RENDER_MESSAGE_do_post_processing] = "post processing",
+        };
+        
+        debug_overlay_str_len += snprintf(debug_overlay_str + debug_overlay_str_len,
+                                          sizeof(debug_overlay_str) - debug_overlay_str_len,
+                                          "\n\ngpu : %f ms (%llu untimed flushes):",
+                                          gpu_stats->total_time * 1000.0,
+                                          (unsigned long long)gpu_stats->untimed_flush_count);
+        
+        for (I32 kind = 0;
+             kind < RENDER_MESSAGE_MAX;
+             ++kind)
+        {
+            debug_overlay_str_len += snprintf(debug_overlay_str + debug_overlay_str_len,
+                                              sizeof(debug_overlay_str) - debug_overlay_str_len,
+                                              "\n    %-16s: %f ms in %u passes",
+                                              kind_names[kind],
+                                              gpu_stats->pass_times[kind] * 1000.0,
+                                              gpu_stats->pass_counts[kind]);
+        }
+    }
     
     draw_s8(global_ui_font,
             16.0f, 16.0f,
@@ -5353,13 +11672,37 @@ game_update_and_render(PlatformState *input,
     {
         platform_toggle_fullscreen();
     }
+    else if (is_key_pressed(input,
+                            KEY_b,
+                            INPUT_MODIFIER_ctrl))
+    {
+        global_rcx.cpu_post_processing.enabled = !global_rcx.cpu_post_processing.enabled;
+    }
+    else if (is_key_pressed(input,
+                            KEY_i,
+                            INPUT_MODIFIER_ctrl))
+    {
+        global_rcx.is_instancing_enabled = !global_rcx.is_instancing_enabled;
+    }
+    else if (is_key_pressed(input,
+                            KEY_p,
+                            INPUT_MODIFIER_ctrl))
+    {
+        global_profiler.is_flame_bar_visible = !global_profiler.is_flame_bar_visible;
+    }
+    else if (is_key_pressed(input,
+                            KEY_t,
+                            INPUT_MODIFIER_ctrl))
+    {
+        write_profiler_chrome_trace(s8_lit("profile.json"));
+    }
     else if (is_key_pressed(input,
                             KEY_e,
                             INPUT_MODIFIER_ctrl))
     {
         if (global_game_state == GAME_STATE_editor)
         {
-            global_editor_selected_entity = NULL;
+            global_editor_selected_entity = 0;
             
             serialise_current_level();
             set_current_level(global_current_level_state.path);
@@ -5383,13 +11726,19 @@ game_update_and_render(PlatformState *input,
             col(1.0f, 0.0f, 0.0f, 1.0f),
             s8_lit("debug build"),
             UI_SORT_DEPTH, global_ui_projection_matrix);
+    
+    if (global_profiler.is_flame_bar_visible)
+    {
+        draw_profiler_flame_bar();
+    }
 #endif
     
     //
     // NOTE(tbt): finish main loop
     //~
-    ui_finish();
-    renderer_flush_message_queue();
+    profile_scope("ui_finish") { ui_finish(); }
+    profile_scope("renderer_flush_message_queue") { renderer_flush_message_queue(); }
+    record_frame_memory_usage();
     arena_free_all(&global_frame_memory);
     global_time += frametime_in_s;
 }
@@ -5401,6 +11750,47 @@ game_cleanup(void)
     {
         serialise_current_level();
     }
+    
+    // NOTE(tbt): the platform layer unloads the game after this, so nothing can still be streaming in or saving
+    platform_complete_all_background_work();
+    
+#ifdef LUCERNA_DEBUG
+    write_memory_report(s8_lit("memory_report.txt"));
+#endif
+}
+
+// NOTE(tbt): plays office_1 with synthetic entities added - see benchmarks/entities_100k.txt
+void
+game_load_benchmark_level(U32 entity_count)
+{
+    set_current_level(s8_lit("../assets/levels/office_1.level"));
+    spawn_benchmark_entities(entity_count);
+    global_current_level_state.is_benchmark = true;
+    
+    global_player.x = 960.0f;
+    global_player.y = 490.0f;
+    global_game_state = GAME_STATE_playing;
+}
+
+// NOTE(tbt): so that running the benchmarks never overwrites a level, e.g. when a scenario quits from the editor
+void
+game_disable_level_saving(void)
+{
+    global_level_save.is_disabled = true;
+}
+
+void
+game_get_stats(GameStats *stats)
+{
+    stats->static_memory_high_water_mark = global_static_memory.high_water_mark;
+    stats->frame_memory_high_water_mark = global_frame_memory.high_water_mark;
+    stats->level_memory_high_water_mark = global_level_memory.high_water_mark;
+    stats->temp_memory_high_water_mark = global_temp_memory.high_water_mark;
+    stats->draw_call_count = global_rcx.last_draw_call_count;
+    stats->blur_pass_count = global_rcx.screen_blur.last_pass_count;
+    stats->blur_passes_saved = global_rcx.screen_blur.last_passes_saved;
+    stats->render_target_bytes = global_rcx.render_targets.bytes;
+    stats->render_target_allocation_count = global_rcx.render_targets.last_allocation_count;
 }
 
 
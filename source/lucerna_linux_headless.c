@@ -0,0 +1,1661 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "lucerna_common.c"
+
+// NOTE(tbt): a platform layer with no window, no GPU and no sound card
+//            - runs the game at a fixed timestep for a set number of frames
+//            - input comes from a script of timestamped platform events, or a replay recorded with --record
+//            - OpenGL calls are stubbed out, but counted, so frame cost can be measured on CI machines
+
+internal MemoryArena global_platform_layer_frame_memory;
+internal MemoryArena global_platform_layer_static_memory;
+
+//
+// NOTE(tbt): file IO
+//~
+
+struct PlatformFile
+{
+ I32 file;
+#ifdef LUCERNA_DEBUG
+ U8 *name;
+#endif
+};
+
+PlatformFile *
+platform_open_file_ex(S8 path,
+                      PlatformOpenFileFlags flags)
+{
+ PlatformFile *result = calloc(1, sizeof(PlatformFile));
+ if (result)
+ {
+  arena_temporary_memory(&global_platform_layer_frame_memory)
+  {
+   U8 *path_cstr = cstring_from_s8(&global_platform_layer_frame_memory, path);
+   
+   I32 open_flags = 0;
+   if ((flags & PLATFORM_OPEN_FILE_read) &&
+       (flags & PLATFORM_OPEN_FILE_write))
+   {
+    open_flags |= O_RDWR;
+   }
+   else if (flags & PLATFORM_OPEN_FILE_write)
+   {
+    open_flags |= O_WRONLY;
+   }
+   else
+   {
+    open_flags |= O_RDONLY;
+   }
+   
+   // NOTE(tbt): same creation semantics as CreateFileA in the windows layer
+   if (flags & PLATFORM_OPEN_FILE_always_create)
+   {
+    open_flags |= O_CREAT | O_TRUNC;
+   }
+   else if (!(flags & PLATFORM_OPEN_FILE_never_create))
+   {
+    open_flags |= O_CREAT;
+   }
+   
+   result->file = open(path_cstr, open_flags, 0644);
+   
+   if (result->file < 0)
+   {
+    debug_log("failure opening file '%.*s' - ", unravel_s8(path));
+    perror("open");
+    free(result);
+    result = NULL;
+   }
+   else
+   {
+#ifdef LUCERNA_DEBUG
+    result->name = calloc(path.size + 1, 1);
+    memcpy(result->name, path.buffer, path.size);
+#endif
+   }
+  }
+ }
+ 
+ return result;
+}
+
+PlatformFile *
+platform_open_file(S8 path)
+{
+ return platform_open_file_ex(path, PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_write);
+}
+
+void
+platform_close_file(PlatformFile **file)
+{
+ if (file &&
+     *file)
+ {
+  close((*file)->file);
+#ifdef LUCERNA_DEBUG
+  free((*file)->name);
+#endif
+  free(*file);
+  *file = NULL;
+ }
+}
+
+U64
+platform_get_file_size_f(PlatformFile *file)
+{
+ U64 result = 0;
+ if (file)
+ {
+  struct stat file_stat;
+  if (0 == fstat(file->file, &file_stat))
+  {
+   result = file_stat.st_size;
+  }
+ }
+ return result;
+}
+
+U64
+platform_get_file_modified_time_f(PlatformFile *file)
+{
+ U64 result = 0;
+ 
+ if (file)
+ {
+  struct stat file_stat;
+  if (0 == fstat(file->file, &file_stat))
+  {
+   result = (U64)file_stat.st_mtim.tv_sec * 1000000000ull + (U64)file_stat.st_mtim.tv_nsec;
+  }
+  else
+  {
+   debug_log("failure getting last modified time for file '%s' - ", file->name);
+   perror("fstat");
+  }
+ }
+ 
+ return result;
+}
+
+S8
+platform_read_entire_file_f(MemoryArena *memory,
+                            PlatformFile *file)
+{
+ S8 result = {0};
+ 
+ if (file)
+ {
+  U64 bytes_to_read = platform_get_file_size_f(file);
+  if (bytes_to_read)
+  {
+   U8 *read_data = arena_push(memory, bytes_to_read);
+   U64 bytes_read = platform_read_file_f(file, 0, bytes_to_read, read_data);
+   
+   result.buffer = read_data;
+   result.size = bytes_read;
+   
+   if (bytes_to_read == bytes_read &&
+       read_data &&
+       bytes_read)
+   {
+    debug_log("successfully read entire file '%s'\n", file->name);
+   }
+   else
+   {
+    debug_log("failure reading entire file '%s'\n", file->name);
+   }
+  }
+  else
+  {
+   debug_log("failure reading entire file '%s' - file has no size\n", file->name);
+  }
+ }
+ 
+ return result;
+}
+
+U64
+platform_read_file_f(PlatformFile *file,
+                     U64 offset,
+                     U64 read_size,
+                     void *buffer)
+{
+ U64 bytes_read = 0;
+ 
+ if (file &&
+     buffer &&
+     read_size)
+ {
+  while (bytes_read < read_size)
+  {
+   ssize_t result = pread(file->file,
+                          (U8 *)buffer + bytes_read,
+                          read_size - bytes_read,
+                          offset + bytes_read);
+   if (result <= 0)
+   {
+    break;
+   }
+   bytes_read += result;
+  }
+  
+  if (!bytes_read)
+  {
+   debug_log("failure reading file '%s' - ", file->name);
+   perror("pread");
+  }
+  else
+  {
+   debug_log("successfully read fom file '%s'\n", file->name);
+  }
+ }
+ return bytes_read;
+}
+
+U64
+platform_write_to_file_f(PlatformFile *file,
+                         void *buffer,
+                         U64 buffer_size)
+{
+ U64 bytes_written = 0;
+ 
+ if (file &&
+     buffer &&
+     buffer_size)
+ {
+  while (bytes_written < buffer_size)
+  {
+   ssize_t result = write(file->file,
+                          (U8 *)buffer + bytes_written,
+                          buffer_size - bytes_written);
+   if (result <= 0)
+   {
+    break;
+   }
+   bytes_written += result;
+  }
+  
+  if (bytes_written != buffer_size)
+  {
+   debug_log("failure writing file '%s' - ", file->name);
+   perror("write");
+  }
+  else
+  {
+   debug_log("successfully wrote to file '%s'\n", file->name);
+  }
+ }
+ 
+ return bytes_written;
+}
+
+U64
+platform_get_file_size_p(S8 path)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ U64 result = platform_get_file_size_f(file);
+ platform_close_file(&file);
+ return result;
+}
+
+U64
+platform_get_file_modified_time_p(S8 path)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ U64 result = platform_get_file_modified_time_f(file);
+ platform_close_file(&file);
+ return result;
+}
+
+S8
+platform_read_entire_file_p(MemoryArena *memory,
+                            S8 path)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ S8 result = platform_read_entire_file_f(memory, file);
+ platform_close_file(&file);
+ return result;
+}
+
+U64
+platform_read_file_p(S8 path,
+                     U64 offset,
+                     U64 read_size,
+                     void *buffer)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ U64 result = platform_read_file_f(file, offset, read_size, buffer);
+ platform_close_file(&file);
+ return result;
+}
+
+U64
+platform_write_entire_file_p(S8 path,
+                             void *buffer,
+                             U64 buffer_size)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read |
+                                            PLATFORM_OPEN_FILE_write |
+                                            PLATFORM_OPEN_FILE_always_create);
+ U64 result = platform_write_to_file_f(file, buffer, buffer_size);
+ platform_close_file(&file);
+ return result;
+}
+
+U64
+platform_append_to_file_p(S8 path,
+                          void *buffer,
+                          U64 buffer_size)
+{
+ PlatformFile *file = platform_open_file_ex(path, PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_write);
+ if (file)
+ {
+  lseek(file->file, 0, SEEK_END);
+ }
+ U64 result = platform_write_to_file_f(file, buffer, buffer_size);
+ platform_close_file(&file);
+ return result;
+}
+
+B32
+platform_write_entire_file_atomic_p(S8 path,
+                                    void *buffer,
+                                    U64 buffer_size)
+{
+ B32 result = false;
+ 
+ I8 path_cstr[PATH_MAX];
+ I8 temporary_path_cstr[PATH_MAX];
+ if (snprintf(path_cstr, sizeof(path_cstr), "%.*s", unravel_s8(path)) < sizeof(path_cstr) &&
+     snprintf(temporary_path_cstr, sizeof(temporary_path_cstr), "%.*s.tmp", unravel_s8(path)) < sizeof(temporary_path_cstr))
+ {
+  I32 file = open(temporary_path_cstr, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file >= 0)
+  {
+   U64 bytes_written = 0;
+   while (bytes_written < buffer_size)
+   {
+    ssize_t write_result = write(file,
+                                 (U8 *)buffer + bytes_written,
+                                 buffer_size - bytes_written);
+    if (write_result <= 0)
+    {
+     break;
+    }
+    bytes_written += write_result;
+   }
+   
+   result = (bytes_written == buffer_size && 0 == fsync(file));
+   close(file);
+   
+   if (result)
+   {
+    result = (0 == rename(temporary_path_cstr, path_cstr));
+   }
+   
+   if (!result)
+   {
+    unlink(temporary_path_cstr);
+   }
+  }
+ }
+ 
+ if (result)
+ {
+  debug_log("successfully wrote to file '%s'\n", path_cstr);
+ }
+ else
+ {
+  debug_log("failure writing file '%.*s' - ", unravel_s8(path));
+  perror("platform_write_entire_file_atomic_p");
+ }
+ 
+ return result;
+}
+
+S8
+platform_map_entire_file_p(S8 path)
+{
+ S8 result = {0};
+ 
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ U64 size = platform_get_file_size_f(file);
+ if (file &&
+     size > 0)
+ {
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file->file, 0);
+  if (MAP_FAILED == mapping)
+  {
+   debug_log("failure mapping file '%.*s' - ", unravel_s8(path));
+   perror("mmap");
+  }
+  else
+  {
+   result.buffer = mapping;
+   result.size = size;
+  }
+ }
+ platform_close_file(&file);
+ 
+ return result;
+}
+
+void
+platform_unmap_file(S8 *file)
+{
+ if (file &&
+     file->buffer)
+ {
+  munmap(file->buffer, file->size);
+  file->buffer = NULL;
+  file->size = 0;
+ }
+}
+
+//
+// NOTE(tbt): stubbed OpenGL
+//~
+
+// NOTE(tbt): counters for the work the game asked the GPU to do, reset every frame
+internal struct
+{
+ U64 draw_calls;
+ U64 bytes_uploaded;
+ U32 next_name;
+ 
+ // NOTE(tbt): scratch memory handed out by glMapBufferRange
+ void *mapped_buffer;
+ U64 mapped_buffer_size;
+} global_headless_gl;
+
+internal U64
+linux_headless_bytes_per_pixel(GLenum format)
+{
+ U64 result = 4;
+ if (GL_RED == format)
+ {
+  result = 1;
+ }
+ else if (GL_RG == format)
+ {
+  result = 2;
+ }
+ else if (GL_RGB == format)
+ {
+  result = 3;
+ }
+ return result;
+}
+
+internal void
+linux_headless_gen_names(GLsizei n,
+                         GLuint *names)
+{
+ for (I32 i = 0;
+      i < n;
+      ++i)
+ {
+  global_headless_gl.next_name += 1;
+  names[i] = global_headless_gl.next_name;
+ }
+}
+
+internal void APIENTRY headless_glActiveTexture(GLenum texture) {}
+internal void APIENTRY headless_glAttachShader(GLuint program, GLuint shader) {}
+internal void APIENTRY headless_glBeginQuery(GLenum target, GLuint id) {}
+internal void APIENTRY headless_glBindBuffer(GLenum target, GLuint buffer) {}
+internal void APIENTRY headless_glBindFramebuffer(GLenum target, GLuint framebuffer) {}
+internal void APIENTRY headless_glBindTexture(GLenum target, GLuint texture) {}
+internal void APIENTRY headless_glBindVertexArray(GLuint array) {}
+internal void APIENTRY headless_glBlendFunc(GLenum sfactor, GLenum dfactor) {}
+internal void APIENTRY headless_glBlitFramebuffer(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1, GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter) {}
+internal void APIENTRY headless_glClear(GLbitfield mask) {}
+internal void APIENTRY headless_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {}
+internal void APIENTRY headless_glCompileShader(GLuint shader) {}
+internal void APIENTRY headless_glDebugMessageCallback(GLDEBUGPROC callback, const void *user_param) {}
+internal void APIENTRY headless_glDeleteBuffers(GLsizei n, const GLuint *buffers) {}
+internal void APIENTRY headless_glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers) {}
+internal void APIENTRY headless_glDeleteProgram(GLuint program) {}
+internal void APIENTRY headless_glDeleteQueries(GLsizei n, const GLuint *ids) {}
+internal void APIENTRY headless_glDeleteShader(GLuint shader) {}
+internal void APIENTRY headless_glDeleteTextures(GLsizei n, const GLuint *textures) {}
+internal void APIENTRY headless_glDeleteVertexArrays(GLsizei n, const GLuint *arrays) {}
+internal void APIENTRY headless_glDetachShader(GLuint program, GLuint shader) {}
+internal void APIENTRY headless_glDisable(GLenum cap) {}
+internal void APIENTRY headless_glEnable(GLenum cap) {}
+internal void APIENTRY headless_glEnableVertexAttribArray(GLuint index) {}
+internal void APIENTRY headless_glEndQuery(GLenum target) {}
+internal void APIENTRY headless_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {}
+internal void APIENTRY headless_glLinkProgram(GLuint program) {}
+internal void APIENTRY headless_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels) {}
+internal void APIENTRY headless_glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {}
+internal void APIENTRY headless_glShaderSource(GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length) {}
+internal void APIENTRY headless_glTexParameteri(GLenum target, GLenum pname, GLint param) {}
+internal void APIENTRY headless_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {}
+internal void APIENTRY headless_glUniform1i(GLint location, GLint v0) {}
+internal void APIENTRY headless_glUniform1f(GLint location, GLfloat v0) {}
+internal void APIENTRY headless_glUniform2f(GLint location, GLfloat v0, GLfloat v1) {}
+internal void APIENTRY headless_glUseProgram(GLuint program) {}
+internal void APIENTRY headless_glVertexAttribDivisor(GLuint index, GLuint divisor) {}
+internal void APIENTRY headless_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) {}
+internal void APIENTRY headless_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {}
+
+internal void APIENTRY headless_glGenBuffers(GLsizei n, GLuint *buffers) { linux_headless_gen_names(n, buffers); }
+internal void APIENTRY headless_glGenFramebuffers(GLsizei n, GLuint *framebuffers) { linux_headless_gen_names(n, framebuffers); }
+internal void APIENTRY headless_glGenQueries(GLsizei n, GLuint *ids) { linux_headless_gen_names(n, ids); }
+internal void APIENTRY headless_glGenTextures(GLsizei n, GLuint *textures) { linux_headless_gen_names(n, textures); }
+internal void APIENTRY headless_glGenVertexArrays(GLsizei n, GLuint *arrays) { linux_headless_gen_names(n, arrays); }
+
+internal GLuint APIENTRY headless_glCreateProgram(void) { global_headless_gl.next_name += 1; return global_headless_gl.next_name; }
+internal GLuint APIENTRY headless_glCreateShader(GLenum type) { global_headless_gl.next_name += 1; return global_headless_gl.next_name; }
+internal GLenum APIENTRY headless_glGetError(void) { return GL_NO_ERROR; }
+internal GLint APIENTRY headless_glGetUniformLocation(GLuint program, const GLchar *name) { return -1; }
+
+internal void APIENTRY headless_glGetProgramiv(GLuint program, GLenum pname, GLint *params) { *params = GL_TRUE; }
+internal void APIENTRY headless_glGetShaderiv(GLuint shader, GLenum pname, GLint *params) { *params = GL_TRUE; }
+internal void APIENTRY headless_glGetQueryObjectiv(GLuint id, GLenum pname, GLint *params) { *params = GL_TRUE; }
+internal void APIENTRY headless_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params) { *params = 0; }
+internal void APIENTRY headless_glGetShaderInfoLog(GLuint shader, GLsizei buf_size, GLsizei *length, GLchar *info_log) { if (buf_size) { info_log[0] = 0; } }
+
+internal void APIENTRY headless_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) { global_headless_gl.draw_calls += 1; }
+internal void APIENTRY headless_glDrawArrays(GLenum mode, GLint first, GLsizei count) { global_headless_gl.draw_calls += 1; }
+internal void APIENTRY headless_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint base_vertex) { global_headless_gl.draw_calls += 1; }
+internal void APIENTRY headless_glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instance_count) { global_headless_gl.draw_calls += 1; }
+
+internal void APIENTRY headless_glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) { global_headless_gl.bytes_uploaded += data ? size : 0; }
+internal void APIENTRY headless_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) { global_headless_gl.bytes_uploaded += size; }
+internal GLboolean APIENTRY headless_glUnmapBuffer(GLenum target) { return GL_TRUE; }
+
+internal void *APIENTRY
+headless_glMapBufferRange(GLenum target,
+                          GLintptr offset,
+                          GLsizeiptr length,
+                          GLbitfield access)
+{
+ if (length > global_headless_gl.mapped_buffer_size)
+ {
+  global_headless_gl.mapped_buffer = realloc(global_headless_gl.mapped_buffer, length);
+  global_headless_gl.mapped_buffer_size = length;
+ }
+ if (access & GL_MAP_WRITE_BIT)
+ {
+  global_headless_gl.bytes_uploaded += length;
+ }
+ return global_headless_gl.mapped_buffer;
+}
+
+internal void APIENTRY
+headless_glTexImage2D(GLenum target,
+                      GLint level,
+                      GLint internal_format,
+                      GLsizei width,
+                      GLsizei height,
+                      GLint border,
+                      GLenum format,
+                      GLenum type,
+                      const void *pixels)
+{
+ if (pixels)
+ {
+  global_headless_gl.bytes_uploaded += (U64)width * (U64)height * linux_headless_bytes_per_pixel(format);
+ }
+}
+
+internal void APIENTRY
+headless_glTexSubImage2D(GLenum target,
+                         GLint level,
+                         GLint x_offset,
+                         GLint y_offset,
+                         GLsizei width,
+                         GLsizei height,
+                         GLenum format,
+                         GLenum type,
+                         const void *pixels)
+{
+ global_headless_gl.bytes_uploaded += (U64)width * (U64)height * linux_headless_bytes_per_pixel(format);
+}
+
+internal void
+linux_headless_load_all_opengl_functions(OpenGLFunctions *result)
+{
+#define gl_func(_type, _name) result->_name = headless_gl ## _name
+#include "gl_funcs.h"
+}
+
+PlatformState global_platform_state = {0};
+internal volatile B32 global_running = true;
+
+internal PlatformFramebuffer global_software_framebuffer = {0};
+
+internal GameInit game_init;
+internal GameUpdateAndRender game_update_and_render;
+internal GameAudioCallback game_audio_callback;
+internal GameCleanup game_cleanup;
+
+//
+// NOTE(tbt): clipboard
+//~
+
+// NOTE(tbt): there is no system clipboard, so just keep a copy in the platform layer
+internal S8 global_clipboard = {0};
+
+void
+platform_set_clipboard_text(S8 text)
+{
+ free(global_clipboard.buffer);
+ global_clipboard.buffer = malloc(text.size);
+ global_clipboard.size = text.size;
+ memcpy(global_clipboard.buffer, text.buffer, text.size);
+}
+
+S8
+platform_get_clipboard_text(MemoryArena *memory)
+{
+ return copy_s8(memory, global_clipboard);
+}
+
+//
+// NOTE(tbt): platform layer utilities
+//~
+
+void
+platform_set_vsync(B32 enabled)
+{
+ // NOTE(tbt): nothing to synchronise with - frames are run back to back
+}
+
+void
+platform_toggle_fullscreen(void)
+{
+ // NOTE(tbt): no window
+}
+
+F64
+platform_get_time(void)
+{
+ struct timespec now;
+ clock_gettime(CLOCK_MONOTONIC, &now);
+ return (F64)now.tv_sec + (F64)now.tv_nsec / 1000000000.0;
+}
+
+void
+platform_quit(void)
+{
+ platform_audio_critical_section
+ {
+  global_running = false;
+ }
+}
+
+//
+// NOTE(tbt): audio
+//~
+
+internal pthread_mutex_t global_audio_lock;
+
+void
+platform_get_audio_lock(void)
+{
+ pthread_mutex_lock(&global_audio_lock);
+}
+
+void
+platform_release_audio_lock(void)
+{
+ pthread_mutex_unlock(&global_audio_lock);
+}
+
+//
+// NOTE(tbt): worker threads
+//~
+
+#define LINUX_HEADLESS_MAX_WORKERS 31
+#define LINUX_HEADLESS_BACKGROUND_WORKERS 2
+#define LINUX_HEADLESS_WORK_QUEUE_SIZE 256
+
+typedef struct
+{
+ PlatformWorkFunction function;
+ void *data;
+} LinuxHeadlessWorkEntry;
+
+// NOTE(tbt): single producer, multiple consumer ring buffer
+typedef struct
+{
+ LinuxHeadlessWorkEntry entries[LINUX_HEADLESS_WORK_QUEUE_SIZE];
+ volatile U32 next_entry_to_write;
+ volatile U32 next_entry_to_read;
+ volatile U32 completion_goal;
+ volatile U32 completion_count;
+ sem_t semaphore;
+ U32 worker_count;
+} LinuxHeadlessWorkQueue;
+
+internal LinuxHeadlessWorkQueue global_work_queue;
+internal LinuxHeadlessWorkQueue global_background_work_queue;
+
+internal __thread U32 global_thread_index = 0;
+
+// NOTE(tbt): returns true if there was nothing to do
+internal B32
+linux_headless_do_next_work_entry(LinuxHeadlessWorkQueue *queue)
+{
+ B32 result = false;
+ 
+ U32 original_next_entry_to_read = __atomic_load_n(&queue->next_entry_to_read, __ATOMIC_ACQUIRE);
+ U32 new_next_entry_to_read = (original_next_entry_to_read + 1) % LINUX_HEADLESS_WORK_QUEUE_SIZE;
+ 
+ if (original_next_entry_to_read != __atomic_load_n(&queue->next_entry_to_write, __ATOMIC_ACQUIRE))
+ {
+  // NOTE(tbt): the entry is read before the CAS, which hands its slot back to the producer to be overwritten
+  //            - only used if the CAS succeeds, in which case nobody can have written to the slot since it was read
+  LinuxHeadlessWorkEntry *slot = &queue->entries[original_next_entry_to_read];
+  PlatformWorkFunction function = __atomic_load_n(&slot->function, __ATOMIC_RELAXED);
+  void *data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+  
+  if (__atomic_compare_exchange_n(&queue->next_entry_to_read,
+                                  &original_next_entry_to_read,
+                                  new_next_entry_to_read,
+                                  false,
+                                  __ATOMIC_ACQ_REL,
+                                  __ATOMIC_ACQUIRE))
+  {
+   function(data);
+   __atomic_add_fetch(&queue->completion_count, 1, __ATOMIC_ACQ_REL);
+  }
+ }
+ else
+ {
+  result = true;
+ }
+ 
+ return result;
+}
+
+internal void *
+linux_headless_worker_thread_main(void *arg)
+{
+ global_thread_index = (U32)(uintptr_t)arg;
+ 
+ LinuxHeadlessWorkQueue *queue = global_thread_index > global_work_queue.worker_count ? &global_background_work_queue : &global_work_queue;
+ 
+ for (;;)
+ {
+  if (linux_headless_do_next_work_entry(queue))
+  {
+   sem_wait(&queue->semaphore);
+  }
+ }
+ 
+ return NULL;
+}
+
+internal void
+linux_headless_start_workers(U32 worker_count)
+{
+ global_work_queue.worker_count = min_u(worker_count, LINUX_HEADLESS_MAX_WORKERS);
+ global_background_work_queue.worker_count = LINUX_HEADLESS_BACKGROUND_WORKERS;
+ 
+ sem_init(&global_work_queue.semaphore, 0, 0);
+ sem_init(&global_background_work_queue.semaphore, 0, 0);
+ 
+ // NOTE(tbt): background workers are numbered after the normal workers
+ for (U32 i = 0;
+      i < global_work_queue.worker_count + global_background_work_queue.worker_count;
+      ++i)
+ {
+  pthread_t thread;
+  pthread_create(&thread, NULL, linux_headless_worker_thread_main, (void *)(uintptr_t)(i + 1));
+  pthread_detach(thread);
+ }
+}
+
+internal void
+linux_headless_push_work(LinuxHeadlessWorkQueue *queue,
+                         PlatformWorkFunction function,
+                         void *data)
+{
+ U32 next_entry_to_write = queue->next_entry_to_write;
+ U32 new_next_entry_to_write = (next_entry_to_write + 1) % LINUX_HEADLESS_WORK_QUEUE_SIZE;
+ 
+ // NOTE(tbt): if the queue is full, or there is nobody to hand the work to, just do it now
+ if (new_next_entry_to_write == __atomic_load_n(&queue->next_entry_to_read, __ATOMIC_ACQUIRE) ||
+     0 == queue->worker_count)
+ {
+  function(data);
+  return;
+ }
+ 
+ __atomic_store_n(&queue->entries[next_entry_to_write].function, function, __ATOMIC_RELAXED);
+ __atomic_store_n(&queue->entries[next_entry_to_write].data, data, __ATOMIC_RELAXED);
+ queue->completion_goal += 1;
+ 
+ __atomic_store_n(&queue->next_entry_to_write, new_next_entry_to_write, __ATOMIC_RELEASE);
+ sem_post(&queue->semaphore);
+}
+
+internal void
+linux_headless_complete_all_work(LinuxHeadlessWorkQueue *queue)
+{
+ while (queue->completion_goal != __atomic_load_n(&queue->completion_count, __ATOMIC_ACQUIRE))
+ {
+  linux_headless_do_next_work_entry(queue);
+ }
+ 
+ queue->completion_goal = 0;
+ __atomic_store_n(&queue->completion_count, 0, __ATOMIC_RELEASE);
+}
+
+void
+platform_push_work(PlatformWorkFunction function,
+                   void *data)
+{
+ linux_headless_push_work(&global_work_queue, function, data);
+}
+
+void
+platform_complete_all_work(void)
+{
+ linux_headless_complete_all_work(&global_work_queue);
+}
+
+void
+platform_push_background_work(PlatformWorkFunction function,
+                              void *data)
+{
+ linux_headless_push_work(&global_background_work_queue, function, data);
+}
+
+B32
+platform_is_background_work_complete(void)
+{
+ return global_background_work_queue.completion_goal == __atomic_load_n(&global_background_work_queue.completion_count, __ATOMIC_ACQUIRE);
+}
+
+void
+platform_complete_all_background_work(void)
+{
+ linux_headless_complete_all_work(&global_background_work_queue);
+}
+
+U32
+platform_get_worker_count(void)
+{
+ return global_work_queue.worker_count;
+}
+
+U32
+platform_get_thread_index(void)
+{
+ return global_thread_index;
+}
+
+//
+// NOTE(tbt): event scripts
+//~
+
+// NOTE(tbt): an event script is a text file with one event per line, in frame order:
+//            <frame> mouse_move <x> <y>
+//            <frame> key_press <key> [modifiers]
+//            <frame> key_release <key> [modifiers]
+//            <frame> key_typed <character>
+//            <frame> mouse_press <left|middle|right> <x> <y> [modifiers]
+//            <frame> mouse_release <left|middle|right> <x> <y> [modifiers]
+//            <frame> mouse_scroll <h> <v>
+//            <frame> window_resize <w> <h>
+//            <frame> benchmark_entities <count>
+//            <frame> quit
+//            where modifiers are any of ctrl, shift and alt joined with '+' and keys are named as in keys.h
+//            blank lines and lines beginning with '#' are ignored
+
+typedef struct ScriptedEvent ScriptedEvent;
+struct ScriptedEvent
+{
+ ScriptedEvent *next;
+ U64 frame;
+ B32 is_quit;
+ U32 benchmark_entity_count; // NOTE(tbt): loads the benchmark level with this many synthetic entities if not 0
+ PlatformEvent event;
+};
+
+internal struct
+{
+ S8 name;
+ Key key;
+} global_key_names[] =
+{
+#define key(_name) { { #_name, sizeof(#_name) - 1 }, KEY_ ## _name },
+#include "keys.h"
+};
+
+internal void
+linux_headless_push_platform_event(PlatformEvent event)
+{
+ PlatformEvent *_event = arena_push(&global_platform_layer_frame_memory, sizeof(*_event));
+ *_event = event;
+ 
+ _event->next = global_platform_state.events;
+ global_platform_state.events = _event;
+}
+
+#include "platform_events.h"
+
+internal S8
+linux_headless_consume_token(S8 *line)
+{
+ S8 result = {0};
+ 
+ U32 i = 0;
+ while (i < line->size && is_char_space(line->buffer[i])) { i += 1; }
+ 
+ result.buffer = line->buffer + i;
+ while (i < line->size && !is_char_space(line->buffer[i])) { i += 1; result.size += 1; }
+ 
+ line->buffer += i;
+ line->size -= i;
+ 
+ return result;
+}
+
+internal Key
+linux_headless_key_from_s8(S8 name)
+{
+ for (I32 i = 0;
+      i < sizeof(global_key_names) / sizeof(global_key_names[0]);
+      ++i)
+ {
+  if (s8_match(name, global_key_names[i].name))
+  {
+   return global_key_names[i].key;
+  }
+ }
+ debug_log("unknown key '%.*s' in event script\n", unravel_s8(name));
+ return KEY_none;
+}
+
+internal MouseButton
+linux_headless_mouse_button_from_s8(S8 name)
+{
+ MouseButton result = MOUSE_BUTTON_left;
+ if (s8_match(name, s8_lit("middle")))
+ {
+  result = MOUSE_BUTTON_middle;
+ }
+ else if (s8_match(name, s8_lit("right")))
+ {
+  result = MOUSE_BUTTON_right;
+ }
+ return result;
+}
+
+internal InputModifiers
+linux_headless_modifiers_from_s8(S8 string)
+{
+ InputModifiers result = 0;
+ 
+ while (string.size)
+ {
+  S8 modifier = string;
+  modifier.size = 0;
+  while (modifier.size < string.size && string.buffer[modifier.size] != '+') { modifier.size += 1; }
+  
+  if (s8_match(modifier, s8_lit("ctrl")))
+  {
+   result |= INPUT_MODIFIER_ctrl;
+  }
+  else if (s8_match(modifier, s8_lit("shift")))
+  {
+   result |= INPUT_MODIFIER_shift;
+  }
+  else if (s8_match(modifier, s8_lit("alt")))
+  {
+   result |= INPUT_MODIFIER_alt;
+  }
+  
+  U32 advance = min_u(modifier.size + 1, string.size);
+  string.buffer += advance;
+  string.size -= advance;
+ }
+ 
+ return result;
+}
+
+internal ScriptedEvent *
+linux_headless_load_event_script(MemoryArena *memory,
+                                 S8 path)
+{
+ ScriptedEvent *result = NULL;
+ ScriptedEvent **last = &result;
+ 
+ S8 file = platform_read_entire_file_p(memory, path);
+ 
+ U32 line_number = 0;
+ while (file.size)
+ {
+  S8 line = file;
+  line.size = 0;
+  while (line.size < file.size && file.buffer[line.size] != '\n') { line.size += 1; }
+  
+  U32 advance = min_u(line.size + 1, file.size);
+  file.buffer += advance;
+  file.size -= advance;
+  line_number += 1;
+  
+  S8 frame = linux_headless_consume_token(&line);
+  if (0 == frame.size ||
+      '#' == frame.buffer[0])
+  {
+   continue;
+  }
+  
+  ScriptedEvent *scripted = arena_push(memory, sizeof(*scripted));
+  scripted->frame = f64_from_s8(frame);
+  
+  S8 kind = linux_headless_consume_token(&line);
+  if (s8_match(kind, s8_lit("mouse_move")))
+  {
+   F32 x = f64_from_s8(linux_headless_consume_token(&line));
+   F32 y = f64_from_s8(linux_headless_consume_token(&line));
+   scripted->event = platform_mouse_move_event(x, y);
+  }
+  else if (s8_match(kind, s8_lit("key_press")))
+  {
+   Key key = linux_headless_key_from_s8(linux_headless_consume_token(&line));
+   InputModifiers modifiers = linux_headless_modifiers_from_s8(linux_headless_consume_token(&line));
+   scripted->event = platform_key_press_event(key, modifiers);
+  }
+  else if (s8_match(kind, s8_lit("key_release")))
+  {
+   Key key = linux_headless_key_from_s8(linux_headless_consume_token(&line));
+   InputModifiers modifiers = linux_headless_modifiers_from_s8(linux_headless_consume_token(&line));
+   scripted->event = platform_key_release_event(key, modifiers);
+  }
+  else if (s8_match(kind, s8_lit("key_typed")))
+  {
+   S8 character = linux_headless_consume_token(&line);
+   scripted->event = platform_key_typed_event(consume_utf8_from_string(character, 0).codepoint);
+  }
+  else if (s8_match(kind, s8_lit("mouse_press")) ||
+           s8_match(kind, s8_lit("mouse_release")))
+  {
+   MouseButton button = linux_headless_mouse_button_from_s8(linux_headless_consume_token(&line));
+   F32 x = f64_from_s8(linux_headless_consume_token(&line));
+   F32 y = f64_from_s8(linux_headless_consume_token(&line));
+   InputModifiers modifiers = linux_headless_modifiers_from_s8(linux_headless_consume_token(&line));
+   if (s8_match(kind, s8_lit("mouse_press")))
+   {
+    scripted->event = platform_mouse_press_event(button, x, y, modifiers);
+   }
+   else
+   {
+    scripted->event = platform_mouse_release_event(button, x, y, modifiers);
+   }
+  }
+  else if (s8_match(kind, s8_lit("mouse_scroll")))
+  {
+   I32 h = f64_from_s8(linux_headless_consume_token(&line));
+   I32 v = f64_from_s8(linux_headless_consume_token(&line));
+   scripted->event = platform_mouse_scroll_event(h, v, 0, 0, 0);
+  }
+  else if (s8_match(kind, s8_lit("window_resize")))
+  {
+   U32 w = f64_from_s8(linux_headless_consume_token(&line));
+   U32 h = f64_from_s8(linux_headless_consume_token(&line));
+   scripted->event = platform_resize_event(w, h);
+  }
+  else if (s8_match(kind, s8_lit("benchmark_entities")))
+  {
+   scripted->benchmark_entity_count = f64_from_s8(linux_headless_consume_token(&line));
+  }
+  else if (s8_match(kind, s8_lit("quit")))
+  {
+   scripted->is_quit = true;
+  }
+  else
+  {
+   fprintf(stderr, "%.*s:%u: unknown event '%.*s'\n", unravel_s8(path), line_number, unravel_s8(kind));
+   continue;
+  }
+  
+  *last = scripted;
+  last = &scripted->next;
+ }
+ 
+ return result;
+}
+
+//
+// NOTE(tbt): software framebuffer
+//~
+
+internal void
+linux_headless_resize_software_framebuffer(U32 w,
+                                           U32 h)
+{
+ free(global_software_framebuffer.pixels);
+ global_software_framebuffer.pixels = calloc((U64)w * (U64)h, sizeof(U32));
+ global_software_framebuffer.w = w;
+ global_software_framebuffer.h = h;
+}
+
+// NOTE(tbt): write the framebuffer out as a binary PPM, for use as a reference image
+internal void
+linux_headless_write_software_framebuffer(S8 path)
+{
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_write |
+                                            PLATFORM_OPEN_FILE_always_create);
+ if (file)
+ {
+  arena_temporary_memory(&global_platform_layer_frame_memory)
+  {
+   S8 header = s8_from_format_string(&global_platform_layer_frame_memory,
+                                     "P6\n%u %u\n255\n",
+                                     global_software_framebuffer.w,
+                                     global_software_framebuffer.h);
+   platform_write_to_file_f(file, header.buffer, header.size - 1);
+   
+   U64 row_size = global_software_framebuffer.w * 3;
+   U8 *row = arena_push(&global_platform_layer_frame_memory, row_size);
+   for (U32 y = 0;
+        y < global_software_framebuffer.h;
+        ++y)
+   {
+    for (U32 x = 0;
+         x < global_software_framebuffer.w;
+         ++x)
+    {
+     U32 pixel = global_software_framebuffer.pixels[y * global_software_framebuffer.w + x];
+     row[x * 3 + 0] = (pixel >> 0) & 0xff;
+     row[x * 3 + 1] = (pixel >> 8) & 0xff;
+     row[x * 3 + 2] = (pixel >> 16) & 0xff;
+    }
+    platform_write_to_file_f(file, row, row_size);
+   }
+  }
+  platform_close_file(&file);
+ }
+}
+
+// NOTE(tbt): update the platform state the same way the windows layer does when it receives the equivalent message
+internal void
+linux_headless_process_event(PlatformEvent event)
+{
+ switch (event.kind)
+ {
+  case PLATFORM_EVENT_key_press:
+  {
+   global_platform_state.is_key_down[event.key] = true;
+   break;
+  }
+  case PLATFORM_EVENT_key_release:
+  {
+   global_platform_state.is_key_down[event.key] = false;
+   break;
+  }
+  case PLATFORM_EVENT_mouse_move:
+  {
+   global_platform_state.mouse_x = event.mouse_x;
+   global_platform_state.mouse_y = event.mouse_y;
+   break;
+  }
+  case PLATFORM_EVENT_mouse_press:
+  case PLATFORM_EVENT_mouse_release:
+  {
+   global_platform_state.is_mouse_button_down[event.mouse_button] = (event.kind == PLATFORM_EVENT_mouse_press);
+   global_platform_state.mouse_x = event.mouse_x;
+   global_platform_state.mouse_y = event.mouse_y;
+   break;
+  }
+  case PLATFORM_EVENT_mouse_scroll:
+  {
+   global_platform_state.mouse_scroll_h = event.mouse_scroll_h;
+   global_platform_state.mouse_scroll_v = event.mouse_scroll_v;
+   event.mouse_x = global_platform_state.mouse_x;
+   event.mouse_y = global_platform_state.mouse_y;
+   break;
+  }
+  case PLATFORM_EVENT_window_resize:
+  {
+   global_platform_state.window_w = event.window_w;
+   global_platform_state.window_h = event.window_h;
+   if (global_software_framebuffer.pixels)
+   {
+    linux_headless_resize_software_framebuffer(event.window_w, event.window_h);
+   }
+   break;
+  }
+  default: break;
+ }
+ 
+ linux_headless_push_platform_event(event);
+}
+
+//
+// NOTE(tbt): benchmark summary
+//~
+
+internal int
+linux_headless_compare_f64(const void *a,
+                           const void *b)
+{
+ F64 _a = *(F64 *)a;
+ F64 _b = *(F64 *)b;
+ return (_a > _b) - (_a < _b);
+}
+
+// NOTE(tbt): one line of JSON describing the whole run, so results from different builds can be diffed by a script
+internal void
+linux_headless_write_summary(S8 path,
+                             U8 *input_path,
+                             F64 *frame_times,
+                             U64 frames_run,
+                             U64 total_draw_calls,
+                             U64 max_draw_calls,
+                             U64 total_blur_passes,
+                             U64 total_blur_passes_saved,
+                             U64 max_render_target_bytes,
+                             U64 total_render_target_allocations,
+                             GameStats *stats)
+{
+ F64 total_frame_time = 0.0;
+ for (U64 i = 0;
+      i < frames_run;
+      ++i)
+ {
+  total_frame_time += frame_times[i];
+ }
+ 
+ qsort(frame_times, frames_run, sizeof(frame_times[0]), linux_headless_compare_f64);
+ 
+ F64 mean_ms = frames_run ? total_frame_time * 1000.0 / frames_run : 0.0;
+ F64 p99_ms = frames_run ? frame_times[(frames_run * 99 + 99) / 100 - 1] * 1000.0 : 0.0;
+ F64 max_ms = frames_run ? frame_times[frames_run - 1] * 1000.0 : 0.0;
+ 
+ arena_temporary_memory(&global_platform_layer_frame_memory)
+ {
+  S8 summary = s8_from_format_string(&global_platform_layer_frame_memory,
+                                     "{\"input\":\"%s\",\"frames\":%lu,"
+                                     "\"mean_ms\":%.4f,\"p99_ms\":%.4f,\"max_ms\":%.4f,"
+                                     "\"mean_draw_calls\":%.2f,\"max_draw_calls\":%lu,"
+                                     "\"mean_blur_passes\":%.2f,\"mean_blur_passes_saved\":%.2f,"
+                                     "\"max_render_target_bytes\":%lu,\"render_target_allocations\":%lu,"
+                                     "\"static_memory_high_water_mark\":%lu,"
+                                     "\"frame_memory_high_water_mark\":%lu,"
+                                     "\"level_memory_high_water_mark\":%lu,"
+                                     "\"temp_memory_high_water_mark\":%lu}\n",
+                                     input_path ? input_path : (U8 *)"",
+                                     frames_run,
+                                     mean_ms,
+                                     p99_ms,
+                                     max_ms,
+                                     frames_run ? (F64)total_draw_calls / frames_run : 0.0,
+                                     max_draw_calls,
+                                     frames_run ? (F64)total_blur_passes / frames_run : 0.0,
+                                     frames_run ? (F64)total_blur_passes_saved / frames_run : 0.0,
+                                     max_render_target_bytes,
+                                     total_render_target_allocations,
+                                     stats->static_memory_high_water_mark,
+                                     stats->frame_memory_high_water_mark,
+                                     stats->level_memory_high_water_mark,
+                                     stats->temp_memory_high_water_mark);
+  
+  // NOTE(tbt): s8_from_format_string counts the nul terminator
+  platform_append_to_file_p(path, summary.buffer, summary.size - 1);
+ }
+}
+
+//
+// NOTE(tbt): entry point
+//~
+
+I32
+main(I32 argc,
+     U8 **argv)
+{
+ OpenGLFunctions gl;
+ 
+ U8 *game_path = "./liblucerna.so";
+ U8 *script_path = NULL;
+ U8 *replay_path = NULL;
+ U8 *record_path = NULL;
+ U8 *summary_path = NULL;
+ U8 *dump_path = NULL;
+ B32 software = false;
+ B32 is_saving_disabled = false;
+ U64 frame_count = 600;
+ B32 is_frame_count_set = false;
+ I32 worker_count = -1;
+ F64 frametime_in_s = 1.0 / 60.0;
+ B32 use_recorded_frametime = false;
+ U32 window_w = DEFAULT_WINDOW_WIDTH;
+ U32 window_h = DEFAULT_WINDOW_HEIGHT;
+ 
+ for (I32 i = 1;
+      i < argc;
+      ++i)
+ {
+  S8 arg = s8(argv[i]);
+  S8 value = arg;
+  while (value.size && value.buffer[0] != '=') { value.buffer += 1; value.size -= 1; }
+  if (value.size) { value.buffer += 1; value.size -= 1; }
+  
+  if (0 == strncmp(arg.buffer, "--frames=", 9))
+  {
+   frame_count = f64_from_s8(value);
+   is_frame_count_set = true;
+  }
+  else if (0 == strcmp(arg.buffer, "--dt=recorded"))
+  {
+   use_recorded_frametime = true;
+  }
+  else if (0 == strncmp(arg.buffer, "--dt=", 5))
+  {
+   frametime_in_s = f64_from_s8(value);
+  }
+  else if (0 == strncmp(arg.buffer, "--width=", 8))
+  {
+   window_w = f64_from_s8(value);
+  }
+  else if (0 == strncmp(arg.buffer, "--height=", 9))
+  {
+   window_h = f64_from_s8(value);
+  }
+  else if (0 == strncmp(arg.buffer, "--script=", 9))
+  {
+   script_path = value.buffer;
+  }
+  else if (0 == strncmp(arg.buffer, "--replay=", 9))
+  {
+   replay_path = value.buffer;
+  }
+  else if (0 == strncmp(arg.buffer, "--record=", 9))
+  {
+   record_path = value.buffer;
+  }
+  else if (0 == strncmp(arg.buffer, "--summary=", 10))
+  {
+   summary_path = value.buffer;
+  }
+  else if (0 == strncmp(arg.buffer, "--dump=", 7))
+  {
+   dump_path = value.buffer;
+   software = true;
+  }
+  else if (0 == strcmp(arg.buffer, "--software"))
+  {
+   software = true;
+  }
+  else if (0 == strcmp(arg.buffer, "--no-saving"))
+  {
+   is_saving_disabled = true;
+  }
+  else if (0 == strncmp(arg.buffer, "--workers=", 10))
+  {
+   worker_count = f64_from_s8(value);
+  }
+  else if (0 == strncmp(arg.buffer, "--game=", 7))
+  {
+   game_path = value.buffer;
+  }
+  else
+  {
+   fprintf(stderr, "Ignoring unrecognised option %s\n", argv[i]);
+  }
+ }
+ 
+ initialise_arena_with_new_memory(&global_platform_layer_frame_memory, PLATFORM_LAYER_FRAME_MEMORY_SIZE);
+ initialise_arena_with_new_memory(&global_platform_layer_static_memory, PLATFORM_LAYER_STATIC_MEMORY_SIZE);
+ 
+ // NOTE(tbt): recursive to match the semantics of a CRITICAL_SECTION on windows
+ pthread_mutexattr_t audio_lock_attributes;
+ pthread_mutexattr_init(&audio_lock_attributes);
+ pthread_mutexattr_settype(&audio_lock_attributes, PTHREAD_MUTEX_RECURSIVE);
+ pthread_mutex_init(&global_audio_lock, &audio_lock_attributes);
+ 
+ // NOTE(tbt): one worker for each core, other than the one the main thread is running on
+ if (worker_count < 0)
+ {
+  worker_count = max_i(sysconf(_SC_NPROCESSORS_ONLN) - 1, 0);
+ }
+ linux_headless_start_workers(worker_count);
+ 
+ //
+ // NOTE(tbt): load game shared object
+ //~
+ 
+ void *game = dlopen(game_path, RTLD_NOW);
+ if (!game)
+ {
+  fprintf(stderr, "could not load game '%s' - %s\n", game_path, dlerror());
+  return -1;
+ }
+ 
+ game_init = (GameInit)dlsym(game, "game_init");
+ game_update_and_render = (GameUpdateAndRender)dlsym(game, "game_update_and_render");
+ game_audio_callback = (GameAudioCallback)dlsym(game, "game_audio_callback");
+ game_cleanup = (GameCleanup)dlsym(game, "game_cleanup");
+ GameGetStats game_get_stats = (GameGetStats)dlsym(game, "game_get_stats");
+ GameLoadBenchmarkLevel game_load_benchmark_level = (GameLoadBenchmarkLevel)dlsym(game, "game_load_benchmark_level");
+ GameDisableLevelSaving game_disable_level_saving = (GameDisableLevelSaving)dlsym(game, "game_disable_level_saving");
+ 
+ assert(game_init);
+ assert(game_update_and_render);
+ assert(game_audio_callback);
+ assert(game_cleanup);
+ 
+ ScriptedEvent *scripted_events = NULL;
+ if (script_path)
+ {
+  scripted_events = linux_headless_load_event_script(&global_platform_layer_static_memory, s8(script_path));
+ }
+ 
+ S8 replay = {0};
+ U64 replay_offset = sizeof(ReplayHeader);
+ if (replay_path)
+ {
+  replay = platform_map_entire_file_p(s8(replay_path));
+  if (!replay_is_valid(replay))
+  {
+   fprintf(stderr, "'%s' is not a replay\n", replay_path);
+   return -1;
+  }
+  
+  // NOTE(tbt): play the whole replay unless told otherwise
+  if (!is_frame_count_set)
+  {
+   frame_count = ~((U64)0);
+  }
+ }
+ 
+ PlatformFile *record_file = NULL;
+ if (record_path)
+ {
+  record_file = platform_open_file_ex(s8(record_path),
+                                      PLATFORM_OPEN_FILE_write |
+                                      PLATFORM_OPEN_FILE_always_create);
+  if (record_file)
+  {
+   ReplayHeader header = { .magic = REPLAY_MAGIC, .version = REPLAY_VERSION, };
+   platform_write_to_file_f(record_file, &header, sizeof(header));
+  }
+ }
+ 
+ global_platform_state.window_w = window_w;
+ global_platform_state.window_h = window_h;
+ 
+ linux_headless_load_all_opengl_functions(&gl);
+ 
+ // NOTE(tbt): OpenGL is still stubbed, the software renderer just means frames actually get drawn
+ PlatformFramebuffer *software_framebuffer = NULL;
+ if (software)
+ {
+  linux_headless_resize_software_framebuffer(window_w, window_h);
+  software_framebuffer = &global_software_framebuffer;
+ }
+ 
+ game_init(&gl, software_framebuffer);
+ 
+ if (is_saving_disabled && game_disable_level_saving) { game_disable_level_saving(); }
+ 
+ // NOTE(tbt): enough for a few frames of 16 bit stereo samples, even at a long timestep
+ U64 audio_buffer_size = 4 * AUDIO_SAMPLERATE;
+ I16 *audio_buffer = arena_push(&global_platform_layer_static_memory, audio_buffer_size);
+ F64 audio_samples_owed = 0.0;
+ 
+ //
+ // NOTE(tbt): main loop
+ //~
+ 
+ F64 total_frame_time = 0.0;
+ F64 min_frame_time = 0.0;
+ F64 max_frame_time = 0.0;
+ U64 frames_run = 0;
+ 
+ U64 total_draw_calls = 0;
+ U64 max_draw_calls = 0;
+ U64 total_blur_passes = 0;
+ U64 total_blur_passes_saved = 0;
+ U64 max_render_target_bytes = 0;
+ U64 total_render_target_allocations = 0;
+ 
+ // NOTE(tbt): kept for every frame so the summary can work out percentiles
+ F64 *frame_times = NULL;
+ U64 frame_times_capacity = 0;
+ 
+ fprintf(stdout, "frame,update_ms,audio_ms,draw_calls,bytes_uploaded\n");
+ 
+ for (U64 frame_index = 0;
+      frame_index < frame_count && global_running;
+      ++frame_index)
+ {
+  global_platform_state.mouse_scroll_h = 0;
+  global_platform_state.mouse_scroll_v = 0;
+  global_platform_state.events = NULL;
+  
+  while (scripted_events &&
+         scripted_events->frame <= frame_index)
+  {
+   if (scripted_events->is_quit)
+   {
+    platform_quit();
+   }
+   else if (scripted_events->benchmark_entity_count)
+   {
+    if (game_load_benchmark_level) { game_load_benchmark_level(scripted_events->benchmark_entity_count); }
+   }
+   else
+   {
+    linux_headless_process_event(scripted_events->event);
+   }
+   scripted_events = scripted_events->next;
+  }
+  
+  F64 recorded_frametime_in_s;
+  if (replay.buffer)
+  {
+   U32 previous_window_w = global_platform_state.window_w;
+   U32 previous_window_h = global_platform_state.window_h;
+   
+   if (!replay_read_frame(&global_platform_layer_frame_memory, replay, &replay_offset, &global_platform_state, &recorded_frametime_in_s))
+   {
+    break;
+   }
+   
+   if (use_recorded_frametime)
+   {
+    frametime_in_s = recorded_frametime_in_s;
+   }
+   
+   if (global_software_framebuffer.pixels &&
+       (previous_window_w != global_platform_state.window_w ||
+        previous_window_h != global_platform_state.window_h))
+   {
+    linux_headless_resize_software_framebuffer(global_platform_state.window_w, global_platform_state.window_h);
+   }
+  }
+  
+  if (record_file)
+  {
+   S8 frame = replay_s8_from_frame(&global_platform_layer_frame_memory, &global_platform_state, frametime_in_s);
+   platform_write_to_file_f(record_file, frame.buffer, frame.size);
+  }
+  
+  global_headless_gl.draw_calls = 0;
+  global_headless_gl.bytes_uploaded = 0;
+  
+  F64 start_time = platform_get_time();
+  
+  game_update_and_render(&global_platform_state, frametime_in_s);
+  
+  F64 update_end_time = platform_get_time();
+  
+  // NOTE(tbt): pull exactly one timestep worth of audio so the mixer runs at the same rate as the game
+  audio_samples_owed += frametime_in_s * AUDIO_SAMPLERATE;
+  U64 audio_samples = min_u(audio_samples_owed, audio_buffer_size / (2 * sizeof(I16)));
+  audio_samples_owed -= audio_samples;
+  game_audio_callback(audio_buffer, audio_samples * 2 * sizeof(I16));
+  
+  F64 end_time = platform_get_time();
+  
+  arena_free_all(&global_platform_layer_frame_memory);
+  
+  F64 frame_time = end_time - start_time;
+  total_frame_time += frame_time;
+  if (0 == frames_run || frame_time < min_frame_time) { min_frame_time = frame_time; }
+  if (0 == frames_run || frame_time > max_frame_time) { max_frame_time = frame_time; }
+  
+  if (summary_path)
+  {
+   if (frames_run == frame_times_capacity)
+   {
+    frame_times_capacity = max_u(frame_times_capacity * 2, 1024);
+    frame_times = realloc(frame_times, frame_times_capacity * sizeof(frame_times[0]));
+   }
+   frame_times[frames_run] = frame_time;
+   
+   GameStats stats = {0};
+   if (game_get_stats) { game_get_stats(&stats); }
+   total_draw_calls += stats.draw_call_count;
+   max_draw_calls = max_u(max_draw_calls, stats.draw_call_count);
+   total_blur_passes += stats.blur_pass_count;
+   total_blur_passes_saved += stats.blur_passes_saved;
+   max_render_target_bytes = max_u(max_render_target_bytes, stats.render_target_bytes);
+   total_render_target_allocations += stats.render_target_allocation_count;
+  }
+  
+  frames_run += 1;
+  
+  fprintf(stdout, "%lu,%.4f,%.4f,%lu,%lu\n",
+          frame_index,
+          (update_end_time - start_time) * 1000.0,
+          (end_time - update_end_time) * 1000.0,
+          global_headless_gl.draw_calls,
+          global_headless_gl.bytes_uploaded);
+ }
+ 
+ game_cleanup();
+ 
+ if (record_file)
+ {
+  platform_close_file(&record_file);
+ }
+ 
+ if (summary_path)
+ {
+  GameStats stats = {0};
+  if (game_get_stats) { game_get_stats(&stats); }
+  linux_headless_write_summary(s8(summary_path),
+                               replay_path ? replay_path : script_path,
+                               frame_times,
+                               frames_run,
+                               total_draw_calls,
+                               max_draw_calls,
+                               total_blur_passes,
+                               total_blur_passes_saved,
+                               max_render_target_bytes,
+                               total_render_target_allocations,
+                               &stats);
+ }
+ 
+ if (dump_path)
+ {
+  linux_headless_write_software_framebuffer(s8(dump_path));
+ }
+ 
+ if (frames_run)
+ {
+  fprintf(stderr,
+          "%lu frames - mean %.4fms, min %.4fms, max %.4fms\n",
+          frames_run,
+          total_frame_time * 1000.0 / frames_run,
+          min_frame_time * 1000.0,
+          max_frame_time * 1000.0);
+ }
+ 
+ dlclose(game);
+ 
+ return 0;
+}
@@ -3,6 +3,7 @@
 #include <dsound.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "lucerna_common.c"
@@ -353,6 +354,117 @@ platform_append_to_file_p(S8 path,
  return result;
 }
 
+B32
+platform_write_entire_file_atomic_p(S8 path,
+                                    void *buffer,
+                                    U64 buffer_size)
+{
+ B32 result = false;
+ 
+ I8 path_cstr[MAX_PATH];
+ I8 temporary_path_cstr[MAX_PATH];
+ if (snprintf(path_cstr, sizeof(path_cstr), "%.*s", unravel_s8(path)) < sizeof(path_cstr) &&
+     snprintf(temporary_path_cstr, sizeof(temporary_path_cstr), "%.*s.tmp", unravel_s8(path)) < sizeof(temporary_path_cstr))
+ {
+  HANDLE file = CreateFileA(temporary_path_cstr,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+  if (INVALID_HANDLE_VALUE != file)
+  {
+   U64 bytes_written = 0;
+   while (bytes_written < buffer_size)
+   {
+    DWORD chunk_size = (DWORD)min_u(buffer_size - bytes_written, 1 << 30);
+    DWORD chunk_bytes_written = 0;
+    if (0 == WriteFile(file, (U8 *)buffer + bytes_written, chunk_size, &chunk_bytes_written, NULL) ||
+        0 == chunk_bytes_written)
+    {
+     break;
+    }
+    bytes_written += chunk_bytes_written;
+   }
+   
+   result = (bytes_written == buffer_size && FlushFileBuffers(file));
+   CloseHandle(file);
+   
+   if (result)
+   {
+    result = MoveFileExA(temporary_path_cstr, path_cstr, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+   }
+   
+   if (!result)
+   {
+    DeleteFileA(temporary_path_cstr);
+   }
+  }
+ }
+ 
+ if (result)
+ {
+  debug_log("successfully wrote to file '%s'\n", path_cstr);
+ }
+ else
+ {
+  debug_log("failure writing file '%.*s' - ", unravel_s8(path));
+  windows_print_error("platform_write_entire_file_atomic_p");
+ }
+ 
+ return result;
+}
+
+S8
+platform_map_entire_file_p(S8 path)
+{
+ S8 result = {0};
+ 
+ PlatformFile *file = platform_open_file_ex(path,
+                                            PLATFORM_OPEN_FILE_read | PLATFORM_OPEN_FILE_never_create);
+ U64 size = platform_get_file_size_f(file);
+ if (file &&
+     size > 0)
+ {
+  // NOTE(tbt): the view keeps the file open, so the handles can be closed straight away
+  HANDLE mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping)
+  {
+   void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (view)
+   {
+    result.buffer = view;
+    result.size = size;
+   }
+   else
+   {
+    windows_print_error("MapViewOfFile");
+   }
+   CloseHandle(mapping);
+  }
+  else
+  {
+   windows_print_error("CreateFileMappingA");
+  }
+ }
+ platform_close_file(&file);
+ 
+ return result;
+}
+
+void
+platform_unmap_file(S8 *file)
+{
+ if (file &&
+     file->buffer)
+ {
+  UnmapViewOfFile(file->buffer);
+  file->buffer = NULL;
+  file->size = 0;
+ }
+}
+
 //
 // NOTE(tbt): OpenGL loading
 //~
@@ -439,7 +551,7 @@ windows_load_all_opengl_functions(OpenGLFunctions *result)
 {
  HMODULE opengl32;
  opengl32 = LoadLibraryA("opengl32.dll");
-#define gl_func(_type, _name) result-> ## _name = (PFNGL ## _type ## PROC)windows_load_opengl_function(opengl32, "gl" #_name)
+#define gl_func(_type, _name) result->_name = (PFNGL ## _type ## PROC)windows_load_opengl_function(opengl32, "gl" #_name)
 #include "gl_funcs.h"
  
  FreeModule(opengl32);
@@ -553,6 +665,16 @@ platform_toggle_fullscreen(void)
  }
 }
 
+internal LARGE_INTEGER global_clock_frequency;
+
+F64
+platform_get_time(void)
+{
+ LARGE_INTEGER now;
+ QueryPerformanceCounter(&now);
+ return (F64)now.QuadPart / (F64)global_clock_frequency.QuadPart;
+}
+
 void
 platform_quit(void)
 {
@@ -928,6 +1050,211 @@ window_proc(HWND window_handle,
  return result;
 }
 
+//
+// NOTE(tbt): worker threads
+//~
+
+#define WINDOWS_MAX_WORKERS 31
+#define WINDOWS_BACKGROUND_WORKERS 2
+#define WINDOWS_WORK_QUEUE_SIZE 256
+
+typedef struct
+{
+ PlatformWorkFunction function;
+ void *data;
+} WindowsWorkEntry;
+
+// NOTE(tbt): single producer, multiple consumer ring buffer
+typedef struct
+{
+ WindowsWorkEntry entries[WINDOWS_WORK_QUEUE_SIZE];
+ volatile LONG next_entry_to_write;
+ volatile LONG next_entry_to_read;
+ volatile LONG completion_goal;
+ volatile LONG completion_count;
+ HANDLE semaphore;
+ U32 worker_count;
+} WindowsWorkQueue;
+
+internal WindowsWorkQueue global_work_queue;
+internal WindowsWorkQueue global_background_work_queue;
+
+internal __declspec(thread) U32 global_thread_index = 0;
+
+// NOTE(tbt): returns true if there was nothing to do
+internal B32
+windows_do_next_work_entry(WindowsWorkQueue *queue)
+{
+ B32 result = false;
+ 
+ LONG original_next_entry_to_read = queue->next_entry_to_read;
+ LONG new_next_entry_to_read = (original_next_entry_to_read + 1) % WINDOWS_WORK_QUEUE_SIZE;
+ 
+ if (original_next_entry_to_read != queue->next_entry_to_write)
+ {
+  // NOTE(tbt): the entry is read before the CAS, which hands its slot back to the producer to be overwritten
+  //            - only used if the CAS succeeds, in which case nobody can have written to the slot since it was read
+  WindowsWorkEntry entry = queue->entries[original_next_entry_to_read];
+  
+  if (InterlockedCompareExchange(&queue->next_entry_to_read,
+                                 new_next_entry_to_read,
+                                 original_next_entry_to_read) == original_next_entry_to_read)
+  {
+   entry.function(entry.data);
+   InterlockedIncrement(&queue->completion_count);
+  }
+ }
+ else
+ {
+  result = true;
+ }
+ 
+ return result;
+}
+
+internal DWORD WINAPI
+windows_worker_thread_main(LPVOID arg)
+{
+ global_thread_index = (U32)(uintptr_t)arg;
+ 
+ WindowsWorkQueue *queue = global_thread_index > global_work_queue.worker_count ? &global_background_work_queue : &global_work_queue;
+ 
+ for (;;)
+ {
+  if (windows_do_next_work_entry(queue))
+  {
+   WaitForSingleObjectEx(queue->semaphore, INFINITE, FALSE);
+  }
+ }
+ 
+ return 0;
+}
+
+internal void
+windows_start_workers(void)
+{
+ SYSTEM_INFO system_info;
+ GetSystemInfo(&system_info);
+ 
+ // NOTE(tbt): one worker for each core, other than the one the main thread is running on
+ global_work_queue.worker_count = min_u(system_info.dwNumberOfProcessors - 1, WINDOWS_MAX_WORKERS);
+ global_background_work_queue.worker_count = WINDOWS_BACKGROUND_WORKERS;
+ 
+ global_work_queue.semaphore = CreateSemaphoreEx(NULL,
+                                                 0,
+                                                 global_work_queue.worker_count + 1,
+                                                 NULL,
+                                                 0,
+                                                 SEMAPHORE_ALL_ACCESS);
+ global_background_work_queue.semaphore = CreateSemaphoreEx(NULL,
+                                                            0,
+                                                            WINDOWS_WORK_QUEUE_SIZE,
+                                                            NULL,
+                                                            0,
+                                                            SEMAPHORE_ALL_ACCESS);
+ 
+ for (U32 i = 0;
+      i < global_work_queue.worker_count;
+      ++i)
+ {
+  HANDLE thread = CreateThread(NULL, 0, windows_worker_thread_main, (LPVOID)(uintptr_t)(i + 1), 0, NULL);
+  CloseHandle(thread);
+ }
+ 
+ // NOTE(tbt): background workers are numbered after the normal workers, and run at a lower priority so they don't hold up a frame
+ for (U32 i = 0;
+      i < global_background_work_queue.worker_count;
+      ++i)
+ {
+  HANDLE thread = CreateThread(NULL, 0, windows_worker_thread_main, (LPVOID)(uintptr_t)(global_work_queue.worker_count + i + 1), 0, NULL);
+  SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+  CloseHandle(thread);
+ }
+}
+
+internal void
+windows_push_work(WindowsWorkQueue *queue,
+                  PlatformWorkFunction function,
+                  void *data)
+{
+ LONG next_entry_to_write = queue->next_entry_to_write;
+ LONG new_next_entry_to_write = (next_entry_to_write + 1) % WINDOWS_WORK_QUEUE_SIZE;
+ 
+ // NOTE(tbt): if the queue is full, or there is nobody to hand the work to, just do it now
+ if (new_next_entry_to_write == queue->next_entry_to_read ||
+     0 == queue->worker_count)
+ {
+  function(data);
+  return;
+ }
+ 
+ queue->entries[next_entry_to_write].function = function;
+ queue->entries[next_entry_to_write].data = data;
+ queue->completion_goal += 1;
+ 
+ // NOTE(tbt): make sure the entry is visible before the workers can see the new write index
+ MemoryBarrier();
+ 
+ queue->next_entry_to_write = new_next_entry_to_write;
+ ReleaseSemaphore(queue->semaphore, 1, NULL);
+}
+
+internal void
+windows_complete_all_work(WindowsWorkQueue *queue)
+{
+ while (queue->completion_goal != queue->completion_count)
+ {
+  windows_do_next_work_entry(queue);
+ }
+ 
+ queue->completion_goal = 0;
+ queue->completion_count = 0;
+}
+
+void
+platform_push_work(PlatformWorkFunction function,
+                   void *data)
+{
+ windows_push_work(&global_work_queue, function, data);
+}
+
+void
+platform_complete_all_work(void)
+{
+ windows_complete_all_work(&global_work_queue);
+}
+
+void
+platform_push_background_work(PlatformWorkFunction function,
+                              void *data)
+{
+ windows_push_work(&global_background_work_queue, function, data);
+}
+
+B32
+platform_is_background_work_complete(void)
+{
+ return global_background_work_queue.completion_goal == global_background_work_queue.completion_count;
+}
+
+void
+platform_complete_all_background_work(void)
+{
+ windows_complete_all_work(&global_background_work_queue);
+}
+
+U32
+platform_get_worker_count(void)
+{
+ return global_work_queue.worker_count;
+}
+
+U32
+platform_get_thread_index(void)
+{
+ return global_thread_index;
+}
+
 //
 // NOTE(tbt): audio
 //~
@@ -1125,10 +1452,13 @@ WinMain(HINSTANCE hInstance,
  B32 recreate_context;
  HDC device_context;
  HGLRC render_context;
- LARGE_INTEGER clock_frequency;
  
  initialise_arena_with_new_memory(&global_platform_layer_frame_memory, PLATFORM_LAYER_FRAME_MEMORY_SIZE);
  
+ QueryPerformanceFrequency(&global_clock_frequency);
+ 
+ windows_start_workers();
+ 
  //
  // NOTE(tbt): load game dll
  //~
@@ -1357,7 +1687,21 @@ WinMain(HINSTANCE hInstance,
  
  platform_set_vsync(true);
  
- game_init(&gl);
+ game_init(&gl, NULL);
+ 
+ // NOTE(tbt): `platform_windows.exe --record=<path>` saves the input for every frame, to be played back by the headless platform layer
+ PlatformFile *record_file = NULL;
+ if (0 == strncmp(pCmdLine, "--record=", 9))
+ {
+  record_file = platform_open_file_ex(s8(pCmdLine + 9),
+                                      PLATFORM_OPEN_FILE_write |
+                                      PLATFORM_OPEN_FILE_always_create);
+  if (record_file)
+  {
+   ReplayHeader header = { .magic = REPLAY_MAGIC, .version = REPLAY_VERSION, };
+   platform_write_to_file_f(record_file, &header, sizeof(header));
+  }
+ }
  
  //
  // NOTE(tbt): setup audio thread
@@ -1371,8 +1715,6 @@ WinMain(HINSTANCE hInstance,
  //~
  
  
- QueryPerformanceFrequency(&clock_frequency);
- 
  LARGE_INTEGER start_time = {0}, end_time = {0};
  F64 frametime_in_s = 0.0;
  
@@ -1394,15 +1736,26 @@ WinMain(HINSTANCE hInstance,
   
   SwapBuffers(device_context);
   
+  if (record_file)
+  {
+   S8 frame = replay_s8_from_frame(&global_platform_layer_frame_memory, &global_platform_state, frametime_in_s);
+   platform_write_to_file_f(record_file, frame.buffer, frame.size);
+  }
+  
   game_update_and_render(&global_platform_state, frametime_in_s);
   
   arena_free_all(&global_platform_layer_frame_memory);
   
   QueryPerformanceCounter(&end_time);
-  frametime_in_s = (F64)(end_time.QuadPart - start_time.QuadPart) / (F64)clock_frequency.QuadPart;
+  frametime_in_s = (F64)(end_time.QuadPart - start_time.QuadPart) / (F64)global_clock_frequency.QuadPart;
  }
  
  game_cleanup();
  
+ if (record_file)
+ {
+  platform_close_file(&record_file);
+ }
+ 
  FreeModule(game);
 }
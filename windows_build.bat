@@ -34,7 +34,7 @@ SET sources=..\source\lucerna_game.c
 
 SET common_compiler_flags=/nologo /utf-8 /I..\include
 
-SET common_linker_flags=/subsystem:windows /INCREMENTAL:NO /nologo platform_windows.lib /dll /EXPORT:game_init /EXPORT:game_update_and_render /EXPORT:game_audio_callback /EXPORT:game_cleanup /out:lucerna.dll
+SET common_linker_flags=/subsystem:windows /INCREMENTAL:NO /nologo platform_windows.lib /dll /EXPORT:game_init /EXPORT:game_update_and_render /EXPORT:game_audio_callback /EXPORT:game_cleanup /EXPORT:game_get_stats /out:lucerna.dll
 
 
 SET compiler_flags=%release_compiler_flags%
@@ -0,0 +1,14 @@
+@echo off
+
+PUSHD bin
+ECHO:
+ECHO ~~~~~~~~~~~~~~~~~~~~~ BUILDING ASSET PACKER ~~~~~~~~~~~~~~~~~~~~~
+CL /nologo /O2 /I..\include ..\source\lucerna_asset_packer.c /link /subsystem:console /INCREMENTAL:NO /out:asset_packer.exe
+
+DEL *.obj
+
+ECHO:
+ECHO ~~~~~~~~~~~~~~~~~~~~~~~~~ PACKING ASSETS ~~~~~~~~~~~~~~~~~~~~~~~~~
+asset_packer.exe ../assets lucerna.pack
+
+POPD